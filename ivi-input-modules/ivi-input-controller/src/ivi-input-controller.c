@@ -196,15 +196,7 @@ static struct ivisurface *
 input_ctrl_get_surf_ctx(struct input_context *ctx,
         struct ivi_layout_surface *lyt_surf)
 {
-    struct ivisurface *surf_ctx = NULL;
-    struct ivisurface *ret_ctx = NULL;
-    wl_list_for_each(surf_ctx, &ctx->ivishell->list_surface, link) {
-        if (lyt_surf == surf_ctx->layout_surface) {
-            ret_ctx = surf_ctx;
-            break;
-        }
-    }
-    return ret_ctx;
+    return ivi_shell_get_surface(ctx->ivishell, lyt_surf);
 }
 
 
@@ -212,11 +204,7 @@ static struct ivisurface *
 input_ctrl_get_surf_ctx_from_id(struct input_context *ctx,
         uint32_t ivi_surf_id)
 {
-    const struct ivi_layout_interface *interface = ctx->ivishell->interface;
-    struct ivi_layout_surface *lyt_surf;
-    lyt_surf = interface->get_surface_from_id(ivi_surf_id);
-
-    return input_ctrl_get_surf_ctx(ctx, lyt_surf);
+    return ivi_shell_get_surface_from_id(ctx->ivishell, ivi_surf_id);
 }
 
 
@@ -64,6 +64,28 @@ t_ilm_bool ilm_isInitialized(void);
  */
 ilmErrorTypes ilm_commitChanges(void);
 
+/**
+ * \brief Commit all changes like ilm_commitChanges, without waiting for them
+ *        to be applied. The call returns as soon as the commit is sent, and
+ *        other ilm calls can be made while it is in flight.
+ *        The callback is invoked from the ilm event dispatching, usually the
+ *        ilm control thread, once the compositor has repainted with the
+ *        committed changes. frameTime is the frame time of that repaint in
+ *        milliseconds, or 0 if the compositor can not report it.
+ *        If the connection is closed before completion, the callback is
+ *        invoked with ILM_ERROR_ON_CONNECTION.
+ * \ingroup ilmCommon
+ * \param[in] callback pointer to function to be called on completion
+              callback function is defined as:
+              void cb(ilmErrorTypes result, t_ilm_uint frameTime, void *user_data)
+ * \param[in] user_data pointer to data which will be passed to the callback
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if callback is NULL
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_commitChangesAsync(commitNotificationFunc callback,
+                                     void *user_data);
+
 /**
  * \brief register for notification on an event of ilm shutdown
  * \ingroup ilmCommon
@@ -80,6 +102,9 @@ ilmErrorTypes ilm_registerShutdownNotification(shutdownNotificationFunc callback
 /**
  * \brief Destroys the IVI LayerManagement Client.
  * \ingroup ilmCommon
+ *
+ * This unmaps the scene mirror. No thread may be inside or call one of
+ * the ilm_*FromMirror functions while or after ilm_destroy runs.
  * \return ILM_SUCCESS if the method call was successful
  * \return ILM_FAILED if the client can not be closed or was not initialized.
  */
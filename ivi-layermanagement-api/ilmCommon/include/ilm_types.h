@@ -126,6 +126,20 @@ typedef enum e_ilmSurfaceType
     ILM_SURFACETYPE_DESKTOP = 1,                     /*!< SurfaceType value, to describe a desktop compatible surface*/
 } ilmSurfaceType;
 
+/**
+ * \brief Enumeration for the row filters of png screenshots
+ * \ingroup ilmControl
+ **/
+typedef enum e_ilmPngFilter
+{
+    ILM_PNG_FILTER_NONE = 0,           /*!< rows are stored unfiltered */
+    ILM_PNG_FILTER_SUB = 1,            /*!< difference to the left pixel */
+    ILM_PNG_FILTER_UP = 2,             /*!< difference to the pixel above */
+    ILM_PNG_FILTER_AVERAGE = 3,        /*!< difference to the mean of left and above */
+    ILM_PNG_FILTER_PAETH = 4,          /*!< difference to the paeth predictor */
+    ILM_PNG_FILTER_ADAPTIVE = 5        /*!< best filter chosen for every row */
+} ilmPngFilter;
+
 /**
  * \brief Identifier of different input device types. Can be used as a bitmask.
  * \ingroup ilmClient
@@ -201,6 +215,24 @@ struct ilmSurfaceProperties
     ilmInputDevice focus;                   /*!< bitmask of every type of device that this surface has focus in */
 };
 
+/**
+ * \brief Typedef for representing the frame timing of a surface
+ * \ingroup ilmControl
+ *
+ * The compositor measures it over the last 128 commits of the surface.
+ * All values are 0 until the surface committed twice.
+ **/
+struct ilmSurfaceFrameStats
+{
+    t_ilm_uint frames;                  /*!< frame intervals the timing is based on */
+    t_ilm_float frameRate;              /*!< average frames per second over these intervals */
+    t_ilm_uint intervalP50;             /*!< median frame interval in microseconds */
+    t_ilm_uint intervalP95;             /*!< 95th percentile frame interval in microseconds */
+    t_ilm_uint intervalP99;             /*!< 99th percentile frame interval in microseconds */
+    t_ilm_uint intervalMax;             /*!< longest frame interval in microseconds, including the time since the last commit */
+    t_ilm_uint jitter;                  /*!< mean difference between consecutive intervals in microseconds */
+};
+
 /**
  * \brief Typedef for representing a the layer properties structure
  * \ingroup ilmControl
@@ -232,6 +264,101 @@ struct ilmScreenProperties
     t_ilm_char connectorName[256];  /*!< name of the connector of the screen */
 };
 
+/**
+ * \brief Typedef for representing a screen inside a scene snapshot
+ * \ingroup ilmControl
+ **/
+struct ilmSceneScreen
+{
+    t_ilm_display screenId;             /*!< id of the screen */
+    struct ilmScreenProperties prop;    /*!< properties, layerIds points into the snapshot */
+};
+
+/**
+ * \brief Typedef for representing a layer inside a scene snapshot
+ * \ingroup ilmControl
+ **/
+struct ilmSceneLayer
+{
+    t_ilm_layer layerId;                /*!< id of the layer */
+    struct ilmLayerProperties prop;     /*!< properties of the layer */
+    t_ilm_uint surfaceCount;            /*!< number of surfaces on the layer */
+    t_ilm_surface* surfaceIds;          /*!< render order, points into the snapshot */
+};
+
+/**
+ * \brief Typedef for representing a surface inside a scene snapshot
+ * \ingroup ilmControl
+ **/
+struct ilmSceneSurface
+{
+    t_ilm_surface surfaceId;            /*!< id of the surface */
+    struct ilmSurfaceProperties prop;   /*!< properties of the surface */
+};
+
+/**
+ * \brief Typedef for representing a snapshot of the whole scene
+ * \ingroup ilmControl
+ *
+ * The snapshot is a single contiguous allocation, all arrays point into it.
+ **/
+struct ilmScene
+{
+    t_ilm_uint screenCount;             /*!< number of entries in screens */
+    struct ilmSceneScreen* screens;     /*!< all screens */
+    t_ilm_uint layerCount;              /*!< number of entries in layers */
+    struct ilmSceneLayer* layers;       /*!< all layers, rendered or not */
+    t_ilm_uint surfaceCount;            /*!< number of entries in surfaces */
+    struct ilmSceneSurface* surfaces;   /*!< all surfaces, on layers or not */
+};
+
+/**
+ * \brief Typedef for representing a screenshot kept in memory
+ * \ingroup ilmControl
+ *
+ * buffer maps the file the compositor wrote the pixels to, fd refers to the
+ * same file. Both stay valid until ilm_releaseScreenshot is called.
+ **/
+struct ilmScreenshot
+{
+    const void* buffer;                 /*!< pixel rows, read only */
+    t_ilm_int fd;                       /*!< file descriptor of the pixel data */
+    t_ilm_uint size;                    /*!< size of the mapping in bytes */
+    t_ilm_uint width;                   /*!< image width in pixels */
+    t_ilm_uint height;                  /*!< image height in pixels */
+    t_ilm_uint stride;                  /*!< number of bytes per pixel row */
+    t_ilm_uint format;                  /*!< pixel format of type wl_shm_format */
+    t_ilm_uint timestamp;               /*!< time of the capture in milliseconds */
+};
+
+/**
+ * \brief Typedef for representing the tiles of a screenshot which changed
+ * since a previous one
+ * \ingroup ilmControl
+ *
+ * The image is cut into square tiles of tileSize pixels, row by row; tiles
+ * at the right and bottom edge are clipped to the image. changeMap has an
+ * entry for every tile, which is not 0 if the tile is contained in tiles.
+ * tiles holds the pixels of the changed tiles in the order of changeMap,
+ * each with rows of 4 bytes per pixel of the tile width.
+ **/
+struct ilmScreenshotDelta
+{
+    t_ilm_uint id;                      /*!< id to pass as base of the next delta */
+    t_ilm_uint baseId;                  /*!< screenshot the tiles apply to, 0 if all tiles are contained */
+    t_ilm_uint width;                   /*!< image width in pixels */
+    t_ilm_uint height;                  /*!< image height in pixels */
+    t_ilm_uint format;                  /*!< pixel format of type wl_shm_format */
+    t_ilm_uint timestamp;               /*!< time of the capture in milliseconds */
+    t_ilm_uint tileSize;                /*!< width and height of a tile in pixels */
+    t_ilm_uint tilesX;                  /*!< number of tile columns */
+    t_ilm_uint tilesY;                  /*!< number of tile rows */
+    t_ilm_uint changedTiles;            /*!< number of tiles contained in tiles */
+    unsigned char* changeMap;           /*!< tilesX * tilesY entries */
+    void* tiles;                        /*!< pixels of the changed tiles */
+    t_ilm_uint tilesSize;               /*!< size of tiles in bytes */
+};
+
 /**
  * enum representing the possible flags for changed properties in notification callbacks.
  */
@@ -287,4 +414,39 @@ typedef void(*notificationFunc)(ilmObjectType object,
 typedef void(*shutdownNotificationFunc)(t_ilm_shutdown_error_type error_type,
                                         int errornum,
                                         void* user_data);
+
+/**
+ * \brief Frame delivered by a capture stream
+ * \ingroup ilmControl
+ */
+struct ilmCaptureFrame
+{
+    struct ilmScreenshot image;         /*!< pixels, owned by the capture stream */
+    t_ilm_uint index;                   /*!< index of the buffer in the pool */
+    t_ilm_ulong tvSec;                  /*!< presentation time, seconds */
+    t_ilm_uint tvNsec;                  /*!< presentation time, nanoseconds */
+    t_ilm_uint dropped;                 /*!< frames missed since the previous one */
+};
+
+/**
+ * Typedef for notification callback on completion of an asynchronous commit
+ */
+typedef void(*commitNotificationFunc)(ilmErrorTypes result,
+                                        t_ilm_uint frameTime,
+                                        void* user_data);
+
+/**
+ * Typedef for notification callback on completion of an asynchronous screenshot
+ */
+typedef void(*screenshotNotificationFunc)(ilmErrorTypes result,
+                                          struct ilmScreenshot* pScreenshot,
+                                          void* user_data);
+
+/**
+ * Typedef for notification callback on frames of a capture stream
+ */
+typedef void(*captureNotificationFunc)(ilmErrorTypes result,
+                                       t_ilm_uint captureId,
+                                       const struct ilmCaptureFrame* pFrame,
+                                       void* user_data);
 #endif /* _ILM_TYPES_H_*/
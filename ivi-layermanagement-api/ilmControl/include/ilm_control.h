@@ -46,6 +46,156 @@ ilmErrorTypes ilm_getPropertiesOfSurface(t_ilm_uint surfaceID, struct ilmSurface
  */
 ilmErrorTypes ilm_getPropertiesOfLayer(t_ilm_uint layerID, struct ilmLayerProperties* pLayerProperties);
 
+/**
+ * \brief Get the frame timing of a surface from the compositor
+ * \ingroup ilmControl
+ * \param[in] surfaceID surface identifier
+ * \param[out] pStats pointer where the frame timing should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pStats is NULL
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor is older than
+ *         ivi_wm version 7
+ * \return ILM_FAILED if the surface is unknown
+ */
+ilmErrorTypes ilm_getSurfaceFrameStats(t_ilm_surface surfaceID, struct ilmSurfaceFrameStats* pStats);
+
+/**
+ * \brief Get the properties of several surfaces with a single roundtrip
+ * \ingroup ilmControl
+ * \param[in] number number of entries in pSurfaceIDs and pSurfaceProperties
+ * \param[in] pSurfaceIDs array of surface identifiers
+ * \param[out] pSurfaceProperties array where the surface properties should be
+ *             stored, entry i belongs to pSurfaceIDs[i]
+ * \return ILM_SUCCESS if the properties of all surfaces were stored
+ * \return ILM_FAILED if at least one surface is unknown, its entry is zeroed.
+ */
+ilmErrorTypes ilm_getPropertiesOfSurfaces(t_ilm_uint number,
+                                          const t_ilm_surface* pSurfaceIDs,
+                                          struct ilmSurfaceProperties* pSurfaceProperties);
+
+/**
+ * \brief Get the properties of several layers with a single roundtrip
+ * \ingroup ilmControl
+ * \param[in] number number of entries in pLayerIDs and pLayerProperties
+ * \param[in] pLayerIDs array of layer identifiers
+ * \param[out] pLayerProperties array where the layer properties should be
+ *             stored, entry i belongs to pLayerIDs[i]
+ * \return ILM_SUCCESS if the properties of all layers were stored
+ * \return ILM_FAILED if at least one layer is unknown, its entry is zeroed.
+ */
+ilmErrorTypes ilm_getPropertiesOfLayers(t_ilm_uint number,
+                                        const t_ilm_layer* pLayerIDs,
+                                        struct ilmLayerProperties* pLayerProperties);
+
+/**
+ * \brief Get the surface properties from the local mirror of the ilm context
+ * A surface with a notification registered by ilm_surfaceAddNotification is
+ * kept current by the compositor, its properties are returned without a
+ * roundtrip and without waiting for other ilm calls in progress.
+ * For other surfaces the mirror is refreshed with a roundtrip
+ * first, like ilm_getPropertiesOfSurface does.
+ * \ingroup ilmControl
+ * \param[in] surfaceID surface Indentifier as a Number from 0 .. MaxNumber of Surfaces
+ * \param[out] pSurfaceProperties pointer where the surface properties should be stored
+ * \param[out] pSequence if not NULL, set to the update counter of the surface.
+ *             It changes whenever any property of the surface has changed.
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pSurfaceProperties is NULL
+ * \return ILM_FAILED if the surface is unknown
+ */
+ilmErrorTypes ilm_getPropertiesOfSurfaceCached(t_ilm_uint surfaceID,
+                                               struct ilmSurfaceProperties* pSurfaceProperties,
+                                               t_ilm_uint* pSequence);
+
+/**
+ * \brief Get the layer properties from the local mirror of the ilm context
+ * A layer with a notification registered by ilm_layerAddNotification is
+ * kept current by the compositor, its properties are returned without a
+ * roundtrip and without waiting for other ilm calls in progress.
+ * For other layers the mirror is refreshed with a roundtrip
+ * first, like ilm_getPropertiesOfLayer does.
+ * \ingroup ilmControl
+ * \param[in] layerID layer Indentifier as a Number from 0 .. MaxNumber of Layer
+ * \param[out] pLayerProperties pointer where the layer properties should be stored
+ * \param[out] pSequence if not NULL, set to the update counter of the layer.
+ *             It changes whenever any property of the layer has changed.
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pLayerProperties is NULL
+ * \return ILM_FAILED if the layer is unknown
+ */
+ilmErrorTypes ilm_getPropertiesOfLayerCached(t_ilm_uint layerID,
+                                             struct ilmLayerProperties* pLayerProperties,
+                                             t_ilm_uint* pSequence);
+
+/**
+ * \brief Get a snapshot of the whole scene in a single protocol exchange
+ * \ingroup ilmControl
+ * \param[out] ppScene pointer where the address of the snapshot should be
+ *             stored. The snapshot contains all screens, layers and surfaces
+ *             with their properties and render orders. It is a single
+ *             allocation, which must be released by the caller using free().
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not support scene snapshots
+ * \return ILM_FAILED if the client can not get the scene.
+ */
+ilmErrorTypes ilm_getScene(struct ilmScene** ppScene);
+
+/**
+ * \brief Get a snapshot of the whole scene from the memory the compositor
+ * publishes it in
+ * \ingroup ilmControl
+ * The first call maps the memory, after that the scene is copied without
+ * any protocol exchange or lock. The focus of the surfaces is not part of
+ * the published scene and reads as 0. Frame counters and buffer sizes are
+ * published once the compositor dispatched the pending surface commits.
+ * Changes committed by this client are visible once ilm_commitChanges
+ * returns, others once the compositor processed them.
+ * A copy which the compositor changed in the meantime is taken again, with
+ * a growing pause in between. If the compositor keeps changing the scene
+ * for about a second, the call fails.
+ * ilm_destroy unmaps the memory, so neither this function nor the other
+ * FromMirror functions may run in another thread while or after ilm_destroy
+ * is called.
+ * \param[out] ppScene pointer where the address of the snapshot should be
+ *             stored. It is a single allocation, which must be released by
+ *             the caller using free().
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if ppScene is NULL
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not publish the scene
+ * \return ILM_FAILED if the client can not get the scene, or no consistent
+ *         copy could be taken.
+ */
+ilmErrorTypes ilm_getSceneFromMirror(struct ilmScene** ppScene);
+
+/**
+ * \brief Get the properties of a surface from the scene published by the
+ * compositor, like ilm_getSceneFromMirror
+ * \ingroup ilmControl
+ * \param[in] surfaceID surface id
+ * \param[out] pSurfaceProperties pointer where the surface properties should
+ *             be stored. focus is always 0.
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pSurfaceProperties is NULL
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not publish the scene
+ * \return ILM_FAILED if the surface is not published
+ */
+ilmErrorTypes ilm_getPropertiesOfSurfaceFromMirror(t_ilm_uint surfaceID,
+                                                   struct ilmSurfaceProperties* pSurfaceProperties);
+
+/**
+ * \brief Get the properties of a layer from the scene published by the
+ * compositor, like ilm_getSceneFromMirror
+ * \ingroup ilmControl
+ * \param[in] layerID layer id
+ * \param[out] pLayerProperties pointer where the layer properties should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pLayerProperties is NULL
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not publish the scene
+ * \return ILM_FAILED if the layer is not published
+ */
+ilmErrorTypes ilm_getPropertiesOfLayerFromMirror(t_ilm_uint layerID,
+                                                 struct ilmLayerProperties* pLayerProperties);
+
 /**
  * \brief Get the screen properties from the Layermanagement
  * \ingroup ilmControl
@@ -188,6 +338,21 @@ ilmErrorTypes ilm_layerSetVisibility(t_ilm_layer layerId, t_ilm_bool newVisibili
  */
 ilmErrorTypes ilm_layerGetVisibility(t_ilm_layer layerId, t_ilm_bool *pVisibility);
 
+/**
+ * \brief Get the visibility of a layer from the local mirror, see
+ *        ilm_getPropertiesOfLayerCached.
+ * \ingroup ilmControl
+ * \param[in] layerId Id of the layer to obtain the visibility of.
+ * \param[out] pVisibility pointer where the visibility of the layer should be returned,
+ *                         ILM_TRUE if the layer is visible,
+ *                         ILM_FALSE if the visibility is disabled.
+ * \param[out] pSequence if not NULL, set to the update counter of the layer
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the layer is unknown
+ */
+ilmErrorTypes ilm_layerGetVisibilityCached(t_ilm_layer layerId, t_ilm_bool *pVisibility,
+                                           t_ilm_uint *pSequence);
+
 /**
  * \brief Set the opacity of a layer.
  * \ingroup ilmControl
@@ -211,6 +376,19 @@ ilmErrorTypes ilm_layerSetOpacity(t_ilm_layer layerId, t_ilm_float opacity);
  */
 ilmErrorTypes ilm_layerGetOpacity(t_ilm_layer layerId, t_ilm_float *pOpacity);
 
+/**
+ * \brief Get the opacity of a layer from the local mirror, see
+ *        ilm_getPropertiesOfLayerCached.
+ * \ingroup ilmControl
+ * \param[in] layerId Id of the layer to obtain the opacity of.
+ * \param[out] pOpacity pointer where the layer opacity should be stored.
+ * \param[out] pSequence if not NULL, set to the update counter of the layer
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the layer is unknown
+ */
+ilmErrorTypes ilm_layerGetOpacityCached(t_ilm_layer layerId, t_ilm_float *pOpacity,
+                                        t_ilm_uint *pSequence);
+
 /**
  * \brief Set the area of a layer which should be used for the rendering. Only this part will be visible.
  * \ingroup ilmControl
@@ -271,6 +449,19 @@ ilmErrorTypes ilm_surfaceSetVisibility(t_ilm_surface surfaceId, t_ilm_bool newVi
  */
 ilmErrorTypes ilm_surfaceGetVisibility(t_ilm_surface surfaceId, t_ilm_bool *pVisibility);
 
+/**
+ * \brief Get the visibility of a surface from the local mirror, see
+ *        ilm_getPropertiesOfSurfaceCached.
+ * \ingroup ilmControl
+ * \param[in] surfaceId Id of the surface to get the visibility of.
+ * \param[out] pVisibility pointer where the visibility of a surface should be stored
+ * \param[out] pSequence if not NULL, set to the update counter of the surface
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the surface is unknown
+ */
+ilmErrorTypes ilm_surfaceGetVisibilityCached(t_ilm_surface surfaceId, t_ilm_bool *pVisibility,
+                                             t_ilm_uint *pSequence);
+
 /**
  * \brief Set the opacity of a surface.
  * \ingroup ilmControl
@@ -294,6 +485,19 @@ ilmErrorTypes ilm_surfaceSetOpacity(const t_ilm_surface surfaceId, t_ilm_float o
  */
 ilmErrorTypes ilm_surfaceGetOpacity(const t_ilm_surface surfaceId, t_ilm_float *pOpacity);
 
+/**
+ * \brief Get the opacity of a surface from the local mirror, see
+ *        ilm_getPropertiesOfSurfaceCached.
+ * \ingroup ilmControl
+ * \param[in] surfaceId Id of the surface to get the opacity of.
+ * \param[out] pOpacity pointer where the surface opacity should be returned
+ * \param[out] pSequence if not NULL, set to the update counter of the surface
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the surface is unknown
+ */
+ilmErrorTypes ilm_surfaceGetOpacityCached(const t_ilm_surface surfaceId, t_ilm_float *pOpacity,
+                                          t_ilm_uint *pSequence);
+
 /**
  * \brief Set the area of a surface which should be used for the rendering.
  * \ingroup ilmControl
@@ -376,6 +580,313 @@ ilmErrorTypes ilm_takeScreenshot(t_ilm_uint screen, t_ilm_const_string filename)
  */
 ilmErrorTypes ilm_takeSurfaceScreenshot(t_ilm_const_string filename, t_ilm_surface surfaceid);
 
+/**
+ * \brief Take a screenshot from the current displayed layer scene, and keep
+ * it in memory instead of encoding it to a file.
+ * The pixels are neither copied nor converted, the image refers to the
+ * buffer the compositor wrote. It has to be released with
+ * ilm_releaseScreenshot.
+ * \ingroup ilmControl
+ * \param[in] screen Id of screen where screenshot should be taken
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot is NULL
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_takeScreenshotToMemory(t_ilm_uint screen, struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Take a screenshot of a certain surface, and keep it in memory
+ * instead of encoding it to a file.
+ * The image has to be released with ilm_releaseScreenshot.
+ * \ingroup ilmControl
+ * \param[in] surfaceid Identifier of the surface to take the screenshot of
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot is NULL
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_takeSurfaceScreenshotToMemory(t_ilm_surface surfaceid, struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Take a screenshot of a rectangle of the current displayed layer
+ * scene, and keep it in memory like ilm_takeScreenshotToMemory.
+ * Only the rectangle is read back by the compositor, and it is scaled down
+ * there with a box filter, e.g. for crops of a widget or thumbnails.
+ * \ingroup ilmControl
+ * \param[in] screen Id of screen where screenshot should be taken
+ * \param[in] x horizontal start position of the rectangle in screen pixels
+ * \param[in] y vertical start position of the rectangle in screen pixels
+ * \param[in] width width of the rectangle
+ * \param[in] height height of the rectangle
+ * \param[in] targetWidth width of the image, at most width, 0 to keep width
+ * \param[in] targetHeight height of the image, at most height, 0 to keep height
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot is NULL, the rectangle
+ *         is empty or the target is larger than the rectangle
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not support it
+ * \return ILM_FAILED if the client can not call the method on the service,
+ *         or the rectangle is not inside the screen.
+ */
+ilmErrorTypes ilm_takeScreenshotRegionToMemory(t_ilm_uint screen,
+                                               t_ilm_int x, t_ilm_int y,
+                                               t_ilm_int width, t_ilm_int height,
+                                               t_ilm_int targetWidth, t_ilm_int targetHeight,
+                                               struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Take a screenshot of a rectangle of a certain surface, and keep it
+ * in memory. The rectangle is given in buffer pixels of the surface,
+ * otherwise it is handled like for ilm_takeScreenshotRegionToMemory.
+ * \ingroup ilmControl
+ * \param[in] surfaceid Identifier of the surface to take the screenshot of
+ * \param[in] x horizontal start position of the rectangle in buffer pixels
+ * \param[in] y vertical start position of the rectangle in buffer pixels
+ * \param[in] width width of the rectangle
+ * \param[in] height height of the rectangle
+ * \param[in] targetWidth width of the image, at most width, 0 to keep width
+ * \param[in] targetHeight height of the image, at most height, 0 to keep height
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot is NULL, the rectangle
+ *         is empty or the target is larger than the rectangle
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not support it
+ * \return ILM_FAILED if the client can not call the method on the service,
+ *         or the rectangle is not inside the surface.
+ */
+ilmErrorTypes ilm_takeSurfaceScreenshotRegionToMemory(t_ilm_surface surfaceid,
+                                                      t_ilm_int x, t_ilm_int y,
+                                                      t_ilm_int width, t_ilm_int height,
+                                                      t_ilm_int targetWidth, t_ilm_int targetHeight,
+                                                      struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Take a screenshot from the current displayed layer scene, without
+ * waiting for it. The call returns as soon as the request is sent, and other
+ * ilm calls, including further screenshots, can be made while it is in
+ * flight.
+ * The callback is invoked from the ilm event dispatching, usually the ilm
+ * control thread, once the compositor has captured the next frame. On
+ * success the image is kept in memory like with ilm_takeScreenshotToMemory,
+ * and the callback has to release it with ilm_releaseScreenshot; the
+ * structure itself is only valid during the callback. If the connection is
+ * closed before completion, the callback is invoked with
+ * ILM_ERROR_ON_CONNECTION.
+ * \ingroup ilmControl
+ * \param[in] screen Id of screen where screenshot should be taken
+ * \param[in] callback pointer to function to be called on completion
+ *             callback function is defined as:
+ *             void cb(ilmErrorTypes result, struct ilmScreenshot *pScreenshot, void *user_data)
+ * \param[in] user_data pointer to data which will be passed to the callback
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if callback is NULL
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_takeScreenshotAsync(t_ilm_uint screen, screenshotNotificationFunc callback, void* user_data);
+
+/**
+ * \brief Take a screenshot of a certain surface, without waiting for it.
+ * Completion is reported like for ilm_takeScreenshotAsync.
+ * \ingroup ilmControl
+ * \param[in] surfaceid Identifier of the surface to take the screenshot of
+ * \param[in] callback pointer to function to be called on completion
+ * \param[in] user_data pointer to data which will be passed to the callback
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if callback is NULL
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_takeSurfaceScreenshotAsync(t_ilm_surface surfaceid, screenshotNotificationFunc callback, void* user_data);
+
+/**
+ * \brief Save a screenshot kept in memory to a file.
+ * The format is chosen by the extension of the filename:
+ * - .png  png, see ilm_setScreenshotPngOptions
+ * - .qoi  "Quite OK Image" format, lossless and several times faster than png
+ * - .lz4  the pixels as they are, as one lz4 block behind a 32 byte header;
+ *         this is not the lz4 frame format, the lz4 tool can not read it
+ * - .raw  the pixels as they are, uncompressed, behind the same header
+ * - bmp for any other extension, like ilm_takeScreenshot does.
+ * Rows are written without the padding a stride larger than width * 4 adds.
+ * \ingroup ilmControl
+ * \param[in] pScreenshot image taken by one of the ToMemory functions
+ * \param[in] filename Location where the screenshot should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot or filename is NULL, the
+ *         image is empty or its stride is smaller than width * 4
+ * \return ILM_FAILED if the file could not be written
+ */
+ilmErrorTypes ilm_saveScreenshot(const struct ilmScreenshot* pScreenshot, t_ilm_const_string filename);
+
+/**
+ * \brief Load a screenshot written by ilm_saveScreenshot as .qoi, .lz4 or
+ * .raw file, e.g. to convert it to png with ilm_saveScreenshot.
+ * qoi files are returned as ABGR8888 or XBGR8888, the others in the format
+ * they were captured in. The image has to be released with
+ * ilm_releaseScreenshot.
+ * \ingroup ilmControl
+ * \param[in] filename file to load
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if an argument is NULL or the extension
+ *         is not supported
+ * \return ILM_FAILED if the file could not be read or is corrupt
+ */
+ilmErrorTypes ilm_loadScreenshot(t_ilm_const_string filename, struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Set how screenshots are encoded as png files.
+ * The image is cut into stripes of rows which are compressed in parallel,
+ * on threadCount threads including the calling one. The defaults are the
+ * zlib default level, ILM_PNG_FILTER_ADAPTIVE and all online cpus.
+ * \ingroup ilmControl
+ * \param[in] compressionLevel zlib compression level 0 to 9, or -1 for the
+ *             zlib default
+ * \param[in] filter row filter of the image
+ * \param[in] threadCount number of threads, 0 for all online cpus, 1 encodes
+ *             with libpng on the calling thread
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if the level or the filter is out of range
+ */
+ilmErrorTypes ilm_setScreenshotPngOptions(t_ilm_int compressionLevel, ilmPngFilter filter, t_ilm_uint threadCount);
+
+/**
+ * \brief Unmap and close a screenshot kept in memory.
+ * \ingroup ilmControl
+ * The compositor reuses the buffer for later screenshots once it is
+ * released, so images should not be kept longer than needed.
+ * \param[in] pScreenshot image taken by one of the ToMemory functions
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pScreenshot is NULL
+ */
+ilmErrorTypes ilm_releaseScreenshot(struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Find the tiles of a screenshot which changed since a previous one.
+ * The tiles are compared by hashes, which are kept for the last few
+ * screenshots passed to this function, under the id returned in pDelta.
+ * Passing that id as baseId of a later call only returns the tiles which
+ * changed in between. With a baseId of 0 all tiles are returned, so the
+ * delta holds the full image.
+ * Only 64 bit hashes of a base are kept, not its pixels. A changed tile
+ * whose hash equals the one of the base is therefore missed; this is very
+ * unlikely, but a client which cannot accept it should request a full
+ * image with a baseId of 0 from time to time.
+ * The delta only reduces what the client stores or forwards, the full
+ * screenshot is still transferred from the compositor.
+ * The delta has to be released with ilm_releaseScreenshotDelta.
+ * \ingroup ilmControl
+ * \param[in] pScreenshot image taken by one of the ToMemory functions
+ * \param[in] baseId id of a previous delta, or 0
+ * \param[in] tileSize width and height of a tile in pixels
+ * \param[out] pDelta pointer where the delta should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if a pointer is NULL, tileSize is 0,
+ *         the format has not 4 bytes per pixel or the size, format or
+ *         tile size differ from the base
+ * \return ILM_ERROR_RESOURCE_NOT_FOUND if the base is not known (anymore)
+ * \return ILM_FAILED if ilm is not initialized or memory is exhausted
+ */
+ilmErrorTypes ilm_computeScreenshotDelta(const struct ilmScreenshot* pScreenshot,
+                                         t_ilm_uint baseId, t_ilm_uint tileSize,
+                                         struct ilmScreenshotDelta* pDelta);
+
+/**
+ * \brief Take a screenshot from the current displayed layer scene, and keep
+ * only the tiles which changed since a previous one, see
+ * ilm_computeScreenshotDelta. The compositor still sends the full image.
+ * \ingroup ilmControl
+ * \param[in] screen Id of screen where screenshot should be taken
+ * \param[in] baseId id of a previous delta, or 0
+ * \param[in] tileSize width and height of a tile in pixels
+ * \param[out] pDelta pointer where the delta should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pDelta is NULL or tileSize is 0
+ * \return ILM_ERROR_RESOURCE_NOT_FOUND if the base is not known (anymore)
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_takeScreenshotDelta(t_ilm_uint screen, t_ilm_uint baseId,
+                                      t_ilm_uint tileSize,
+                                      struct ilmScreenshotDelta* pDelta);
+
+/**
+ * \brief Rebuild the full image of a delta on top of the image of its base.
+ * Neither ilm nor a compositor is needed, e.g. to restore recorded deltas
+ * off target.
+ * The image has to be released with ilm_releaseScreenshot.
+ * \ingroup ilmControl
+ * \param[in] pBase image of the base screenshot, may be NULL if the delta
+ *            has a baseId of 0
+ * \param[in] pDelta delta of the image to rebuild
+ * \param[out] pScreenshot pointer where the image should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pDelta or pScreenshot is NULL, or
+ *         pBase does not match the size and format of the delta
+ * \return ILM_FAILED if memory is exhausted
+ */
+ilmErrorTypes ilm_reconstructScreenshot(const struct ilmScreenshot* pBase,
+                                        const struct ilmScreenshotDelta* pDelta,
+                                        struct ilmScreenshot* pScreenshot);
+
+/**
+ * \brief Free the tiles of a delta.
+ * \ingroup ilmControl
+ * \param[in] pDelta delta from ilm_computeScreenshotDelta
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pDelta is NULL
+ */
+ilmErrorTypes ilm_releaseScreenshotDelta(struct ilmScreenshotDelta* pDelta);
+
+/**
+ * \brief Start a capture stream of a screen.
+ * Every frame the compositor renders to the screen is copied into one of
+ * bufferCount shared memory buffers and passed to the callback, together
+ * with its presentation time. The callback is invoked from the ilm event
+ * dispatching, usually the ilm control thread. The buffer stays owned by
+ * the client until it is handed back with ilm_captureReleaseFrame; frames
+ * rendered while all buffers are owned by the client are not captured,
+ * they are counted in the dropped field of the next frame.
+ * If the stream fails, e.g. when the screen is removed, the callback is
+ * invoked with ILM_FAILED and a NULL frame, and no further frames follow.
+ * If the connection is closed, it is invoked with ILM_ERROR_ON_CONNECTION.
+ * \ingroup ilmControl
+ * \param[in] screen Id of the screen to capture
+ * \param[in] bufferCount number of buffers in the pool, 1 to 16
+ * \param[in] callback pointer to function to be called for every frame
+ *             callback function is defined as:
+ *             void cb(ilmErrorTypes result, t_ilm_uint captureId, const struct ilmCaptureFrame *pFrame, void *user_data)
+ * \param[in] user_data pointer to data which will be passed to the callback
+ * \param[out] pCaptureId id of the capture stream
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if callback or pCaptureId is NULL, or
+ *         bufferCount is out of range
+ * \return ILM_ERROR_NOT_IMPLEMENTED if the compositor does not support capture
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_captureStart(t_ilm_uint screen, t_ilm_uint bufferCount, captureNotificationFunc callback, void* user_data, t_ilm_uint* pCaptureId);
+
+/**
+ * \brief Hand a buffer of a capture stream back to the compositor.
+ * \ingroup ilmControl
+ * \param[in] captureId id of the capture stream
+ * \param[in] index index of the frame passed to the callback
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if index is out of range
+ * \return ILM_FAILED if the capture stream does not exist
+ */
+ilmErrorTypes ilm_captureReleaseFrame(t_ilm_uint captureId, t_ilm_uint index);
+
+/**
+ * \brief Stop a capture stream and unmap its buffers.
+ * Frames passed to the callback must not be accessed anymore.
+ * \ingroup ilmControl
+ * \param[in] captureId id of the capture stream
+ * \param[out] pDropped total number of dropped frames, may be NULL
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the capture stream does not exist
+ */
+ilmErrorTypes ilm_captureStop(t_ilm_uint captureId, t_ilm_uint* pDropped);
+
 /**
  * \brief register for notification on property changes of layer
  * \ingroup ilmControl
@@ -438,6 +949,197 @@ ilmErrorTypes ilm_registerNotification(notificationFunc callback, void *user_dat
  */
 ilmErrorTypes ilm_unregisterNotification();
 
+/**
+ * \brief Select whether property change notifications of surfaces and layers
+ * are delivered per event, or once per object for each batch of dispatched
+ * events.
+ * When coalescing, a commit changing several properties of a surface results
+ * in one call of its surfaceNotificationFunc, with the mask of all changed
+ * properties and the final property values, instead of one call per property.
+ * Notifications are still delivered from the thread dispatching the events,
+ * before it gives up the ilm lock. The default is not to coalesce.
+ * \ingroup ilmControl
+ * \param[in] enable ILM_TRUE to coalesce notifications
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_setNotificationCoalescing(t_ilm_bool enable);
+
+/**
+ * \brief Select whether the next ilm_init or ilm_initWithNativedisplay starts
+ * the internal control thread (the default), or leaves event dispatching to
+ * an event loop of the application.
+ * With an external event loop, notifications and completion callbacks are
+ * only invoked from ilm_dispatchPending and from ilm calls waiting for the
+ * compositor, in the thread calling them. The loop follows the usual wayland
+ * pattern:
+ *   ilm_prepareRead(); poll on the fd from ilm_getFd();
+ *   ilm_readEvents() if readable, ilm_cancelRead() otherwise;
+ *   ilm_dispatchPending();
+ * \ingroup ilmControl
+ * \param[in] enable ILM_TRUE to use an external event loop
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if ilm is currently initialized
+ */
+ilmErrorTypes ilm_useExternalEventLoop(t_ilm_bool enable);
+
+/**
+ * \brief Get the file descriptor to poll for ilm events, external event loop only.
+ * \ingroup ilmControl
+ * \param[out] pFd pointer where the file descriptor should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pFd is NULL
+ * \return ILM_FAILED if ilm is not initialized for an external event loop
+ */
+ilmErrorTypes ilm_getFd(t_ilm_int *pFd);
+
+/**
+ * \brief Dispatch events already queued and announce the intention to read
+ * from the file descriptor, external event loop only. Pending requests are
+ * flushed. Must be followed by ilm_readEvents or ilm_cancelRead.
+ * Until then, no thread may call an ilm function which waits for the
+ * compositor, like ilm_commitChanges, the getters which are not cached or
+ * the screenshot functions. They wait for events which are only read by
+ * ilm_readEvents, so the call never returns.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_ON_CONNECTION if the connection to the compositor failed
+ * \return ILM_FAILED if ilm is not initialized for an external event loop
+ */
+ilmErrorTypes ilm_prepareRead(void);
+
+/**
+ * \brief Read events from the file descriptor after ilm_prepareRead, once
+ * polling reported it readable. External event loop only.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_ON_CONNECTION if the connection to the compositor failed
+ * \return ILM_FAILED if ilm is not initialized for an external event loop
+ */
+ilmErrorTypes ilm_readEvents(void);
+
+/**
+ * \brief Cancel a read announced by ilm_prepareRead, external event loop only.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if ilm is not initialized for an external event loop
+ */
+ilmErrorTypes ilm_cancelRead(void);
+
+/**
+ * \brief Dispatch the events read so far, external event loop only.
+ * Notification callbacks are invoked from this call.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_ON_CONNECTION if the connection to the compositor failed
+ * \return ILM_FAILED if ilm is not initialized for an external event loop
+ */
+ilmErrorTypes ilm_dispatchPending(void);
+
+/**
+ * \brief Select whether the next ilm_init or ilm_initWithNativedisplay
+ * invokes surface, layer and creation/deletion notification callbacks
+ * directly while dispatching events (the default), or queues them.
+ * Queued notifications carry a copy of the properties at the time of the
+ * event and are invoked later without the ilm lock held, either by a worker
+ * thread of the library or by the application calling
+ * ilm_dispatchNotifications, so a slow callback, or one calling ilm
+ * functions, never stalls event dispatching. If the queue is full, new
+ * notifications are dropped and counted, see ilm_getNotificationQueueStats.
+ * Queued notifications of a callback removed by ilm_surfaceRemoveNotification,
+ * ilm_layerRemoveNotification or ilm_unregisterNotification are discarded,
+ * except one which is being invoked at that time.
+ * \ingroup ilmControl
+ * \param[in] capacity number of notifications the queue can hold, rounded
+ *             up to a power of two, at most 65536; 0 to not queue
+ * \param[in] useWorker ILM_TRUE to have a worker thread invoke the callbacks
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if capacity is too large
+ * \return ILM_FAILED if ilm is currently initialized
+ */
+ilmErrorTypes ilm_useNotificationQueue(t_ilm_uint capacity, t_ilm_bool useWorker);
+
+/**
+ * \brief Get a file descriptor which becomes readable when queued
+ * notifications are available, notification queue without worker only.
+ * \ingroup ilmControl
+ * \param[out] pFd pointer where the file descriptor should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if pFd is NULL
+ * \return ILM_FAILED if notifications are not queued or a worker consumes them
+ */
+ilmErrorTypes ilm_getNotificationFd(t_ilm_int *pFd);
+
+/**
+ * \brief Invoke the callbacks of all queued notifications in the calling
+ * thread, notification queue without worker only.
+ * \ingroup ilmControl
+ * \param[out] pCount pointer where the number of notifications should be
+ *              stored, may be NULL
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if notifications are not queued or a worker consumes them
+ */
+ilmErrorTypes ilm_dispatchNotifications(t_ilm_uint *pCount);
+
+/**
+ * \brief Get the number of queued notifications delivered and dropped so far.
+ * \ingroup ilmControl
+ * \param[out] pDelivered pointer where the number of delivered notifications should be stored
+ * \param[out] pDropped pointer where the number of notifications dropped
+ *              because the queue was full should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if a pointer is NULL
+ * \return ILM_FAILED if notifications are not queued
+ */
+ilmErrorTypes ilm_getNotificationQueueStats(t_ilm_uint *pDelivered, t_ilm_uint *pDropped);
+
+/**
+ * \brief Start recording property changes instead of sending them.
+ * Until the matching ilm_endTransaction, the opacity, visibility, source
+ * rectangle and destination rectangle setters of surfaces and layers only
+ * update a local pending state, where a later set of the same property
+ * replaces the earlier one. All other requests are still sent in order,
+ * and are only flushed before the transaction ends when a function waits
+ * for the compositor, such as the getters, or when the buffer of the
+ * connection is full. Getters keep returning the state known by the
+ * compositor. Transactions can be nested.
+ * A transaction belongs to the whole ilm context, not to the thread which
+ * began it: while one is open, the setters called by any thread of the
+ * process are recorded in it and only sent when it ends. Threads which
+ * must not be held back have to coordinate with the one using
+ * transactions.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if the client can not call the method on the service.
+ */
+ilmErrorTypes ilm_beginTransaction(void);
+
+/**
+ * \brief End a transaction started with ilm_beginTransaction.
+ * When the outermost transaction ends, the pending state is sent followed
+ * by a commit, all with a single flush, without waiting for the compositor.
+ * ilm_commitChanges and ilm_commitChangesAsync called inside a transaction
+ * send the pending state as well, the transaction stays open.
+ * \ingroup ilmControl
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_FAILED if no transaction is open or the client can not call
+ *         the method on the service.
+ */
+ilmErrorTypes ilm_endTransaction(void);
+
+/**
+ * \brief Get how many property sets were recorded in transactions and how
+ * many requests were sent for them since ilm was initialized. Sets of the
+ * same property of an object within a transaction are sent as one request.
+ * \ingroup ilmControl
+ * \param[out] pRecorded pointer where the number of recorded sets should be stored
+ * \param[out] pSent pointer where the number of requests sent for them should be stored
+ * \return ILM_SUCCESS if the method call was successful
+ * \return ILM_ERROR_INVALID_ARGUMENTS if a pointer is NULL
+ * \return ILM_FAILED if ilm is not initialized
+ */
+ilmErrorTypes ilm_getTransactionStats(t_ilm_uint *pRecorded, t_ilm_uint *pSent);
+
 /**
  * \brief returns the global error flag.
  * When compositor sends an error, the error flag is set to appropriate error code
@@ -28,6 +28,115 @@ extern "C" {
 #include "ilm_common.h"
 #include "wayland-util.h"
 
+/*
+ * Intrusive hash index over object ids. Objects embed an id_index_entry and
+ * stay on their wl_list as well, so iteration order is unchanged while
+ * lookups by id no longer walk the whole list.
+ */
+struct id_index_entry {
+    struct wl_list link;
+    uint32_t id;
+};
+
+struct id_index {
+    struct wl_list *buckets;
+    uint32_t shift;
+    uint32_t count;
+};
+
+/*
+ * Hands out ids for objects created without an explicit id. Ids of
+ * destroyed objects are reused first, then the counter moves on; ids
+ * already present in the object index, e.g. assigned by the compositor or
+ * another client, are skipped, so allocation never walks the object list.
+ */
+struct id_allocator {
+    /* highest id the counter has reached */
+    uint32_t next;
+    /* generated ids given back by destroyed objects, used as a stack */
+    struct wl_array released;
+};
+
+/*
+ * Property changes of one surface or layer, collected while notifications
+ * are coalesced. Linked on wayland_context.list_notify while mask is set.
+ */
+struct pending_notification {
+    struct wl_list link;
+    uint32_t mask;
+    bool is_layer;
+};
+
+enum notification_record_type {
+    NOTIFICATION_RECORD_SURFACE,
+    NOTIFICATION_RECORD_LAYER,
+    NOTIFICATION_RECORD_OBJECT
+};
+
+/*
+ * A notification decoded by the dispatching thread, with a copy of
+ * everything the callback needs, so it can run later in another thread.
+ */
+struct notification_record {
+    enum notification_record_type type;
+    t_ilm_uint id;
+    union {
+        surfaceNotificationFunc surface;
+        layerNotificationFunc layer;
+        notificationFunc object;
+    } callback;
+    /* set by the producer once the callback was removed, read atomically */
+    bool cancelled;
+    union {
+        struct {
+            struct ilmSurfaceProperties prop;
+            t_ilm_notification_mask mask;
+        } surface;
+        struct {
+            struct ilmLayerProperties prop;
+            t_ilm_notification_mask mask;
+        } layer;
+        struct {
+            ilmObjectType type;
+            t_ilm_bool created;
+            void *user_data;
+        } object;
+    } u;
+};
+
+/*
+ * Bounded single producer, single consumer ring of notification records.
+ * The producer is whoever dispatches events, serialized by the context
+ * lock; consumers are serialized by consumer_lock. head and tail run freely
+ * and are masked on access, each is only written by its own side.
+ */
+struct notification_queue {
+    struct notification_record *records;
+    uint32_t mask;
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    /* records pushed but not yet signalled on fd, producer only */
+    bool signal_pending;
+    uint32_t dropped;
+    uint32_t delivered;
+    int fd;
+    pthread_mutex_t consumer_lock;
+    pthread_t worker;
+    bool has_worker;
+    bool shutdown;
+};
+
+struct transaction_context {
+    uint32_t depth;
+    /* sets recorded and property requests sent, see ilm_getTransactionStats */
+    uint32_t recorded;
+    uint32_t sent;
+    /* pending_state entries in the order they were first touched */
+    struct wl_list list_pending;
+    struct id_index index_surface;
+    struct id_index index_layer;
+};
+
 struct wayland_context {
     struct wl_display *display;
     struct wl_registry *registry;
@@ -40,8 +149,31 @@ struct wayland_context {
     struct wl_list list_layer;
     struct wl_list list_screen;
     struct wl_list list_seat;
+    struct wl_list list_commit;
+    struct wl_list list_screenshot;
+    /* mapped screenshots the compositor waits for to reuse their buffer */
+    struct wl_list list_screenshot_held;
+    struct wl_list list_capture;
+    uint32_t next_capture_id;
+    /* tile hashes of recent delta screenshots, newest first */
+    struct wl_list list_delta_base;
+    uint32_t next_delta_id;
+    /* scene published by the compositor, mapped read-only once */
+    const struct ivi_scene_mirror *scene_mirror;
+    struct id_index index_surface;
+    struct id_index index_layer;
+    struct id_index index_screen;
+    struct id_allocator layer_ids;
+    struct transaction_context transaction;
+    /* guards the surface and layer contexts for lock-free readers */
+    pthread_rwlock_t mirror_lock;
     notificationFunc notification;
     void *notification_user_data;
+    /* pending_notification entries in the order they were first touched */
+    struct wl_list list_notify;
+    bool coalesce_notifications;
+    /* records is NULL unless notifications are queued */
+    struct notification_queue notify_queue;
 
     ilmErrorTypes error_flag;
 
@@ -52,11 +184,13 @@ struct ilm_control_context {
     struct wayland_context wl;
     bool initialized;
 
-    uint32_t internal_id_layer;
-
     pthread_t thread;
     pthread_mutex_t mutex;
+    /* recursion depth of mutex, only accessed with it held */
+    int lock_depth;
     int shutdown_fd;
+    /* no control thread, events are dispatched by the application */
+    bool external_event_loop;
     uint32_t internal_id_surface;
 
     shutdownNotificationFunc notification;
@@ -78,9 +212,17 @@ struct surface_context {
     struct wl_list link;
 
     t_ilm_uint id_surface;
+    struct id_index_entry index;
     struct ilmSurfaceProperties prop;
+    /* last timing sent by the compositor, not part of the mirror */
+    struct ilmSurfaceFrameStats frame_stats;
+    /* bumped whenever prop changes */
+    uint32_t seq;
+    /* prop is kept current by the compositor */
+    bool mirrored;
     struct wl_list list_accepted_seats;
     surfaceNotificationFunc notification;
+    struct pending_notification notify;
 
     struct wayland_context *ctx;
 };
@@ -22,10 +22,10 @@
 #include "bitmap.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdlib.h>
 #include <stdbool.h>
 #include <arpa/inet.h>
 #include "ivi-wm-client-protocol.h"
+#include "swizzle.h"
 
 struct __attribute__ ((__packed__)) BITMAPFILEHEADER {
     char bfType[2];
@@ -102,42 +102,21 @@ save_as_bitmap(const char *filename,
     int32_t image_size = 0;
     char *image_buffer = NULL;
     int32_t row = 0;
-    int32_t col = 0;
-    int32_t image_offset = 0;
-    int32_t offset = 0;
-    int32_t i = 0;
-    int32_t j = 0;
     int bytes_per_pixel;
-    bool flip_order;
-    bool has_alpha;
+    swizzle_func swizzle;
 
     if ((filename == NULL) || (buffer == NULL)) {
         return -1;
     }
 
-    switch (format) {
-    case WL_SHM_FORMAT_ARGB8888:
-        flip_order = true;
-        has_alpha = true;
-        break;
-    case WL_SHM_FORMAT_XRGB8888:
-        flip_order = true;
-        has_alpha = false;
-        break;
-    case WL_SHM_FORMAT_ABGR8888:
-        flip_order = false;
-        has_alpha = true;
-        break;
-    case WL_SHM_FORMAT_XBGR8888:
-        flip_order = false;
-        has_alpha = false;
-        break;
-    default:
+    swizzle = get_swizzle_func(format, SWIZZLE_ORDER_BGR,
+                               swizzle_best_kernel());
+    if (swizzle == NULL) {
         fprintf(stderr, "unsupported pixelformat 0x%x\n", format);
         return -1;
     }
 
-    bytes_per_pixel = has_alpha ? 4 : 3;
+    bytes_per_pixel = swizzle_bytes_per_pixel(format);
     image_stride = (((width * bytes_per_pixel) + 3) & ~3);
     image_size = image_stride * height;
 
@@ -149,20 +128,11 @@ save_as_bitmap(const char *filename,
     }
 
     // Store the image in image_buffer in the follwing order B, G, R, [A](B at the lowest address)
+    // bmp rows are stored bottom-up
     for (row = 0; row < height; ++row) {
-        for (col = 0; col < width; ++col) {
-            offset = (height - row - 1) * width + col;
-            uint32_t pixel = htonl(((uint32_t*)buffer)[offset]);
-            char * pixel_p = (char*) &pixel;
-            image_offset = row * image_stride + col * bytes_per_pixel;
-            for (i = 0; i < 3; ++i) {
-                j = flip_order ? 2 - i : i;
-                image_buffer[image_offset + i] = pixel_p[1 + j];
-            }
-            if (has_alpha) {
-                image_buffer[image_offset + 3] = pixel_p[0];
-            }
-        }
+        swizzle((const uint32_t *)buffer + (size_t)(height - row - 1) * width,
+                (unsigned char *)image_buffer + (size_t)row * image_stride,
+                width);
     }
 
     struct BITMAPFILEHEADER file_header = {};
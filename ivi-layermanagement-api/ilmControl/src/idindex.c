@@ -0,0 +1,129 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "ilm_types.h"
+#include "idindex.h"
+
+#define ID_INDEX_INITIAL_SHIFT 6
+
+static int
+id_index_alloc(struct id_index *index, uint32_t shift)
+{
+    struct wl_list *buckets;
+    struct id_index_entry *entry, *next;
+    uint32_t i, size = 1u << shift;
+
+    buckets = malloc(size * sizeof *buckets);
+    if (buckets == NULL)
+        return -1;
+
+    for (i = 0; i < size; i++)
+        wl_list_init(&buckets[i]);
+
+    if (index->buckets != NULL) {
+        uint32_t old_size = 1u << index->shift;
+
+        for (i = 0; i < old_size; i++) {
+            wl_list_for_each_safe(entry, next, &index->buckets[i], link) {
+                uint32_t slot = (entry->id * 2654435761u) >> (32 - shift);
+                wl_list_remove(&entry->link);
+                wl_list_insert(&buckets[slot], &entry->link);
+            }
+        }
+        free(index->buckets);
+    }
+
+    index->buckets = buckets;
+    index->shift = shift;
+    return 0;
+}
+
+int
+id_index_init(struct id_index *index)
+{
+    index->buckets = NULL;
+    index->count = 0;
+    return id_index_alloc(index, ID_INDEX_INITIAL_SHIFT);
+}
+
+void
+id_index_release(struct id_index *index)
+{
+    free(index->buckets);
+    index->buckets = NULL;
+    index->count = 0;
+}
+
+void
+id_index_insert(struct id_index *index, struct id_index_entry *entry,
+                uint32_t id)
+{
+    /* keep the load factor below two, a failed resize only costs speed */
+    if ((index->count >> 1) >= (1u << index->shift) && index->shift < 24)
+        id_index_alloc(index, index->shift + 1);
+
+    entry->id = id;
+    wl_list_insert(id_index_bucket(index, id), &entry->link);
+    index->count++;
+}
+
+void
+id_index_remove(struct id_index *index, struct id_index_entry *entry)
+{
+    if (wl_list_empty(&entry->link))
+        return;
+
+    wl_list_remove(&entry->link);
+    wl_list_init(&entry->link);
+    index->count--;
+}
+
+uint32_t
+id_allocator_get(struct id_allocator *ids, struct id_index *index)
+{
+    uint32_t id;
+
+    while (ids->released.size > 0) {
+        ids->released.size -= sizeof id;
+        memcpy(&id, (char *)ids->released.data + ids->released.size,
+               sizeof id);
+        if (id_index_lookup(index, id) == NULL)
+            return id;
+    }
+
+    do {
+        ids->next++;
+    } while (ids->next == INVALID_ID ||
+             id_index_lookup(index, ids->next) != NULL);
+
+    return ids->next;
+}
+
+void
+id_allocator_put(struct id_allocator *ids, uint32_t id)
+{
+    uint32_t *slot;
+
+    slot = wl_array_add(&ids->released, sizeof *slot);
+    if (slot == NULL) {
+        /* the id is only lost for reuse, the counter never returns to it */
+        return;
+    }
+
+    *slot = id;
+}
@@ -0,0 +1,77 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef IVICONTROLLER_IDINDEX_H_
+#define IVICONTROLLER_IDINDEX_H_
+
+#include <stdint.h>
+
+#include "ilm_control_platform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* returns -1 if the buckets can not be allocated */
+int
+id_index_init(struct id_index *index);
+
+void
+id_index_release(struct id_index *index);
+
+/* the entry must not be in an index */
+void
+id_index_insert(struct id_index *index, struct id_index_entry *entry,
+                uint32_t id);
+
+/* does nothing for an entry which is not in an index */
+void
+id_index_remove(struct id_index *index, struct id_index_entry *entry);
+
+static inline struct wl_list *
+id_index_bucket(struct id_index *index, uint32_t id)
+{
+    return &index->buckets[(id * 2654435761u) >> (32 - index->shift)];
+}
+
+static inline struct id_index_entry *
+id_index_lookup(struct id_index *index, uint32_t id)
+{
+    struct id_index_entry *entry;
+
+    if (index->buckets == NULL)
+        return NULL;
+
+    wl_list_for_each(entry, id_index_bucket(index, id), link) {
+        if (entry->id == id)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/* the id released last which is not in index, else the next free one */
+uint32_t
+id_allocator_get(struct id_allocator *ids, struct id_index *index);
+
+/* gives back a generated id of a destroyed object */
+void
+id_allocator_put(struct id_allocator *ids, uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IVICONTROLLER_IDINDEX_H_ */
@@ -16,6 +16,10 @@
  * limitations under the License.
  *
  ****************************************************************************/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,25 +30,40 @@
 
 #include <unistd.h>
 #include <poll.h>
+#include <sched.h>
+#include <time.h>
 
 #include <sys/mman.h>
 #include <sys/eventfd.h>
 
 #include "writepng.h"
 #include "bitmap.h"
+#include "qoi.h"
+#include "rawimage.h"
+#include "tiledelta.h"
+#include "idindex.h"
 #include "ilm_common.h"
 #include "ilm_control_platform.h"
 #include "wayland-util.h"
 #include "ivi-wm-client-protocol.h"
 #include "ivi-input-client-protocol.h"
+#include "ivi-scene-mirror.h"
 
 struct layer_context {
     struct wl_list link;
 
     t_ilm_uint id_layer;
+    struct id_index_entry index;
 
     struct ilmLayerProperties prop;
+    /* bumped whenever prop changes */
+    uint32_t seq;
+    /* prop is kept current by the compositor */
+    bool mirrored;
+    /* id came from layer_ids and goes back there on destruction */
+    bool id_generated;
     layerNotificationFunc notification;
+    struct pending_notification notify;
 
     struct wl_array render_order;
 
@@ -57,6 +76,7 @@ struct screen_context {
     struct wl_output *output;
     struct ivi_wm_screen *controller;
     t_ilm_uint id_screen;
+    struct id_index_entry index;
     t_ilm_uint name;
     int32_t transform;
 
@@ -68,20 +88,558 @@ struct screen_context {
 };
 
 struct screenshot_context {
-    const char *filename;
+    struct wayland_context *ctx;
+    struct ilmScreenshot *image;
+    bool done;
     ilmErrorTypes result;
 };
 
+/* a mapped screenshot whose buffer the compositor recycles on destroy */
+struct held_screenshot {
+    struct wl_list link;
+    struct ivi_screenshot *screenshot;
+    int fd;
+};
+
+/* hashes of a screenshot, which later deltas can be based on */
+struct delta_base {
+    struct wl_list link;
+    uint32_t id;
+    uint32_t format;
+    struct tile_grid grid;
+    uint64_t *hashes;
+};
+
+/* how many screenshots a delta can be based on */
+#define DELTA_BASE_COUNT 8
+
+struct screenshot_async_context {
+    struct wl_list link;
+    struct wayland_context *ctx;
+    struct ivi_screenshot *screenshot;
+    screenshotNotificationFunc notification;
+    void *user_data;
+};
+
+struct capture_context {
+    struct wl_list link;
+    uint32_t id;
+    struct ivi_capture *capture;
+    struct ilmScreenshot *buffers;
+    uint32_t buffer_count;
+    uint32_t dropped;
+    bool started;
+    bool failed;
+    captureNotificationFunc notification;
+    void *user_data;
+};
+
+struct commit_context {
+    struct wl_list link;
+    struct wl_callback *callback;
+    commitNotificationFunc notification;
+    void *user_data;
+    /* the sync fallback carries a serial, not a frame time */
+    bool has_frame_time;
+};
+
+enum pending_state_mask {
+    PENDING_OPACITY = 1 << 0,
+    PENDING_VISIBILITY = 1 << 1,
+    PENDING_SOURCE_RECT = 1 << 2,
+    PENDING_DEST_RECT = 1 << 3
+};
+
+struct pending_rect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct pending_state {
+    struct id_index_entry index;
+    struct wl_list link;
+    bool is_layer;
+    uint32_t mask;
+    wl_fixed_t opacity;
+    uint32_t visibility;
+    struct pending_rect source;
+    struct pending_rect dest;
+};
+
+struct scene_context {
+    struct wayland_context *ctx;
+
+    struct wl_array screens;
+    struct wl_array layers;
+    struct wl_array surfaces;
+    /* render orders of screens and layers, in the order they were sent */
+    struct wl_array ids;
+
+    bool done;
+    bool error;
+};
+
+static void notify_flush(struct wayland_context *ctx);
+static void notification_queue_signal(struct notification_queue *queue);
+
 static inline void lock_context(struct ilm_control_context *ctx)
 {
    pthread_mutex_lock(&ctx->mutex);
+   ctx->lock_depth++;
 }
 
+/* Coalesced notifications collected while the lock was held are delivered
+ * before the outermost lock is given up, so they still arrive with the lock
+ * held and in the thread which dispatched the events, just once per object.
+ */
 static inline void unlock_context(struct ilm_control_context *ctx)
 {
+   if (ctx->lock_depth == 1) {
+      if (ctx->wl.coalesce_notifications)
+         notify_flush(&ctx->wl);
+      if (ctx->wl.notify_queue.signal_pending)
+         notification_queue_signal(&ctx->wl.notify_queue);
+   }
+   ctx->lock_depth--;
    pthread_mutex_unlock(&ctx->mutex);
 }
 
+/* The surface and layer contexts are only modified with the context lock
+ * held, and additionally the mirror lock for writing. Readers of the
+ * mirrored properties can take the mirror lock only, so they neither
+ * serialize on each other nor wait for a roundtrip in progress.
+ * User callbacks are never invoked with the mirror lock held.
+ */
+static inline void mirror_read_lock(struct wayland_context *ctx)
+{
+   pthread_rwlock_rdlock(&ctx->mirror_lock);
+}
+
+static inline void mirror_read_unlock(struct wayland_context *ctx)
+{
+   pthread_rwlock_unlock(&ctx->mirror_lock);
+}
+
+static inline void mirror_write_lock(struct wayland_context *ctx)
+{
+   pthread_rwlock_wrlock(&ctx->mirror_lock);
+}
+
+static inline void mirror_write_unlock(struct wayland_context *ctx)
+{
+   pthread_rwlock_unlock(&ctx->mirror_lock);
+}
+
+static struct pending_state *
+transaction_pending(struct wayland_context *ctx, bool is_layer, uint32_t id)
+{
+    struct transaction_context *tr = &ctx->transaction;
+    struct id_index *index = is_layer ? &tr->index_layer : &tr->index_surface;
+    struct id_index_entry *entry;
+    struct pending_state *pending;
+
+    if (tr->depth == 0)
+        return NULL;
+
+    entry = id_index_lookup(index, id);
+    if (entry != NULL) {
+        tr->recorded++;
+        return wl_container_of(entry, pending, index);
+    }
+
+    /* without an entry the caller sends the request directly */
+    pending = calloc(1, sizeof *pending);
+    if (pending == NULL)
+        return NULL;
+
+    pending->is_layer = is_layer;
+    id_index_insert(index, &pending->index, id);
+    wl_list_insert(tr->list_pending.prev, &pending->link);
+    tr->recorded++;
+
+    return pending;
+}
+
+static void
+transaction_free_pending(struct transaction_context *tr,
+                         struct pending_state *pending)
+{
+    id_index_remove(pending->is_layer ? &tr->index_layer : &tr->index_surface,
+                    &pending->index);
+    wl_list_remove(&pending->link);
+    free(pending);
+}
+
+static void
+transaction_drop_pending(struct wayland_context *ctx, bool is_layer,
+                         uint32_t id)
+{
+    struct transaction_context *tr = &ctx->transaction;
+    struct id_index_entry *entry;
+    struct pending_state *pending;
+
+    entry = id_index_lookup(is_layer ? &tr->index_layer : &tr->index_surface,
+                            id);
+    if (entry != NULL)
+        transaction_free_pending(tr, wl_container_of(entry, pending, index));
+}
+
+static void
+transaction_write_pending(struct wayland_context *ctx)
+{
+    struct transaction_context *tr = &ctx->transaction;
+    struct pending_state *pending, *next;
+
+    wl_list_for_each_safe(pending, next, &tr->list_pending, link) {
+        uint32_t id = pending->index.id;
+
+        tr->sent += __builtin_popcount(pending->mask);
+
+        if (pending->is_layer) {
+            if (pending->mask & PENDING_VISIBILITY)
+                ivi_wm_set_layer_visibility(ctx->controller, id,
+                                            pending->visibility);
+            if (pending->mask & PENDING_OPACITY)
+                ivi_wm_set_layer_opacity(ctx->controller, id,
+                                         pending->opacity);
+            if (pending->mask & PENDING_SOURCE_RECT)
+                ivi_wm_set_layer_source_rectangle(ctx->controller, id,
+                        pending->source.x, pending->source.y,
+                        pending->source.width, pending->source.height);
+            if (pending->mask & PENDING_DEST_RECT)
+                ivi_wm_set_layer_destination_rectangle(ctx->controller, id,
+                        pending->dest.x, pending->dest.y,
+                        pending->dest.width, pending->dest.height);
+        } else {
+            if (pending->mask & PENDING_VISIBILITY)
+                ivi_wm_set_surface_visibility(ctx->controller, id,
+                                              pending->visibility);
+            if (pending->mask & PENDING_OPACITY)
+                ivi_wm_set_surface_opacity(ctx->controller, id,
+                                           pending->opacity);
+            if (pending->mask & PENDING_SOURCE_RECT)
+                ivi_wm_set_surface_source_rectangle(ctx->controller, id,
+                        pending->source.x, pending->source.y,
+                        pending->source.width, pending->source.height);
+            if (pending->mask & PENDING_DEST_RECT)
+                ivi_wm_set_surface_destination_rectangle(ctx->controller, id,
+                        pending->dest.x, pending->dest.y,
+                        pending->dest.width, pending->dest.height);
+        }
+
+        transaction_free_pending(tr, pending);
+    }
+}
+
+static void
+control_flush(struct ilm_control_context *ctx)
+{
+    /* inside a transaction everything goes out with the final commit */
+    if (ctx->wl.transaction.depth == 0)
+        wl_display_flush(ctx->wl.display);
+}
+
+static struct notification_record *
+notification_queue_reserve(struct notification_queue *queue)
+{
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    if (queue->tail - head > queue->mask) {
+        /* the consumer is behind, the newest record is lost */
+        __atomic_fetch_add(&queue->dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    return &queue->records[queue->tail & queue->mask];
+}
+
+static void
+notification_queue_push(struct notification_queue *queue)
+{
+    queue->records[queue->tail & queue->mask].cancelled = false;
+    __atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+    queue->signal_pending = true;
+}
+
+/* one wakeup per batch of dispatched events, not per record */
+static void
+notification_queue_signal(struct notification_queue *queue)
+{
+    uint64_t buf = 1;
+
+    queue->signal_pending = false;
+    while (write(queue->fd, &buf, sizeof buf) == -1 && errno == EINTR)
+        ;
+}
+
+static void
+notification_record_invoke(struct notification_record *record)
+{
+    switch (record->type) {
+    case NOTIFICATION_RECORD_SURFACE:
+        record->callback.surface(record->id, &record->u.surface.prop,
+                                 record->u.surface.mask);
+        break;
+    case NOTIFICATION_RECORD_LAYER:
+        record->callback.layer(record->id, &record->u.layer.prop,
+                               record->u.layer.mask);
+        break;
+    case NOTIFICATION_RECORD_OBJECT:
+        record->callback.object(record->u.object.type, record->id,
+                                record->u.object.created,
+                                record->u.object.user_data);
+        break;
+    }
+}
+
+/* Records not consumed yet which call a removed callback are skipped. One
+ * which the consumer already took out may still be delivered.
+ */
+static void
+notification_queue_cancel(struct notification_queue *queue,
+                          enum notification_record_type type, t_ilm_uint id)
+{
+    struct notification_record *record;
+    uint32_t head;
+
+    if (queue->records == NULL)
+        return;
+
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    for (; head != queue->tail; head++) {
+        record = &queue->records[head & queue->mask];
+        if (record->type == type &&
+            (type == NOTIFICATION_RECORD_OBJECT || record->id == id))
+            __atomic_store_n(&record->cancelled, true, __ATOMIC_RELEASE);
+    }
+}
+
+/* Records are copied out before their slot is released, so a slow
+ * callback does not keep the producer from reusing it. cancelled is the
+ * only field the producer writes while a record is queued, it is not part
+ * of the copy.
+ */
+static uint32_t
+notification_queue_drain(struct notification_queue *queue)
+{
+    struct notification_record *slot;
+    struct notification_record record;
+    bool cancelled;
+    uint32_t count = 0;
+    uint64_t buf;
+    uint32_t head, tail;
+
+    pthread_mutex_lock(&queue->consumer_lock);
+
+    /* cleared first, records pushed from now on signal again */
+    while (read(queue->fd, &buf, sizeof buf) == -1 && errno == EINTR)
+        ;
+
+    head = queue->head;
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        slot = &queue->records[head & queue->mask];
+        record.type = slot->type;
+        record.id = slot->id;
+        record.callback = slot->callback;
+        record.u = slot->u;
+        cancelled = __atomic_load_n(&slot->cancelled, __ATOMIC_ACQUIRE);
+        head++;
+        __atomic_store_n(&queue->head, head, __ATOMIC_RELEASE);
+
+        if (!cancelled) {
+            notification_record_invoke(&record);
+            count++;
+        }
+
+        if (head == tail)
+            tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    }
+
+    __atomic_fetch_add(&queue->delivered, count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->consumer_lock);
+
+    return count;
+}
+
+static void*
+notification_worker(void *data)
+{
+    struct notification_queue *queue = data;
+
+    while (1)
+    {
+        struct pollfd pfd = { .fd = queue->fd, .events = POLLIN };
+
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+        {
+            fprintf(stderr, "notification worker failed to poll: %s\n",
+                    strerror(errno));
+            break;
+        }
+
+        if (__atomic_load_n(&queue->shutdown, __ATOMIC_ACQUIRE))
+            break;
+
+        notification_queue_drain(queue);
+    }
+
+    return NULL;
+}
+
+static void
+surface_deliver(struct surface_context *ctx_surf,
+                t_ilm_notification_mask mask)
+{
+    struct notification_queue *queue = &ctx_surf->ctx->notify_queue;
+    struct notification_record *record;
+
+    if (queue->records == NULL) {
+        ctx_surf->notification(ctx_surf->id_surface, &ctx_surf->prop, mask);
+        return;
+    }
+
+    record = notification_queue_reserve(queue);
+    if (record == NULL)
+        return;
+
+    record->type = NOTIFICATION_RECORD_SURFACE;
+    record->id = ctx_surf->id_surface;
+    record->callback.surface = ctx_surf->notification;
+    record->u.surface.prop = ctx_surf->prop;
+    record->u.surface.mask = mask;
+    notification_queue_push(queue);
+}
+
+static void
+layer_deliver(struct layer_context *ctx_layer, t_ilm_notification_mask mask)
+{
+    struct notification_queue *queue = &ctx_layer->ctx->notify_queue;
+    struct notification_record *record;
+
+    if (queue->records == NULL) {
+        ctx_layer->notification(ctx_layer->id_layer, &ctx_layer->prop, mask);
+        return;
+    }
+
+    record = notification_queue_reserve(queue);
+    if (record == NULL)
+        return;
+
+    record->type = NOTIFICATION_RECORD_LAYER;
+    record->id = ctx_layer->id_layer;
+    record->callback.layer = ctx_layer->notification;
+    record->u.layer.prop = ctx_layer->prop;
+    record->u.layer.mask = mask;
+    notification_queue_push(queue);
+}
+
+static void
+object_deliver(struct wayland_context *ctx, ilmObjectType type,
+               t_ilm_uint id, t_ilm_bool created)
+{
+    struct notification_record *record;
+
+    if (ctx->notification == NULL)
+        return;
+
+    if (ctx->notify_queue.records == NULL) {
+        ctx->notification(type, id, created, ctx->notification_user_data);
+        return;
+    }
+
+    record = notification_queue_reserve(&ctx->notify_queue);
+    if (record == NULL)
+        return;
+
+    record->type = NOTIFICATION_RECORD_OBJECT;
+    record->id = id;
+    record->callback.object = ctx->notification;
+    record->u.object.type = type;
+    record->u.object.created = created;
+    record->u.object.user_data = ctx->notification_user_data;
+    notification_queue_push(&ctx->notify_queue);
+}
+
+static void
+notify_defer(struct wayland_context *ctx, struct pending_notification *notify,
+             uint32_t mask)
+{
+    if (notify->mask == 0)
+        wl_list_insert(ctx->list_notify.prev, &notify->link);
+
+    notify->mask |= mask;
+}
+
+static uint32_t
+notify_take(struct pending_notification *notify)
+{
+    uint32_t mask = notify->mask;
+
+    if (mask != 0) {
+        wl_list_remove(&notify->link);
+        notify->mask = 0;
+    }
+
+    return mask;
+}
+
+static void
+surface_notify(struct surface_context *ctx_surf, uint32_t mask)
+{
+    if (ctx_surf->notification == NULL)
+        return;
+
+    if (ctx_surf->ctx->coalesce_notifications) {
+        notify_defer(ctx_surf->ctx, &ctx_surf->notify, mask);
+        return;
+    }
+
+    surface_deliver(ctx_surf, (t_ilm_notification_mask)mask);
+}
+
+static void
+layer_notify(struct layer_context *ctx_layer, uint32_t mask)
+{
+    if (ctx_layer->notification == NULL)
+        return;
+
+    if (ctx_layer->ctx->coalesce_notifications) {
+        notify_defer(ctx_layer->ctx, &ctx_layer->notify, mask);
+        return;
+    }
+
+    layer_deliver(ctx_layer, (t_ilm_notification_mask)mask);
+}
+
+/* Entries are taken one at a time, as a callback may call into ilm and
+ * dispatch further events, which add to or flush the list themselves.
+ */
+static void
+notify_flush(struct wayland_context *ctx)
+{
+    while (!wl_list_empty(&ctx->list_notify)) {
+        struct pending_notification *notify =
+            wl_container_of(ctx->list_notify.next, notify, link);
+        t_ilm_notification_mask mask =
+            (t_ilm_notification_mask)notify_take(notify);
+
+        if (notify->is_layer) {
+            struct layer_context *ctx_layer =
+                wl_container_of(notify, ctx_layer, notify);
+            if (ctx_layer->notification != NULL)
+                layer_deliver(ctx_layer, mask);
+        } else {
+            struct surface_context *ctx_surf =
+                wl_container_of(notify, ctx_surf, notify);
+            if (ctx_surf->notification != NULL)
+                surface_deliver(ctx_surf, mask);
+        }
+    }
+}
+
 static int init_control(void);
 
 static struct surface_context* get_surface_context(struct wayland_context *, uint32_t);
@@ -89,17 +647,10 @@ static struct surface_context* get_surface_context(struct wayland_context *, uin
 void release_instance(void);
 
 static int32_t
-wayland_controller_is_inside_layer_list(struct wl_list *list,
+wayland_controller_is_inside_layer_list(struct wayland_context *ctx,
                                         uint32_t id_layer)
 {
-    struct layer_context *ctx_layer = NULL;
-    wl_list_for_each(ctx_layer, list, link) {
-        if (ctx_layer->id_layer == id_layer) {
-            return 1;
-        }
-    }
-
-    return 0;
+    return id_index_lookup(&ctx->index_layer, id_layer) != NULL;
 }
 
 static struct layer_context*
@@ -107,19 +658,47 @@ wayland_controller_get_layer_context(struct wayland_context *ctx,
                                      uint32_t id_layer)
 {
     struct layer_context *ctx_layer = NULL;
+    struct id_index_entry *entry;
 
     if (ctx->controller == NULL) {
         fprintf(stderr, "controller is not initialized in ilmControl\n");
         return NULL;
     }
 
-    wl_list_for_each(ctx_layer, &ctx->list_layer, link) {
-        if (ctx_layer->id_layer == id_layer) {
-            return ctx_layer;
-        }
-    }
+    entry = id_index_lookup(&ctx->index_layer, id_layer);
+    if (entry == NULL)
+        return NULL;
 
-    return NULL;
+    return wl_container_of(entry, ctx_layer, index);
+}
+
+/* For readers holding the mirror lock only, which must not look at
+ * anything but the index and the mirrored fields.
+ */
+static struct layer_context*
+mirror_get_layer_context(struct wayland_context *ctx, uint32_t id_layer)
+{
+    struct layer_context *ctx_layer = NULL;
+    struct id_index_entry *entry;
+
+    entry = id_index_lookup(&ctx->index_layer, id_layer);
+    if (entry == NULL)
+        return NULL;
+
+    return wl_container_of(entry, ctx_layer, index);
+}
+
+static struct surface_context*
+mirror_get_surface_context(struct wayland_context *ctx, uint32_t id_surface)
+{
+    struct surface_context *ctx_surf = NULL;
+    struct id_index_entry *entry;
+
+    entry = id_index_lookup(&ctx->index_surface, id_surface);
+    if (entry == NULL)
+        return NULL;
+
+    return wl_container_of(entry, ctx_surf, index);
 }
 
 static void
@@ -211,13 +790,13 @@ wm_listener_layer_visibility(void *data, struct ivi_wm *controller,
     if (ctx_layer->prop.visibility == (t_ilm_bool)visibility)
         return;
 
+    mirror_write_lock(ctx);
     ctx_layer->prop.visibility = (t_ilm_bool)visibility;
 
-    if (ctx_layer->notification != NULL) {
-        ctx_layer->notification(ctx_layer->id_layer,
-                                &ctx_layer->prop,
-                                ILM_NOTIFICATION_VISIBILITY);
-    }
+    ctx_layer->seq++;
+    mirror_write_unlock(ctx);
+
+    layer_notify(ctx_layer, ILM_NOTIFICATION_VISIBILITY);
 }
 
 static void
@@ -234,13 +813,13 @@ wm_listener_layer_opacity(void *data, struct ivi_wm *controller,
     if (ctx_layer->prop.opacity == (t_ilm_float)wl_fixed_to_double(opacity))
         return;
 
+    mirror_write_lock(ctx);
     ctx_layer->prop.opacity = (t_ilm_float)wl_fixed_to_double(opacity);
 
-    if (ctx_layer->notification != NULL) {
-        ctx_layer->notification(ctx_layer->id_layer,
-                                &ctx_layer->prop,
-                                ILM_NOTIFICATION_OPACITY);
-    }
+    ctx_layer->seq++;
+    mirror_write_unlock(ctx);
+
+    layer_notify(ctx_layer, ILM_NOTIFICATION_OPACITY);
 }
 
 static void
@@ -261,16 +840,16 @@ wm_listener_layer_source_rectangle(void *data, struct ivi_wm *controller,
         (ctx_layer->prop.sourceHeight == (t_ilm_uint)height)))
         return;
 
+    mirror_write_lock(ctx);
     ctx_layer->prop.sourceX = (t_ilm_uint)x;
     ctx_layer->prop.sourceY = (t_ilm_uint)y;
     ctx_layer->prop.sourceWidth = (t_ilm_uint)width;
     ctx_layer->prop.sourceHeight = (t_ilm_uint)height;
 
-    if (ctx_layer->notification != NULL) {
-        ctx_layer->notification(ctx_layer->id_layer,
-                                &ctx_layer->prop,
-                                ILM_NOTIFICATION_SOURCE_RECT);
-    }
+    ctx_layer->seq++;
+    mirror_write_unlock(ctx);
+
+    layer_notify(ctx_layer, ILM_NOTIFICATION_SOURCE_RECT);
 }
 
 static void
@@ -291,16 +870,16 @@ wm_listener_layer_destination_rectangle(void *data, struct ivi_wm *controller,
         (ctx_layer->prop.destHeight == (t_ilm_uint)height)))
         return;
 
+    mirror_write_lock(ctx);
     ctx_layer->prop.destX = (t_ilm_uint)x;
     ctx_layer->prop.destY = (t_ilm_uint)y;
     ctx_layer->prop.destWidth = (t_ilm_uint)width;
     ctx_layer->prop.destHeight = (t_ilm_uint)height;
 
-    if (ctx_layer->notification != NULL) {
-        ctx_layer->notification(ctx_layer->id_layer,
-                                &ctx_layer->prop,
-                                ILM_NOTIFICATION_DEST_RECT);
-    }
+    ctx_layer->seq++;
+    mirror_write_unlock(ctx);
+
+    layer_notify(ctx_layer, ILM_NOTIFICATION_DEST_RECT);
 }
 
 static void
@@ -321,14 +900,14 @@ wm_listener_layer_created(void *data, struct ivi_wm *controller, uint32_t layer_
 
     ctx_layer->id_layer = layer_id;
     ctx_layer->ctx = ctx;
+    ctx_layer->notify.is_layer = true;
 
+    mirror_write_lock(ctx);
     wl_list_insert(&ctx->list_layer, &ctx_layer->link);
+    id_index_insert(&ctx->index_layer, &ctx_layer->index, layer_id);
+    mirror_write_unlock(ctx);
 
-    if (ctx->notification != NULL) {
-       ilmObjectType layer = ILM_LAYER;
-       ctx->notification(layer, ctx_layer->id_layer, ILM_TRUE,
-                         ctx->notification_user_data);
-    }
+    object_deliver(ctx, ILM_LAYER, ctx_layer->id_layer, ILM_TRUE);
 }
 
 static void
@@ -341,13 +920,17 @@ wm_listener_layer_destroyed(void *data, struct ivi_wm *controller, uint32_t laye
     if(!ctx_layer)
         return;
 
+    notify_take(&ctx_layer->notify);
+
+    mirror_write_lock(ctx);
     wl_list_remove(&ctx_layer->link);
+    id_index_remove(&ctx->index_layer, &ctx_layer->index);
+    mirror_write_unlock(ctx);
 
-    if (ctx_layer->ctx->notification != NULL) {
-        ilmObjectType layer = ILM_LAYER;
-        ctx_layer->ctx->notification(layer, ctx_layer->id_layer, ILM_FALSE,
-                                     ctx_layer->ctx->notification_user_data);
-    }
+    object_deliver(ctx, ILM_LAYER, ctx_layer->id_layer, ILM_FALSE);
+
+    if (ctx_layer->id_generated)
+        id_allocator_put(&ctx->layer_ids, ctx_layer->id_layer);
 
     free(ctx_layer);
 }
@@ -369,23 +952,55 @@ wm_listener_layer_surface_added(void *data, struct ivi_wm *controller,
 }
 
 static void
-wm_listener_layer_error(void *data, struct ivi_wm *controller, uint32_t object_id,
-                        uint32_t code, const char *message)
+wm_listener_scene_mirror(void *data, struct ivi_wm *controller,
+                         int32_t fd, uint32_t size)
 {
     struct wayland_context *ctx = data;
-    ilmErrorTypes error_code;
+    struct ivi_scene_mirror *mirror;
+    (void)controller;
 
-    switch (code) {
-    case IVI_WM_LAYER_ERROR_NO_SURFACE:
-        error_code = ILM_ERROR_RESOURCE_NOT_FOUND;
-        fprintf(stderr, "The surface with id: %d does not exist\n", object_id);
-        break;
-    case IVI_WM_LAYER_ERROR_NO_LAYER:
-        error_code = ILM_ERROR_RESOURCE_NOT_FOUND;
-        fprintf(stderr, "The layer with id: %d does not exist\n", object_id);
-        break;
-    case IVI_WM_LAYER_ERROR_BAD_PARAM:
-        error_code = ILM_ERROR_INVALID_ARGUMENTS;
+    if ((ctx->scene_mirror != NULL) || (size < sizeof *mirror)) {
+        close(fd);
+        return;
+    }
+
+    mirror = mmap(NULL, sizeof *mirror, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mirror == MAP_FAILED) {
+        fprintf(stderr, "failed to map scene mirror: %s\n", strerror(errno));
+        return;
+    }
+
+    if ((mirror->magic != IVI_SCENE_MIRROR_MAGIC) ||
+        (mirror->version != IVI_SCENE_MIRROR_VERSION) ||
+        (mirror->size != sizeof *mirror)) {
+        fprintf(stderr, "scene mirror layout is not supported\n");
+        munmap(mirror, sizeof *mirror);
+        return;
+    }
+
+    /* readers pick the mapping up without taking the context lock */
+    __atomic_store_n(&ctx->scene_mirror, mirror, __ATOMIC_RELEASE);
+}
+
+static void
+wm_listener_layer_error(void *data, struct ivi_wm *controller, uint32_t object_id,
+                        uint32_t code, const char *message)
+{
+    struct wayland_context *ctx = data;
+    ilmErrorTypes error_code;
+
+    switch (code) {
+    case IVI_WM_LAYER_ERROR_NO_SURFACE:
+        error_code = ILM_ERROR_RESOURCE_NOT_FOUND;
+        fprintf(stderr, "The surface with id: %d does not exist\n", object_id);
+        break;
+    case IVI_WM_LAYER_ERROR_NO_LAYER:
+        error_code = ILM_ERROR_RESOURCE_NOT_FOUND;
+        fprintf(stderr, "The layer with id: %d does not exist\n", object_id);
+        break;
+    case IVI_WM_LAYER_ERROR_BAD_PARAM:
+        error_code = ILM_ERROR_INVALID_ARGUMENTS;
         fprintf(stderr, "The layer with id: %d is used with invalid parameter\n",
                 object_id);
         break;
@@ -415,13 +1030,13 @@ wm_listener_surface_visibility(void *data, struct ivi_wm *controller,
     if (ctx_surf->prop.visibility == (t_ilm_bool)visibility)
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.visibility = (t_ilm_bool)visibility;
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                                &ctx_surf->prop,
-                                ILM_NOTIFICATION_VISIBILITY);
-    }
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+
+    surface_notify(ctx_surf, ILM_NOTIFICATION_VISIBILITY);
 }
 
 static void
@@ -438,13 +1053,13 @@ wm_listener_surface_opacity(void *data, struct ivi_wm *controller,
     if (ctx_surf->prop.opacity == (t_ilm_float)wl_fixed_to_double(opacity))
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.opacity = (t_ilm_float)wl_fixed_to_double(opacity);
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                                &ctx_surf->prop,
-                                ILM_NOTIFICATION_OPACITY);
-    }
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+
+    surface_notify(ctx_surf, ILM_NOTIFICATION_OPACITY);
 }
 
 static void
@@ -462,14 +1077,14 @@ wm_listener_surface_size(void *data, struct ivi_wm *controller,
         (ctx_surf->prop.origSourceHeight == (t_ilm_uint)height))
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.origSourceWidth = (t_ilm_uint)width;
     ctx_surf->prop.origSourceHeight = (t_ilm_uint)height;
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                                &ctx_surf->prop,
-                                ILM_NOTIFICATION_CONFIGURED);
-    }
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+
+    surface_notify(ctx_surf, ILM_NOTIFICATION_CONFIGURED);
 }
 
 static void
@@ -490,16 +1105,16 @@ wm_listener_surface_source_rectangle(void *data, struct ivi_wm *controller,
         (ctx_surf->prop.sourceHeight == (t_ilm_uint)height)))
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.sourceX = (t_ilm_uint)x;
     ctx_surf->prop.sourceY = (t_ilm_uint)y;
     ctx_surf->prop.sourceWidth = (t_ilm_uint)width;
     ctx_surf->prop.sourceHeight = (t_ilm_uint)height;
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                                &ctx_surf->prop,
-                                ILM_NOTIFICATION_SOURCE_RECT);
-    }
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+
+    surface_notify(ctx_surf, ILM_NOTIFICATION_SOURCE_RECT);
 }
 
 static void
@@ -520,16 +1135,16 @@ wm_listener_surface_destination_rectangle(void *data, struct ivi_wm *controller,
         (ctx_surf->prop.destHeight == (t_ilm_uint)height)))
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.destX = (t_ilm_uint)x;
     ctx_surf->prop.destY = (t_ilm_uint)y;
     ctx_surf->prop.destWidth = (t_ilm_uint)width;
     ctx_surf->prop.destHeight = (t_ilm_uint)height;
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                                &ctx_surf->prop,
-                                ILM_NOTIFICATION_DEST_RECT);
-    }
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+
+    surface_notify(ctx_surf, ILM_NOTIFICATION_DEST_RECT);
 }
 
 static void
@@ -544,8 +1159,34 @@ wm_listener_surface_stats(void *data, struct ivi_wm *controller,
     if(!ctx_surf)
         return;
 
+    mirror_write_lock(ctx);
     ctx_surf->prop.frameCounter = (t_ilm_uint)frame_count;
     ctx_surf->prop.creatorPid = (t_ilm_uint)pid;
+    ctx_surf->seq++;
+    mirror_write_unlock(ctx);
+}
+
+static void
+wm_listener_surface_frame_stats(void *data, struct ivi_wm *controller,
+                                uint32_t surface_id, uint32_t frames,
+                                wl_fixed_t fps, uint32_t interval_p50,
+                                uint32_t interval_p95, uint32_t interval_p99,
+                                uint32_t interval_max, uint32_t jitter)
+{
+    struct wayland_context *ctx = data;
+    struct surface_context *ctx_surf;
+
+    ctx_surf = get_surface_context(ctx, surface_id);
+    if(!ctx_surf)
+        return;
+
+    ctx_surf->frame_stats.frames = (t_ilm_uint)frames;
+    ctx_surf->frame_stats.frameRate = (t_ilm_float)wl_fixed_to_double(fps);
+    ctx_surf->frame_stats.intervalP50 = (t_ilm_uint)interval_p50;
+    ctx_surf->frame_stats.intervalP95 = (t_ilm_uint)interval_p95;
+    ctx_surf->frame_stats.intervalP99 = (t_ilm_uint)interval_p99;
+    ctx_surf->frame_stats.intervalMax = (t_ilm_uint)interval_max;
+    ctx_surf->frame_stats.jitter = (t_ilm_uint)jitter;
 }
 
 static void
@@ -568,14 +1209,13 @@ wm_listener_surface_created(void *data, struct ivi_wm *controller,
     ctx_surf->id_surface = surface_id;
     ctx_surf->ctx = ctx;
 
+    mirror_write_lock(ctx);
     wl_list_insert(&ctx->list_surface, &ctx_surf->link);
+    id_index_insert(&ctx->index_surface, &ctx_surf->index, surface_id);
+    mirror_write_unlock(ctx);
     wl_list_init(&ctx_surf->list_accepted_seats);
 
-    if (ctx->notification != NULL) {
-        ilmObjectType surface = ILM_SURFACE;
-        ctx->notification(surface, ctx_surf->id_surface, ILM_TRUE,
-                          ctx->notification_user_data);
-    }
+    object_deliver(ctx, ILM_SURFACE, ctx_surf->id_surface, ILM_TRUE);
 }
 
 static void
@@ -590,25 +1230,27 @@ wm_listener_surface_destroyed(void *data, struct ivi_wm *controller,
     if(!ctx_surf)
         return;
 
-    if (ctx_surf->notification != NULL) {
-        ctx_surf->notification(ctx_surf->id_surface,
-                               &ctx_surf->prop,
-                               ILM_NOTIFICATION_CONTENT_REMOVED);
-    }
+    {
+        /* changes not delivered yet are reported along with the removal */
+        t_ilm_notification_mask mask = (t_ilm_notification_mask)
+            (notify_take(&ctx_surf->notify) | ILM_NOTIFICATION_CONTENT_REMOVED);
 
-    if (ctx_surf->ctx->notification != NULL) {
-        ilmObjectType surface = ILM_SURFACE;
-        ctx_surf->ctx->notification(surface, ctx_surf->id_surface, ILM_FALSE,
-                                    ctx_surf->ctx->notification_user_data);
+        if (ctx_surf->notification != NULL)
+            surface_deliver(ctx_surf, mask);
     }
 
+    object_deliver(ctx, ILM_SURFACE, ctx_surf->id_surface, ILM_FALSE);
+
     wl_list_for_each_safe(seat, seat_next, &ctx_surf->list_accepted_seats, link) {
         wl_list_remove(&seat->link);
         free(seat->seat_name);
         free(seat);
     }
 
+    mirror_write_lock(ctx);
     wl_list_remove(&ctx_surf->link);
+    id_index_remove(&ctx->index_surface, &ctx_surf->index);
+    mirror_write_unlock(ctx);
     free(ctx_surf);
 }
 
@@ -664,6 +1306,8 @@ static struct ivi_wm_listener wm_listener=
     wm_listener_surface_size,
     wm_listener_surface_stats,
     wm_listener_layer_surface_added,
+    wm_listener_scene_mirror,
+    wm_listener_surface_frame_stats,
 };
 
 static void
@@ -671,8 +1315,11 @@ wm_screen_listener_screen_id(void *data, struct ivi_wm_screen *controller,
                              uint32_t screen_id)
 {
     struct screen_context *ctx_screen = data;
+    struct wayland_context *ctx = ctx_screen->ctx;
 
+    id_index_remove(&ctx->index_screen, &ctx_screen->index);
     ctx_screen->id_screen = screen_id;
+    id_index_insert(&ctx->index_screen, &ctx_screen->index, screen_id);
 }
 
 static void
@@ -812,15 +1459,18 @@ input_listener_input_focus(void *data,
 {
     struct wayland_context *ctx = data;
     struct surface_context *surf_ctx;
-    wl_list_for_each(surf_ctx, &ctx->list_surface, link) {
-        if (surface != surf_ctx->id_surface)
-            continue;
 
-        if (enabled == ILM_TRUE)
-            surf_ctx->prop.focus |= device;
-        else
-            surf_ctx->prop.focus &= ~device;
-    }
+    surf_ctx = get_surface_context(ctx, surface);
+    if (surf_ctx == NULL)
+        return;
+
+    mirror_write_lock(ctx);
+    if (enabled == ILM_TRUE)
+        surf_ctx->prop.focus |= device;
+    else
+        surf_ctx->prop.focus &= ~device;
+    surf_ctx->seq++;
+    mirror_write_unlock(ctx);
 }
 
 static void
@@ -833,17 +1483,10 @@ input_listener_input_acceptance(void *data,
     struct accepted_seat *accepted_seat, *next;
     struct wayland_context *ctx = data;
     struct surface_context *surface_ctx = NULL;
-    int surface_found = 1;
     int accepted_seat_found = 0;
 
-    wl_list_for_each(surface_ctx, &ctx->list_surface, link) {
-        if (surface_ctx->id_surface == surface) {
-            surface_found = 1;
-            break;
-        }
-    }
-
-    if (!surface_found) {
+    surface_ctx = get_surface_context(ctx, surface);
+    if (surface_ctx == NULL) {
         fprintf(stderr, "Warning: input acceptance event received for "
                 "nonexistent surface %d\n", surface);
         return;
@@ -899,11 +1542,11 @@ registry_handle_control(void *data,
                        uint32_t version)
 {
     struct wayland_context *ctx = data;
-    (void)version;
 
     if (strcmp(interface, "ivi_wm") == 0) {
         ctx->controller = wl_registry_bind(registry, name,
-                                           &ivi_wm_interface, 1);
+                                           &ivi_wm_interface,
+                                           version < 7 ? version : 7);
         if (ctx->controller == NULL) {
             fprintf(stderr, "Failed to registry bind ivi_wm\n");
             return;
@@ -952,6 +1595,7 @@ registry_handle_control(void *data,
 
         ctx_scrn->ctx = ctx;
         ctx_scrn->name = name;
+        wl_list_init(&ctx_scrn->index.link);
         wl_list_insert(&ctx->list_screen, &ctx_scrn->link);
     }
 }
@@ -975,6 +1619,7 @@ registry_handle_control_remove(void *data, struct wl_registry *registry, uint32_
             }
 
             wl_list_remove(&ctx_scrn->link);
+            id_index_remove(&ctx->index_screen, &ctx_scrn->index);
             wl_array_release(&ctx_scrn->render_order);
             free(ctx_scrn);
         }
@@ -989,6 +1634,108 @@ registry_control_listener= {
 
 struct ilm_control_context ilm_context;
 
+/* selected by ilm_useExternalEventLoop for the next initialization */
+static bool use_external_event_loop = false;
+static uint32_t notification_queue_capacity = 0;
+static bool notification_queue_worker = false;
+
+static int
+notification_queue_init(struct notification_queue *queue, uint32_t capacity,
+                        bool worker)
+{
+    uint32_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    queue->records = calloc(size, sizeof *queue->records);
+    if (queue->records == NULL) {
+        fprintf(stderr, "Failed to allocate memory for notification queue\n");
+        return -1;
+    }
+
+    queue->mask = size - 1;
+    queue->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (queue->fd == -1) {
+        fprintf(stderr, "Could not setup notification-fd: %s\n", strerror(errno));
+        free(queue->records);
+        queue->records = NULL;
+        return -1;
+    }
+
+    pthread_mutex_init(&queue->consumer_lock, NULL);
+
+    if (worker) {
+        if (pthread_create(&queue->worker, NULL, notification_worker, queue) != 0) {
+            fprintf(stderr, "Failed to start notification worker thread\n");
+            pthread_mutex_destroy(&queue->consumer_lock);
+            close(queue->fd);
+            free(queue->records);
+            queue->records = NULL;
+            return -1;
+        }
+        queue->has_worker = true;
+    }
+
+    return 0;
+}
+
+/* records not consumed yet are discarded */
+static void
+notification_queue_release(struct notification_queue *queue)
+{
+    if (queue->records == NULL)
+        return;
+
+    if (queue->has_worker) {
+        __atomic_store_n(&queue->shutdown, true, __ATOMIC_RELEASE);
+        notification_queue_signal(queue);
+        if (0 != pthread_join(queue->worker, NULL)) {
+            fprintf(stderr, "failed to join notification worker thread\n");
+        }
+        queue->has_worker = false;
+    }
+
+    close(queue->fd);
+    pthread_mutex_destroy(&queue->consumer_lock);
+    free(queue->records);
+    queue->records = NULL;
+}
+
+static void
+destroy_capture_context(struct capture_context *ctx_capture)
+{
+    uint32_t i;
+
+    wl_list_remove(&ctx_capture->link);
+    ivi_capture_destroy(ctx_capture->capture);
+
+    for (i = 0; i < ctx_capture->buffer_count; i++) {
+        struct ilmScreenshot *image = &ctx_capture->buffers[i];
+
+        if (image->buffer != NULL)
+            munmap((void *)image->buffer, image->size);
+        if (image->fd >= 0)
+            close(image->fd);
+    }
+
+    free(ctx_capture->buffers);
+    free(ctx_capture);
+}
+
+/* The destroy request only exists since version 6. Older objects are
+ * destroyed by the compositor after done or error, only the proxy is left.
+ */
+static void
+screenshot_proxy_destroy(struct ivi_screenshot *screenshot)
+{
+    if (ivi_screenshot_get_version(screenshot) >=
+        IVI_SCREENSHOT_DESTROY_SINCE_VERSION)
+        ivi_screenshot_destroy(screenshot);
+    else
+        wl_proxy_destroy((struct wl_proxy *)screenshot);
+}
+
 static void destroy_control_resources(void)
 {
     struct ilm_control_context *ctx = &ilm_context;
@@ -1013,7 +1760,10 @@ static void destroy_control_resources(void)
         }
     }
 
+    wl_list_init(&ctx->wl.list_notify);
+
     if (ctx->wl.controller != NULL) {
+        mirror_write_lock(&ctx->wl);
         {
             struct surface_context *l;
             struct surface_context *n;
@@ -1039,6 +1789,7 @@ static void destroy_control_resources(void)
                 free(l);
             }
         }
+        mirror_write_unlock(&ctx->wl);
 
         ivi_wm_destroy(ctx->wl.controller);
         ctx->wl.controller = NULL;
@@ -1053,6 +1804,76 @@ static void destroy_control_resources(void)
         }
     }
 
+    {
+        struct commit_context *c, *n;
+        wl_list_for_each_safe(c, n, &ctx->wl.list_commit, link) {
+            wl_list_remove(&c->link);
+            wl_callback_destroy(c->callback);
+            c->notification(ILM_ERROR_ON_CONNECTION, 0, c->user_data);
+            free(c);
+        }
+    }
+
+    {
+        struct screenshot_async_context *c, *n;
+        wl_list_for_each_safe(c, n, &ctx->wl.list_screenshot, link) {
+            wl_list_remove(&c->link);
+            screenshot_proxy_destroy(c->screenshot);
+            c->notification(ILM_ERROR_ON_CONNECTION, NULL, c->user_data);
+            free(c);
+        }
+    }
+
+    {
+        struct capture_context *c, *n;
+        wl_list_for_each_safe(c, n, &ctx->wl.list_capture, link) {
+            uint32_t id = c->id;
+            captureNotificationFunc notification = c->notification;
+            void *user_data = c->user_data;
+
+            destroy_capture_context(c);
+            notification(ILM_ERROR_ON_CONNECTION, id, NULL, user_data);
+        }
+    }
+
+    {
+        struct held_screenshot *h, *n;
+        wl_list_for_each_safe(h, n, &ctx->wl.list_screenshot_held, link) {
+            wl_list_remove(&h->link);
+            screenshot_proxy_destroy(h->screenshot);
+            free(h);
+        }
+    }
+
+    {
+        struct delta_base *b, *n;
+        wl_list_for_each_safe(b, n, &ctx->wl.list_delta_base, link) {
+            wl_list_remove(&b->link);
+            free(b->hashes);
+            free(b);
+        }
+    }
+
+    if (ctx->wl.scene_mirror != NULL) {
+        munmap((void *)ctx->wl.scene_mirror, sizeof(struct ivi_scene_mirror));
+        ctx->wl.scene_mirror = NULL;
+    }
+
+    {
+        struct pending_state *p, *n;
+        wl_list_for_each_safe(p, n, &ctx->wl.transaction.list_pending, link) {
+            transaction_free_pending(&ctx->wl.transaction, p);
+        }
+        ctx->wl.transaction.depth = 0;
+    }
+
+    id_index_release(&ctx->wl.index_surface);
+    id_index_release(&ctx->wl.index_layer);
+    id_index_release(&ctx->wl.index_screen);
+    id_index_release(&ctx->wl.transaction.index_surface);
+    id_index_release(&ctx->wl.transaction.index_layer);
+    wl_array_release(&ctx->wl.layer_ids.released);
+
     if (ctx->wl.display) {
         wl_display_flush(ctx->wl.display);
     }
@@ -1072,6 +1893,10 @@ static void destroy_control_resources(void)
         ctx->wl.input_controller = NULL;
     }
 
+    if (0 != pthread_rwlock_destroy(&ctx->wl.mirror_lock)) {
+        fprintf(stderr, "failed to destroy pthread_rwlock\n");
+    }
+
     if (0 != pthread_mutex_destroy(&ctx->mutex)) {
         fprintf(stderr, "failed to destroy pthread_mutex\n");
     }
@@ -1126,6 +1951,8 @@ ilmControl_destroy(void)
         }
     }
 
+    notification_queue_release(&ctx->wl.notify_queue);
+
     destroy_control_resources();
 
     if (ctx->shutdown_fd > -1)
@@ -1152,6 +1979,7 @@ ilmControl_init(t_ilm_nativedisplay nativedisplay)
     ctx->shutdown_fd = -1;
     ctx->notification = NULL;
     ctx->notification_user_data = NULL;
+    ctx->external_event_loop = use_external_event_loop;
 
     ctx->wl.display = (struct wl_display*)nativedisplay;
 
@@ -1159,6 +1987,35 @@ ilmControl_init(t_ilm_nativedisplay nativedisplay)
     wl_list_init(&ctx->wl.list_layer);
     wl_list_init(&ctx->wl.list_surface);
     wl_list_init(&ctx->wl.list_seat);
+    wl_list_init(&ctx->wl.list_commit);
+    wl_list_init(&ctx->wl.list_screenshot);
+    wl_list_init(&ctx->wl.list_screenshot_held);
+    wl_list_init(&ctx->wl.list_capture);
+    ctx->wl.next_capture_id = 1;
+    wl_list_init(&ctx->wl.list_delta_base);
+    ctx->wl.next_delta_id = 1;
+    wl_list_init(&ctx->wl.list_notify);
+    wl_list_init(&ctx->wl.transaction.list_pending);
+    ctx->wl.transaction.depth = 0;
+    ctx->wl.transaction.recorded = 0;
+    ctx->wl.transaction.sent = 0;
+    ctx->wl.layer_ids.next = 0;
+    wl_array_init(&ctx->wl.layer_ids.released);
+
+    if (id_index_init(&ctx->wl.index_surface) != 0 ||
+        id_index_init(&ctx->wl.index_layer) != 0 ||
+        id_index_init(&ctx->wl.index_screen) != 0 ||
+        id_index_init(&ctx->wl.transaction.index_surface) != 0 ||
+        id_index_init(&ctx->wl.transaction.index_layer) != 0)
+    {
+        fprintf(stderr, "Failed to allocate memory for id index\n");
+        id_index_release(&ctx->wl.index_surface);
+        id_index_release(&ctx->wl.index_layer);
+        id_index_release(&ctx->wl.index_screen);
+        id_index_release(&ctx->wl.transaction.index_surface);
+        id_index_release(&ctx->wl.transaction.index_layer);
+        return ILM_FAILED;
+    }
 
     {
        pthread_mutexattr_t a;
@@ -1183,8 +2040,43 @@ ilmControl_init(t_ilm_nativedisplay nativedisplay)
        pthread_mutexattr_destroy(&a);
     }
 
+    {
+       pthread_rwlockattr_t a;
+       int ret;
+
+       if (pthread_rwlockattr_init(&a) != 0)
+       {
+          pthread_mutex_destroy(&ctx->mutex);
+          return ILM_FAILED;
+       }
+
+       /* a steady stream of readers must not starve event dispatching */
+       pthread_rwlockattr_setkind_np(&a, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+       ret = pthread_rwlock_init(&ctx->wl.mirror_lock, &a);
+       pthread_rwlockattr_destroy(&a);
+
+       if (ret != 0)
+       {
+           fprintf(stderr, "failed to initialize pthread_rwlock\n");
+           pthread_mutex_destroy(&ctx->mutex);
+           return ILM_FAILED;
+       }
+    }
+
+    /* before init_control, the control thread produces notifications */
+    if (notification_queue_capacity > 0 &&
+        notification_queue_init(&ctx->wl.notify_queue,
+                                notification_queue_capacity,
+                                notification_queue_worker) != 0)
+    {
+        pthread_rwlock_destroy(&ctx->wl.mirror_lock);
+        pthread_mutex_destroy(&ctx->mutex);
+        return ILM_FAILED;
+    }
+
     if (init_control() != 0)
     {
+        notification_queue_release(&ctx->wl.notify_queue);
         ilmControl_destroy();
         return ILM_FAILED;
     }
@@ -1229,6 +2121,7 @@ control_thread(void *p_ret)
     struct wl_event_queue *const queue = wl->queue;
     int const fd = wl_display_get_fd(display);
     int const shutdown_fd = ctx->shutdown_fd;
+    int flushed;
     (void) p_ret;
 
     while (1)
@@ -1240,7 +2133,14 @@ control_thread(void *p_ret)
             unlock_context(ctx);
         }
 
-        if (wl_display_flush(display) == -1)
+        /* Requests of an open transaction go out when it ends. The lock
+         * keeps one from starting during the flush.
+         */
+        lock_context(ctx);
+        flushed = wl->transaction.depth > 0 ? 0 : wl_display_flush(display);
+        unlock_context(ctx);
+
+        if (flushed == -1)
         {
             handle_shutdown(ctx, ILM_ERROR_WAYLAND);
             break;
@@ -1283,131 +2183,330 @@ control_thread(void *p_ret)
     return NULL;
 }
 
-static int
-init_control(void)
+ILM_EXPORT ilmErrorTypes
+ilm_useExternalEventLoop(t_ilm_bool enable)
 {
     struct ilm_control_context *ctx = &ilm_context;
-    struct wayland_context *wl = &ctx->wl;
-    struct screen_context *ctx_scrn;
-    int ret = 0;
-
-    wl->queue = wl_display_create_queue(wl->display);
-    if (! wl->queue) {
-        fprintf(stderr, "Could not create wayland event queue\n");
-        return -1;
-    }
-
-    /* registry_add_listener for request by ivi-controller */
-    wl->registry = wl_display_get_registry(wl->display);
-    if (wl->registry == NULL) {
-        wl_event_queue_destroy(wl->queue);
-        wl->queue = NULL;
-        fprintf(stderr, "Failed to get registry\n");
-        return -1;
-    }
-    wl_proxy_set_queue((void*)wl->registry, wl->queue);
-
-    if (wl_registry_add_listener(wl->registry,
-                             &registry_control_listener, ctx)) {
-        fprintf(stderr, "Failed to add registry listener\n");
-        return -1;
-    }
 
-    // get globals
-    if (wl_display_roundtrip_queue(wl->display, wl->queue) == -1)
+    if (ctx->initialized)
     {
-        fprintf(stderr, "Failed to initialize wayland connection: %s\n", strerror(errno));
-        return -1;
+        fprintf(stderr, "[Error] event loop mode can not be changed while initialized\n");
+        return ILM_FAILED;
     }
 
-    if (! wl->controller)
-    {
-        fprintf(stderr, "ivi_wm not available\n");
-        return -1;
-    }
+    use_external_event_loop = (enable == ILM_TRUE);
+    return ILM_SUCCESS;
+}
 
-    wl_list_for_each(ctx_scrn, &ctx->wl.list_screen, link) {
-        if (!ctx_scrn->controller) {
-            ctx_scrn->controller = ivi_wm_create_screen(wl->controller, ctx_scrn->output);
-            ivi_wm_screen_add_listener(ctx_scrn->controller, &wm_screen_listener,
-                                       ctx_scrn);
-        }
-    }
+static struct ilm_control_context *
+acquire_external_event_loop(void)
+{
+    struct ilm_control_context *ctx = &ilm_context;
 
-    // get screen-ids
-    if (wl_display_roundtrip_queue(wl->display, wl->queue) == -1)
+    if (!ctx->initialized || !ctx->external_event_loop)
     {
-        fprintf(stderr, "Failed to do roundtrip queue: %s\n", strerror(errno));
-        return -1;
+        fprintf(stderr, "[Error] ilm is not initialized for an external event loop\n");
+        return NULL;
     }
 
-    ctx->shutdown_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
-
-    if (ctx->shutdown_fd == -1)
-    {
-        fprintf(stderr, "Could not setup shutdown-fd: %s\n", strerror(errno));
-        return ILM_FAILED;
-    }
+    return ctx;
+}
 
-    ret = pthread_create(&ctx->thread, NULL, control_thread, NULL);
+ILM_EXPORT ilmErrorTypes
+ilm_getFd(t_ilm_int *pFd)
+{
+    struct ilm_control_context *ctx = acquire_external_event_loop();
 
-    if (ret != 0) {
-        fprintf(stderr, "Failed to start internal receive thread. returned %d\n", ret);
-        return -1;
-    }
+    if (pFd == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-    ctx->initialized = true;
+    if (ctx == NULL)
+        return ILM_FAILED;
 
-    return 0;
+    *pFd = wl_display_get_fd(ctx->wl.display);
+    return ILM_SUCCESS;
 }
 
-ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx)
+ILM_EXPORT ilmErrorTypes
+ilm_prepareRead(void)
 {
-    if (! ctx->initialized) {
-        fprintf(stderr, "Not initialized\n");
+    ilmErrorTypes returnValue = ILM_SUCCESS;
+    struct ilm_control_context *ctx = acquire_external_event_loop();
+
+    if (ctx == NULL)
         return ILM_FAILED;
-    }
 
     lock_context(ctx);
+    while (wl_display_prepare_read_queue(ctx->wl.display, ctx->wl.queue) != 0)
+    {
+        if (wl_display_dispatch_queue_pending(ctx->wl.display, ctx->wl.queue) == -1)
+        {
+            handle_shutdown(ctx, ILM_ERROR_WAYLAND);
+            returnValue = ILM_ERROR_ON_CONNECTION;
+            break;
+        }
+    }
 
-    if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
-        int err = wl_display_get_error(ctx->wl.display);
-        fprintf(stderr, "Error communicating with wayland: %s\n", strerror(err));
-        unlock_context(ctx);
-        return ILM_FAILED;
+    /* EAGAIN only means the socket is full, poll for POLLOUT in that case */
+    if (returnValue == ILM_SUCCESS &&
+        wl_display_flush(ctx->wl.display) == -1 && errno != EAGAIN)
+    {
+        wl_display_cancel_read(ctx->wl.display);
+        handle_shutdown(ctx, ILM_ERROR_WAYLAND);
+        returnValue = ILM_ERROR_ON_CONNECTION;
     }
+    unlock_context(ctx);
 
-    return ILM_SUCCESS;
+    return returnValue;
 }
 
-void release_instance(void)
+ILM_EXPORT ilmErrorTypes
+ilm_readEvents(void)
 {
-    struct ilm_control_context *ctx = &ilm_context;
+    struct ilm_control_context *ctx = acquire_external_event_loop();
+
+    if (ctx == NULL)
+        return ILM_FAILED;
+
+    /* blocks only until other threads which prepared a read are done */
+    if (wl_display_read_events(ctx->wl.display) == -1)
+    {
+        handle_shutdown(ctx, ILM_ERROR_WAYLAND);
+        return ILM_ERROR_ON_CONNECTION;
+    }
+
+    return ILM_SUCCESS;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_cancelRead(void)
+{
+    struct ilm_control_context *ctx = acquire_external_event_loop();
+
+    if (ctx == NULL)
+        return ILM_FAILED;
+
+    wl_display_cancel_read(ctx->wl.display);
+    return ILM_SUCCESS;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_dispatchPending(void)
+{
+    ilmErrorTypes returnValue = ILM_SUCCESS;
+    struct ilm_control_context *ctx = acquire_external_event_loop();
+
+    if (ctx == NULL)
+        return ILM_FAILED;
+
+    lock_context(ctx);
+    if (wl_display_dispatch_queue_pending(ctx->wl.display, ctx->wl.queue) == -1)
+    {
+        handle_shutdown(ctx, ILM_ERROR_WAYLAND);
+        returnValue = ILM_ERROR_ON_CONNECTION;
+    }
     unlock_context(ctx);
+
+    return returnValue;
 }
 
-static uint32_t
-gen_layer_id(struct ilm_control_context *ctx)
+ILM_EXPORT ilmErrorTypes
+ilm_useNotificationQueue(t_ilm_uint capacity, t_ilm_bool useWorker)
 {
-    struct layer_context *ctx_layer = NULL;
-    do {
-        int found = 0;
-        if (wl_list_length(&ctx->wl.list_layer) == 0) {
-            ctx->internal_id_layer++;
-            return ctx->internal_id_layer;
-        }
-        wl_list_for_each(ctx_layer, &ctx->wl.list_layer, link) {
-            if (ctx_layer->id_layer == ctx->internal_id_layer) {
-                found = 1;
-                break;
-            }
+    struct ilm_control_context *ctx = &ilm_context;
 
-            if (found == 0) {
-                return ctx->internal_id_layer;
-            }
+    if (ctx->initialized)
+    {
+        fprintf(stderr, "[Error] notification delivery can not be changed while initialized\n");
+        return ILM_FAILED;
+    }
+
+    if (capacity > 0x10000)
+    {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    notification_queue_capacity = capacity;
+    notification_queue_worker = (useWorker == ILM_TRUE);
+    return ILM_SUCCESS;
+}
+
+static struct notification_queue *
+acquire_notification_queue(void)
+{
+    struct ilm_control_context *ctx = &ilm_context;
+
+    if (!ctx->initialized || ctx->wl.notify_queue.records == NULL)
+    {
+        fprintf(stderr, "[Error] ilm is not initialized with a notification queue\n");
+        return NULL;
+    }
+
+    if (ctx->wl.notify_queue.has_worker)
+    {
+        fprintf(stderr, "[Error] notifications are consumed by the worker thread\n");
+        return NULL;
+    }
+
+    return &ctx->wl.notify_queue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getNotificationFd(t_ilm_int *pFd)
+{
+    struct notification_queue *queue = acquire_notification_queue();
+
+    if (pFd == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
+
+    if (queue == NULL)
+        return ILM_FAILED;
+
+    *pFd = queue->fd;
+    return ILM_SUCCESS;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_dispatchNotifications(t_ilm_uint *pCount)
+{
+    struct notification_queue *queue = acquire_notification_queue();
+    uint32_t count;
+
+    if (queue == NULL)
+        return ILM_FAILED;
+
+    count = notification_queue_drain(queue);
+    if (pCount != NULL)
+        *pCount = count;
+
+    return ILM_SUCCESS;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getNotificationQueueStats(t_ilm_uint *pDelivered, t_ilm_uint *pDropped)
+{
+    struct ilm_control_context *ctx = &ilm_context;
+    struct notification_queue *queue = &ctx->wl.notify_queue;
+
+    if (pDelivered == NULL || pDropped == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
+
+    if (!ctx->initialized || queue->records == NULL)
+        return ILM_FAILED;
+
+    *pDelivered = __atomic_load_n(&queue->delivered, __ATOMIC_RELAXED);
+    *pDropped = __atomic_load_n(&queue->dropped, __ATOMIC_RELAXED);
+    return ILM_SUCCESS;
+}
+
+static int
+init_control(void)
+{
+    struct ilm_control_context *ctx = &ilm_context;
+    struct wayland_context *wl = &ctx->wl;
+    struct screen_context *ctx_scrn;
+    int ret = 0;
+
+    wl->queue = wl_display_create_queue(wl->display);
+    if (! wl->queue) {
+        fprintf(stderr, "Could not create wayland event queue\n");
+        return -1;
+    }
+
+    /* registry_add_listener for request by ivi-controller */
+    wl->registry = wl_display_get_registry(wl->display);
+    if (wl->registry == NULL) {
+        wl_event_queue_destroy(wl->queue);
+        wl->queue = NULL;
+        fprintf(stderr, "Failed to get registry\n");
+        return -1;
+    }
+    wl_proxy_set_queue((void*)wl->registry, wl->queue);
+
+    if (wl_registry_add_listener(wl->registry,
+                             &registry_control_listener, ctx)) {
+        fprintf(stderr, "Failed to add registry listener\n");
+        return -1;
+    }
+
+    // get globals
+    if (wl_display_roundtrip_queue(wl->display, wl->queue) == -1)
+    {
+        fprintf(stderr, "Failed to initialize wayland connection: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (! wl->controller)
+    {
+        fprintf(stderr, "ivi_wm not available\n");
+        return -1;
+    }
+
+    wl_list_for_each(ctx_scrn, &ctx->wl.list_screen, link) {
+        if (!ctx_scrn->controller) {
+            ctx_scrn->controller = ivi_wm_create_screen(wl->controller, ctx_scrn->output);
+            ivi_wm_screen_add_listener(ctx_scrn->controller, &wm_screen_listener,
+                                       ctx_scrn);
         }
-        ctx->internal_id_layer++;
-    } while(1);
+    }
+
+    // get screen-ids
+    if (wl_display_roundtrip_queue(wl->display, wl->queue) == -1)
+    {
+        fprintf(stderr, "Failed to do roundtrip queue: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (ctx->external_event_loop)
+    {
+        /* the application dispatches through ilm_dispatchPending */
+        ctx->initialized = true;
+        return 0;
+    }
+
+    ctx->shutdown_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (ctx->shutdown_fd == -1)
+    {
+        fprintf(stderr, "Could not setup shutdown-fd: %s\n", strerror(errno));
+        return ILM_FAILED;
+    }
+
+    ret = pthread_create(&ctx->thread, NULL, control_thread, NULL);
+
+    if (ret != 0) {
+        fprintf(stderr, "Failed to start internal receive thread. returned %d\n", ret);
+        return -1;
+    }
+
+    ctx->initialized = true;
+
+    return 0;
+}
+
+ilmErrorTypes impl_sync_and_acquire_instance(struct ilm_control_context *ctx)
+{
+    if (! ctx->initialized) {
+        fprintf(stderr, "Not initialized\n");
+        return ILM_FAILED;
+    }
+
+    lock_context(ctx);
+
+    if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
+        int err = wl_display_get_error(ctx->wl.display);
+        fprintf(stderr, "Error communicating with wayland: %s\n", strerror(err));
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    return ILM_SUCCESS;
+}
+
+void release_instance(void)
+{
+    struct ilm_control_context *ctx = &ilm_context;
+    unlock_context(ctx);
 }
 
 static struct surface_context*
@@ -1415,37 +2514,36 @@ get_surface_context(struct wayland_context *ctx,
                           uint32_t id_surface)
 {
     struct surface_context *ctx_surf = NULL;
+    struct id_index_entry *entry;
 
     if (ctx->controller == NULL) {
         fprintf(stderr, "controller is not initialized in ilmControl\n");
         return NULL;
     }
 
-    wl_list_for_each(ctx_surf, &ctx->list_surface, link) {
-        if (ctx_surf->id_surface == id_surface) {
-            return ctx_surf;
-        }
-    }
+    entry = id_index_lookup(&ctx->index_surface, id_surface);
+    if (entry == NULL)
+        return NULL;
 
-    return NULL;
+    return wl_container_of(entry, ctx_surf, index);
 }
 
 static struct screen_context*
 get_screen_context_by_id(struct wayland_context *ctx, uint32_t id_screen)
 {
     struct screen_context *ctx_scrn = NULL;
+    struct id_index_entry *entry;
 
     if (ctx->controller == NULL) {
         fprintf(stderr, "get_screen_context_by_id: controller is NULL\n");
         return NULL;
     }
 
-    wl_list_for_each(ctx_scrn, &ctx->list_screen, link) {
-        if (ctx_scrn->id_screen == id_screen) {
-            return ctx_scrn;
-        }
-    }
-    return NULL;
+    entry = id_index_lookup(&ctx->index_screen, id_screen);
+    if (entry == NULL)
+        return NULL;
+
+    return wl_container_of(entry, ctx_scrn, index);
 }
 
 ILM_EXPORT ilmErrorTypes
@@ -1481,772 +2579,2606 @@ ilm_getPropertiesOfLayer(t_ilm_uint layerID,
     return returnValue;
 }
 
-static void
-create_layerids(struct screen_context *ctx_screen,
-                t_ilm_layer **layer_ids, t_ilm_uint *layer_count)
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfLayers(t_ilm_uint number, const t_ilm_layer* pLayerIDs,
+                          struct ilmLayerProperties* pLayerProperties)
 {
-    t_ilm_layer *ids = NULL;
-    uint32_t *id = NULL;
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct layer_context *ctx_layer = NULL;
+    int32_t mask;
+    t_ilm_uint i;
 
-    if (ctx_screen->render_order.size == 0) {
-        *layer_ids = NULL;
-        *layer_count = 0;
-        return;
-    }
+    mask = IVI_WM_PARAM_OPACITY | IVI_WM_PARAM_VISIBILITY | IVI_WM_PARAM_SIZE;
 
-    *layer_ids = malloc(ctx_screen->render_order.size);
-    if (*layer_ids == NULL) {
-        fprintf(stderr, "memory insufficient for layerids\n");
-        *layer_count = 0;
-        wl_array_release(&ctx_screen->render_order);
-        wl_array_init(&ctx_screen->render_order);
-        return;
+    if ((pLayerIDs == NULL) || (pLayerProperties == NULL)) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
     }
 
-    ids = *layer_ids;
-    wl_array_for_each(id, &ctx_screen->render_order) {
-        *ids = (t_ilm_layer) *id;
-        ids++;
-        (*layer_count)++;
+    lock_context(ctx);
+
+    if (ctx->wl.controller) {
+        /* queue all requests, the roundtrip waits for every reply */
+        for (i = 0; i < number; i++) {
+            ivi_wm_layer_get(ctx->wl.controller, pLayerIDs[i], mask);
+        }
+
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) {
+            returnValue = ILM_SUCCESS;
+
+            for (i = 0; i < number; i++) {
+                ctx_layer = wayland_controller_get_layer_context(
+                                &ctx->wl, (uint32_t)pLayerIDs[i]);
+                if (ctx_layer != NULL) {
+                    pLayerProperties[i] = ctx_layer->prop;
+                } else {
+                    memset(&pLayerProperties[i], 0, sizeof *pLayerProperties);
+                    returnValue = ILM_FAILED;
+                }
+            }
+        }
     }
 
-    wl_array_release(&ctx_screen->render_order);
-    wl_array_init(&ctx_screen->render_order);
+    unlock_context(ctx);
+    return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_getPropertiesOfScreen(t_ilm_display screenID,
-                              struct ilmScreenProperties* pScreenProperties)
+ilm_getPropertiesOfLayerCached(t_ilm_uint layerID,
+                               struct ilmLayerProperties* pLayerProperties,
+                               t_ilm_uint* pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct layer_context *ctx_layer = NULL;
+
+    if (pLayerProperties == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    /* mirrored layers are read without waiting for the context lock */
+    mirror_read_lock(&ctx->wl);
+    ctx_layer = mirror_get_layer_context(&ctx->wl, (uint32_t)layerID);
+    if ((ctx_layer != NULL) && ctx_layer->mirrored) {
+        *pLayerProperties = ctx_layer->prop;
+        if (pSequence != NULL) {
+            *pSequence = ctx_layer->seq;
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    mirror_read_unlock(&ctx->wl);
+
+    if (returnValue == ILM_SUCCESS) {
+        return returnValue;
+    }
+
+    lock_context(ctx);
+
+    ctx_layer = wayland_controller_get_layer_context(&ctx->wl, (uint32_t)layerID);
+
+    /* without a notification the compositor does not send updates */
+    if ((ctx_layer != NULL) && !ctx_layer->mirrored) {
+        ivi_wm_layer_get(ctx->wl.controller, layerID,
+                         IVI_WM_PARAM_OPACITY | IVI_WM_PARAM_VISIBILITY |
+                         IVI_WM_PARAM_SIZE);
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) {
+            ctx_layer = wayland_controller_get_layer_context(&ctx->wl,
+                                                             (uint32_t)layerID);
+        } else {
+            ctx_layer = NULL;
+        }
+    }
+
+    if (ctx_layer != NULL) {
+        *pLayerProperties = ctx_layer->prop;
+        if (pSequence != NULL) {
+            *pSequence = ctx_layer->seq;
+        }
+        returnValue = ILM_SUCCESS;
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfSurfaceCached(t_ilm_uint surfaceID,
+                                 struct ilmSurfaceProperties* pSurfaceProperties,
+                                 t_ilm_uint* pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct surface_context *ctx_surf = NULL;
+
+    if (pSurfaceProperties == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    /* mirrored surfaces are read without waiting for the context lock */
+    mirror_read_lock(&ctx->wl);
+    ctx_surf = mirror_get_surface_context(&ctx->wl, (uint32_t)surfaceID);
+    if ((ctx_surf != NULL) && ctx_surf->mirrored) {
+        *pSurfaceProperties = ctx_surf->prop;
+        if (pSequence != NULL) {
+            *pSequence = ctx_surf->seq;
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    mirror_read_unlock(&ctx->wl);
+
+    if (returnValue == ILM_SUCCESS) {
+        return returnValue;
+    }
+
+    lock_context(ctx);
+
+    ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceID);
+
+    /* without a notification the compositor does not send updates */
+    if ((ctx_surf != NULL) && !ctx_surf->mirrored) {
+        ivi_wm_surface_get(ctx->wl.controller, surfaceID,
+                           IVI_WM_PARAM_OPACITY | IVI_WM_PARAM_VISIBILITY |
+                           IVI_WM_PARAM_SIZE);
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) {
+            ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceID);
+        } else {
+            ctx_surf = NULL;
+        }
+    }
+
+    if (ctx_surf != NULL) {
+        *pSurfaceProperties = ctx_surf->prop;
+        if (pSequence != NULL) {
+            *pSequence = ctx_surf->seq;
+        }
+        returnValue = ILM_SUCCESS;
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerGetVisibilityCached(t_ilm_layer layerId, t_ilm_bool *pVisibility,
+                             t_ilm_uint *pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilmLayerProperties prop;
+
+    if (pVisibility != NULL) {
+        returnValue = ilm_getPropertiesOfLayerCached(layerId, &prop, pSequence);
+        if (returnValue == ILM_SUCCESS) {
+            *pVisibility = prop.visibility;
+        }
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerGetOpacityCached(t_ilm_layer layerId, t_ilm_float *pOpacity,
+                          t_ilm_uint *pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilmLayerProperties prop;
+
+    if (pOpacity != NULL) {
+        returnValue = ilm_getPropertiesOfLayerCached(layerId, &prop, pSequence);
+        if (returnValue == ILM_SUCCESS) {
+            *pOpacity = prop.opacity;
+        }
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceGetVisibilityCached(t_ilm_surface surfaceId, t_ilm_bool *pVisibility,
+                               t_ilm_uint *pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilmSurfaceProperties prop;
+
+    if (pVisibility != NULL) {
+        returnValue = ilm_getPropertiesOfSurfaceCached(surfaceId, &prop,
+                                                       pSequence);
+        if (returnValue == ILM_SUCCESS) {
+            *pVisibility = prop.visibility;
+        }
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceGetOpacityCached(const t_ilm_surface surfaceId, t_ilm_float *pOpacity,
+                            t_ilm_uint *pSequence)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilmSurfaceProperties prop;
+
+    if (pOpacity != NULL) {
+        returnValue = ilm_getPropertiesOfSurfaceCached(surfaceId, &prop,
+                                                       pSequence);
+        if (returnValue == ILM_SUCCESS) {
+            *pOpacity = prop.opacity;
+        }
+    }
+
+    return returnValue;
+}
+
+static void
+create_layerids(struct screen_context *ctx_screen,
+                t_ilm_layer **layer_ids, t_ilm_uint *layer_count)
+{
+    t_ilm_layer *ids = NULL;
+    uint32_t *id = NULL;
+
+    if (ctx_screen->render_order.size == 0) {
+        *layer_ids = NULL;
+        *layer_count = 0;
+        return;
+    }
+
+    *layer_ids = malloc(ctx_screen->render_order.size);
+    if (*layer_ids == NULL) {
+        fprintf(stderr, "memory insufficient for layerids\n");
+        *layer_count = 0;
+        wl_array_release(&ctx_screen->render_order);
+        wl_array_init(&ctx_screen->render_order);
+        return;
+    }
+
+    ids = *layer_ids;
+    wl_array_for_each(id, &ctx_screen->render_order) {
+        *ids = (t_ilm_layer) *id;
+        ids++;
+        (*layer_count)++;
+    }
+
+    wl_array_release(&ctx_screen->render_order);
+    wl_array_init(&ctx_screen->render_order);
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfScreen(t_ilm_display screenID,
+                              struct ilmScreenProperties* pScreenProperties)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    if (! pScreenProperties)
+    {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    lock_context(ctx);
+    struct screen_context *ctx_screen = NULL;
+    ctx_screen = get_screen_context_by_id(&ctx->wl, (uint32_t)screenID);
+    if (ctx_screen != NULL) {
+        ivi_wm_screen_get(ctx_screen->controller, IVI_WM_PARAM_RENDER_ORDER);
+
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1 ) {
+            *pScreenProperties = ctx_screen->prop;
+            create_layerids(ctx_screen, &pScreenProperties->layerIds,
+                                        &pScreenProperties->layerCount);
+            returnValue = ILM_SUCCESS;
+        }
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
+static void
+scene_listener_screen(void *data, struct ivi_scene *ivi_scene,
+                      uint32_t screen_id, const char *connector_name,
+                      int32_t width, int32_t height)
+{
+    struct scene_context *ctx_scene = data;
+    struct ilmSceneScreen *screen;
+
+    screen = wl_array_add(&ctx_scene->screens, sizeof *screen);
+    if (screen == NULL) {
+        ctx_scene->error = true;
+        return;
+    }
+
+    memset(screen, 0, sizeof *screen);
+    screen->screenId = screen_id;
+    screen->prop.screenWidth = (t_ilm_uint)width;
+    screen->prop.screenHeight = (t_ilm_uint)height;
+    strncpy(screen->prop.connectorName, connector_name,
+            sizeof(screen->prop.connectorName) - 1);
+}
+
+static void
+scene_listener_screen_layer(void *data, struct ivi_scene *ivi_scene,
+                            uint32_t screen_id, uint32_t layer_id)
+{
+    struct scene_context *ctx_scene = data;
+    struct ilmSceneScreen *screen;
+    t_ilm_uint *id;
+
+    if (ctx_scene->screens.size == 0)
+        return;
+
+    screen = (struct ilmSceneScreen *)((char *)ctx_scene->screens.data +
+                                       ctx_scene->screens.size) - 1;
+    if (screen->screenId != screen_id) {
+        fprintf(stderr, "scene: layer %u of screen %u out of order\n",
+                layer_id, screen_id);
+        return;
+    }
+
+    id = wl_array_add(&ctx_scene->ids, sizeof *id);
+    if (id == NULL) {
+        ctx_scene->error = true;
+        return;
+    }
+
+    *id = layer_id;
+    screen->prop.layerCount++;
+}
+
+static void
+scene_listener_layer(void *data, struct ivi_scene *ivi_scene,
+                     uint32_t layer_id, wl_fixed_t opacity, int32_t visibility,
+                     int32_t source_x, int32_t source_y,
+                     int32_t source_width, int32_t source_height,
+                     int32_t dest_x, int32_t dest_y,
+                     int32_t dest_width, int32_t dest_height)
+{
+    struct scene_context *ctx_scene = data;
+    struct ilmSceneLayer *layer;
+
+    layer = wl_array_add(&ctx_scene->layers, sizeof *layer);
+    if (layer == NULL) {
+        ctx_scene->error = true;
+        return;
+    }
+
+    memset(layer, 0, sizeof *layer);
+    layer->layerId = layer_id;
+    layer->prop.opacity = (t_ilm_float)wl_fixed_to_double(opacity);
+    layer->prop.visibility = (t_ilm_bool)visibility;
+    layer->prop.sourceX = (t_ilm_uint)source_x;
+    layer->prop.sourceY = (t_ilm_uint)source_y;
+    layer->prop.sourceWidth = (t_ilm_uint)source_width;
+    layer->prop.sourceHeight = (t_ilm_uint)source_height;
+    layer->prop.destX = (t_ilm_uint)dest_x;
+    layer->prop.destY = (t_ilm_uint)dest_y;
+    layer->prop.destWidth = (t_ilm_uint)dest_width;
+    layer->prop.destHeight = (t_ilm_uint)dest_height;
+}
+
+static void
+scene_listener_layer_surface(void *data, struct ivi_scene *ivi_scene,
+                             uint32_t layer_id, uint32_t surface_id)
+{
+    struct scene_context *ctx_scene = data;
+    struct ilmSceneLayer *layer;
+    t_ilm_uint *id;
+
+    if (ctx_scene->layers.size == 0)
+        return;
+
+    layer = (struct ilmSceneLayer *)((char *)ctx_scene->layers.data +
+                                     ctx_scene->layers.size) - 1;
+    if (layer->layerId != layer_id) {
+        fprintf(stderr, "scene: surface %u of layer %u out of order\n",
+                surface_id, layer_id);
+        return;
+    }
+
+    id = wl_array_add(&ctx_scene->ids, sizeof *id);
+    if (id == NULL) {
+        ctx_scene->error = true;
+        return;
+    }
+
+    *id = surface_id;
+    layer->surfaceCount++;
+}
+
+static void
+scene_listener_surface(void *data, struct ivi_scene *ivi_scene,
+                       uint32_t surface_id, wl_fixed_t opacity,
+                       int32_t visibility,
+                       int32_t source_x, int32_t source_y,
+                       int32_t source_width, int32_t source_height,
+                       int32_t dest_x, int32_t dest_y,
+                       int32_t dest_width, int32_t dest_height,
+                       int32_t width, int32_t height,
+                       uint32_t frame_count, uint32_t pid)
+{
+    struct scene_context *ctx_scene = data;
+    struct ilmSceneSurface *surface;
+    struct surface_context *ctx_surf;
+
+    surface = wl_array_add(&ctx_scene->surfaces, sizeof *surface);
+    if (surface == NULL) {
+        ctx_scene->error = true;
+        return;
+    }
+
+    memset(surface, 0, sizeof *surface);
+    surface->surfaceId = surface_id;
+    surface->prop.opacity = (t_ilm_float)wl_fixed_to_double(opacity);
+    surface->prop.visibility = (t_ilm_bool)visibility;
+    surface->prop.sourceX = (t_ilm_uint)source_x;
+    surface->prop.sourceY = (t_ilm_uint)source_y;
+    surface->prop.sourceWidth = (t_ilm_uint)source_width;
+    surface->prop.sourceHeight = (t_ilm_uint)source_height;
+    surface->prop.origSourceWidth = (t_ilm_uint)width;
+    surface->prop.origSourceHeight = (t_ilm_uint)height;
+    surface->prop.destX = (t_ilm_uint)dest_x;
+    surface->prop.destY = (t_ilm_uint)dest_y;
+    surface->prop.destWidth = (t_ilm_uint)dest_width;
+    surface->prop.destHeight = (t_ilm_uint)dest_height;
+    surface->prop.frameCounter = (t_ilm_uint)frame_count;
+    surface->prop.creatorPid = (t_ilm_int)pid;
+
+    /* input focus is only known on the client side */
+    ctx_surf = get_surface_context(ctx_scene->ctx, surface_id);
+    if (ctx_surf != NULL)
+        surface->prop.focus = ctx_surf->prop.focus;
+}
+
+static void
+scene_listener_done(void *data, struct ivi_scene *ivi_scene)
+{
+    struct scene_context *ctx_scene = data;
+
+    ctx_scene->done = true;
+    ivi_scene_destroy(ivi_scene);
+}
+
+static struct ivi_scene_listener scene_listener = {
+    scene_listener_screen,
+    scene_listener_screen_layer,
+    scene_listener_layer,
+    scene_listener_layer_surface,
+    scene_listener_surface,
+    scene_listener_done
+};
+
+static struct ilmScene *
+create_scene(struct scene_context *ctx_scene)
+{
+    struct ilmScene *scene;
+    t_ilm_uint *ids;
+    char *ptr;
+    t_ilm_uint i;
+
+    scene = malloc(sizeof *scene +
+                   ctx_scene->screens.size + ctx_scene->layers.size +
+                   ctx_scene->surfaces.size + ctx_scene->ids.size);
+    if (scene == NULL) {
+        fprintf(stderr, "memory insufficient for scene\n");
+        return NULL;
+    }
+
+    ptr = (char *)(scene + 1);
+
+    scene->screenCount = ctx_scene->screens.size / sizeof *scene->screens;
+    scene->screens = (struct ilmSceneScreen *)ptr;
+    if (ctx_scene->screens.size > 0)
+        memcpy(ptr, ctx_scene->screens.data, ctx_scene->screens.size);
+    ptr += ctx_scene->screens.size;
+
+    scene->layerCount = ctx_scene->layers.size / sizeof *scene->layers;
+    scene->layers = (struct ilmSceneLayer *)ptr;
+    if (ctx_scene->layers.size > 0)
+        memcpy(ptr, ctx_scene->layers.data, ctx_scene->layers.size);
+    ptr += ctx_scene->layers.size;
+
+    scene->surfaceCount = ctx_scene->surfaces.size / sizeof *scene->surfaces;
+    scene->surfaces = (struct ilmSceneSurface *)ptr;
+    if (ctx_scene->surfaces.size > 0)
+        memcpy(ptr, ctx_scene->surfaces.data, ctx_scene->surfaces.size);
+    ptr += ctx_scene->surfaces.size;
+
+    ids = (t_ilm_uint *)ptr;
+    if (ctx_scene->ids.size > 0)
+        memcpy(ids, ctx_scene->ids.data, ctx_scene->ids.size);
+
+    /* render orders were streamed right after their owner */
+    for (i = 0; i < scene->screenCount; i++) {
+        struct ilmScreenProperties *prop = &scene->screens[i].prop;
+        prop->layerIds = prop->layerCount ? ids : NULL;
+        ids += prop->layerCount;
+    }
+
+    for (i = 0; i < scene->layerCount; i++) {
+        struct ilmSceneLayer *layer = &scene->layers[i];
+        layer->surfaceIds = layer->surfaceCount ? ids : NULL;
+        ids += layer->surfaceCount;
+    }
+
+    return scene;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getScene(struct ilmScene** ppScene)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct scene_context ctx_scene;
+    struct ivi_scene *scene;
+
+    if (ppScene == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    *ppScene = NULL;
+
+    memset(&ctx_scene, 0, sizeof ctx_scene);
+    ctx_scene.ctx = &ctx->wl;
+    wl_array_init(&ctx_scene.screens);
+    wl_array_init(&ctx_scene.layers);
+    wl_array_init(&ctx_scene.surfaces);
+    wl_array_init(&ctx_scene.ids);
+
+    lock_context(ctx);
+
+    if (ctx->wl.controller == NULL) {
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    if (ivi_wm_get_version(ctx->wl.controller) <
+        IVI_WM_GET_SCENE_SINCE_VERSION) {
+        unlock_context(ctx);
+        return ILM_ERROR_NOT_IMPLEMENTED;
+    }
+
+    scene = ivi_wm_get_scene(ctx->wl.controller);
+    if (scene) {
+        ivi_scene_add_listener(scene, &scene_listener, &ctx_scene);
+
+        /* the whole scene is sent before the reply to the roundtrip */
+        if ((wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) &&
+            ctx_scene.done && !ctx_scene.error) {
+            *ppScene = create_scene(&ctx_scene);
+            if (*ppScene != NULL)
+                returnValue = ILM_SUCCESS;
+        }
+
+        if (!ctx_scene.done)
+            ivi_scene_destroy(scene);
+    }
+
+    unlock_context(ctx);
+
+    wl_array_release(&ctx_scene.screens);
+    wl_array_release(&ctx_scene.layers);
+    wl_array_release(&ctx_scene.surfaces);
+    wl_array_release(&ctx_scene.ids);
+
+    return returnValue;
+}
+
+/* a reader gives up if the compositor keeps writing for this many tries */
+#define SCENE_MIRROR_READ_RETRIES 1000
+/* tries which only yield the cpu, before the pause grows from 1 us */
+#define SCENE_MIRROR_YIELD_TRIES 16
+#define SCENE_MIRROR_MAX_PAUSE_NS 1000000
+
+/* Called after a torn read. Trying again right away can fail every time
+ * while the compositor thread is busy writing, maybe on the same cpu, so
+ * the reader yields first and then pauses for longer and longer, up to a
+ * millisecond. All tries together take about a second.
+ */
+static void
+scene_mirror_backoff(int tries)
+{
+    struct timespec pause = { 0, 1000 };
+
+    if (tries < SCENE_MIRROR_YIELD_TRIES) {
+        sched_yield();
+        return;
+    }
+
+    tries -= SCENE_MIRROR_YIELD_TRIES;
+    while (tries-- > 0 && pause.tv_nsec < SCENE_MIRROR_MAX_PAUSE_NS)
+        pause.tv_nsec *= 2;
+    if (pause.tv_nsec > SCENE_MIRROR_MAX_PAUSE_NS)
+        pause.tv_nsec = SCENE_MIRROR_MAX_PAUSE_NS;
+
+    nanosleep(&pause, NULL);
+}
+
+static ilmErrorTypes
+get_scene_mirror(struct ilm_control_context *ctx,
+                 const struct ivi_scene_mirror **pMirror)
+{
+    const struct ivi_scene_mirror *mirror;
+    ilmErrorTypes returnValue = ILM_FAILED;
+
+    mirror = __atomic_load_n(&ctx->wl.scene_mirror, __ATOMIC_ACQUIRE);
+    if (mirror != NULL) {
+        *pMirror = mirror;
+        return ILM_SUCCESS;
+    }
+
+    if (!ctx->initialized) {
+        return ILM_FAILED;
+    }
+
+    lock_context(ctx);
+
+    if (ctx->wl.controller == NULL) {
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    if (ivi_wm_get_version(ctx->wl.controller) <
+        IVI_WM_GET_SCENE_MIRROR_SINCE_VERSION) {
+        unlock_context(ctx);
+        return ILM_ERROR_NOT_IMPLEMENTED;
+    }
+
+    if (ctx->wl.scene_mirror == NULL) {
+        ivi_wm_get_scene_mirror(ctx->wl.controller);
+        wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+    }
+
+    if (ctx->wl.scene_mirror != NULL) {
+        *pMirror = ctx->wl.scene_mirror;
+        returnValue = ILM_SUCCESS;
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
+static void
+scene_mirror_layer_prop(const struct ivi_scene_mirror_layer *layer,
+                        struct ilmLayerProperties *prop)
+{
+    prop->opacity = (t_ilm_float)wl_fixed_to_double(layer->opacity);
+    prop->visibility = (t_ilm_bool)layer->visibility;
+    prop->sourceX = (t_ilm_uint)layer->source_x;
+    prop->sourceY = (t_ilm_uint)layer->source_y;
+    prop->sourceWidth = (t_ilm_uint)layer->source_width;
+    prop->sourceHeight = (t_ilm_uint)layer->source_height;
+    prop->destX = (t_ilm_uint)layer->dest_x;
+    prop->destY = (t_ilm_uint)layer->dest_y;
+    prop->destWidth = (t_ilm_uint)layer->dest_width;
+    prop->destHeight = (t_ilm_uint)layer->dest_height;
+}
+
+static void
+scene_mirror_surface_prop(const struct ivi_scene_mirror_surface *surface,
+                          struct ilmSurfaceProperties *prop)
+{
+    memset(prop, 0, sizeof *prop);
+    prop->opacity = (t_ilm_float)wl_fixed_to_double(surface->opacity);
+    prop->visibility = (t_ilm_bool)surface->visibility;
+    prop->sourceX = (t_ilm_uint)surface->source_x;
+    prop->sourceY = (t_ilm_uint)surface->source_y;
+    prop->sourceWidth = (t_ilm_uint)surface->source_width;
+    prop->sourceHeight = (t_ilm_uint)surface->source_height;
+    prop->origSourceWidth = (t_ilm_uint)surface->width;
+    prop->origSourceHeight = (t_ilm_uint)surface->height;
+    prop->destX = (t_ilm_uint)surface->dest_x;
+    prop->destY = (t_ilm_uint)surface->dest_y;
+    prop->destWidth = (t_ilm_uint)surface->dest_width;
+    prop->destHeight = (t_ilm_uint)surface->dest_height;
+    prop->frameCounter = (t_ilm_uint)surface->frame_count;
+    prop->creatorPid = (t_ilm_int)surface->pid;
+}
+
+/* Point count ids at index into ids, clamped to the ids which were copied.
+ * A torn read can leave anything in the counts, the caller retries then.
+ */
+static t_ilm_uint *
+scene_mirror_ids(t_ilm_uint *ids, t_ilm_uint id_count,
+                 uint32_t index, t_ilm_uint *count)
+{
+    if ((index > id_count) || (*count > id_count - index)) {
+        *count = 0;
+    }
+
+    return *count ? ids + index : NULL;
+}
+
+/* Copy the mirror into a snapshot laid out like create_scene does. Returns
+ * NULL with *pRetry set if the compositor wrote to the mirror meanwhile.
+ */
+static struct ilmScene *
+read_scene_mirror(const struct ivi_scene_mirror *mirror, bool *pRetry)
+{
+    struct ilmScene *scene;
+    t_ilm_uint screen_count, layer_count, surface_count, id_count;
+    t_ilm_uint *ids;
+    uint32_t sequence;
+    char *ptr;
+    t_ilm_uint i;
+
+    *pRetry = true;
+
+    sequence = ivi_scene_mirror_read_begin(mirror);
+    if (sequence & 1)
+        return NULL;
+
+    screen_count = mirror->screen_count;
+    layer_count = mirror->layer_count;
+    surface_count = mirror->surface_count;
+    id_count = mirror->id_count;
+    if (ivi_scene_mirror_read_retry(mirror, sequence))
+        return NULL;
+
+    if ((screen_count > IVI_SCENE_MIRROR_MAX_SCREENS) ||
+        (layer_count > IVI_SCENE_MIRROR_MAX_LAYERS) ||
+        (surface_count > IVI_SCENE_MIRROR_MAX_SURFACES) ||
+        (id_count > IVI_SCENE_MIRROR_MAX_IDS)) {
+        *pRetry = false;
+        return NULL;
+    }
+
+    scene = malloc(sizeof *scene +
+                   screen_count * sizeof *scene->screens +
+                   layer_count * sizeof *scene->layers +
+                   surface_count * sizeof *scene->surfaces +
+                   id_count * sizeof *ids);
+    if (scene == NULL) {
+        fprintf(stderr, "memory insufficient for scene\n");
+        *pRetry = false;
+        return NULL;
+    }
+
+    ptr = (char *)(scene + 1);
+    scene->screenCount = screen_count;
+    scene->screens = (struct ilmSceneScreen *)ptr;
+    ptr += screen_count * sizeof *scene->screens;
+    scene->layerCount = layer_count;
+    scene->layers = (struct ilmSceneLayer *)ptr;
+    ptr += layer_count * sizeof *scene->layers;
+    scene->surfaceCount = surface_count;
+    scene->surfaces = (struct ilmSceneSurface *)ptr;
+    ptr += surface_count * sizeof *scene->surfaces;
+    ids = (t_ilm_uint *)ptr;
+
+    memcpy(ids, mirror->ids, id_count * sizeof *ids);
+
+    for (i = 0; i < screen_count; i++) {
+        const struct ivi_scene_mirror_screen *src = &mirror->screens[i];
+        struct ilmSceneScreen *screen = &scene->screens[i];
+
+        memset(screen, 0, sizeof *screen);
+        screen->screenId = src->id;
+        screen->prop.screenWidth = (t_ilm_uint)src->width;
+        screen->prop.screenHeight = (t_ilm_uint)src->height;
+        memcpy(screen->prop.connectorName, src->name, sizeof src->name);
+        screen->prop.connectorName[sizeof src->name - 1] = '\0';
+        screen->prop.layerCount = src->layer_count;
+        screen->prop.layerIds = scene_mirror_ids(ids, id_count, src->layer_index,
+                                                 &screen->prop.layerCount);
+    }
+
+    for (i = 0; i < layer_count; i++) {
+        const struct ivi_scene_mirror_layer *src = &mirror->layers[i];
+        struct ilmSceneLayer *layer = &scene->layers[i];
+
+        layer->layerId = src->id;
+        scene_mirror_layer_prop(src, &layer->prop);
+        layer->surfaceCount = src->surface_count;
+        layer->surfaceIds = scene_mirror_ids(ids, id_count, src->surface_index,
+                                             &layer->surfaceCount);
+    }
+
+    for (i = 0; i < surface_count; i++) {
+        const struct ivi_scene_mirror_surface *src = &mirror->surfaces[i];
+        struct ilmSceneSurface *surface = &scene->surfaces[i];
+
+        surface->surfaceId = src->id;
+        scene_mirror_surface_prop(src, &surface->prop);
+    }
+
+    if (ivi_scene_mirror_read_retry(mirror, sequence)) {
+        free(scene);
+        return NULL;
+    }
+
+    *pRetry = false;
+    return scene;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getSceneFromMirror(struct ilmScene** ppScene)
+{
+    struct ilm_control_context *const ctx = &ilm_context;
+    const struct ivi_scene_mirror *mirror = NULL;
+    ilmErrorTypes returnValue;
+    bool retry = true;
+    int tries;
+
+    if (ppScene == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    *ppScene = NULL;
+
+    returnValue = get_scene_mirror(ctx, &mirror);
+    if (returnValue != ILM_SUCCESS) {
+        return returnValue;
+    }
+
+    for (tries = 0; tries < SCENE_MIRROR_READ_RETRIES; tries++) {
+        *ppScene = read_scene_mirror(mirror, &retry);
+        if (!retry)
+            break;
+        scene_mirror_backoff(tries);
+    }
+
+    return (*ppScene != NULL) ? ILM_SUCCESS : ILM_FAILED;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfLayerFromMirror(t_ilm_uint layerID,
+                                   struct ilmLayerProperties* pLayerProperties)
+{
+    struct ilm_control_context *const ctx = &ilm_context;
+    const struct ivi_scene_mirror *mirror = NULL;
+    ilmErrorTypes returnValue;
+    uint32_t sequence, count, i;
+    int tries;
+
+    if (pLayerProperties == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    returnValue = get_scene_mirror(ctx, &mirror);
+    if (returnValue != ILM_SUCCESS) {
+        return returnValue;
+    }
+
+    for (tries = 0; tries < SCENE_MIRROR_READ_RETRIES; tries++) {
+        returnValue = ILM_FAILED;
+        sequence = ivi_scene_mirror_read_begin(mirror);
+
+        count = mirror->layer_count;
+        if (count > IVI_SCENE_MIRROR_MAX_LAYERS)
+            count = IVI_SCENE_MIRROR_MAX_LAYERS;
+
+        for (i = 0; i < count; i++) {
+            if (mirror->layers[i].id == layerID) {
+                scene_mirror_layer_prop(&mirror->layers[i], pLayerProperties);
+                returnValue = ILM_SUCCESS;
+                break;
+            }
+        }
+
+        if (!ivi_scene_mirror_read_retry(mirror, sequence))
+            return returnValue;
+        scene_mirror_backoff(tries);
+    }
+
+    return ILM_FAILED;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfSurfaceFromMirror(t_ilm_uint surfaceID,
+                                     struct ilmSurfaceProperties* pSurfaceProperties)
+{
+    struct ilm_control_context *const ctx = &ilm_context;
+    const struct ivi_scene_mirror *mirror = NULL;
+    ilmErrorTypes returnValue;
+    uint32_t sequence, count, i;
+    int tries;
+
+    if (pSurfaceProperties == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    returnValue = get_scene_mirror(ctx, &mirror);
+    if (returnValue != ILM_SUCCESS) {
+        return returnValue;
+    }
+
+    for (tries = 0; tries < SCENE_MIRROR_READ_RETRIES; tries++) {
+        returnValue = ILM_FAILED;
+        sequence = ivi_scene_mirror_read_begin(mirror);
+
+        count = mirror->surface_count;
+        if (count > IVI_SCENE_MIRROR_MAX_SURFACES)
+            count = IVI_SCENE_MIRROR_MAX_SURFACES;
+
+        for (i = 0; i < count; i++) {
+            if (mirror->surfaces[i].id == surfaceID) {
+                scene_mirror_surface_prop(&mirror->surfaces[i],
+                                          pSurfaceProperties);
+                returnValue = ILM_SUCCESS;
+                break;
+            }
+        }
+
+        if (!ivi_scene_mirror_read_retry(mirror, sequence))
+            return returnValue;
+        scene_mirror_backoff(tries);
+    }
+
+    return ILM_FAILED;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getScreenIDs(t_ilm_uint* pNumberOfIDs, t_ilm_uint** ppIDs)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+
+    if ((pNumberOfIDs != NULL) && (ppIDs != NULL)) {
+        struct screen_context *ctx_scrn = NULL;
+        t_ilm_uint length = wl_list_length(&ctx->wl.list_screen);
+        *pNumberOfIDs = 0;
+
+        *ppIDs = (t_ilm_uint*)malloc(length * sizeof **ppIDs);
+        if (*ppIDs != NULL) {
+            t_ilm_uint* ids = *ppIDs;
+            // compositor sends screens in opposite order
+            // write ids from back to front to turn them around
+            wl_list_for_each_reverse(ctx_scrn, &ctx->wl.list_screen, link) {
+                *ids = ctx_scrn->id_screen;
+                ids++;
+            }
+            *pNumberOfIDs = length;
+
+            returnValue = ILM_SUCCESS;
+        }
+    }
+
+    release_instance();
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getScreenResolution(t_ilm_uint screenID, t_ilm_uint* pWidth, t_ilm_uint* pHeight)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+
+    if ((pWidth != NULL) && (pHeight != NULL))
+    {
+        struct screen_context *ctx_scrn;
+        ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screenID);
+        if (ctx_scrn != NULL) {
+            *pWidth = ctx_scrn->prop.screenWidth;
+            *pHeight = ctx_scrn->prop.screenHeight;
+            returnValue = ILM_SUCCESS;
+        }
+    }
+
+    release_instance();
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getLayerIDs(t_ilm_int* pLength, t_ilm_layer** ppArray)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+
+    if ((pLength != NULL) && (ppArray != NULL)) {
+        struct layer_context *ctx_layer = NULL;
+        t_ilm_uint length = wl_list_length(&ctx->wl.list_layer);
+        *pLength = 0;
+
+        *ppArray = (t_ilm_layer*)malloc(length * sizeof **ppArray);
+        if (*ppArray != NULL) {
+            // compositor sends layers in opposite order
+            // write ids from back to front to turn them around
+            t_ilm_layer* ids = *ppArray;
+            wl_list_for_each_reverse(ctx_layer, &ctx->wl.list_layer, link)
+            {
+                *ids = ctx_layer->id_layer;
+                ++ids;
+            }
+            *pLength = length;
+
+            returnValue = ILM_SUCCESS;
+        }
+    }
+
+    release_instance();
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getLayerIDsOnScreen(t_ilm_uint screenId,
+                            t_ilm_int* pLength,
+                            t_ilm_layer** ppArray)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    if ((pLength != NULL) && (ppArray != NULL)) {
+        lock_context(ctx);
+        struct screen_context *ctx_screen = NULL;
+        ctx_screen = get_screen_context_by_id(&ctx->wl, screenId);
+        if (ctx_screen != NULL) {
+            *pLength = 0;
+            *ppArray = NULL;
+
+            ivi_wm_screen_get(ctx_screen->controller, IVI_WM_PARAM_RENDER_ORDER);
+
+            if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1 ) {
+                create_layerids(ctx_screen, ppArray, (t_ilm_uint*)pLength);
+                returnValue = ILM_SUCCESS;
+            }
+        }
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getSurfaceIDs(t_ilm_int* pLength, t_ilm_surface** ppArray)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+
+    if ((pLength != NULL) && (ppArray != NULL)) {
+        struct surface_context *ctx_surf = NULL;
+        t_ilm_uint length = wl_list_length(&ctx->wl.list_surface);
+        *pLength = 0;
+
+        *ppArray = (t_ilm_surface*)malloc(length * sizeof **ppArray);
+        if (*ppArray != NULL) {
+            t_ilm_surface* ids = *ppArray;
+            wl_list_for_each_reverse(ctx_surf, &ctx->wl.list_surface, link) {
+                *ids = ctx_surf->id_surface;
+                ids++;
+            }
+            *pLength = length;
+
+            returnValue = ILM_SUCCESS;
+        }
+    }
+
+    release_instance();
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getSurfaceIDsOnLayer(t_ilm_layer layer,
+                             t_ilm_int* pLength,
+                             t_ilm_surface** ppArray)
+{
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct layer_context *ctx_layer = NULL;
+    t_ilm_uint length = 0;
+    t_ilm_surface* ids = NULL;
+    uint32_t *id = NULL;
+
+    if ((pLength == NULL) || (ppArray == NULL)) {
+        release_instance();
+        return ILM_FAILED;
+    }
+
+    lock_context(ctx);
+
+    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
+                    &ctx->wl, (uint32_t)layer);
+
+    if (ctx_layer == NULL) {
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    ivi_wm_layer_get(ctx->wl.controller, layer, IVI_WM_PARAM_RENDER_ORDER);
+    int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+    if (ret < 0) {
+        wl_array_release(&ctx_layer->render_order);
+        wl_array_init(&ctx_layer->render_order);
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    *ppArray = (t_ilm_surface*)malloc(ctx_layer->render_order.size);
+    if (*ppArray == NULL) {
+        wl_array_release(&ctx_layer->render_order);
+        wl_array_init(&ctx_layer->render_order);
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    ids = *ppArray;
+    wl_array_for_each(id, &ctx_layer->render_order) {
+        *ids = (t_ilm_surface) *id;
+        ids++;
+        length++;
+    }
+
+    wl_array_release(&ctx_layer->render_order);
+    wl_array_init(&ctx_layer->render_order);
+    *pLength = length;
+
+    unlock_context(ctx);
+    return ILM_SUCCESS;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerCreateWithDimension(t_ilm_layer* pLayerId,
+                                 t_ilm_uint width,
+                                 t_ilm_uint height)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    uint32_t layerid = 0;
+    int32_t is_inside = 0;
+    bool generated = false;
+
+    do {
+        if (pLayerId == NULL) {
+            break;
+        }
+
+        if (*pLayerId != INVALID_ID) {
+            /* Return failed, if layerid is already inside list_layer */
+            is_inside = wayland_controller_is_inside_layer_list(
+                            &ctx->wl, *pLayerId);
+            if (0 != is_inside) {
+                fprintf(stderr, "layerid=%d is already used.\n", *pLayerId);
+                break;
+            }
+            layerid = *pLayerId;
+        }
+        else {
+            /* Generate ID, if layerid is INVALID_ID */
+            layerid = id_allocator_get(&ctx->wl.layer_ids,
+                                       &ctx->wl.index_layer);
+            *pLayerId = layerid;
+            generated = true;
+        }
+
+        ivi_wm_create_layout_layer(ctx->wl.controller, layerid, width, height);
+        wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+        if (generated) {
+            struct layer_context *ctx_layer =
+                wayland_controller_get_layer_context(&ctx->wl, layerid);
+            if (ctx_layer != NULL)
+                ctx_layer->id_generated = true;
+        }
+
+        returnValue = ILM_SUCCESS;
+    } while(0);
+
+    release_instance();
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerRemove(t_ilm_layer layerId)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        transaction_drop_pending(&ctx->wl, true, layerId);
+        ivi_wm_destroy_layout_layer(ctx->wl.controller, layerId);
+        wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerSetVisibility(t_ilm_layer layerId, t_ilm_bool newVisibility)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    uint32_t visibility = 0;
+
+    if (newVisibility == ILM_TRUE) {
+        visibility = 1;
+    }
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, true, layerId);
+
+        if (pending) {
+            pending->visibility = visibility;
+            pending->mask |= PENDING_VISIBILITY;
+        } else {
+            ivi_wm_set_layer_visibility(ctx->wl.controller, layerId, visibility);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerGetVisibility(t_ilm_layer layerId, t_ilm_bool *pVisibility)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct layer_context *ctx_layer = NULL;
+
+    if (pVisibility != NULL) {
+        lock_context(ctx);
+
+        ivi_wm_layer_get(ctx->wl.controller, layerId, IVI_WM_PARAM_VISIBILITY);
+        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+        ctx_layer = (struct layer_context*)
+                    wayland_controller_get_layer_context(
+                        &ctx->wl, (uint32_t)layerId);
+
+        if ((ret != -1) && (ctx_layer != NULL))
+        {
+            *pVisibility = ctx_layer->prop.visibility;
+            returnValue = ILM_SUCCESS;
+        }
+
+        unlock_context(ctx);
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerSetOpacity(t_ilm_layer layerId, t_ilm_float opacity)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    wl_fixed_t opacity_fixed = wl_fixed_from_double((double)opacity);
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, true, layerId);
+
+        if (pending) {
+            pending->opacity = opacity_fixed;
+            pending->mask |= PENDING_OPACITY;
+        } else {
+            ivi_wm_set_layer_opacity(ctx->wl.controller, layerId, opacity_fixed);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerGetOpacity(t_ilm_layer layerId, t_ilm_float *pOpacity)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct layer_context *ctx_layer = NULL;
+
+    if (pOpacity != NULL) {
+        lock_context(ctx);
+
+        ivi_wm_layer_get(ctx->wl.controller, layerId, IVI_WM_PARAM_OPACITY);
+        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+        ctx_layer = (struct layer_context*)
+                    wayland_controller_get_layer_context(
+                        &ctx->wl, (uint32_t)layerId);
+
+        if ((ret != -1) && (ctx_layer != NULL))
+        {
+            *pOpacity = ctx_layer->prop.opacity;
+            returnValue = ILM_SUCCESS;
+        }
+
+        unlock_context(ctx);
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerSetSourceRectangle(t_ilm_layer layerId,
+                                t_ilm_uint x, t_ilm_uint y,
+                                t_ilm_uint width, t_ilm_uint height)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, true, layerId);
+
+        if (pending) {
+            pending->source.x = (int32_t)x;
+            pending->source.y = (int32_t)y;
+            pending->source.width = (int32_t)width;
+            pending->source.height = (int32_t)height;
+            pending->mask |= PENDING_SOURCE_RECT;
+        } else {
+            ivi_wm_set_layer_source_rectangle(ctx->wl.controller, layerId,
+                                              (uint32_t)x, (uint32_t)y,
+                                              (uint32_t)width, (uint32_t)height);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerSetDestinationRectangle(t_ilm_layer layerId,
+                                 t_ilm_int x, t_ilm_int y,
+                                 t_ilm_int width, t_ilm_int height)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, true, layerId);
+
+        if (pending) {
+            pending->dest.x = x;
+            pending->dest.y = y;
+            pending->dest.width = width;
+            pending->dest.height = height;
+            pending->mask |= PENDING_DEST_RECT;
+        } else {
+            ivi_wm_set_layer_destination_rectangle(ctx->wl.controller,
+                                                   layerId, (uint32_t)x,
+                                                   (uint32_t)y, (uint32_t)width,
+                                                   (uint32_t)height);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_layerSetRenderOrder(t_ilm_layer layerId,
+                        t_ilm_surface *pSurfaceId,
+                        t_ilm_int number)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    t_ilm_int i;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        ivi_wm_layer_clear(ctx->wl.controller, layerId);
+
+        for (i = 0; i < number; i++) {
+            ivi_wm_layer_add_surface(ctx->wl.controller, layerId,
+                                     (uint32_t)pSurfaceId[i]);
+        }
+
+        control_flush(ctx);
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceSetVisibility(t_ilm_surface surfaceId, t_ilm_bool newVisibility)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    uint32_t visibility = 0;
+
+    if (newVisibility == ILM_TRUE) {
+        visibility = 1;
+    }
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, false, surfaceId);
+
+        if (pending) {
+            pending->visibility = visibility;
+            pending->mask |= PENDING_VISIBILITY;
+        } else {
+            ivi_wm_set_surface_visibility(ctx->wl.controller, surfaceId, visibility);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceSetOpacity(t_ilm_surface surfaceId, t_ilm_float opacity)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    wl_fixed_t opacity_fixed = wl_fixed_from_double((double)opacity);
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, false, surfaceId);
+
+        if (pending) {
+            pending->opacity = opacity_fixed;
+            pending->mask |= PENDING_OPACITY;
+        } else {
+            ivi_wm_set_surface_opacity(ctx->wl.controller, surfaceId, opacity_fixed);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceGetOpacity(t_ilm_surface surfaceId, t_ilm_float *pOpacity)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct surface_context *ctx_surf = NULL;
+
+    if (pOpacity != NULL) {
+        lock_context(ctx);
+
+        ivi_wm_surface_get(ctx->wl.controller, surfaceId, IVI_WM_PARAM_OPACITY);
+        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+        ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+
+        if ((ret != -1) && (ctx_surf != NULL))
+        {
+            *pOpacity = ctx_surf->prop.opacity;
+            returnValue = ILM_SUCCESS;
+        }
+
+        unlock_context(ctx);
+    }
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceSetDestinationRectangle(t_ilm_surface surfaceId,
+                                   t_ilm_int x, t_ilm_int y,
+                                   t_ilm_int width, t_ilm_int height)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, false, surfaceId);
+
+        if (pending) {
+            pending->dest.x = x;
+            pending->dest.y = y;
+            pending->dest.width = width;
+            pending->dest.height = height;
+            pending->mask |= PENDING_DEST_RECT;
+        } else {
+            ivi_wm_set_surface_destination_rectangle(ctx->wl.controller, surfaceId,
+                                                     x, y, width, height);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_surfaceSetType(t_ilm_surface surfaceId, ilmSurfaceType type)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    int32_t ivitype = 0;
+
+    switch(type) {
+    case ILM_SURFACETYPE_RESTRICTED:
+        ivitype = IVI_WM_SURFACE_TYPE_RESTRICTED;
+        break;
+    case ILM_SURFACETYPE_DESKTOP:
+        ivitype = IVI_WM_SURFACE_TYPE_DESKTOP;
+        break;
+    default:
+        ivitype = -1;
+        returnValue = ILM_ERROR_INVALID_ARGUMENTS;
+        break;
+    }
+
+    lock_context(ctx);
+    if ((ivitype >= 0) && ctx->wl.controller) {
+        ivi_wm_set_surface_type(ctx->wl.controller, surfaceId, type);
+        control_flush(ctx);
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_displaySetRenderOrder(t_ilm_display display,
+                          t_ilm_layer *pLayerId, const t_ilm_uint number)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct screen_context *ctx_scrn = NULL;
+    t_ilm_uint i;
+
+    lock_context(ctx);
+    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)display);
+    if (ctx_scrn != NULL) {
+        ivi_wm_screen_clear(ctx_scrn->controller);
+
+        for (i = 0; i < number; i++) {
+            ivi_wm_screen_add_layer(ctx_scrn->controller, (uint32_t)pLayerId[i]);
+        }
+
+        control_flush(ctx);
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+static ilmErrorTypes
+map_screenshot(struct ilmScreenshot *image, int32_t fd, int32_t width,
+               int32_t height, int32_t stride, uint32_t format,
+               uint32_t timestamp)
+{
+    size_t size = stride * height;
+    void *buffer;
+
+    buffer = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (buffer == MAP_FAILED) {
+        close(fd);
+        fprintf(stderr, "failed to mmap screenshot file: %m\n");
+        return ILM_FAILED;
+    }
+
+    image->buffer = buffer;
+    image->fd = fd;
+    image->size = (t_ilm_uint)size;
+    image->width = (t_ilm_uint)width;
+    image->height = (t_ilm_uint)height;
+    image->stride = (t_ilm_uint)stride;
+    image->format = format;
+    image->timestamp = timestamp;
+    return ILM_SUCCESS;
+}
+
+/* Since version 6 the compositor reuses the buffer once the screenshot
+ * object is destroyed, which ilm_releaseScreenshot does after unmapping.
+ */
+static void
+hold_screenshot(struct wayland_context *ctx,
+                struct ivi_screenshot *ivi_screenshot,
+                ilmErrorTypes result, int32_t fd)
+{
+    struct held_screenshot *held;
+
+    if (result == ILM_SUCCESS &&
+        ivi_screenshot_get_version(ivi_screenshot) >=
+        IVI_SCREENSHOT_DESTROY_SINCE_VERSION) {
+        held = calloc(1, sizeof *held);
+        if (held != NULL) {
+            held->screenshot = ivi_screenshot;
+            held->fd = fd;
+            wl_list_insert(&ctx->list_screenshot_held, &held->link);
+            return;
+        }
+    }
+
+    screenshot_proxy_destroy(ivi_screenshot);
+}
+
+static void screenshot_done(void *data, struct ivi_screenshot *ivi_screenshot,
+                            int32_t fd, int32_t width, int32_t height,
+                            int32_t stride, uint32_t format, uint32_t timestamp)
+{
+    struct screenshot_context *ctx_scrshot = data;
+
+    ctx_scrshot->done = true;
+    ctx_scrshot->result = map_screenshot(ctx_scrshot->image, fd, width, height,
+                                         stride, format, timestamp);
+    hold_screenshot(ctx_scrshot->ctx, ivi_screenshot, ctx_scrshot->result, fd);
+}
+
+static void screenshot_error(void *data, struct ivi_screenshot *ivi_screenshot,
+                             uint32_t error, const char *message)
+{
+    struct screenshot_context *ctx_scrshot = data;
+    ctx_scrshot->done = true;
+    screenshot_proxy_destroy(ivi_screenshot);
+    fprintf(stderr, "screenshot failed, error 0x%x: %s\n", error, message);
+}
+
+static struct ivi_screenshot_listener screenshot_listener = {
+    screenshot_done,
+    screenshot_error,
+};
+
+static void screenshot_async_done(void *data,
+                                  struct ivi_screenshot *ivi_screenshot,
+                                  int32_t fd, int32_t width, int32_t height,
+                                  int32_t stride, uint32_t format,
+                                  uint32_t timestamp)
+{
+    struct screenshot_async_context *ctx_scrshot = data;
+    struct ilmScreenshot image;
+    ilmErrorTypes result;
+
+    wl_list_remove(&ctx_scrshot->link);
+
+    result = map_screenshot(&image, fd, width, height, stride, format,
+                            timestamp);
+    hold_screenshot(ctx_scrshot->ctx, ivi_screenshot, result, fd);
+    ctx_scrshot->notification(result, result == ILM_SUCCESS ? &image : NULL,
+                              ctx_scrshot->user_data);
+    free(ctx_scrshot);
+}
+
+static void screenshot_async_error(void *data,
+                                   struct ivi_screenshot *ivi_screenshot,
+                                   uint32_t error, const char *message)
+{
+    struct screenshot_async_context *ctx_scrshot = data;
+
+    wl_list_remove(&ctx_scrshot->link);
+    screenshot_proxy_destroy(ivi_screenshot);
+    fprintf(stderr, "screenshot failed, error 0x%x: %s\n", error, message);
+
+    ctx_scrshot->notification(ILM_FAILED, NULL, ctx_scrshot->user_data);
+    free(ctx_scrshot);
+}
+
+static struct ivi_screenshot_listener screenshot_async_listener = {
+    screenshot_async_done,
+    screenshot_async_error,
+};
+
+static ilmErrorTypes
+wait_for_screenshot(struct ilm_control_context *ctx,
+                    struct ivi_screenshot *scrshot,
+                    struct ilmScreenshot *image)
+{
+    struct screenshot_context ctx_scrshot = {
+        .ctx = &ctx->wl,
+        .image = image,
+        .done = false,
+        .result = ILM_FAILED,
+    };
+    int ret;
+
+    ivi_screenshot_add_listener(scrshot, &screenshot_listener, &ctx_scrshot);
+
+    // dispatch until the done or error callback was called
+    do {
+        ret = wl_display_dispatch_queue(ctx->wl.display, ctx->wl.queue);
+    } while ((ret != -1) && !ctx_scrshot.done);
+
+    return ctx_scrshot.result;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_takeScreenshotToMemory(t_ilm_uint screen, struct ilmScreenshot *pScreenshot)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
+    struct screen_context *ctx_scrn = NULL;
 
-    if (! pScreenProperties)
-    {
+    if (pScreenshot == NULL)
         return ILM_ERROR_INVALID_ARGUMENTS;
-    }
 
     lock_context(ctx);
-    struct screen_context *ctx_screen = NULL;
-    ctx_screen = get_screen_context_by_id(&ctx->wl, (uint32_t)screenID);
-    if (ctx_screen != NULL) {
-        ivi_wm_screen_get(ctx_screen->controller, IVI_WM_PARAM_RENDER_ORDER);
-
-        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1 ) {
-            *pScreenProperties = ctx_screen->prop;
-            create_layerids(ctx_screen, &pScreenProperties->layerIds,
-                                        &pScreenProperties->layerCount);
-            returnValue = ILM_SUCCESS;
+    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
+    if (ctx_scrn != NULL) {
+        struct ivi_screenshot *scrshot =
+            ivi_wm_screen_screenshot(ctx_scrn->controller);
+        if (scrshot) {
+            returnValue = wait_for_screenshot(ctx, scrshot, pScreenshot);
         }
     }
-
     unlock_context(ctx);
+
     return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_getScreenIDs(t_ilm_uint* pNumberOfIDs, t_ilm_uint** ppIDs)
+ilm_takeSurfaceScreenshotToMemory(t_ilm_surface surfaceid,
+                                  struct ilmScreenshot *pScreenshot)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
-
-    if ((pNumberOfIDs != NULL) && (ppIDs != NULL)) {
-        struct screen_context *ctx_scrn = NULL;
-        t_ilm_uint length = wl_list_length(&ctx->wl.list_screen);
-        *pNumberOfIDs = 0;
+    struct ilm_control_context *const ctx = &ilm_context;
 
-        *ppIDs = (t_ilm_uint*)malloc(length * sizeof **ppIDs);
-        if (*ppIDs != NULL) {
-            t_ilm_uint* ids = *ppIDs;
-            // compositor sends screens in opposite order
-            // write ids from back to front to turn them around
-            wl_list_for_each_reverse(ctx_scrn, &ctx->wl.list_screen, link) {
-                *ids = ctx_scrn->id_screen;
-                ids++;
-            }
-            *pNumberOfIDs = length;
+    if (pScreenshot == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-            returnValue = ILM_SUCCESS;
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        struct ivi_screenshot *scrshot =
+            ivi_wm_surface_screenshot(ctx->wl.controller, surfaceid);
+        if (scrshot) {
+            returnValue = wait_for_screenshot(ctx, scrshot, pScreenshot);
         }
     }
+    unlock_context(ctx);
 
-    release_instance();
     return returnValue;
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_getScreenResolution(t_ilm_uint screenID, t_ilm_uint* pWidth, t_ilm_uint* pHeight)
+static bool
+valid_screenshot_region(t_ilm_int width, t_ilm_int height,
+                        t_ilm_int targetWidth, t_ilm_int targetHeight)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
-
-    if ((pWidth != NULL) && (pHeight != NULL))
-    {
-        struct screen_context *ctx_scrn;
-        wl_list_for_each(ctx_scrn, &ctx->wl.list_screen, link) {
-            if (screenID == ctx_scrn->id_screen) {
-                *pWidth = ctx_scrn->prop.screenWidth;
-                *pHeight = ctx_scrn->prop.screenHeight;
-                returnValue = ILM_SUCCESS;
-                break;
-            }
-        }
-    }
-
-    release_instance();
-    return returnValue;
+    return width > 0 && height > 0 &&
+           targetWidth >= 0 && targetWidth <= width &&
+           targetHeight >= 0 && targetHeight <= height;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_getLayerIDs(t_ilm_int* pLength, t_ilm_layer** ppArray)
+ilm_takeScreenshotRegionToMemory(t_ilm_uint screen, t_ilm_int x, t_ilm_int y,
+                                 t_ilm_int width, t_ilm_int height,
+                                 t_ilm_int targetWidth, t_ilm_int targetHeight,
+                                 struct ilmScreenshot *pScreenshot)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
-
-    if ((pLength != NULL) && (ppArray != NULL)) {
-        struct layer_context *ctx_layer = NULL;
-        t_ilm_uint length = wl_list_length(&ctx->wl.list_layer);
-        *pLength = 0;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct screen_context *ctx_scrn = NULL;
 
-        *ppArray = (t_ilm_layer*)malloc(length * sizeof **ppArray);
-        if (*ppArray != NULL) {
-            // compositor sends layers in opposite order
-            // write ids from back to front to turn them around
-            t_ilm_layer* ids = *ppArray;
-            wl_list_for_each_reverse(ctx_layer, &ctx->wl.list_layer, link)
-            {
-                *ids = ctx_layer->id_layer;
-                ++ids;
-            }
-            *pLength = length;
+    if (pScreenshot == NULL ||
+        !valid_screenshot_region(width, height, targetWidth, targetHeight))
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-            returnValue = ILM_SUCCESS;
+    lock_context(ctx);
+    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
+    if (ctx_scrn != NULL &&
+        ivi_wm_screen_get_version(ctx_scrn->controller) <
+        IVI_WM_SCREEN_SCREENSHOT_REGION_SINCE_VERSION) {
+        returnValue = ILM_ERROR_NOT_IMPLEMENTED;
+    } else if (ctx_scrn != NULL) {
+        struct ivi_screenshot *scrshot =
+            ivi_wm_screen_screenshot_region(ctx_scrn->controller, x, y,
+                                            width, height,
+                                            targetWidth, targetHeight);
+        if (scrshot) {
+            returnValue = wait_for_screenshot(ctx, scrshot, pScreenshot);
         }
     }
+    unlock_context(ctx);
 
-    release_instance();
     return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_getLayerIDsOnScreen(t_ilm_uint screenId,
-                            t_ilm_int* pLength,
-                            t_ilm_layer** ppArray)
+ilm_takeSurfaceScreenshotRegionToMemory(t_ilm_surface surfaceid,
+                                        t_ilm_int x, t_ilm_int y,
+                                        t_ilm_int width, t_ilm_int height,
+                                        t_ilm_int targetWidth,
+                                        t_ilm_int targetHeight,
+                                        struct ilmScreenshot *pScreenshot)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
 
-    if ((pLength != NULL) && (ppArray != NULL)) {
-        lock_context(ctx);
-        struct screen_context *ctx_screen = NULL;
-        ctx_screen = get_screen_context_by_id(&ctx->wl, screenId);
-        if (ctx_screen != NULL) {
-            *pLength = 0;
-            *ppArray = NULL;
-
-            ivi_wm_screen_get(ctx_screen->controller, IVI_WM_PARAM_RENDER_ORDER);
+    if (pScreenshot == NULL ||
+        !valid_screenshot_region(width, height, targetWidth, targetHeight))
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-            if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1 ) {
-                create_layerids(ctx_screen, ppArray, (t_ilm_uint*)pLength);
-                returnValue = ILM_SUCCESS;
-            }
+    lock_context(ctx);
+    if (ctx->wl.controller != NULL &&
+        ivi_wm_get_version(ctx->wl.controller) <
+        IVI_WM_SURFACE_SCREENSHOT_REGION_SINCE_VERSION) {
+        returnValue = ILM_ERROR_NOT_IMPLEMENTED;
+    } else if (ctx->wl.controller != NULL) {
+        struct ivi_screenshot *scrshot =
+            ivi_wm_surface_screenshot_region(ctx->wl.controller, surfaceid,
+                                             x, y, width, height,
+                                             targetWidth, targetHeight);
+        if (scrshot) {
+            returnValue = wait_for_screenshot(ctx, scrshot, pScreenshot);
         }
     }
-
     unlock_context(ctx);
+
     return returnValue;
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_getSurfaceIDs(t_ilm_int* pLength, t_ilm_surface** ppArray)
+static struct screenshot_async_context *
+create_screenshot_async_context(screenshotNotificationFunc callback,
+                                void *user_data)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
+    struct screenshot_async_context *ctx_scrshot;
 
-    if ((pLength != NULL) && (ppArray != NULL)) {
-        struct surface_context *ctx_surf = NULL;
-        t_ilm_uint length = wl_list_length(&ctx->wl.list_surface);
-        *pLength = 0;
+    ctx_scrshot = calloc(1, sizeof *ctx_scrshot);
+    if (ctx_scrshot == NULL) {
+        fprintf(stderr, "Failed to allocate memory for screenshot_async_context\n");
+        return NULL;
+    }
 
-        *ppArray = (t_ilm_surface*)malloc(length * sizeof **ppArray);
-        if (*ppArray != NULL) {
-            t_ilm_surface* ids = *ppArray;
-            wl_list_for_each_reverse(ctx_surf, &ctx->wl.list_surface, link) {
-                *ids = ctx_surf->id_surface;
-                ids++;
-            }
-            *pLength = length;
+    ctx_scrshot->notification = callback;
+    ctx_scrshot->user_data = user_data;
+    return ctx_scrshot;
+}
 
-            returnValue = ILM_SUCCESS;
-        }
-    }
+static ilmErrorTypes
+send_screenshot_async(struct ilm_control_context *ctx,
+                      struct screenshot_async_context *ctx_scrshot,
+                      struct ivi_screenshot *scrshot)
+{
+    if (scrshot == NULL)
+        return ILM_FAILED;
 
-    release_instance();
-    return returnValue;
+    ctx_scrshot->ctx = &ctx->wl;
+    ctx_scrshot->screenshot = scrshot;
+    ivi_screenshot_add_listener(scrshot, &screenshot_async_listener,
+                                ctx_scrshot);
+    wl_list_insert(ctx->wl.list_screenshot.prev, &ctx_scrshot->link);
+    wl_display_flush(ctx->wl.display);
+    return ILM_SUCCESS;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_getSurfaceIDsOnLayer(t_ilm_layer layer,
-                             t_ilm_int* pLength,
-                             t_ilm_surface** ppArray)
+ilm_takeScreenshotAsync(t_ilm_uint screen, screenshotNotificationFunc callback,
+                        void *user_data)
 {
+    ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
-    struct layer_context *ctx_layer = NULL;
-    t_ilm_uint length = 0;
-    t_ilm_surface* ids = NULL;
-    uint32_t *id = NULL;
+    struct screenshot_async_context *ctx_scrshot;
+    struct screen_context *ctx_scrn = NULL;
 
-    if ((pLength == NULL) || (ppArray == NULL)) {
-        release_instance();
+    if (callback == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    ctx_scrshot = create_screenshot_async_context(callback, user_data);
+    if (ctx_scrshot == NULL) {
         return ILM_FAILED;
     }
 
     lock_context(ctx);
+    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
+    if (ctx_scrn != NULL) {
+        returnValue = send_screenshot_async(ctx, ctx_scrshot,
+            ivi_wm_screen_screenshot(ctx_scrn->controller));
+    }
+    unlock_context(ctx);
 
-    ctx_layer = (struct layer_context*)wayland_controller_get_layer_context(
-                    &ctx->wl, (uint32_t)layer);
-
-    if (ctx_layer == NULL) {
-        unlock_context(ctx);
-        return ILM_FAILED;
+    if (returnValue != ILM_SUCCESS) {
+        free(ctx_scrshot);
     }
 
-    ivi_wm_layer_get(ctx->wl.controller, layer, IVI_WM_PARAM_RENDER_ORDER);
-    int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+    return returnValue;
+}
 
-    if (ret < 0) {
-        wl_array_release(&ctx_layer->render_order);
-        wl_array_init(&ctx_layer->render_order);
-        unlock_context(ctx);
-        return ILM_FAILED;
+ILM_EXPORT ilmErrorTypes
+ilm_takeSurfaceScreenshotAsync(t_ilm_surface surfaceid,
+                               screenshotNotificationFunc callback,
+                               void *user_data)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct screenshot_async_context *ctx_scrshot;
+
+    if (callback == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
     }
 
-    *ppArray = (t_ilm_surface*)malloc(ctx_layer->render_order.size);
-    if (*ppArray == NULL) {
-        wl_array_release(&ctx_layer->render_order);
-        wl_array_init(&ctx_layer->render_order);
-        unlock_context(ctx);
+    ctx_scrshot = create_screenshot_async_context(callback, user_data);
+    if (ctx_scrshot == NULL) {
         return ILM_FAILED;
     }
 
-    ids = *ppArray;
-    wl_array_for_each(id, &ctx_layer->render_order) {
-        *ids = (t_ilm_surface) *id;
-        ids++;
-        length++;
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        returnValue = send_screenshot_async(ctx, ctx_scrshot,
+            ivi_wm_surface_screenshot(ctx->wl.controller, surfaceid));
     }
+    unlock_context(ctx);
 
-    wl_array_release(&ctx_layer->render_order);
-    wl_array_init(&ctx_layer->render_order);
-    *pLength = length;
+    if (returnValue != ILM_SUCCESS) {
+        free(ctx_scrshot);
+    }
 
-    unlock_context(ctx);
-    return ILM_SUCCESS;
+    return returnValue;
+}
+
+static bool
+has_extension(const char *filename, const char *extension)
+{
+    const char *filename_ext = strrchr(filename, '.');
+    return filename_ext != NULL && strcmp(filename_ext, extension) == 0;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerCreateWithDimension(t_ilm_layer* pLayerId,
-                                 t_ilm_uint width,
-                                 t_ilm_uint height)
+ilm_saveScreenshot(const struct ilmScreenshot *pScreenshot,
+                   t_ilm_const_string filename)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *ctx = sync_and_acquire_instance();
-    uint32_t layerid = 0;
-    int32_t is_inside = 0;
+    const char *buffer;
+    char *packed = NULL;
+    size_t row_size;
+    int32_t width, height, row;
+    uint32_t format;
+    int ret;
+
+    if (pScreenshot == NULL || filename == NULL) {
+        fprintf(stderr, "screenshot file name not provided\n");
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
 
-    do {
-        if (pLayerId == NULL) {
-            break;
+    if (pScreenshot->buffer == NULL || pScreenshot->width == 0 ||
+        pScreenshot->height == 0 || pScreenshot->width > INT32_MAX / 4 ||
+        pScreenshot->height > INT32_MAX ||
+        pScreenshot->stride < pScreenshot->width * 4) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    buffer = (const char *)pScreenshot->buffer;
+    width = pScreenshot->width;
+    height = pScreenshot->height;
+    format = pScreenshot->format;
+    row_size = (size_t)width * 4;
+
+    /* the encoders take rows without padding */
+    if (pScreenshot->stride != row_size) {
+        packed = malloc(row_size * height);
+        if (packed == NULL) {
+            fprintf(stderr, "failed to allocate %zu bytes: %m\n",
+                    row_size * height);
+            return ILM_FAILED;
         }
 
-        if (*pLayerId != INVALID_ID) {
-            /* Return failed, if layerid is already inside list_layer */
-            is_inside = wayland_controller_is_inside_layer_list(
-                            &ctx->wl.list_layer, *pLayerId);
-            if (0 != is_inside) {
-                fprintf(stderr, "layerid=%d is already used.\n", *pLayerId);
-                break;
-            }
-            layerid = *pLayerId;
+        for (row = 0; row < height; ++row) {
+            memcpy(packed + row_size * row,
+                   buffer + (size_t)pScreenshot->stride * row, row_size);
         }
-        else {
-            /* Generate ID, if layerid is INVALID_ID */
-            layerid = gen_layer_id(ctx);
-            *pLayerId = layerid;
+        buffer = packed;
+    }
+
+    if (has_extension(filename, ".png")) {
+        ret = save_as_png(filename, buffer, width, height, format);
+    } else if (has_extension(filename, ".qoi")) {
+        ret = save_as_qoi(filename, buffer, width, height, format);
+    } else if (has_extension(filename, ".lz4")) {
+        ret = save_as_raw(filename, buffer, width, height, format, true);
+    } else if (has_extension(filename, ".raw")) {
+        ret = save_as_raw(filename, buffer, width, height, format, false);
+    } else {
+        if (!has_extension(filename, ".bmp")) {
+            fprintf(stderr, "trying to write screenshot as bmp file, although file extension does not match: %m\n");
         }
 
-        ivi_wm_create_layout_layer(ctx->wl.controller, layerid, width, height);
-        wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+        ret = save_as_bitmap(filename, buffer, width, height, format);
+    }
 
-        returnValue = ILM_SUCCESS;
-    } while(0);
+    free(packed);
 
-    release_instance();
-    return returnValue;
+    if (ret != 0) {
+        fprintf(stderr, "failed to write screenshot file %s: %m\n", filename);
+        return ILM_FAILED;
+    }
+
+    return ILM_SUCCESS;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerRemove(t_ilm_layer layerId)
+ilm_loadScreenshot(t_ilm_const_string filename, struct ilmScreenshot *pScreenshot)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
+    void *buffer = NULL;
+    int32_t width = 0, height = 0;
+    uint32_t format = 0;
+    int ret;
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_destroy_layout_layer(ctx->wl.controller, layerId);
-        wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
-        returnValue = ILM_SUCCESS;
+    if (pScreenshot == NULL || filename == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    if (has_extension(filename, ".qoi")) {
+        ret = load_qoi(filename, &buffer, &width, &height, &format);
+    } else if (has_extension(filename, ".lz4") ||
+               has_extension(filename, ".raw")) {
+        ret = load_raw(filename, &buffer, &width, &height, &format);
+    } else {
+        fprintf(stderr, "can not load %s, only qoi, lz4 and raw files are supported\n",
+                filename);
+        return ILM_ERROR_INVALID_ARGUMENTS;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    if (ret != 0) {
+        return ILM_FAILED;
+    }
+
+    pScreenshot->buffer = buffer;
+    pScreenshot->fd = -1;
+    pScreenshot->width = (t_ilm_uint)width;
+    pScreenshot->height = (t_ilm_uint)height;
+    pScreenshot->stride = (t_ilm_uint)width * 4;
+    pScreenshot->size = pScreenshot->stride * pScreenshot->height;
+    pScreenshot->format = format;
+    pScreenshot->timestamp = 0;
+    return ILM_SUCCESS;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerSetVisibility(t_ilm_layer layerId, t_ilm_bool newVisibility)
+ilm_setScreenshotPngOptions(t_ilm_int compressionLevel, ilmPngFilter filter,
+                            t_ilm_uint threadCount)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    uint32_t visibility = 0;
-
-    if (newVisibility == ILM_TRUE) {
-        visibility = 1;
-    }
-
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_layer_visibility(ctx->wl.controller, layerId, visibility);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+    if (compressionLevel < -1 || compressionLevel > 9 ||
+        filter < ILM_PNG_FILTER_NONE || filter > ILM_PNG_FILTER_ADAPTIVE) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    set_png_options(compressionLevel, (int)filter, threadCount);
+    return ILM_SUCCESS;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerGetVisibility(t_ilm_layer layerId, t_ilm_bool *pVisibility)
+ilm_releaseScreenshot(struct ilmScreenshot *pScreenshot)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
-    struct layer_context *ctx_layer = NULL;
 
-    if (pVisibility != NULL) {
-        lock_context(ctx);
+    if (pScreenshot == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-        ivi_wm_layer_get(ctx->wl.controller, layerId, IVI_WM_PARAM_VISIBILITY);
-        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+    if (pScreenshot->buffer != NULL)
+        munmap((void *)pScreenshot->buffer, pScreenshot->size);
 
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+    if (pScreenshot->fd >= 0 && ctx->initialized) {
+        struct held_screenshot *held;
 
-        if ((ret != -1) && (ctx_layer != NULL))
-        {
-            *pVisibility = ctx_layer->prop.visibility;
-            returnValue = ILM_SUCCESS;
+        lock_context(ctx);
+        wl_list_for_each(held, &ctx->wl.list_screenshot_held, link) {
+            if (held->fd == pScreenshot->fd) {
+                wl_list_remove(&held->link);
+                screenshot_proxy_destroy(held->screenshot);
+                wl_display_flush(ctx->wl.display);
+                free(held);
+                break;
+            }
         }
-
         unlock_context(ctx);
     }
 
-    return returnValue;
+    if (pScreenshot->fd >= 0)
+        close(pScreenshot->fd);
+
+    pScreenshot->buffer = NULL;
+    pScreenshot->fd = -1;
+    return ILM_SUCCESS;
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_layerSetOpacity(t_ilm_layer layerId, t_ilm_float opacity)
+static bool
+is_32bit_format(uint32_t format)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    wl_fixed_t opacity_fixed = wl_fixed_from_double((double)opacity);
+    return format == WL_SHM_FORMAT_ARGB8888 ||
+           format == WL_SHM_FORMAT_XRGB8888 ||
+           format == WL_SHM_FORMAT_ABGR8888 ||
+           format == WL_SHM_FORMAT_XBGR8888;
+}
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_layer_opacity(ctx->wl.controller, layerId, opacity_fixed);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+/* Stores the hashes as new base, and drops the oldest one beyond
+ * DELTA_BASE_COUNT. Called with the context lock held.
+ */
+static uint32_t
+add_delta_base(struct wayland_context *ctx, struct delta_base *base)
+{
+    struct delta_base *b, *n;
+    int count = 0;
+
+    base->id = ctx->next_delta_id++;
+    if (ctx->next_delta_id == 0)
+        ctx->next_delta_id = 1;
+
+    wl_list_insert(&ctx->list_delta_base, &base->link);
+    wl_list_for_each_safe(b, n, &ctx->list_delta_base, link) {
+        if (++count > DELTA_BASE_COUNT) {
+            wl_list_remove(&b->link);
+            free(b->hashes);
+            free(b);
+        }
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    return base->id;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerGetOpacity(t_ilm_layer layerId, t_ilm_float *pOpacity)
+ilm_computeScreenshotDelta(const struct ilmScreenshot *pScreenshot,
+                           t_ilm_uint baseId, t_ilm_uint tileSize,
+                           struct ilmScreenshotDelta *pDelta)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
+    ilmErrorTypes returnValue = ILM_SUCCESS;
     struct ilm_control_context *const ctx = &ilm_context;
-    struct layer_context *ctx_layer = NULL;
+    struct delta_base *base, *previous;
+    struct tile_grid grid;
+    uint32_t count, i;
+    size_t size;
+
+    if (pScreenshot == NULL || pDelta == NULL || tileSize == 0 ||
+        tileSize > INT32_MAX || pScreenshot->buffer == NULL ||
+        pScreenshot->width == 0 || pScreenshot->height == 0 ||
+        pScreenshot->stride < pScreenshot->width * 4 ||
+        !is_32bit_format(pScreenshot->format)) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
 
-    if (pOpacity != NULL) {
-        lock_context(ctx);
+    if (!ctx->initialized) {
+        fprintf(stderr, "Not initialized\n");
+        return ILM_FAILED;
+    }
 
-        ivi_wm_layer_get(ctx->wl.controller, layerId, IVI_WM_PARAM_OPACITY);
-        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+    memset(pDelta, 0, sizeof *pDelta);
+    tile_grid_init(&grid, pScreenshot->width, pScreenshot->height, tileSize);
+    count = tile_grid_count(&grid);
 
-        ctx_layer = (struct layer_context*)
-                    wayland_controller_get_layer_context(
-                        &ctx->wl, (uint32_t)layerId);
+    base = calloc(1, sizeof *base);
+    if (base == NULL) {
+        fprintf(stderr, "Failed to allocate memory for delta_base\n");
+        return ILM_FAILED;
+    }
 
-        if ((ret != -1) && (ctx_layer != NULL))
-        {
-            *pOpacity = ctx_layer->prop.opacity;
+    base->grid = grid;
+    base->format = pScreenshot->format;
+    base->hashes = malloc(count * sizeof *base->hashes);
+    pDelta->changeMap = malloc(count);
+    if (base->hashes == NULL || pDelta->changeMap == NULL) {
+        fprintf(stderr, "Failed to allocate memory for screenshot delta\n");
+        returnValue = ILM_FAILED;
+        goto err;
+    }
+
+    // hashing the whole image is done without the lock
+    tile_hashes_compute(&grid, pScreenshot->buffer, pScreenshot->stride,
+                        base->hashes);
+
+    lock_context(ctx);
+    if (baseId == 0) {
+        memset(pDelta->changeMap, 1, count);
+    } else {
+        returnValue = ILM_ERROR_RESOURCE_NOT_FOUND;
+        wl_list_for_each(previous, &ctx->wl.list_delta_base, link) {
+            if (previous->id != baseId)
+                continue;
+
+            if (memcmp(&previous->grid, &grid, sizeof grid) != 0 ||
+                previous->format != base->format) {
+                returnValue = ILM_ERROR_INVALID_ARGUMENTS;
+                break;
+            }
+
+            for (i = 0; i < count; ++i)
+                pDelta->changeMap[i] = previous->hashes[i] != base->hashes[i];
             returnValue = ILM_SUCCESS;
+            break;
         }
+    }
 
-        unlock_context(ctx);
+    if (returnValue == ILM_SUCCESS) {
+        pDelta->id = add_delta_base(&ctx->wl, base);
+        base = NULL;
     }
+    unlock_context(ctx);
 
-    return returnValue;
-}
+    if (returnValue != ILM_SUCCESS)
+        goto err;
+
+    size = tile_delta_pack(&grid, pScreenshot->buffer, pScreenshot->stride,
+                           pDelta->changeMap, NULL);
+    if (size != 0) {
+        pDelta->tiles = malloc(size);
+        if (pDelta->tiles == NULL) {
+            fprintf(stderr, "Failed to allocate memory for screenshot delta\n");
+            returnValue = ILM_FAILED;
+            goto err;
+        }
+        tile_delta_pack(&grid, pScreenshot->buffer, pScreenshot->stride,
+                        pDelta->changeMap, pDelta->tiles);
+    }
 
-ILM_EXPORT ilmErrorTypes
-ilm_layerSetSourceRectangle(t_ilm_layer layerId,
-                                t_ilm_uint x, t_ilm_uint y,
-                                t_ilm_uint width, t_ilm_uint height)
-{
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
+    pDelta->baseId = baseId;
+    pDelta->width = pScreenshot->width;
+    pDelta->height = pScreenshot->height;
+    pDelta->format = pScreenshot->format;
+    pDelta->timestamp = pScreenshot->timestamp;
+    pDelta->tileSize = tileSize;
+    pDelta->tilesX = (t_ilm_uint)grid.tiles_x;
+    pDelta->tilesY = (t_ilm_uint)grid.tiles_y;
+    pDelta->tilesSize = (t_ilm_uint)size;
+    for (i = 0; i < count; ++i)
+        pDelta->changedTiles += pDelta->changeMap[i];
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_layer_source_rectangle(ctx->wl.controller, layerId,
-                                          (uint32_t)x, (uint32_t)y,
-                                          (uint32_t)width, (uint32_t)height);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
-    }
-    unlock_context(ctx);
+    return ILM_SUCCESS;
 
+err:
+    if (base != NULL) {
+        free(base->hashes);
+        free(base);
+    }
+    free(pDelta->changeMap);
+    pDelta->changeMap = NULL;
     return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerSetDestinationRectangle(t_ilm_layer layerId,
-                                 t_ilm_int x, t_ilm_int y,
-                                 t_ilm_int width, t_ilm_int height)
+ilm_takeScreenshotDelta(t_ilm_uint screen, t_ilm_uint baseId,
+                        t_ilm_uint tileSize, struct ilmScreenshotDelta *pDelta)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
+    ilmErrorTypes returnValue;
+    struct ilmScreenshot image;
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_layer_destination_rectangle(ctx->wl.controller,
-                                               layerId, (uint32_t)x,
-                                               (uint32_t)y, (uint32_t)width,
-                                               (uint32_t)height);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
-    }
-    unlock_context(ctx);
+    if (pDelta == NULL || tileSize == 0)
+        return ILM_ERROR_INVALID_ARGUMENTS;
+
+    returnValue = ilm_takeScreenshotToMemory(screen, &image);
+    if (returnValue != ILM_SUCCESS)
+        return returnValue;
+
+    returnValue = ilm_computeScreenshotDelta(&image, baseId, tileSize, pDelta);
+    ilm_releaseScreenshot(&image);
 
     return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_layerSetRenderOrder(t_ilm_layer layerId,
-                        t_ilm_surface *pSurfaceId,
-                        t_ilm_int number)
+ilm_reconstructScreenshot(const struct ilmScreenshot *pBase,
+                          const struct ilmScreenshotDelta *pDelta,
+                          struct ilmScreenshot *pScreenshot)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    t_ilm_int i;
+    struct tile_grid grid;
+    uint32_t stride, y;
+    size_t size;
+    void *buffer;
+
+    if (pDelta == NULL || pScreenshot == NULL || pDelta->changeMap == NULL ||
+        pDelta->tileSize == 0 || pDelta->tileSize > INT32_MAX ||
+        pDelta->width == 0 || pDelta->width > INT32_MAX / 4 ||
+        pDelta->height == 0 || pDelta->height > INT32_MAX ||
+        !is_32bit_format(pDelta->format))
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_layer_clear(ctx->wl.controller, layerId);
+    tile_grid_init(&grid, pDelta->width, pDelta->height, pDelta->tileSize);
+    if ((t_ilm_uint)grid.tiles_x != pDelta->tilesX ||
+        (t_ilm_uint)grid.tiles_y != pDelta->tilesY ||
+        tile_delta_pack(&grid, NULL, 0, pDelta->changeMap, NULL) !=
+        pDelta->tilesSize)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-        for (i = 0; i < number; i++) {
-            ivi_wm_layer_add_surface(ctx->wl.controller, layerId,
-                                     (uint32_t)pSurfaceId[i]);
-        }
+    if (pBase == NULL ? pDelta->baseId != 0 :
+        pBase->buffer == NULL || pBase->width != pDelta->width ||
+        pBase->height != pDelta->height || pBase->format != pDelta->format ||
+        pBase->stride < pDelta->width * 4)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+    stride = pDelta->width * 4;
+    size = (size_t)stride * pDelta->height;
+    buffer = image_alloc(size);
+    if (buffer == NULL) {
+        fprintf(stderr, "failed to allocate screenshot: %m\n");
+        return ILM_FAILED;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    if (pBase != NULL) {
+        for (y = 0; y < pDelta->height; ++y) {
+            memcpy((char *)buffer + (size_t)y * stride,
+                   (const char *)pBase->buffer + (size_t)y * pBase->stride,
+                   stride);
+        }
+    }
+
+    tile_delta_apply(&grid, pDelta->changeMap, pDelta->tiles, buffer, stride);
+
+    pScreenshot->buffer = buffer;
+    pScreenshot->fd = -1;
+    pScreenshot->size = (t_ilm_uint)size;
+    pScreenshot->width = pDelta->width;
+    pScreenshot->height = pDelta->height;
+    pScreenshot->stride = stride;
+    pScreenshot->format = pDelta->format;
+    pScreenshot->timestamp = pDelta->timestamp;
+    return ILM_SUCCESS;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_surfaceSetVisibility(t_ilm_surface surfaceId, t_ilm_bool newVisibility)
+ilm_releaseScreenshotDelta(struct ilmScreenshotDelta *pDelta)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    uint32_t visibility = 0;
+    if (pDelta == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
 
-    if (newVisibility == ILM_TRUE) {
-        visibility = 1;
-    }
+    free(pDelta->changeMap);
+    free(pDelta->tiles);
+    pDelta->changeMap = NULL;
+    pDelta->tiles = NULL;
+    pDelta->tilesSize = 0;
+    pDelta->changedTiles = 0;
+    return ILM_SUCCESS;
+}
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_surface_visibility(ctx->wl.controller, surfaceId, visibility);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+static void capture_buffer(void *data, struct ivi_capture *ivi_capture,
+                           uint32_t index, int32_t fd, int32_t width,
+                           int32_t height, int32_t stride, uint32_t format)
+{
+    struct capture_context *ctx_capture = data;
+    (void)ivi_capture;
+
+    if (index >= ctx_capture->buffer_count ||
+        ctx_capture->buffers[index].buffer != NULL) {
+        close(fd);
+        return;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    /* on failure the frames of this buffer are handed back as dropped */
+    map_screenshot(&ctx_capture->buffers[index], fd, width, height,
+                   stride, format, 0);
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_surfaceSetOpacity(t_ilm_surface surfaceId, t_ilm_float opacity)
+static void capture_frame(void *data, struct ivi_capture *ivi_capture,
+                          uint32_t index, uint32_t tv_sec_hi,
+                          uint32_t tv_sec_lo, uint32_t tv_nsec,
+                          uint32_t dropped)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    wl_fixed_t opacity_fixed = wl_fixed_from_double((double)opacity);
+    struct capture_context *ctx_capture = data;
+    struct ilmCaptureFrame frame;
+    uint64_t tv_sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo;
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_surface_opacity(ctx->wl.controller, surfaceId, opacity_fixed);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+    ctx_capture->dropped += dropped;
+
+    /* a buffer which could not be mapped is returned right away */
+    if (index >= ctx_capture->buffer_count ||
+        ctx_capture->buffers[index].buffer == NULL) {
+        ctx_capture->dropped++;
+        ivi_capture_release(ivi_capture, index);
+        return;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    frame.image = ctx_capture->buffers[index];
+    frame.image.timestamp = (t_ilm_uint)(tv_sec * 1000 + tv_nsec / 1000000);
+    frame.index = index;
+    frame.tvSec = (t_ilm_ulong)tv_sec;
+    frame.tvNsec = tv_nsec;
+    frame.dropped = dropped;
+
+    /* the callback may stop the capture, ctx_capture is not used after it */
+    ctx_capture->notification(ILM_SUCCESS, ctx_capture->id, &frame,
+                              ctx_capture->user_data);
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_surfaceGetOpacity(t_ilm_surface surfaceId, t_ilm_float *pOpacity)
+static void capture_error(void *data, struct ivi_capture *ivi_capture,
+                          uint32_t error, const char *message)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    struct surface_context *ctx_surf = NULL;
+    struct capture_context *ctx_capture = data;
+    (void)ivi_capture;
 
-    if (pOpacity != NULL) {
-        lock_context(ctx);
+    fprintf(stderr, "capture failed, error 0x%x: %s\n", error, message);
+    ctx_capture->failed = true;
 
-        ivi_wm_surface_get(ctx->wl.controller, surfaceId, IVI_WM_PARAM_OPACITY);
-        int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+    if (ctx_capture->started)
+        ctx_capture->notification(ILM_FAILED, ctx_capture->id, NULL,
+                                  ctx_capture->user_data);
+}
 
-        ctx_surf = get_surface_context(&ctx->wl, (uint32_t)surfaceId);
+static struct ivi_capture_listener capture_listener = {
+    capture_buffer,
+    capture_frame,
+    capture_error,
+};
 
-        if ((ret != -1) && (ctx_surf != NULL))
-        {
-            *pOpacity = ctx_surf->prop.opacity;
-            returnValue = ILM_SUCCESS;
-        }
+static struct capture_context *
+get_capture_context_by_id(struct wayland_context *ctx, uint32_t id)
+{
+    struct capture_context *ctx_capture;
 
-        unlock_context(ctx);
+    wl_list_for_each(ctx_capture, &ctx->list_capture, link) {
+        if (ctx_capture->id == id)
+            return ctx_capture;
     }
 
-    return returnValue;
+    return NULL;
 }
 
-ILM_EXPORT ilmErrorTypes
-ilm_surfaceSetDestinationRectangle(t_ilm_surface surfaceId,
-                                   t_ilm_int x, t_ilm_int y,
-                                   t_ilm_int width, t_ilm_int height)
+static struct capture_context *
+create_capture_context(t_ilm_uint bufferCount,
+                       captureNotificationFunc callback, void *user_data)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
+    struct capture_context *ctx_capture;
+    uint32_t i;
 
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-        ivi_wm_set_surface_destination_rectangle(ctx->wl.controller, surfaceId,
-                                                 x, y, width, height);
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
+    ctx_capture = calloc(1, sizeof *ctx_capture);
+    if (ctx_capture == NULL) {
+        fprintf(stderr, "Failed to allocate memory for capture_context\n");
+        return NULL;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    ctx_capture->buffers = calloc(bufferCount, sizeof *ctx_capture->buffers);
+    if (ctx_capture->buffers == NULL) {
+        fprintf(stderr, "Failed to allocate memory for capture buffers\n");
+        free(ctx_capture);
+        return NULL;
+    }
+
+    for (i = 0; i < bufferCount; i++)
+        ctx_capture->buffers[i].fd = -1;
+
+    ctx_capture->buffer_count = bufferCount;
+    ctx_capture->notification = callback;
+    ctx_capture->user_data = user_data;
+    return ctx_capture;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_surfaceSetType(t_ilm_surface surfaceId, ilmSurfaceType type)
+ilm_captureStart(t_ilm_uint screen, t_ilm_uint bufferCount,
+                 captureNotificationFunc callback, void *user_data,
+                 t_ilm_uint *pCaptureId)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
-    int32_t ivitype = 0;
+    struct capture_context *ctx_capture;
+    struct screen_context *ctx_scrn;
 
-    switch(type) {
-    case ILM_SURFACETYPE_RESTRICTED:
-        ivitype = IVI_WM_SURFACE_TYPE_RESTRICTED;
-        break;
-    case ILM_SURFACETYPE_DESKTOP:
-        ivitype = IVI_WM_SURFACE_TYPE_DESKTOP;
-        break;
-    default:
-        ivitype = -1;
-        returnValue = ILM_ERROR_INVALID_ARGUMENTS;
-        break;
+    if (callback == NULL || pCaptureId == NULL ||
+        bufferCount == 0 || bufferCount > 16) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    ctx_capture = create_capture_context(bufferCount, callback, user_data);
+    if (ctx_capture == NULL) {
+        return ILM_FAILED;
     }
 
     lock_context(ctx);
-    if ((ivitype >= 0) && ctx->wl.controller) {
-        ivi_wm_set_surface_type(ctx->wl.controller, surfaceId, type);
-        wl_display_flush(ctx->wl.display);
+
+    if (ctx->wl.controller != NULL &&
+        ivi_wm_get_version(ctx->wl.controller) <
+        IVI_WM_CREATE_CAPTURE_SINCE_VERSION) {
+        returnValue = ILM_ERROR_NOT_IMPLEMENTED;
+    } else if (ctx->wl.controller != NULL) {
+        ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
+        if (ctx_scrn != NULL) {
+            ctx_capture->capture = ivi_wm_create_capture(ctx->wl.controller,
+                                                         ctx_scrn->output,
+                                                         bufferCount);
+        }
+    }
+
+    if (ctx_capture->capture == NULL) {
+        unlock_context(ctx);
+        free(ctx_capture->buffers);
+        free(ctx_capture);
+        return returnValue;
+    }
+
+    ctx_capture->id = ctx->wl.next_capture_id++;
+    ivi_capture_add_listener(ctx_capture->capture, &capture_listener,
+                             ctx_capture);
+    wl_list_insert(ctx->wl.list_capture.prev, &ctx_capture->link);
+
+    /* the buffers or an error are sent in reply to the request */
+    if ((wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) &&
+        !ctx_capture->failed) {
+        ctx_capture->started = true;
+        *pCaptureId = ctx_capture->id;
         returnValue = ILM_SUCCESS;
+    } else {
+        destroy_capture_context(ctx_capture);
     }
+
     unlock_context(ctx);
 
     return returnValue;
 }
 
 ILM_EXPORT ilmErrorTypes
-ilm_displaySetRenderOrder(t_ilm_display display,
-                          t_ilm_layer *pLayerId, const t_ilm_uint number)
+ilm_captureReleaseFrame(t_ilm_uint captureId, t_ilm_uint index)
 {
     ilmErrorTypes returnValue = ILM_FAILED;
     struct ilm_control_context *const ctx = &ilm_context;
-    struct screen_context *ctx_scrn = NULL;
-    t_ilm_uint i;
+    struct capture_context *ctx_capture;
 
     lock_context(ctx);
-    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)display);
-    if (ctx_scrn != NULL) {
-        ivi_wm_screen_clear(ctx_scrn->controller);
-
-        for (i = 0; i < number; i++) {
-            ivi_wm_screen_add_layer(ctx_scrn->controller, (uint32_t)pLayerId[i]);
+    ctx_capture = get_capture_context_by_id(&ctx->wl, captureId);
+    if (ctx_capture != NULL) {
+        if (index < ctx_capture->buffer_count) {
+            ivi_capture_release(ctx_capture->capture, index);
+            wl_display_flush(ctx->wl.display);
+            returnValue = ILM_SUCCESS;
+        } else {
+            returnValue = ILM_ERROR_INVALID_ARGUMENTS;
         }
-
-        wl_display_flush(ctx->wl.display);
-        returnValue = ILM_SUCCESS;
     }
     unlock_context(ctx);
 
     return returnValue;
 }
 
-static void screenshot_done(void *data, struct ivi_screenshot *ivi_screenshot,
-                            int32_t fd, int32_t width, int32_t height,
-                            int32_t stride, uint32_t format, uint32_t timestamp)
+ILM_EXPORT ilmErrorTypes
+ilm_captureStop(t_ilm_uint captureId, t_ilm_uint *pDropped)
 {
-    struct screenshot_context *ctx_scrshot = data;
-    char *buffer;
-    size_t size = stride * height;
-    const char *filename = ctx_scrshot->filename;
-    char *filename_ext = NULL;
-
-    ctx_scrshot->filename = NULL;
-    ivi_screenshot_destroy(ivi_screenshot);
-
-    if (filename == NULL) {
-        ctx_scrshot->result = ILM_FAILED;
-        fprintf(stderr, "screenshot file name not provided: %m\n");
-        return;
-    }
-
-    buffer = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
-    close(fd);
-
-    if (buffer == MAP_FAILED) {
-        ctx_scrshot->result = ILM_FAILED;
-        fprintf(stderr, "failed to mmap screenshot file: %m\n");
-        return;
-    }
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct capture_context *ctx_capture;
 
-    if ((filename_ext = strstr(filename, ".png")) && (strlen(filename_ext) == 4)) {
-        if (save_as_png(filename, (const char *)buffer,
-                        width, height, format) == 0) {
-            ctx_scrshot->result = ILM_SUCCESS;
-        } else {
-            ctx_scrshot->result = ILM_FAILED;
-            fprintf(stderr, "failed to write screenshot as png file: %m\n");
-        }
-    } else {
-        if (!((filename_ext = strstr(filename, ".bmp")) && (strlen(filename_ext) == 4))) {
-            fprintf(stderr, "trying to write screenshot as bmp file, although file extension does not match: %m\n");
-        }
+    lock_context(ctx);
+    ctx_capture = get_capture_context_by_id(&ctx->wl, captureId);
+    if (ctx_capture != NULL) {
+        if (pDropped != NULL)
+            *pDropped = ctx_capture->dropped;
 
-        if (save_as_bitmap(filename, (const char *)buffer,
-                           width, height, format) == 0) {
-            ctx_scrshot->result = ILM_SUCCESS;
-        } else {
-            ctx_scrshot->result = ILM_FAILED;
-            fprintf(stderr, "failed to write screenshot as bmp file: %m\n");
-        }
+        destroy_capture_context(ctx_capture);
+        wl_display_flush(ctx->wl.display);
+        returnValue = ILM_SUCCESS;
     }
+    unlock_context(ctx);
 
-    munmap(buffer, size);
+    return returnValue;
 }
 
-static void screenshot_error(void *data, struct ivi_screenshot *ivi_screenshot,
-                             uint32_t error, const char *message)
+/* The file is encoded after the lock is given up, other ilm calls do not
+ * wait for it.
+ */
+static ilmErrorTypes
+save_screenshot_file(ilmErrorTypes result, struct ilmScreenshot *image,
+                     t_ilm_const_string filename)
 {
-    struct screenshot_context *ctx_scrshot = data;
-    ctx_scrshot->filename = NULL;
-    ivi_screenshot_destroy(ivi_screenshot);
-    fprintf(stderr, "screenshot failed, error 0x%x: %s\n", error, message);
-}
+    if (result != ILM_SUCCESS)
+        return result;
 
-static struct ivi_screenshot_listener screenshot_listener = {
-    screenshot_done,
-    screenshot_error,
-};
+    result = ilm_saveScreenshot(image, filename);
+    ilm_releaseScreenshot(image);
+
+    return result;
+}
 
 ILM_EXPORT ilmErrorTypes
 ilm_takeScreenshot(t_ilm_uint screen, t_ilm_const_string filename)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-    struct screen_context *ctx_scrn = NULL;
-
-    lock_context(ctx);
-    ctx_scrn = get_screen_context_by_id(&ctx->wl, (uint32_t)screen);
-    if (ctx_scrn != NULL) {
-        struct screenshot_context ctx_scrshot = {
-            .filename = filename,
-            .result = ILM_FAILED,
-        };
-
-        struct ivi_screenshot *scrshot =
-            ivi_wm_screen_screenshot(ctx_scrn->controller);
-        if (scrshot) {
-            ivi_screenshot_add_listener(scrshot, &screenshot_listener,
-                                        &ctx_scrshot);
-            // dispatch until filename has been reset in done or error callback
-            int ret;
-            do {
-                ret =
-                    wl_display_dispatch_queue(ctx->wl.display, ctx->wl.queue);
-            } while ((ret != -1) && ctx_scrshot.filename);
+    struct ilmScreenshot image;
 
-            returnValue = ctx_scrshot.result;
-        }
+    if (filename == NULL) {
+        fprintf(stderr, "screenshot file name not provided\n");
+        return ILM_FAILED;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    return save_screenshot_file(ilm_takeScreenshotToMemory(screen, &image),
+                                &image, filename);
 }
 
 ILM_EXPORT ilmErrorTypes
 ilm_takeSurfaceScreenshot(t_ilm_const_string filename,
                               t_ilm_surface surfaceid)
 {
-    ilmErrorTypes returnValue = ILM_FAILED;
-    struct ilm_control_context *const ctx = &ilm_context;
-
-    lock_context(ctx);
-    if (ctx->wl.controller) {
-          struct screenshot_context ctx_scrshot = {
-            .filename = filename,
-            .result = ILM_FAILED,
-        };
-
-        struct ivi_screenshot *scrshot =
-            ivi_wm_surface_screenshot(ctx->wl.controller, surfaceid);
-        if (scrshot) {
-            ivi_screenshot_add_listener(scrshot, &screenshot_listener,
-                                        &ctx_scrshot);
-            // dispatch until filename has been reset in done or error callback
-            int ret;
-            do {
-                ret =
-                    wl_display_dispatch_queue(ctx->wl.display, ctx->wl.queue);
-            } while ((ret != -1) && ctx_scrshot.filename);
+    struct ilmScreenshot image;
 
-            returnValue = ctx_scrshot.result;
-        }
+    if (filename == NULL) {
+        fprintf(stderr, "screenshot file name not provided\n");
+        return ILM_FAILED;
     }
-    unlock_context(ctx);
 
-    return returnValue;
+    return save_screenshot_file(
+        ilm_takeSurfaceScreenshotToMemory(surfaceid, &image), &image, filename);
 }
 
 ILM_EXPORT ilmErrorTypes
@@ -2264,8 +5196,13 @@ ilm_layerAddNotification(t_ilm_layer layer,
     } else {
         ctx_layer->notification = callback;
         ivi_wm_layer_sync(ctx->wl.controller, layer, IVI_WM_SYNC_ADD);
-        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1)
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
             fprintf(stderr, "wl_display_roundtrip queue failed\n");
+        } else {
+            mirror_write_lock(&ctx->wl);
+            ctx_layer->mirrored = true;
+            mirror_write_unlock(&ctx->wl);
+        }
 
         returnValue = ILM_SUCCESS;
     }
@@ -2285,10 +5222,16 @@ ilm_layerRemoveNotification(t_ilm_layer layer)
                     &ctx->wl, (uint32_t)layer);
     if (ctx_layer != NULL) {
         if (ctx_layer->notification != NULL) {
+            mirror_write_lock(&ctx->wl);
+            ctx_layer->mirrored = false;
+            mirror_write_unlock(&ctx->wl);
+
             ivi_wm_layer_sync(ctx->wl.controller, layer, IVI_WM_SYNC_REMOVE);
             wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
 
             ctx_layer->notification = NULL;
+            notification_queue_cancel(&ctx->wl.notify_queue,
+                                      NOTIFICATION_RECORD_LAYER, layer);
             returnValue = ILM_SUCCESS;
         } else {
             returnValue = ILM_ERROR_INVALID_ARGUMENTS;
@@ -2313,7 +5256,10 @@ create_surface_context(struct wayland_context *ctx, uint32_t id_surface)
     ctx_surf->id_surface = id_surface;
     ctx_surf->ctx = ctx;
 
+    mirror_write_lock(ctx);
     wl_list_insert(&ctx->list_surface, &ctx_surf->link);
+    id_index_insert(&ctx->index_surface, &ctx_surf->index, id_surface);
+    mirror_write_unlock(ctx);
     wl_list_init(&ctx_surf->list_accepted_seats);
 
     return ctx_surf;
@@ -2326,16 +5272,18 @@ ilm_registerNotification(notificationFunc callback, void *user_data)
     struct layer_context *ctx_layer = NULL;
     struct surface_context *ctx_surf = NULL;
 
+    /* the previous callback is not called any more */
+    notification_queue_cancel(&ctx->wl.notify_queue,
+                              NOTIFICATION_RECORD_OBJECT, 0);
+
     ctx->wl.notification = callback;
     ctx->wl.notification_user_data = user_data;
-    if (callback != NULL) {
-        wl_list_for_each(ctx_layer, &ctx->wl.list_layer, link) {
-            callback(ILM_LAYER, ctx_layer->id_layer, ILM_TRUE, user_data);
-        }
+    wl_list_for_each(ctx_layer, &ctx->wl.list_layer, link) {
+        object_deliver(&ctx->wl, ILM_LAYER, ctx_layer->id_layer, ILM_TRUE);
+    }
 
-        wl_list_for_each(ctx_surf, &ctx->wl.list_surface, link) {
-            callback(ILM_SURFACE, ctx_surf->id_surface, ILM_TRUE, user_data);
-        }
+    wl_list_for_each(ctx_surf, &ctx->wl.list_surface, link) {
+        object_deliver(&ctx->wl, ILM_SURFACE, ctx_surf->id_surface, ILM_TRUE);
     }
     release_instance();
     return ILM_SUCCESS;
@@ -2347,6 +5295,21 @@ ilm_unregisterNotification(void)
    return ilm_registerNotification(NULL, NULL);
 }
 
+ILM_EXPORT ilmErrorTypes
+ilm_setNotificationCoalescing(t_ilm_bool enable)
+{
+    struct ilm_control_context *ctx = sync_and_acquire_instance();
+
+    /* deliver what was collected so far before switching back */
+    if (enable != ILM_TRUE)
+        notify_flush(&ctx->wl);
+
+    ctx->wl.coalesce_notifications = (enable == ILM_TRUE);
+
+    release_instance();
+    return ILM_SUCCESS;
+}
+
 ILM_EXPORT ilmErrorTypes
 ilm_surfaceAddNotification(t_ilm_surface surface,
                              surfaceNotificationFunc callback)
@@ -2368,11 +5331,15 @@ ilm_surfaceAddNotification(t_ilm_surface surface,
         if (callback != NULL) {
             ctx_surf->notification = callback;
             ivi_wm_surface_sync(ctx->wl.controller, surface, IVI_WM_SYNC_ADD);
-            if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1)
+            if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) == -1) {
                 fprintf(stderr, "wl_display_roundtrip queue failed\n");
+            } else {
+                mirror_write_lock(&ctx->wl);
+                ctx_surf->mirrored = true;
+                mirror_write_unlock(&ctx->wl);
+            }
 
-            callback(ctx_surf->id_surface,
-                     &ctx_surf->prop, ILM_NOTIFICATION_CONTENT_AVAILABLE);
+            surface_deliver(ctx_surf, ILM_NOTIFICATION_CONTENT_AVAILABLE);
         }
     }
 
@@ -2381,6 +5348,9 @@ ilm_surfaceAddNotification(t_ilm_surface surface,
     }
     else {
         ctx_surf->notification = callback;
+        if (callback == NULL)
+            notification_queue_cancel(&ctx->wl.notify_queue,
+                                      NOTIFICATION_RECORD_SURFACE, surface);
         returnValue = ILM_SUCCESS;
     }
 
@@ -2399,10 +5369,16 @@ ilm_surfaceRemoveNotification(t_ilm_surface surface)
                     &ctx->wl, (uint32_t)surface);
     if (ctx_surf != NULL) {
         if (ctx_surf->notification != NULL) {
+            mirror_write_lock(&ctx->wl);
+            ctx_surf->mirrored = false;
+            mirror_write_unlock(&ctx->wl);
+
             ivi_wm_surface_sync(ctx->wl.controller, surface, IVI_WM_SYNC_REMOVE);
             wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
 
             ctx_surf->notification = NULL;
+            notification_queue_cancel(&ctx->wl.notify_queue,
+                                      NOTIFICATION_RECORD_SURFACE, surface);
             returnValue = ILM_SUCCESS;
         } else {
             returnValue = ILM_ERROR_INVALID_ARGUMENTS;
@@ -2446,6 +5422,91 @@ ilm_getPropertiesOfSurface(t_ilm_uint surfaceID,
     return returnValue;
 }
 
+ILM_EXPORT ilmErrorTypes
+ilm_getSurfaceFrameStats(t_ilm_surface surfaceID,
+                         struct ilmSurfaceFrameStats* pStats)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct surface_context *ctx_surface = NULL;
+
+    if (pStats == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
+
+    lock_context(ctx);
+
+    if (ctx->wl.controller == NULL) {
+        unlock_context(ctx);
+        return ILM_FAILED;
+    }
+
+    if (ivi_wm_get_version(ctx->wl.controller) <
+        IVI_WM_SURFACE_FRAME_STATS_SINCE_VERSION) {
+        unlock_context(ctx);
+        return ILM_ERROR_NOT_IMPLEMENTED;
+    }
+
+    /* no parameter is requested, the stats are sent for every surface_get */
+    ivi_wm_surface_get(ctx->wl.controller, surfaceID, 0);
+    int ret = wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue);
+
+    ctx_surface = get_surface_context(&ctx->wl, (uint32_t)surfaceID);
+    if ((ret != -1) && (ctx_surface != NULL)) {
+        *pStats = ctx_surface->frame_stats;
+        returnValue = ILM_SUCCESS;
+    }
+
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getPropertiesOfSurfaces(t_ilm_uint number, const t_ilm_surface* pSurfaceIDs,
+                            struct ilmSurfaceProperties* pSurfaceProperties)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct surface_context *ctx_surface = NULL;
+    int32_t mask = 0;
+    t_ilm_uint i;
+
+    mask |= IVI_WM_PARAM_OPACITY;
+    mask |= IVI_WM_PARAM_VISIBILITY;
+    mask |= IVI_WM_PARAM_SIZE;
+
+    if ((pSurfaceIDs == NULL) || (pSurfaceProperties == NULL)) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    lock_context(ctx);
+
+    if (ctx->wl.controller) {
+        /* queue all requests, the roundtrip waits for every reply */
+        for (i = 0; i < number; i++) {
+            ivi_wm_surface_get(ctx->wl.controller, pSurfaceIDs[i], mask);
+        }
+
+        if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1) {
+            returnValue = ILM_SUCCESS;
+
+            for (i = 0; i < number; i++) {
+                ctx_surface = get_surface_context(&ctx->wl,
+                                                  (uint32_t)pSurfaceIDs[i]);
+                if (ctx_surface != NULL) {
+                    pSurfaceProperties[i] = ctx_surface->prop;
+                } else {
+                    memset(&pSurfaceProperties[i], 0, sizeof *pSurfaceProperties);
+                    returnValue = ILM_FAILED;
+                }
+            }
+        }
+    }
+
+    unlock_context(ctx);
+    return returnValue;
+}
+
 ILM_EXPORT ilmErrorTypes
 ilm_layerAddSurface(t_ilm_layer layerId,
                         t_ilm_surface surfaceId)
@@ -2456,7 +5517,7 @@ ilm_layerAddSurface(t_ilm_layer layerId,
     lock_context(ctx);
     if (ctx->wl.controller) {
         ivi_wm_layer_add_surface(ctx->wl.controller, layerId, surfaceId);
-        wl_display_flush(ctx->wl.display);
+        control_flush(ctx);
         returnValue = ILM_SUCCESS;
     }
     unlock_context(ctx);
@@ -2474,7 +5535,7 @@ ilm_layerRemoveSurface(t_ilm_layer layerId,
     lock_context(ctx);
     if (ctx->wl.controller) {
         ivi_wm_layer_remove_surface(ctx->wl.controller, layerId, surfaceId);
-        wl_display_flush(ctx->wl.display);
+        control_flush(ctx);
         returnValue = ILM_SUCCESS;
     }
     unlock_context(ctx);
@@ -2521,9 +5582,76 @@ ilm_surfaceSetSourceRectangle(t_ilm_surface surfaceId,
 
     lock_context(ctx);
     if (ctx->wl.controller) {
-        ivi_wm_set_surface_source_rectangle(ctx->wl.controller, surfaceId, x, y,
-                                            width, height);
-        wl_display_flush(ctx->wl.display);
+        struct pending_state *pending =
+            transaction_pending(&ctx->wl, false, surfaceId);
+
+        if (pending) {
+            pending->source.x = x;
+            pending->source.y = y;
+            pending->source.width = width;
+            pending->source.height = height;
+            pending->mask |= PENDING_SOURCE_RECT;
+        } else {
+            ivi_wm_set_surface_source_rectangle(ctx->wl.controller, surfaceId, x, y,
+                                                width, height);
+            control_flush(ctx);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_beginTransaction(void)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        ctx->wl.transaction.depth++;
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_endTransaction(void)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    lock_context(ctx);
+    if (ctx->wl.controller && ctx->wl.transaction.depth > 0) {
+        if (--ctx->wl.transaction.depth == 0) {
+            transaction_write_pending(&ctx->wl);
+            ivi_wm_commit_changes(ctx->wl.controller);
+            wl_display_flush(ctx->wl.display);
+        }
+        returnValue = ILM_SUCCESS;
+    }
+    unlock_context(ctx);
+
+    return returnValue;
+}
+
+ILM_EXPORT ilmErrorTypes
+ilm_getTransactionStats(t_ilm_uint *pRecorded, t_ilm_uint *pSent)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+
+    if (pRecorded == NULL || pSent == NULL)
+        return ILM_ERROR_INVALID_ARGUMENTS;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        *pRecorded = ctx->wl.transaction.recorded;
+        *pSent = ctx->wl.transaction.sent;
         returnValue = ILM_SUCCESS;
     }
     unlock_context(ctx);
@@ -2539,6 +5667,7 @@ ilm_commitChanges(void)
 
     lock_context(ctx);
     if (ctx->wl.controller) {
+        transaction_write_pending(&ctx->wl);
         ivi_wm_commit_changes(ctx->wl.controller);
 
         if (wl_display_roundtrip_queue(ctx->wl.display, ctx->wl.queue) != -1)
@@ -2551,6 +5680,84 @@ ilm_commitChanges(void)
     return returnValue;
 }
 
+static void
+commit_listener_done(void *data, struct wl_callback *callback,
+                     uint32_t callback_data)
+{
+    struct commit_context *ctx_commit = data;
+
+    wl_list_remove(&ctx_commit->link);
+    wl_callback_destroy(callback);
+
+    ctx_commit->notification(ILM_SUCCESS,
+                             ctx_commit->has_frame_time ? callback_data : 0,
+                             ctx_commit->user_data);
+    free(ctx_commit);
+}
+
+static const struct wl_callback_listener commit_listener = {
+    commit_listener_done
+};
+
+ILM_EXPORT ilmErrorTypes
+ilm_commitChangesAsync(commitNotificationFunc callback, void *user_data)
+{
+    ilmErrorTypes returnValue = ILM_FAILED;
+    struct ilm_control_context *const ctx = &ilm_context;
+    struct commit_context *ctx_commit;
+
+    if (callback == NULL) {
+        return ILM_ERROR_INVALID_ARGUMENTS;
+    }
+
+    ctx_commit = calloc(1, sizeof *ctx_commit);
+    if (ctx_commit == NULL) {
+        fprintf(stderr, "Failed to allocate memory for commit_context\n");
+        return ILM_FAILED;
+    }
+
+    ctx_commit->notification = callback;
+    ctx_commit->user_data = user_data;
+
+    lock_context(ctx);
+    if (ctx->wl.controller) {
+        transaction_write_pending(&ctx->wl);
+
+        if (ivi_wm_get_version(ctx->wl.controller) >=
+            IVI_WM_COMMIT_CHANGES_FEEDBACK_SINCE_VERSION) {
+            ctx_commit->callback =
+                ivi_wm_commit_changes_feedback(ctx->wl.controller);
+            ctx_commit->has_frame_time = true;
+        } else {
+            /* the sync reply is ordered after the commit being applied */
+            struct wl_display *wrapper =
+                wl_proxy_create_wrapper(ctx->wl.display);
+
+            if (wrapper) {
+                ivi_wm_commit_changes(ctx->wl.controller);
+                wl_proxy_set_queue((struct wl_proxy *)wrapper, ctx->wl.queue);
+                ctx_commit->callback = wl_display_sync(wrapper);
+                wl_proxy_wrapper_destroy(wrapper);
+            }
+        }
+
+        if (ctx_commit->callback) {
+            wl_callback_add_listener(ctx_commit->callback, &commit_listener,
+                                     ctx_commit);
+            wl_list_insert(ctx->wl.list_commit.prev, &ctx_commit->link);
+            wl_display_flush(ctx->wl.display);
+            returnValue = ILM_SUCCESS;
+        }
+    }
+    unlock_context(ctx);
+
+    if (returnValue != ILM_SUCCESS) {
+        free(ctx_commit);
+    }
+
+    return returnValue;
+}
+
 ILM_EXPORT ilmErrorTypes
 ilm_getError(void)
 {
@@ -0,0 +1,341 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "ivi-wm-client-protocol.h"
+#include "qoi.h"
+#include "rawimage.h"
+#include "swizzle.h"
+
+/* "Quite OK Image" format, see https://qoiformat.org/qoi-specification.pdf */
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_MASK_2   0xc0
+
+#define QOI_HEADER_SIZE 14
+
+static const unsigned char qoi_padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct qoi_rgba {
+    unsigned char r, g, b, a;
+};
+
+static inline unsigned int
+qoi_hash(struct qoi_rgba px)
+{
+    return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+static inline bool
+qoi_equal(struct qoi_rgba a, struct qoi_rgba b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static void
+write32be(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t
+read32be(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+struct qoi_encoder {
+    struct qoi_rgba index[64];
+    struct qoi_rgba prev;
+    int run;
+};
+
+/* one row of swizzled R,G,B[,A] pixels, out needs room for 5 bytes per
+ * pixel plus one pending run */
+static size_t
+qoi_encode_row(struct qoi_encoder *enc, const unsigned char *in,
+               int32_t width, int channels, bool last_row,
+               unsigned char *out)
+{
+    unsigned char *op = out;
+    int32_t x;
+
+    for (x = 0; x < width; ++x, in += channels) {
+        struct qoi_rgba px = { in[0], in[1], in[2],
+                               channels == 4 ? in[3] : 255 };
+
+        if (qoi_equal(px, enc->prev)) {
+            enc->run++;
+            if (enc->run == 62 || (last_row && x == width - 1)) {
+                *op++ = QOI_OP_RUN | (enc->run - 1);
+                enc->run = 0;
+            }
+            continue;
+        }
+
+        if (enc->run > 0) {
+            *op++ = QOI_OP_RUN | (enc->run - 1);
+            enc->run = 0;
+        }
+
+        unsigned int h = qoi_hash(px);
+        if (qoi_equal(enc->index[h], px)) {
+            *op++ = QOI_OP_INDEX | h;
+        } else {
+            enc->index[h] = px;
+
+            if (px.a == enc->prev.a) {
+                signed char vr = px.r - enc->prev.r;
+                signed char vg = px.g - enc->prev.g;
+                signed char vb = px.b - enc->prev.b;
+                signed char vg_r = vr - vg;
+                signed char vg_b = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 &&
+                    vb > -3 && vb < 2) {
+                    *op++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 |
+                            (vb + 2);
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 &&
+                           vg_b > -9 && vg_b < 8) {
+                    *op++ = QOI_OP_LUMA | (vg + 32);
+                    *op++ = (vg_r + 8) << 4 | (vg_b + 8);
+                } else {
+                    *op++ = QOI_OP_RGB;
+                    *op++ = px.r;
+                    *op++ = px.g;
+                    *op++ = px.b;
+                }
+            } else {
+                *op++ = QOI_OP_RGBA;
+                *op++ = px.r;
+                *op++ = px.g;
+                *op++ = px.b;
+                *op++ = px.a;
+            }
+        }
+
+        enc->prev = px;
+    }
+
+    return op - out;
+}
+
+int
+save_as_qoi(const char *filename,
+            const char *buffer,
+            int32_t width,
+            int32_t height,
+            uint32_t format)
+{
+    struct qoi_encoder enc;
+    unsigned char header[QOI_HEADER_SIZE];
+    unsigned char *row = NULL;
+    unsigned char *out = NULL;
+    swizzle_func swizzle;
+    int channels;
+    int32_t y;
+    FILE *fp;
+    int ret = -1;
+
+    if ((filename == NULL) || (buffer == NULL) || (width <= 0) || (height <= 0)) {
+        return -1;
+    }
+
+    /* never write a file load_qoi would refuse */
+    if (width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) {
+        fprintf(stderr, "%dx%d is too large for a qoi screenshot\n",
+                width, height);
+        return -1;
+    }
+
+    swizzle = get_swizzle_func(format, SWIZZLE_ORDER_RGB,
+                               swizzle_best_kernel());
+    if (swizzle == NULL) {
+        fprintf(stderr, "unsupported pixelformat 0x%x\n", format);
+        return -1;
+    }
+
+    channels = swizzle_bytes_per_pixel(format);
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "could not open the file %s\n", filename);
+        return -1;
+    }
+
+    row = malloc((size_t)width * channels);
+    out = malloc((size_t)width * 5 + 1);
+    if (row == NULL || out == NULL) {
+        fprintf(stderr, "failed to allocate qoi buffers: %m\n");
+        goto out;
+    }
+
+    memcpy(header, "qoif", 4);
+    write32be(header + 4, width);
+    write32be(header + 8, height);
+    header[12] = channels;
+    header[13] = 0; /* sRGB with linear alpha */
+    if (fwrite(header, sizeof header, 1, fp) != 1)
+        goto out;
+
+    memset(&enc, 0, sizeof enc);
+    enc.prev.a = 255;
+
+    for (y = 0; y < height; ++y) {
+        size_t size;
+
+        swizzle((const uint32_t *)buffer + (size_t)y * width, row, width);
+        size = qoi_encode_row(&enc, row, width, channels, y == height - 1,
+                              out);
+        if (size > 0 && fwrite(out, size, 1, fp) != 1)
+            goto out;
+    }
+
+    if (fwrite(qoi_padding, sizeof qoi_padding, 1, fp) != 1)
+        goto out;
+
+    ret = 0;
+
+out:
+    if (fclose(fp) != 0)
+        ret = -1;
+    if (ret != 0)
+        fprintf(stderr, "failed to write qoi file %s\n", filename);
+    free(row);
+    free(out);
+    return ret;
+}
+
+int
+load_qoi(const char *filename,
+         void **buffer,
+         int32_t *width,
+         int32_t *height,
+         uint32_t *format)
+{
+    struct qoi_rgba index[64];
+    struct qoi_rgba px = { 0, 0, 0, 255 };
+    unsigned char *data;
+    unsigned char *pixels = NULL;
+    size_t data_size = 0;
+    size_t size = 0;
+    size_t p, end, i;
+    uint32_t w, h;
+    int run = 0;
+    int ret = -1;
+
+    data = read_image_file(filename, &data_size);
+    if (data == NULL)
+        return -1;
+
+    if (data_size < QOI_HEADER_SIZE + sizeof qoi_padding ||
+        memcmp(data, "qoif", 4) != 0)
+        goto bad;
+
+    w = read32be(data + 4);
+    h = read32be(data + 8);
+    if (w == 0 || h == 0 ||
+        w > IMAGE_MAX_DIMENSION || h > IMAGE_MAX_DIMENSION ||
+        (data[12] != 3 && data[12] != 4))
+        goto bad;
+
+    size = (size_t)w * h * 4;
+    pixels = image_alloc(size);
+    if (pixels == NULL)
+        goto out;
+
+    memset(index, 0, sizeof index);
+    p = QOI_HEADER_SIZE;
+    end = data_size - sizeof qoi_padding;
+
+    /* written as R,G,B,A bytes, which is ABGR8888 */
+    for (i = 0; i < size; i += 4) {
+        if (run > 0) {
+            run--;
+        } else if (p < end) {
+            unsigned char b1 = data[p++];
+
+            if (b1 == QOI_OP_RGB) {
+                if (end - p < 3)
+                    goto bad;
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+            } else if (b1 == QOI_OP_RGBA) {
+                if (end - p < 4)
+                    goto bad;
+                px.r = data[p++];
+                px.g = data[p++];
+                px.b = data[p++];
+                px.a = data[p++];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = index[b1];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                px.r += ((b1 >> 4) & 0x03) - 2;
+                px.g += ((b1 >> 2) & 0x03) - 2;
+                px.b += (b1 & 0x03) - 2;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                unsigned char b2;
+                int vg;
+
+                if (p >= end)
+                    goto bad;
+                b2 = data[p++];
+                vg = (b1 & 0x3f) - 32;
+                px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.g += vg;
+                px.b += vg - 8 + (b2 & 0x0f);
+            } else { /* QOI_OP_RUN */
+                run = b1 & 0x3f;
+            }
+
+            index[qoi_hash(px)] = px;
+        } else {
+            goto bad;
+        }
+
+        pixels[i] = px.r;
+        pixels[i + 1] = px.g;
+        pixels[i + 2] = px.b;
+        pixels[i + 3] = px.a;
+    }
+
+    *buffer = pixels;
+    *width = w;
+    *height = h;
+    *format = data[12] == 4 ? WL_SHM_FORMAT_ABGR8888 : WL_SHM_FORMAT_XBGR8888;
+    pixels = NULL;
+    ret = 0;
+    goto out;
+
+bad:
+    fprintf(stderr, "%s is not a valid qoi file\n", filename);
+out:
+    if (pixels != NULL)
+        munmap(pixels, size);
+    free(data);
+    return ret;
+}
@@ -0,0 +1,37 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef IVICONTROLLER_QOI_H_
+#define IVICONTROLLER_QOI_H_
+
+#include <stdint.h>
+
+int
+save_as_qoi(const char *filename,
+            const char *buffer,
+            int32_t width,
+            int32_t height,
+            uint32_t format);
+
+/* the pixels are returned as ABGR8888 or XBGR8888, allocated with
+ * image_alloc */
+int
+load_qoi(const char *filename,
+         void **buffer,
+         int32_t *width,
+         int32_t *height,
+         uint32_t *format);
+
+#endif /* IVICONTROLLER_QOI_H_ */
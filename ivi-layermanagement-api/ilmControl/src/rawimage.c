@@ -0,0 +1,405 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include "ivi-wm-client-protocol.h"
+#include "rawimage.h"
+
+struct __attribute__ ((__packed__)) rawimage_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t compression;
+    uint32_t payload_size;
+};
+
+/*
+ * lz4 block format
+ *
+ * A block is a list of sequences: a token with the literal length in the
+ * high and the match length - 4 in the low nibble, extra length bytes if
+ * a nibble is 15, the literals, a 16 bit offset and extra match length
+ * bytes. The last sequence has literals only. Matches end at least 5 bytes
+ * before the end and start at least 12 bytes before it.
+ */
+
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT      12
+#define LZ4_MAX_OFFSET    65535
+#define LZ4_HASH_LOG      16
+
+static inline uint32_t
+read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static inline uint32_t
+lz4_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+static unsigned char *
+lz4_write_length(unsigned char *op, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char)length;
+    return op;
+}
+
+static unsigned char *
+lz4_write_sequence(unsigned char *op, const unsigned char *literals,
+                   size_t literal_length, size_t offset, size_t match_length)
+{
+    unsigned char *token = op++;
+    size_t match_code = match_length - LZ4_MIN_MATCH;
+
+    *token = (literal_length >= 15 ? 15 : literal_length) << 4;
+    if (literal_length >= 15)
+        op = lz4_write_length(op, literal_length - 15);
+
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+
+    /* the last sequence carries literals only */
+    if (match_length == 0)
+        return op;
+
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+
+    *token |= match_code >= 15 ? 15 : match_code;
+    if (match_code >= 15)
+        op = lz4_write_length(op, match_code - 15);
+
+    return op;
+}
+
+size_t
+lz4_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t
+lz4_compress(const unsigned char *src, size_t size, unsigned char *dst)
+{
+    uint32_t *table;
+    unsigned char *op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+    unsigned int misses = 0;
+
+    table = calloc(1u << LZ4_HASH_LOG, sizeof *table);
+    if (table == NULL)
+        return 0;
+
+    while (size > LZ4_MF_LIMIT && ip < size - LZ4_MF_LIMIT) {
+        uint32_t sequence = read32(src + ip);
+        uint32_t h = lz4_hash(sequence);
+        /* positions are stored + 1, 0 is an empty slot */
+        size_t ref = table[h];
+
+        table[h] = (uint32_t)ip + 1;
+
+        if (ref == 0 || ip - (ref - 1) > LZ4_MAX_OFFSET ||
+            read32(src + ref - 1) != sequence) {
+            /* skip faster through data which does not compress */
+            ip += 1 + (misses++ >> 6);
+            continue;
+        }
+
+        ref--;
+        size_t length = LZ4_MIN_MATCH;
+        while (ip + length < size - LZ4_LAST_LITERALS &&
+               src[ref + length] == src[ip + length])
+            length++;
+
+        op = lz4_write_sequence(op, src + anchor, ip - anchor, ip - ref,
+                                length);
+        ip += length;
+        anchor = ip;
+        misses = 0;
+    }
+
+    op = lz4_write_sequence(op, src + anchor, size - anchor, 0, 0);
+
+    free(table);
+    return op - dst;
+}
+
+static int
+lz4_read_length(const unsigned char **ip, const unsigned char *end,
+                size_t *length)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= end)
+            return -1;
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+
+    return 0;
+}
+
+size_t
+lz4_decompress(const unsigned char *src, size_t size,
+               unsigned char *dst, size_t capacity)
+{
+    const unsigned char *ip = src;
+    const unsigned char *end = src + size;
+    size_t op = 0;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t literal_length = token >> 4;
+        size_t match_length = (token & 15) + LZ4_MIN_MATCH;
+        size_t offset;
+
+        if (literal_length == 15 &&
+            lz4_read_length(&ip, end, &literal_length) != 0)
+            return (size_t)-1;
+
+        if (literal_length > (size_t)(end - ip) ||
+            literal_length > capacity - op)
+            return (size_t)-1;
+
+        memcpy(dst + op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return (size_t)-1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if ((token & 15) == 15 &&
+            lz4_read_length(&ip, end, &match_length) != 0)
+            return (size_t)-1;
+
+        if (offset == 0 || offset > op || match_length > capacity - op)
+            return (size_t)-1;
+
+        /* byte by byte, the match may overlap its own output */
+        for (; match_length > 0; --match_length, ++op)
+            dst[op] = dst[op - offset];
+    }
+
+    return op;
+}
+
+void *
+image_alloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+unsigned char *
+read_image_file(const char *filename, size_t *size)
+{
+    unsigned char *data = NULL;
+    FILE *fp;
+    long length;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "could not open the file %s\n", filename);
+        return NULL;
+    }
+
+    if (fseek(fp, 0, SEEK_END) == 0 && (length = ftell(fp)) > 0 &&
+        fseek(fp, 0, SEEK_SET) == 0) {
+        data = malloc(length);
+        if (data != NULL && fread(data, length, 1, fp) != 1) {
+            free(data);
+            data = NULL;
+        }
+        *size = length;
+    }
+
+    if (data == NULL)
+        fprintf(stderr, "failed to read the file %s\n", filename);
+
+    fclose(fp);
+    return data;
+}
+
+int
+save_as_raw(const char *filename,
+            const char *buffer,
+            int32_t width,
+            int32_t height,
+            uint32_t format,
+            bool compress)
+{
+    struct rawimage_header header;
+    size_t size = (size_t)width * height * 4;
+    unsigned char *payload = (unsigned char *)buffer;
+    size_t payload_size = size;
+    FILE *fp;
+    int ret = 0;
+
+    if ((filename == NULL) || (buffer == NULL) || (width <= 0) || (height <= 0)) {
+        return -1;
+    }
+
+    /* never write a file load_raw would refuse */
+    if (width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION) {
+        fprintf(stderr, "%dx%d is too large for a raw screenshot\n",
+                width, height);
+        return -1;
+    }
+
+    if (compress) {
+        payload = malloc(lz4_compress_bound(size));
+        if (payload == NULL) {
+            fprintf(stderr, "failed to allocate lz4 buffer: %m\n");
+            return -1;
+        }
+
+        payload_size = lz4_compress((const unsigned char *)buffer, size,
+                                    payload);
+        if (payload_size == 0) {
+            free(payload);
+            return -1;
+        }
+    }
+
+    /* the payload size has to fit the 32 bit header field */
+    if (payload_size > UINT32_MAX) {
+        fprintf(stderr, "%dx%d is too large for a raw screenshot\n",
+                width, height);
+        if (compress)
+            free(payload);
+        return -1;
+    }
+
+    memcpy(header.magic, "ILMS", 4);
+    header.version = htole32(1);
+    header.width = htole32(width);
+    header.height = htole32(height);
+    header.stride = htole32(width * 4);
+    header.format = htole32(format);
+    header.compression = htole32(compress ? RAWIMAGE_LZ4 : RAWIMAGE_NONE);
+    header.payload_size = htole32(payload_size);
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "could not open the file %s\n", filename);
+        ret = -1;
+    } else {
+        if (fwrite(&header, sizeof header, 1, fp) != 1 ||
+            fwrite(payload, payload_size, 1, fp) != 1)
+            ret = -1;
+        if (fclose(fp) != 0)
+            ret = -1;
+    }
+
+    if (compress)
+        free(payload);
+
+    return ret;
+}
+
+int
+load_raw(const char *filename,
+         void **buffer,
+         int32_t *width,
+         int32_t *height,
+         uint32_t *format)
+{
+    struct rawimage_header header;
+    unsigned char *data;
+    size_t data_size = 0;
+    size_t size;
+    void *pixels = NULL;
+    int ret = -1;
+
+    data = read_image_file(filename, &data_size);
+    if (data == NULL)
+        return -1;
+
+    if (data_size < sizeof header)
+        goto out;
+
+    memcpy(&header, data, sizeof header);
+    header.width = le32toh(header.width);
+    header.height = le32toh(header.height);
+    header.stride = le32toh(header.stride);
+    header.payload_size = le32toh(header.payload_size);
+    header.compression = le32toh(header.compression);
+
+    if (memcmp(header.magic, "ILMS", 4) != 0 || le32toh(header.version) != 1 ||
+        header.width == 0 || header.height == 0 ||
+        header.width > IMAGE_MAX_DIMENSION ||
+        header.height > IMAGE_MAX_DIMENSION ||
+        header.stride != header.width * 4 ||
+        header.payload_size > data_size - sizeof header) {
+        fprintf(stderr, "%s is not a raw screenshot\n", filename);
+        goto out;
+    }
+
+    size = (size_t)header.stride * header.height;
+    pixels = image_alloc(size);
+    if (pixels == NULL)
+        goto out;
+
+    if (header.compression == RAWIMAGE_LZ4) {
+        if (lz4_decompress(data + sizeof header, header.payload_size,
+                           pixels, size) != size) {
+            fprintf(stderr, "%s: corrupt lz4 data\n", filename);
+            goto out;
+        }
+    } else if (header.compression == RAWIMAGE_NONE &&
+               header.payload_size == size) {
+        memcpy(pixels, data + sizeof header, size);
+    } else {
+        fprintf(stderr, "%s: unsupported compression %u\n", filename,
+                header.compression);
+        goto out;
+    }
+
+    *buffer = pixels;
+    *width = header.width;
+    *height = header.height;
+    *format = le32toh(header.format);
+    pixels = NULL;
+    ret = 0;
+
+out:
+    if (pixels != NULL)
+        munmap(pixels, (size_t)header.stride * header.height);
+    free(data);
+    return ret;
+}
@@ -0,0 +1,76 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef IVICONTROLLER_RAWIMAGE_H_
+#define IVICONTROLLER_RAWIMAGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Raw screenshot files keep the wl_shm pixels as they are, behind a
+ * 32 byte little endian header:
+ *   char     magic[4]       "ILMS"
+ *   uint32_t version        1
+ *   uint32_t width, height
+ *   uint32_t stride         width * 4
+ *   uint32_t format         wl_shm format
+ *   uint32_t compression    RAWIMAGE_NONE or RAWIMAGE_LZ4
+ *   uint32_t payload_size   bytes following the header
+ * With RAWIMAGE_LZ4 the payload is a single lz4 block.
+ */
+#define RAWIMAGE_NONE 0
+#define RAWIMAGE_LZ4  1
+
+/* largest width or height written or read by the raw and qoi files */
+#define IMAGE_MAX_DIMENSION 0x8000
+
+int
+save_as_raw(const char *filename,
+            const char *buffer,
+            int32_t width,
+            int32_t height,
+            uint32_t format,
+            bool compress);
+
+/* *buffer is allocated with image_alloc */
+int
+load_raw(const char *filename,
+         void **buffer,
+         int32_t *width,
+         int32_t *height,
+         uint32_t *format);
+
+/* page backed pixel memory, released with munmap like a screenshot */
+void *
+image_alloc(size_t size);
+
+/* the whole file in malloc'ed memory */
+unsigned char *
+read_image_file(const char *filename, size_t *size);
+
+size_t
+lz4_compress_bound(size_t size);
+
+size_t
+lz4_compress(const unsigned char *src, size_t size, unsigned char *dst);
+
+/* returns the decompressed size, or (size_t)-1 on malformed input */
+size_t
+lz4_decompress(const unsigned char *src, size_t size,
+               unsigned char *dst, size_t capacity);
+
+#endif /* IVICONTROLLER_RAWIMAGE_H_ */
@@ -0,0 +1,371 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#include <stdbool.h>
+#include <string.h>
+#include "ivi-wm-client-protocol.h"
+#include "swizzle.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SWIZZLE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define SWIZZLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * wl_shm pixels are little endian, so a row is a byte sequence of
+ * B,G,R,A for ARGB8888 and R,G,B,A for ABGR8888. Every conversion is one
+ * of four byte operations on it:
+ *   copy4      keep all four bytes
+ *   swap4      swap bytes 0 and 2
+ *   pack3      drop byte 3
+ *   swappack3  swap bytes 0 and 2, drop byte 3
+ */
+enum swizzle_op {
+    SWIZZLE_OP_COPY4 = 0,
+    SWIZZLE_OP_SWAP4,
+    SWIZZLE_OP_PACK3,
+    SWIZZLE_OP_SWAPPACK3,
+    SWIZZLE_OP_COUNT
+};
+
+/* scalar */
+
+static void
+copy4_scalar(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    memcpy(out, in, (size_t)width * 4);
+}
+
+static void
+swap4_scalar(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i;
+
+    for (i = 0; i < width; ++i, src += 4, out += 4) {
+        out[0] = src[2];
+        out[1] = src[1];
+        out[2] = src[0];
+        out[3] = src[3];
+    }
+}
+
+static void
+pack3_scalar(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i;
+
+    for (i = 0; i < width; ++i, src += 4, out += 3) {
+        out[0] = src[0];
+        out[1] = src[1];
+        out[2] = src[2];
+    }
+}
+
+static void
+swappack3_scalar(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i;
+
+    for (i = 0; i < width; ++i, src += 4, out += 3) {
+        out[0] = src[2];
+        out[1] = src[1];
+        out[2] = src[0];
+    }
+}
+
+#ifdef SWIZZLE_X86
+
+#define SHUFFLE_SWAP4 \
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+#define SHUFFLE_PACK3 \
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+#define SHUFFLE_SWAPPACK3 \
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+/* ssse3 */
+
+__attribute__((target("ssse3"))) static void
+swap4_ssse3(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const __m128i mask = _mm_setr_epi8(SHUFFLE_SWAP4);
+    int32_t i = 0;
+
+    for (; i + 4 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i * 4), _mm_shuffle_epi8(v, mask));
+    }
+
+    swap4_scalar(in + i, out + i * 4, width - i);
+}
+
+/* every store writes 16 bytes of which 12 are used, the loop stops while
+ * the spare 4 bytes are still inside the row */
+__attribute__((target("ssse3"))) static void
+pack3_shuffle_ssse3(const uint32_t *in, unsigned char *out, int32_t width,
+                    __m128i mask, swizzle_func tail)
+{
+    int32_t i = 0;
+
+    for (; i + 6 <= width; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i * 3), _mm_shuffle_epi8(v, mask));
+    }
+
+    tail(in + i, out + i * 3, width - i);
+}
+
+__attribute__((target("ssse3"))) static void
+pack3_ssse3(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    pack3_shuffle_ssse3(in, out, width, _mm_setr_epi8(SHUFFLE_PACK3),
+                        pack3_scalar);
+}
+
+__attribute__((target("ssse3"))) static void
+swappack3_ssse3(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    pack3_shuffle_ssse3(in, out, width, _mm_setr_epi8(SHUFFLE_SWAPPACK3),
+                        swappack3_scalar);
+}
+
+/* avx2, the shuffle works on each 128 bit lane on its own */
+
+__attribute__((target("avx2"))) static void
+swap4_avx2(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const __m256i mask = _mm256_setr_epi8(SHUFFLE_SWAP4, SHUFFLE_SWAP4);
+    int32_t i = 0;
+
+    for (; i + 8 <= width; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_si256((__m256i *)(out + i * 4),
+                            _mm256_shuffle_epi8(v, mask));
+    }
+
+    swap4_ssse3(in + i, out + i * 4, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+pack3_shuffle_avx2(const uint32_t *in, unsigned char *out, int32_t width,
+                   __m256i mask, swizzle_func tail)
+{
+    int32_t i = 0;
+
+    /* the two lanes are stored 12 bytes apart, the second store
+     * overhangs by 4 bytes like in the ssse3 kernel */
+    for (; i + 10 <= width; i += 8) {
+        __m256i v = _mm256_shuffle_epi8(
+            _mm256_loadu_si256((const __m256i *)(in + i)), mask);
+        _mm_storeu_si128((__m128i *)(out + i * 3),
+                         _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *)(out + i * 3 + 12),
+                         _mm256_extracti128_si256(v, 1));
+    }
+
+    tail(in + i, out + i * 3, width - i);
+}
+
+__attribute__((target("avx2"))) static void
+pack3_avx2(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    pack3_shuffle_avx2(in, out, width,
+                       _mm256_setr_epi8(SHUFFLE_PACK3, SHUFFLE_PACK3),
+                       pack3_ssse3);
+}
+
+__attribute__((target("avx2"))) static void
+swappack3_avx2(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    pack3_shuffle_avx2(in, out, width,
+                       _mm256_setr_epi8(SHUFFLE_SWAPPACK3, SHUFFLE_SWAPPACK3),
+                       swappack3_ssse3);
+}
+
+#endif /* SWIZZLE_X86 */
+
+#ifdef SWIZZLE_NEON
+
+/* neon loads deinterleave the channels, the stores interleave them again */
+
+static void
+swap4_neon(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i = 0;
+
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16_t t = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = t;
+        vst4q_u8(out + i * 4, v);
+    }
+
+    swap4_scalar(in + i, out + i * 4, width - i);
+}
+
+static void
+pack3_neon(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i = 0;
+
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16x3_t o = { { v.val[0], v.val[1], v.val[2] } };
+        vst3q_u8(out + i * 3, o);
+    }
+
+    pack3_scalar(in + i, out + i * 3, width - i);
+}
+
+static void
+swappack3_neon(const uint32_t *in, unsigned char *out, int32_t width)
+{
+    const unsigned char *src = (const unsigned char *)in;
+    int32_t i = 0;
+
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16x3_t o = { { v.val[2], v.val[1], v.val[0] } };
+        vst3q_u8(out + i * 3, o);
+    }
+
+    swappack3_scalar(in + i, out + i * 3, width - i);
+}
+
+#endif /* SWIZZLE_NEON */
+
+static const swizzle_func swizzle_funcs[SWIZZLE_KERNEL_COUNT][SWIZZLE_OP_COUNT] = {
+    [SWIZZLE_KERNEL_SCALAR] = {
+        copy4_scalar, swap4_scalar, pack3_scalar, swappack3_scalar
+    },
+#ifdef SWIZZLE_X86
+    [SWIZZLE_KERNEL_SSSE3] = {
+        copy4_scalar, swap4_ssse3, pack3_ssse3, swappack3_ssse3
+    },
+    [SWIZZLE_KERNEL_AVX2] = {
+        copy4_scalar, swap4_avx2, pack3_avx2, swappack3_avx2
+    },
+#endif
+#ifdef SWIZZLE_NEON
+    [SWIZZLE_KERNEL_NEON] = {
+        copy4_scalar, swap4_neon, pack3_neon, swappack3_neon
+    },
+#endif
+};
+
+static bool
+swizzle_kernel_supported(enum swizzle_kernel kernel)
+{
+    switch (kernel) {
+    case SWIZZLE_KERNEL_SCALAR:
+        return true;
+#ifdef SWIZZLE_X86
+    case SWIZZLE_KERNEL_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case SWIZZLE_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef SWIZZLE_NEON
+    case SWIZZLE_KERNEL_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+enum swizzle_kernel
+swizzle_best_kernel(void)
+{
+    static const enum swizzle_kernel preferred[] = {
+        SWIZZLE_KERNEL_AVX2,
+        SWIZZLE_KERNEL_SSSE3,
+        SWIZZLE_KERNEL_NEON,
+    };
+    unsigned int i;
+
+    for (i = 0; i < sizeof preferred / sizeof preferred[0]; ++i) {
+        if (swizzle_kernel_supported(preferred[i]))
+            return preferred[i];
+    }
+
+    return SWIZZLE_KERNEL_SCALAR;
+}
+
+int
+swizzle_bytes_per_pixel(uint32_t format)
+{
+    switch (format) {
+    case WL_SHM_FORMAT_ARGB8888:
+    case WL_SHM_FORMAT_ABGR8888:
+        return 4;
+    case WL_SHM_FORMAT_XRGB8888:
+    case WL_SHM_FORMAT_XBGR8888:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+swizzle_func
+get_swizzle_func(uint32_t format, enum swizzle_order order,
+                 enum swizzle_kernel kernel)
+{
+    /* source bytes are B,G,R for the *RGB formats, R,G,B for *BGR */
+    bool source_bgr;
+    bool has_alpha;
+    enum swizzle_op op;
+
+    switch (format) {
+    case WL_SHM_FORMAT_ARGB8888:
+        source_bgr = true;
+        has_alpha = true;
+        break;
+    case WL_SHM_FORMAT_XRGB8888:
+        source_bgr = true;
+        has_alpha = false;
+        break;
+    case WL_SHM_FORMAT_ABGR8888:
+        source_bgr = false;
+        has_alpha = true;
+        break;
+    case WL_SHM_FORMAT_XBGR8888:
+        source_bgr = false;
+        has_alpha = false;
+        break;
+    default:
+        return NULL;
+    }
+
+    if (kernel >= SWIZZLE_KERNEL_COUNT || !swizzle_kernel_supported(kernel))
+        return NULL;
+
+    if (source_bgr == (order == SWIZZLE_ORDER_BGR))
+        op = has_alpha ? SWIZZLE_OP_COPY4 : SWIZZLE_OP_PACK3;
+    else
+        op = has_alpha ? SWIZZLE_OP_SWAP4 : SWIZZLE_OP_SWAPPACK3;
+
+    return swizzle_funcs[kernel][op];
+}
@@ -0,0 +1,64 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef IVICONTROLLER_SWIZZLE_H_
+#define IVICONTROLLER_SWIZZLE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum swizzle_kernel {
+    SWIZZLE_KERNEL_SCALAR = 0,
+    SWIZZLE_KERNEL_SSSE3,
+    SWIZZLE_KERNEL_AVX2,
+    SWIZZLE_KERNEL_NEON,
+    SWIZZLE_KERNEL_COUNT
+};
+
+/* byte order of the converted pixels, lowest address first */
+enum swizzle_order {
+    SWIZZLE_ORDER_RGB = 0,              /* png */
+    SWIZZLE_ORDER_BGR                   /* bmp */
+};
+
+/*
+ * Converts width pixels of a wl_shm row into packed 8 bit channels in the
+ * given order. Alpha is kept as the fourth byte for ARGB8888 and ABGR8888
+ * and dropped for XRGB8888 and XBGR8888.
+ */
+typedef void (*swizzle_func)(const uint32_t *in, unsigned char *out,
+                             int32_t width);
+
+/* the fastest kernel the cpu supports */
+enum swizzle_kernel
+swizzle_best_kernel(void);
+
+/* NULL if the kernel is not supported by the cpu or the format is unknown */
+swizzle_func
+get_swizzle_func(uint32_t format, enum swizzle_order order,
+                 enum swizzle_kernel kernel);
+
+/* bytes per converted pixel, 3 or 4, or 0 if the format is unknown */
+int
+swizzle_bytes_per_pixel(uint32_t format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IVICONTROLLER_SWIZZLE_H_ */
@@ -0,0 +1,152 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#include <string.h>
+
+#include "tiledelta.h"
+
+#define HASH_SEED  0x9e3779b97f4a7c15ull
+#define HASH_MUL_1 0x87c37b91114253d5ull
+#define HASH_MUL_2 0x4cf5ad432745937full
+
+static inline uint64_t
+hash_mix(uint64_t hash, uint64_t word)
+{
+    word *= HASH_MUL_1;
+    word = (word << 31) | (word >> 33);
+    hash ^= word * HASH_MUL_2;
+    return ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+}
+
+/* rows are a multiple of 4 bytes, mixed 8 bytes at a time */
+static uint64_t
+hash_row(uint64_t hash, const unsigned char *row, size_t size)
+{
+    uint64_t word;
+
+    for (; size >= 8; size -= 8, row += 8) {
+        memcpy(&word, row, 8);
+        hash = hash_mix(hash, word);
+    }
+
+    if (size != 0) {
+        uint32_t tail;
+        memcpy(&tail, row, 4);
+        hash = hash_mix(hash, tail);
+    }
+
+    return hash;
+}
+
+void
+tile_grid_init(struct tile_grid *grid, int32_t width, int32_t height,
+               int32_t tile_size)
+{
+    grid->width = width;
+    grid->height = height;
+    grid->tile_size = tile_size;
+    /* in 64 bit, tile_size may be anything up to INT32_MAX */
+    grid->tiles_x = ((int64_t)width + tile_size - 1) / tile_size;
+    grid->tiles_y = ((int64_t)height + tile_size - 1) / tile_size;
+}
+
+void
+tile_grid_rect(const struct tile_grid *grid, uint32_t index,
+               int32_t *x, int32_t *y, int32_t *width, int32_t *height)
+{
+    *x = (index % grid->tiles_x) * grid->tile_size;
+    *y = (index / grid->tiles_x) * grid->tile_size;
+    *width = grid->width - *x < grid->tile_size ?
+             grid->width - *x : grid->tile_size;
+    *height = grid->height - *y < grid->tile_size ?
+              grid->height - *y : grid->tile_size;
+}
+
+void
+tile_hashes_compute(const struct tile_grid *grid, const void *buffer,
+                    int32_t stride, uint64_t *hashes)
+{
+    const unsigned char *pixels = buffer;
+    int32_t tx, y;
+
+    for (tx = 0; tx < (int32_t)tile_grid_count(grid); ++tx)
+        hashes[tx] = HASH_SEED;
+
+    /* row by row through the image, so it is read sequentially */
+    for (y = 0; y < grid->height; ++y) {
+        const unsigned char *row = pixels + (size_t)y * stride;
+        uint64_t *row_hashes = hashes + (y / grid->tile_size) * grid->tiles_x;
+
+        for (tx = 0; tx < grid->tiles_x; ++tx) {
+            int32_t x = tx * grid->tile_size;
+            int32_t width = grid->width - x < grid->tile_size ?
+                            grid->width - x : grid->tile_size;
+
+            row_hashes[tx] = hash_row(row_hashes[tx], row + (size_t)x * 4,
+                                      (size_t)width * 4);
+        }
+    }
+}
+
+size_t
+tile_delta_pack(const struct tile_grid *grid, const void *buffer,
+                int32_t stride, const unsigned char *change_map,
+                void *tiles)
+{
+    const unsigned char *pixels = buffer;
+    unsigned char *out = tiles;
+    size_t size = 0;
+    uint32_t i;
+    int32_t x, y, width, height, row;
+
+    for (i = 0; i < tile_grid_count(grid); ++i) {
+        if (!change_map[i])
+            continue;
+
+        tile_grid_rect(grid, i, &x, &y, &width, &height);
+        if (out != NULL) {
+            for (row = 0; row < height; ++row) {
+                memcpy(out + size + (size_t)row * width * 4,
+                       pixels + (size_t)(y + row) * stride + (size_t)x * 4,
+                       (size_t)width * 4);
+            }
+        }
+        size += (size_t)width * height * 4;
+    }
+
+    return size;
+}
+
+void
+tile_delta_apply(const struct tile_grid *grid, const unsigned char *change_map,
+                 const void *tiles, void *buffer, int32_t stride)
+{
+    const unsigned char *in = tiles;
+    unsigned char *pixels = buffer;
+    uint32_t i;
+    int32_t x, y, width, height, row;
+
+    for (i = 0; i < tile_grid_count(grid); ++i) {
+        if (!change_map[i])
+            continue;
+
+        tile_grid_rect(grid, i, &x, &y, &width, &height);
+        for (row = 0; row < height; ++row) {
+            memcpy(pixels + (size_t)(y + row) * stride + (size_t)x * 4,
+                   in + (size_t)row * width * 4, (size_t)width * 4);
+        }
+        in += (size_t)width * height * 4;
+    }
+}
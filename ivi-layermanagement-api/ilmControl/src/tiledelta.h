@@ -0,0 +1,80 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+#ifndef IVICONTROLLER_TILEDELTA_H_
+#define IVICONTROLLER_TILEDELTA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * An image of 4 byte pixels cut into square tiles, row by row. Tiles at
+ * the right and bottom edge are clipped to the image.
+ */
+struct tile_grid {
+    int32_t width;
+    int32_t height;
+    int32_t tile_size;
+    int32_t tiles_x;
+    int32_t tiles_y;
+};
+
+void
+tile_grid_init(struct tile_grid *grid, int32_t width, int32_t height,
+               int32_t tile_size);
+
+static inline uint32_t
+tile_grid_count(const struct tile_grid *grid)
+{
+    return (uint32_t)grid->tiles_x * (uint32_t)grid->tiles_y;
+}
+
+void
+tile_grid_rect(const struct tile_grid *grid, uint32_t index,
+               int32_t *x, int32_t *y, int32_t *width, int32_t *height);
+
+/*
+ * One 64 bit hash per tile, tile_grid_count entries. Changes are detected
+ * by comparing hashes only, the pixels of a base are not kept, so a tile
+ * whose hash collides with its previous content is taken as unchanged.
+ */
+void
+tile_hashes_compute(const struct tile_grid *grid, const void *buffer,
+                    int32_t stride, uint64_t *hashes);
+
+/*
+ * Copies the tiles set in change_map, in index order and with rows of
+ * tile width * 4 bytes, to tiles. Returns the number of bytes, and only
+ * counts them if tiles is NULL.
+ */
+size_t
+tile_delta_pack(const struct tile_grid *grid, const void *buffer,
+                int32_t stride, const unsigned char *change_map,
+                void *tiles);
+
+/* writes tiles packed by tile_delta_pack back into an image */
+void
+tile_delta_apply(const struct tile_grid *grid, const unsigned char *change_map,
+                 const void *tiles, void *buffer, int32_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IVICONTROLLER_TILEDELTA_H_ */
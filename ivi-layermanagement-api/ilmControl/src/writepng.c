@@ -19,10 +19,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <arpa/inet.h>
+#include <zlib.h>
 #include "png.h"
 #include "ivi-wm-client-protocol.h"
 #include "writepng.h"
+#include "swizzle.h"
 
 typedef struct _image_info {
     png_structp  png_ptr;
@@ -31,6 +36,24 @@ typedef struct _image_info {
     FILE        *outfile;
 } image_info;
 
+static struct {
+    int level;
+    int filter;
+    unsigned int threads;
+} png_options = {
+    Z_DEFAULT_COMPRESSION,
+    WRITEPNG_FILTER_ADAPTIVE,
+    0,
+};
+
+void
+set_png_options(int level, int filter, unsigned int threads)
+{
+    png_options.level = level;
+    png_options.filter = filter;
+    png_options.threads = threads;
+}
+
 
 static void
 writepng_error_handler(png_structp png_ptr,
@@ -63,24 +86,38 @@ create_png_header(image_info *info,
 
     png_init_io(info->png_ptr, info->outfile);
 
-    png_set_compression_level(info->png_ptr, PNG_Z_DEFAULT_COMPRESSION);
+    png_set_compression_level(info->png_ptr, png_options.level);
 
-    switch (format) {
-    case WL_SHM_FORMAT_ARGB8888:
-        color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-        png_set_swap_alpha(info->png_ptr);
+    switch (png_options.filter) {
+    case PNG_FILTER_VALUE_NONE:
+        png_set_filter(info->png_ptr, 0, PNG_FILTER_NONE);
         break;
-    case WL_SHM_FORMAT_XRGB8888:
-        color_type = PNG_COLOR_TYPE_RGB;
+    case PNG_FILTER_VALUE_SUB:
+        png_set_filter(info->png_ptr, 0, PNG_FILTER_SUB);
+        break;
+    case PNG_FILTER_VALUE_UP:
+        png_set_filter(info->png_ptr, 0, PNG_FILTER_UP);
+        break;
+    case PNG_FILTER_VALUE_AVG:
+        png_set_filter(info->png_ptr, 0, PNG_FILTER_AVG);
         break;
+    case PNG_FILTER_VALUE_PAETH:
+        png_set_filter(info->png_ptr, 0, PNG_FILTER_PAETH);
+        break;
+    default:
+        png_set_filter(info->png_ptr, 0, PNG_ALL_FILTERS);
+        break;
+    }
+
+    /* the rows are already swizzled to R, G, B, [A] */
+    switch (format) {
+    case WL_SHM_FORMAT_ARGB8888:
     case WL_SHM_FORMAT_ABGR8888:
         color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-        png_set_bgr(info->png_ptr);
-        png_set_swap_alpha(info->png_ptr);
         break;
+    case WL_SHM_FORMAT_XRGB8888:
     case WL_SHM_FORMAT_XBGR8888:
         color_type = PNG_COLOR_TYPE_RGB;
-        png_set_bgr(info->png_ptr);
         break;
     default:
         fprintf(stderr, "unsupported pixelformat 0x%x\n", format);
@@ -102,7 +139,7 @@ write_png_file(image_info *info,
                int32_t width,
                int32_t height,
                uint32_t format,
-               int bytes_per_pixel)
+               int32_t stride)
 {
     info->png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL,
                                       writepng_error_handler, NULL);
@@ -117,7 +154,7 @@ write_png_file(image_info *info,
 
     for(int j = 0; j < height  ; ++j) {
         png_const_bytep pointer = (png_const_bytep)buffer;
-        pointer += j * width * bytes_per_pixel;
+        pointer += j * stride;
 
         if (setjmp(info->jmpbuf)) {
             fprintf(stderr, "setjmp: failed, j=%d\n", j);
@@ -147,45 +184,396 @@ write_png_file(image_info *info,
     return 0;
 }
 
-int
-save_as_png(const char *filename,
-            const char *buffer,
-            int32_t width,
-            int32_t height,
-            uint32_t format)
+/*
+ * Parallel encoder
+ *
+ * The image is cut into stripes of rows. Every stripe is converted,
+ * filtered and deflated on its own, the stripes are then concatenated
+ * into a single zlib stream: all but the last stripe end with a sync
+ * flush, so they end on a byte boundary without the final block bit,
+ * and the adler32 checksums of the stripes are combined.
+ */
+
+struct png_stripe {
+    int32_t first_row;
+    int32_t rows;
+    unsigned char *data;
+    size_t size;
+    uLong adler;
+    size_t raw_size;
+};
+
+struct png_encoder {
+    const uint32_t *pixels;
+    int32_t width;
+    int32_t height;
+    swizzle_func swizzle;
+    int bytes_per_pixel;
+    int level;
+    int filter;
+    struct png_stripe *stripes;
+    int stripe_count;
+    int next_stripe;
+    int failed;
+};
+
+static void
+convert_row(const struct png_encoder *enc, int32_t row, unsigned char *out)
 {
-    int32_t image_stride = 0;
-    int32_t image_size = 0;
-    char *image_buffer = NULL;
-    int32_t row = 0;
-    int32_t col = 0;
-    int32_t image_offset = 0;
-    int32_t offset = 0;
-    int bytes_per_pixel = 0;
-    bool has_alpha = false;
-    image_info info;
+    enc->swizzle(enc->pixels + (size_t)row * enc->width, out, enc->width);
+}
+
+static inline unsigned char
+paeth_predictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
 
-    if ((filename == NULL) || (buffer == NULL)) {
+/* out[0] receives the filter type, out[1..len] the filtered bytes */
+static void
+filter_row(int type, const unsigned char *cur, const unsigned char *prev,
+           size_t len, int bpp, unsigned char *out)
+{
+    size_t i;
+
+    out[0] = type;
+    out++;
+
+    switch (type) {
+    case PNG_FILTER_VALUE_NONE:
+        memcpy(out, cur, len);
+        break;
+    case PNG_FILTER_VALUE_SUB:
+        for (i = 0; i < (size_t)bpp; ++i)
+            out[i] = cur[i];
+        for (; i < len; ++i)
+            out[i] = cur[i] - cur[i - bpp];
+        break;
+    case PNG_FILTER_VALUE_UP:
+        for (i = 0; i < len; ++i)
+            out[i] = cur[i] - prev[i];
+        break;
+    case PNG_FILTER_VALUE_AVG:
+        for (i = 0; i < (size_t)bpp; ++i)
+            out[i] = cur[i] - (prev[i] >> 1);
+        for (; i < len; ++i)
+            out[i] = cur[i] - ((cur[i - bpp] + prev[i]) >> 1);
+        break;
+    default: /* PNG_FILTER_VALUE_PAETH */
+        for (i = 0; i < (size_t)bpp; ++i)
+            out[i] = cur[i] - paeth_predictor(0, prev[i], 0);
+        for (; i < len; ++i)
+            out[i] = cur[i] - paeth_predictor(cur[i - bpp], prev[i],
+                                              prev[i - bpp]);
+        break;
+    }
+}
+
+/* the same heuristic libpng uses: smallest sum of the signed residuals */
+static const unsigned char *
+filter_row_adaptive(const unsigned char *cur, const unsigned char *prev,
+                    size_t len, int bpp, unsigned char *candidates)
+{
+    const unsigned char *best = NULL;
+    unsigned long best_sum = ~0UL;
+    int type;
+    size_t i;
+
+    for (type = PNG_FILTER_VALUE_NONE; type <= PNG_FILTER_VALUE_PAETH; ++type) {
+        unsigned char *out = candidates + type * (len + 1);
+        unsigned long sum = 0;
+
+        filter_row(type, cur, prev, len, bpp, out);
+        for (i = 1; i <= len && sum < best_sum; ++i)
+            sum += abs((signed char)out[i]);
+
+        if (sum < best_sum) {
+            best_sum = sum;
+            best = out;
+        }
+    }
+
+    return best;
+}
+
+static int
+encode_stripe(struct png_encoder *enc, struct png_stripe *stripe)
+{
+    size_t len = (size_t)enc->width * enc->bytes_per_pixel;
+    unsigned char *rows = NULL;
+    unsigned char *filtered = NULL;
+    unsigned char *prev, *cur;
+    bool last = stripe->first_row + stripe->rows == enc->height;
+    z_stream strm;
+    int32_t row;
+    int ret = -1;
+
+    memset(&strm, 0, sizeof strm);
+    if (deflateInit2(&strm, enc->level, Z_DEFLATED, -15, 8,
+                     enc->filter == PNG_FILTER_VALUE_NONE ?
+                     Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK) {
+        fprintf(stderr, "deflateInit2: failed\n");
         return -1;
     }
 
-    info.outfile = fopen(filename, "wb");
-    if (!info.outfile) {
-        fprintf(stderr, "could not open the file %s\n", filename);
+    stripe->raw_size = (len + 1) * stripe->rows;
+    /* room for the sync flush marker on top of the bound */
+    stripe->size = deflateBound(&strm, stripe->raw_size) + 16;
+    stripe->data = malloc(stripe->size);
+    rows = calloc(2, len);
+    filtered = malloc((len + 1) * (enc->filter == WRITEPNG_FILTER_ADAPTIVE ?
+                                   PNG_FILTER_VALUE_LAST : 1));
+    if (stripe->data == NULL || rows == NULL || filtered == NULL) {
+        fprintf(stderr, "failed to allocate png stripe buffers: %m\n");
+        goto out;
+    }
+
+    prev = rows;
+    cur = rows + len;
+
+    /* the filters of the first row look at the last row of the stripe above */
+    if (stripe->first_row > 0)
+        convert_row(enc, stripe->first_row - 1, prev);
+
+    strm.next_out = stripe->data;
+    strm.avail_out = stripe->size;
+    stripe->adler = adler32(0L, Z_NULL, 0);
+
+    for (row = stripe->first_row;
+         row < stripe->first_row + stripe->rows; ++row) {
+        const unsigned char *out = filtered;
+        unsigned char *swap;
+
+        convert_row(enc, row, cur);
+        if (enc->filter == WRITEPNG_FILTER_ADAPTIVE)
+            out = filter_row_adaptive(cur, prev, len, enc->bytes_per_pixel,
+                                      filtered);
+        else
+            filter_row(enc->filter, cur, prev, len, enc->bytes_per_pixel,
+                       filtered);
+
+        stripe->adler = adler32(stripe->adler, out, len + 1);
+
+        strm.next_in = (Bytef *)out;
+        strm.avail_in = len + 1;
+        if (deflate(&strm, Z_NO_FLUSH) != Z_OK || strm.avail_in != 0) {
+            fprintf(stderr, "deflate: failed\n");
+            goto out;
+        }
+
+        swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+
+    if (deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH) !=
+        (last ? Z_STREAM_END : Z_OK)) {
+        fprintf(stderr, "deflate: failed to flush stripe\n");
+        goto out;
+    }
+
+    stripe->size -= strm.avail_out;
+    ret = 0;
+
+out:
+    deflateEnd(&strm);
+    free(rows);
+    free(filtered);
+    return ret;
+}
+
+static void *
+encode_worker(void *data)
+{
+    struct png_encoder *enc = data;
+    int index;
+
+    while ((index = __atomic_fetch_add(&enc->next_stripe, 1,
+                                       __ATOMIC_RELAXED)) < enc->stripe_count) {
+        if (encode_stripe(enc, &enc->stripes[index]) != 0)
+            __atomic_store_n(&enc->failed, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static int
+write_chunk(FILE *file, const char *type, const void *head, size_t head_size,
+            const void *data, size_t data_size,
+            const void *tail, size_t tail_size)
+{
+    uint32_t length = htonl(head_size + data_size + tail_size);
+    uLong crc = crc32(0L, (const Bytef *)type, 4);
+    uint32_t crc_be;
+
+    /* crc32 restarts on a NULL buffer, empty parts are skipped */
+    if (head_size)
+        crc = crc32(crc, head, head_size);
+    if (data_size)
+        crc = crc32(crc, data, data_size);
+    if (tail_size)
+        crc = crc32(crc, tail, tail_size);
+    crc_be = htonl(crc);
+
+    if (fwrite(&length, 4, 1, file) != 1 ||
+        fwrite(type, 4, 1, file) != 1 ||
+        (head_size && fwrite(head, head_size, 1, file) != 1) ||
+        (data_size && fwrite(data, data_size, 1, file) != 1) ||
+        (tail_size && fwrite(tail, tail_size, 1, file) != 1) ||
+        fwrite(&crc_be, 4, 1, file) != 1) {
+        fprintf(stderr, "failed to write png chunk: %m\n");
         return -1;
     }
 
-    switch (format) {
-    case WL_SHM_FORMAT_ARGB8888:
-    case WL_SHM_FORMAT_ABGR8888:
-        has_alpha = true;
-        break;
-    default:
-        has_alpha = false;
-        break;
+    return 0;
+}
+
+static int
+write_png_stripes(FILE *file, struct png_encoder *enc)
+{
+    static const unsigned char signature[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+    };
+    unsigned char ihdr[13];
+    unsigned char zlib_header[2] = { 0x78, 0x9c };
+    unsigned char adler_be[4];
+    uint32_t value;
+    uLong adler;
+    int i;
+
+    /* FLEVEL of the zlib header, the check bits are valid for 0x78 */
+    if (enc->level == 0 || enc->level == 1)
+        zlib_header[1] = 0x01;
+    else if (enc->level >= 2 && enc->level <= 5)
+        zlib_header[1] = 0x5e;
+    else if (enc->level >= 7)
+        zlib_header[1] = 0xda;
+
+    value = htonl(enc->width);
+    memcpy(ihdr, &value, 4);
+    value = htonl(enc->height);
+    memcpy(ihdr + 4, &value, 4);
+    ihdr[8] = 8;
+    ihdr[9] = enc->bytes_per_pixel == 4 ? PNG_COLOR_TYPE_RGB_ALPHA :
+                                          PNG_COLOR_TYPE_RGB;
+    ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+    ihdr[11] = PNG_FILTER_TYPE_BASE;
+    ihdr[12] = PNG_INTERLACE_NONE;
+
+    adler = enc->stripes[0].adler;
+    for (i = 1; i < enc->stripe_count; ++i)
+        adler = adler32_combine(adler, enc->stripes[i].adler,
+                                enc->stripes[i].raw_size);
+    value = htonl(adler);
+    memcpy(adler_be, &value, 4);
+
+    if (fwrite(signature, sizeof signature, 1, file) != 1 ||
+        write_chunk(file, "IHDR", NULL, 0, ihdr, sizeof ihdr, NULL, 0) != 0)
+        return -1;
+
+    for (i = 0; i < enc->stripe_count; ++i) {
+        bool first = i == 0;
+        bool last = i == enc->stripe_count - 1;
+
+        if (write_chunk(file, "IDAT",
+                        zlib_header, first ? sizeof zlib_header : 0,
+                        enc->stripes[i].data, enc->stripes[i].size,
+                        adler_be, last ? sizeof adler_be : 0) != 0)
+            return -1;
+    }
+
+    return write_chunk(file, "IEND", NULL, 0, NULL, 0, NULL, 0);
+}
+
+static int
+encode_png_parallel(FILE *file, const char *buffer, int32_t width,
+                    int32_t height, swizzle_func swizzle, int bytes_per_pixel,
+                    unsigned int threads)
+{
+    struct png_encoder enc;
+    pthread_t *workers = NULL;
+    unsigned int started = 0;
+    int32_t rows_per_stripe;
+    unsigned int i;
+    int ret = -1;
+
+    memset(&enc, 0, sizeof enc);
+    enc.pixels = (const uint32_t *)buffer;
+    enc.width = width;
+    enc.height = height;
+    enc.swizzle = swizzle;
+    enc.bytes_per_pixel = bytes_per_pixel;
+    enc.level = png_options.level;
+    enc.filter = png_options.filter;
+
+    /* two stripes per thread even out rows which compress slower */
+    rows_per_stripe = (height + threads * 2 - 1) / (threads * 2);
+    if (rows_per_stripe < 16)
+        rows_per_stripe = 16;
+    enc.stripe_count = (height + rows_per_stripe - 1) / rows_per_stripe;
+
+    enc.stripes = calloc(enc.stripe_count, sizeof *enc.stripes);
+    if (threads > (unsigned int)enc.stripe_count)
+        threads = enc.stripe_count;
+    workers = calloc(threads, sizeof *workers);
+    if (enc.stripes == NULL || workers == NULL) {
+        fprintf(stderr, "failed to allocate png encoder: %m\n");
+        goto out;
+    }
+
+    for (i = 0; i < (unsigned int)enc.stripe_count; ++i) {
+        enc.stripes[i].first_row = i * rows_per_stripe;
+        enc.stripes[i].rows = height - enc.stripes[i].first_row;
+        if (enc.stripes[i].rows > rows_per_stripe)
+            enc.stripes[i].rows = rows_per_stripe;
+    }
+
+    /* the calling thread is one of the workers */
+    for (started = 0; started + 1 < threads; ++started) {
+        if (pthread_create(&workers[started], NULL, encode_worker, &enc) != 0)
+            break;
+    }
+
+    encode_worker(&enc);
+
+    for (i = 0; i < started; ++i)
+        pthread_join(workers[i], NULL);
+
+    if (!enc.failed)
+        ret = write_png_stripes(file, &enc);
+
+out:
+    if (enc.stripes != NULL) {
+        for (i = 0; i < (unsigned int)enc.stripe_count; ++i)
+            free(enc.stripes[i].data);
     }
+    free(enc.stripes);
+    free(workers);
+    return ret;
+}
+
+static int
+encode_png_libpng(FILE *file, const char *buffer, int32_t width,
+                  int32_t height, uint32_t format, swizzle_func swizzle,
+                  int bytes_per_pixel)
+{
+    int32_t image_stride = 0;
+    int32_t image_size = 0;
+    char *image_buffer = NULL;
+    int32_t row = 0;
+    image_info info;
+
+    info.outfile = file;
 
-    bytes_per_pixel = has_alpha ? 4 : 3;
     image_stride = (((width * bytes_per_pixel) + 3) & ~3);
     image_size = image_stride * height;
 
@@ -197,18 +585,12 @@ save_as_png(const char *filename,
     }
 
     for (row = 0; row < height; ++row) {
-        for (col = 0; col < width; ++col) {
-            offset = row * width + col;
-            uint32_t pixel = htonl(((uint32_t*)buffer)[offset]);
-            char * pixel_p = (char*) &pixel;
-            image_offset = row * image_stride + col * bytes_per_pixel;
-            for (int i=0; i<bytes_per_pixel; ++i){
-                image_buffer[image_offset + i] = pixel_p[i + (has_alpha ? 0 : 1)];
-            }
-        }
+        swizzle((const uint32_t *)buffer + (size_t)row * width,
+                (unsigned char *)image_buffer + (size_t)row * image_stride,
+                width);
     }
 
-    if (write_png_file(&info, image_buffer, width, height, format, bytes_per_pixel) != 0) {
+    if (write_png_file(&info, image_buffer, width, height, format, image_stride) != 0) {
         free(image_buffer);
         return -1;
     }
@@ -216,3 +598,54 @@ save_as_png(const char *filename,
     free(image_buffer);
     return 0;
 }
+
+int
+save_as_png(const char *filename,
+            const char *buffer,
+            int32_t width,
+            int32_t height,
+            uint32_t format)
+{
+    int bytes_per_pixel = 0;
+    unsigned int threads = png_options.threads;
+    swizzle_func swizzle;
+    FILE *file;
+    int ret;
+
+    if ((filename == NULL) || (buffer == NULL) || (width <= 0) || (height <= 0)) {
+        return -1;
+    }
+
+    swizzle = get_swizzle_func(format, SWIZZLE_ORDER_RGB,
+                               swizzle_best_kernel());
+    if (swizzle == NULL) {
+        fprintf(stderr, "unsupported pixelformat 0x%x\n", format);
+        return -1;
+    }
+
+    bytes_per_pixel = swizzle_bytes_per_pixel(format);
+
+    file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "could not open the file %s\n", filename);
+        return -1;
+    }
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (unsigned int)cpus : 1;
+    }
+
+    if (threads == 1) {
+        ret = encode_png_libpng(file, buffer, width, height, format,
+                                swizzle, bytes_per_pixel);
+    } else {
+        ret = encode_png_parallel(file, buffer, width, height, swizzle,
+                                  bytes_per_pixel, threads);
+    }
+
+    if (fclose(file) != 0)
+        ret = -1;
+
+    return ret;
+}
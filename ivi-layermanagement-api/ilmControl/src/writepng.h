@@ -21,6 +21,17 @@
 
 #include <stdint.h>
 
+/* chooses the filter of every row, like libpng does by default */
+#define WRITEPNG_FILTER_ADAPTIVE 5
+
+/*
+ * level is a zlib compression level, filter one of the png filter types
+ * 0 to 4 or WRITEPNG_FILTER_ADAPTIVE. threads 0 uses all online cpus,
+ * threads 1 encodes with libpng on the calling thread.
+ */
+void
+set_png_options(int level, int filter, unsigned int threads);
+
 int
 save_as_png(const char *filename,
             const char *buffer,
@@ -45,10 +45,10 @@ protected:
     ivi_application* iviApp;
     wl_shm* wlShm;
     uint32_t shmFormats;
+    wl_compositor* wlCompositor;
 
 private:
     wl_registry*   wlRegistry;
-    wl_compositor* wlCompositor;
 };
 
 inline void TestBase::SetWLCompositor(struct wl_compositor* wl_compositor)
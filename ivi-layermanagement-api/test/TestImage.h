@@ -0,0 +1,85 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#ifndef TEST_IMAGE_H
+#define TEST_IMAGE_H
+
+#include <stdlib.h>
+#include <vector>
+
+#include "wayland-client.h"
+
+extern "C" {
+    #include "ilm_control.h"
+}
+
+/* Synthetic images for the tests of the screenshot code which runs in the
+ * client, so they need no compositor.
+ */
+
+static const uint32_t screenshotFormats[] = {
+    WL_SHM_FORMAT_ARGB8888,
+    WL_SHM_FORMAT_XRGB8888,
+    WL_SHM_FORMAT_ABGR8888,
+    WL_SHM_FORMAT_XBGR8888,
+};
+
+inline std::vector<uint32_t> randomImage(t_ilm_uint width, t_ilm_uint height)
+{
+    std::vector<uint32_t> pixels(width * height);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    }
+    return pixels;
+}
+
+// runs, small steps and noise, to hit every qoi and lz4 path
+inline std::vector<uint32_t> testImage(t_ilm_uint width, t_ilm_uint height)
+{
+    std::vector<uint32_t> pixels(width * height);
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < width; ++x)
+        {
+            uint32_t value = (x / 8 % 2) ? 0xff204060u : 0xff204062u + x;
+            if ((x * 31 + y * 17) % 13 == 0)
+            {
+                value = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+            }
+            pixels[y * width + x] = value;
+        }
+    }
+    return pixels;
+}
+
+inline struct ilmScreenshot wrapImage(std::vector<uint32_t>& pixels, t_ilm_uint width,
+                                      t_ilm_uint height,
+                                      uint32_t format = WL_SHM_FORMAT_XRGB8888)
+{
+    struct ilmScreenshot image;
+    image.buffer = &pixels[0];
+    image.fd = -1;
+    image.width = width;
+    image.height = height;
+    image.stride = width * 4;
+    image.size = image.stride * height;
+    image.format = format;
+    image.timestamp = 0;
+    return image;
+}
+
+#endif // TEST_IMAGE_H
@@ -0,0 +1,147 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+
+#include "idindex.h"
+
+/* The layer id allocator and the id index it checks against, without a
+ * compositor. Entries stand in for the layer contexts.
+ */
+
+class IdAllocatorTest : public ::testing::Test {
+public:
+    void SetUp()
+    {
+        ASSERT_EQ(0, id_index_init(&index));
+        ids.next = 0;
+        wl_array_init(&ids.released);
+        entries.reserve(maxEntries);
+    }
+
+    void TearDown()
+    {
+        wl_array_release(&ids.released);
+        id_index_release(&index);
+    }
+
+protected:
+    static const uint32_t maxEntries = 100000;
+
+    // an object which got the id, from the allocator or elsewhere
+    void add(uint32_t id)
+    {
+        ASSERT_LT(entries.size(), (size_t)maxEntries);
+        entries.push_back(id_index_entry());
+        wl_list_init(&entries.back().link);
+        id_index_insert(&index, &entries.back(), id);
+    }
+
+    uint32_t create()
+    {
+        uint32_t id = id_allocator_get(&ids, &index);
+        add(id);
+        return id;
+    }
+
+    void destroy(uint32_t id)
+    {
+        id_index_remove(&index, id_index_lookup(&index, id));
+        id_allocator_put(&ids, id);
+    }
+
+    struct id_index index;
+    struct id_allocator ids;
+    std::vector<id_index_entry> entries;
+};
+
+TEST_F(IdAllocatorTest, CountsUp)
+{
+    EXPECT_EQ(1u, create());
+    EXPECT_EQ(2u, create());
+    EXPECT_EQ(3u, create());
+    EXPECT_EQ(3u, index.count);
+}
+
+TEST_F(IdAllocatorTest, ReleasedIdsAreReusedLastInFirstOut)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        create();
+    }
+
+    destroy(2);
+    destroy(4);
+    destroy(3);
+
+    EXPECT_EQ(3u, create());
+    EXPECT_EQ(4u, create());
+    EXPECT_EQ(2u, create());
+    // the counter moves on once nothing is left to reuse
+    EXPECT_EQ(6u, create());
+}
+
+TEST_F(IdAllocatorTest, IdsInTheIndexAreSkipped)
+{
+    // ids given by the compositor or another client
+    add(1);
+    add(2);
+    add(4);
+
+    EXPECT_EQ(3u, create());
+    EXPECT_EQ(5u, create());
+
+    // a released id taken by someone else in the meantime
+    destroy(3);
+    add(3);
+    EXPECT_EQ(6u, create());
+    EXPECT_EQ(0u, ids.released.size);
+}
+
+TEST_F(IdAllocatorTest, InvalidIdIsSkipped)
+{
+    ids.next = INVALID_ID - 1;
+    EXPECT_NE((uint32_t)INVALID_ID, create());
+}
+
+TEST_F(IdAllocatorTest, LookupsDoNotWalkTheObjects)
+{
+    for (uint32_t i = 0; i < maxEntries; ++i)
+    {
+        ASSERT_EQ(i + 1, create());
+    }
+    EXPECT_EQ((uint32_t)maxEntries, index.count);
+
+    // the index grows with the objects, every bucket stays short
+    uint32_t buckets = 1u << index.shift;
+    int longest = 0;
+    EXPECT_GE(2 * buckets, index.count);
+    for (uint32_t b = 0; b < buckets; ++b)
+    {
+        longest = std::max(longest, wl_list_length(&index.buckets[b]));
+    }
+    EXPECT_LE(longest, 8);
+
+    for (uint32_t id = 1; id <= maxEntries; ++id)
+    {
+        struct id_index_entry* entry = id_index_lookup(&index, id);
+        ASSERT_TRUE(entry != NULL);
+        EXPECT_EQ(id, entry->id);
+    }
+    EXPECT_TRUE(id_index_lookup(&index, maxEntries + 1) == NULL);
+}
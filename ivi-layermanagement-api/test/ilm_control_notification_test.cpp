@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <assert.h>
+#include <poll.h>
 
 extern "C" {
     #include "ilm_control.h"
@@ -78,6 +79,7 @@ public:
         callbackLayerId = -1;
         LayerProperties = ilmLayerProperties();
         mask = static_cast<t_ilm_notification_mask>(0);
+        lastMask = 0;
         surface = -1;
         SurfaceProperties = ilmSurfaceProperties();
         // create a layer
@@ -125,6 +127,8 @@ public:
     static t_ilm_surface callbackSurfaceId;
     static struct ilmLayerProperties LayerProperties;
     static unsigned int mask;
+    // mask of the last callback only
+    static unsigned int lastMask;
     static t_ilm_surface surface;
     struct ivi_surface* ivi_surface;
     static ilmSurfaceProperties SurfaceProperties;
@@ -188,6 +192,7 @@ public:
         EXPECT_TRUE(callbackLayerId == (unsigned)-1 || callbackLayerId == layer);
         callbackLayerId = layer;
         mask |= (unsigned)m;
+        lastMask = (unsigned)m;
         timesCalled++;
 
         pthread_cond_signal( &waiterVariable );
@@ -226,10 +231,62 @@ public:
         EXPECT_TRUE(callbackSurfaceId == (unsigned)-1 || callbackSurfaceId == surface);
         callbackSurfaceId = surface;
         mask |= (unsigned)m;
+        lastMask = (unsigned)m;
         timesCalled++;
 
         pthread_cond_signal( &waiterVariable );
     }
+
+    static void CommitCallbackFunction(ilmErrorTypes result, t_ilm_uint frameTime, void* user_data)
+    {
+        PthreadMutexLock lock(notificationMutex);
+
+        commitResult = result;
+        commitUserData = user_data;
+        timesCalled++;
+
+        pthread_cond_signal( &waiterVariable );
+    }
+
+    static void ScreenshotCallbackFunction(ilmErrorTypes result, struct ilmScreenshot* pScreenshot, void* user_data)
+    {
+        PthreadMutexLock lock(notificationMutex);
+
+        commitResult = result;
+        commitUserData = user_data;
+        if (pScreenshot != NULL)
+        {
+            screenshotWidth = pScreenshot->width;
+            ilm_releaseScreenshot(pScreenshot);
+        }
+        timesCalled++;
+
+        pthread_cond_signal( &waiterVariable );
+    }
+
+    static void CaptureCallbackFunction(ilmErrorTypes result, t_ilm_uint captureId, const struct ilmCaptureFrame* pFrame, void* user_data)
+    {
+        PthreadMutexLock lock(notificationMutex);
+
+        // the frame is kept until the test releases it
+        commitResult = result;
+        commitUserData = user_data;
+        if (pFrame != NULL)
+        {
+            screenshotWidth = pFrame->image.width;
+            captureIndex = pFrame->index;
+            captureDropped = pFrame->dropped;
+        }
+        timesCalled++;
+
+        pthread_cond_signal( &waiterVariable );
+    }
+
+    static ilmErrorTypes commitResult;
+    static void* commitUserData;
+    static t_ilm_uint screenshotWidth;
+    static t_ilm_uint captureIndex;
+    static t_ilm_uint captureDropped;
 };
 
 // Pointers where to put received values for current Test
@@ -237,8 +294,14 @@ t_ilm_layer NotificationTest::callbackLayerId;
 t_ilm_surface NotificationTest::callbackSurfaceId;
 struct ilmLayerProperties NotificationTest::LayerProperties;
 unsigned int NotificationTest::mask;
+unsigned int NotificationTest::lastMask;
 unsigned int NotificationTest::surface;
 ilmSurfaceProperties NotificationTest::SurfaceProperties;
+ilmErrorTypes NotificationTest::commitResult;
+void* NotificationTest::commitUserData;
+t_ilm_uint NotificationTest::screenshotWidth;
+t_ilm_uint NotificationTest::captureIndex;
+t_ilm_uint NotificationTest::captureDropped;
 
 TEST_F(NotificationTest, ilm_layerAddNotificationWithoutCallback)
 {
@@ -650,7 +713,7 @@ TEST_F(NotificationTest, NotifyOnSurfaceAllValues)
     EXPECT_EQ(155u,SurfaceProperties.destWidth);
     EXPECT_EQ(199u,SurfaceProperties.destHeight);
     EXPECT_EQ(ILM_NOTIFICATION_DEST_RECT|ILM_NOTIFICATION_VISIBILITY|ILM_NOTIFICATION_OPACITY|
-              ILM_NOTIFICATION_SOURCE_RECT|ILM_NOTIFICATION_CONTENT_AVAILABLE,mask);
+              ILM_NOTIFICATION_SOURCE_RECT,lastMask);
 
     ASSERT_EQ(ILM_SUCCESS,ilm_surfaceRemoveNotification(surface));
 }
@@ -726,3 +789,314 @@ TEST_F(NotificationTest, DefaultIsNotToReceiveNotificationsSurface)
     // assert that we have not been notified
     assertNoCallbackIsCalled();
 }
+
+TEST_F(NotificationTest, ilm_commitChangesAsync)
+{
+    ilmLayerProperties properties;
+    int token = 0;
+
+    commitResult = ILM_FAILED;
+    commitUserData = NULL;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layer, 0.75));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChangesAsync(&CommitCallbackFunction, &token));
+
+    // the change is applied once the callback has been called
+    assertCallbackcalled();
+    EXPECT_EQ(ILM_SUCCESS, commitResult);
+    EXPECT_EQ(&token, commitUserData);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layer, &properties));
+    EXPECT_NEAR(0.75, properties.opacity, 0.01);
+}
+
+TEST_F(NotificationTest, ilm_commitChangesAsyncInFlight)
+{
+    // other calls are not blocked while commits are pending
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChangesAsync(&CommitCallbackFunction, NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChangesAsync(&CommitCallbackFunction, NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetVisibility(layer, ILM_TRUE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChangesAsync(&CommitCallbackFunction, NULL));
+
+    assertCallbackcalled(3);
+}
+
+TEST_F(NotificationTest, ilm_commitChangesAsync_InvalidInput)
+{
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_commitChangesAsync(NULL, NULL));
+}
+
+TEST_F(NotificationTest, ilm_takeScreenshotAsync)
+{
+    int token = 0;
+
+    commitResult = ILM_FAILED;
+    commitUserData = NULL;
+    screenshotWidth = 0;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotAsync(0, &ScreenshotCallbackFunction, &token));
+
+    // other calls are not blocked while the screenshot is in flight
+    t_ilm_uint numberOfScreens = 0;
+    t_ilm_uint* screenIDs = NULL;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScreenIDs(&numberOfScreens, &screenIDs));
+    free(screenIDs);
+
+    assertCallbackcalled();
+    EXPECT_EQ(ILM_SUCCESS, commitResult);
+    EXPECT_EQ(&token, commitUserData);
+    EXPECT_GT(screenshotWidth, 0u);
+}
+
+TEST_F(NotificationTest, ilm_takeScreenshotAsyncInFlight)
+{
+    ilm_layerSetVisibility(layer, ILM_TRUE);
+    ilm_commitChanges();
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotAsync(0, &ScreenshotCallbackFunction, NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotAsync(0, &ScreenshotCallbackFunction, NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeSurfaceScreenshotAsync(surface, &ScreenshotCallbackFunction, NULL));
+
+    assertCallbackcalled(3);
+}
+
+TEST_F(NotificationTest, ilm_takeScreenshotAsync_InvalidInput)
+{
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotAsync(0, NULL, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeSurfaceScreenshotAsync(surface, NULL, NULL));
+    ASSERT_EQ(ILM_FAILED, ilm_takeScreenshotAsync(0xdeadbeef, &ScreenshotCallbackFunction, NULL));
+}
+
+TEST_F(NotificationTest, ilm_captureStart)
+{
+    int token = 0;
+    t_ilm_uint captureId = 0;
+    t_ilm_uint dropped = 0;
+
+    ilm_layerSetVisibility(layer, ILM_TRUE);
+    ilm_commitChanges();
+
+    commitResult = ILM_FAILED;
+    commitUserData = NULL;
+    screenshotWidth = 0;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_captureStart(0, 1, &CaptureCallbackFunction, &token, &captureId));
+    assertCallbackcalled();
+    EXPECT_EQ(ILM_SUCCESS, commitResult);
+    EXPECT_EQ(&token, commitUserData);
+    EXPECT_GT(screenshotWidth, 0u);
+    EXPECT_EQ(0u, captureIndex);
+
+    // the only buffer is kept, further frames are dropped
+    ilm_layerSetOpacity(layer, 0.5);
+    ilm_commitChanges();
+    assertNoCallbackIsCalled();
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_captureReleaseFrame(captureId, captureIndex));
+    ilm_layerSetOpacity(layer, 1.0);
+    ilm_commitChanges();
+    assertCallbackcalled();
+    EXPECT_EQ(ILM_SUCCESS, commitResult);
+    EXPECT_GT(captureDropped, 0u);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_captureStop(captureId, &dropped));
+    EXPECT_EQ(captureDropped, dropped);
+    EXPECT_EQ(ILM_FAILED, ilm_captureStop(captureId, NULL));
+}
+
+TEST_F(NotificationTest, ilm_captureStart_InvalidInput)
+{
+    t_ilm_uint captureId = 0;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_captureStart(0, 1, NULL, NULL, &captureId));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_captureStart(0, 1, &CaptureCallbackFunction, NULL, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_captureStart(0, 0, &CaptureCallbackFunction, NULL, &captureId));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_captureStart(0, 17, &CaptureCallbackFunction, NULL, &captureId));
+    ASSERT_EQ(ILM_FAILED, ilm_captureStart(0xdeadbeef, 1, &CaptureCallbackFunction, NULL, &captureId));
+    ASSERT_EQ(ILM_FAILED, ilm_captureReleaseFrame(0xdeadbeef, 0));
+    ASSERT_EQ(ILM_FAILED, ilm_captureStop(0xdeadbeef, NULL));
+}
+
+TEST_F(NotificationTest, ilm_surfaceGetOpacityCached)
+{
+    t_ilm_float opacity = 0.0;
+    t_ilm_bool visibility = ILM_FALSE;
+    t_ilm_uint sequence = 0;
+    t_ilm_uint sequenceAfter = 0;
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_surfaceAddNotification(surface,&SurfaceCallbackFunction));
+    assertCallbackcalled();
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacityCached(surface, &opacity, &sequence));
+
+    ilm_surfaceSetOpacity(surface, 0.321);
+    ilm_surfaceSetVisibility(surface, ILM_TRUE);
+    ilm_commitChanges();
+    assertCallbackcalled(2);
+
+    // the mirror follows the notifications
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacityCached(surface, &opacity, &sequenceAfter));
+    EXPECT_NEAR(0.321, opacity, 0.01);
+    EXPECT_NE(sequence, sequenceAfter);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetVisibilityCached(surface, &visibility, &sequence));
+    EXPECT_EQ(ILM_TRUE, visibility);
+    EXPECT_EQ(sequenceAfter, sequence);
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_surfaceRemoveNotification(surface));
+}
+
+TEST_F(NotificationTest, ilm_layerGetVisibilityCached)
+{
+    t_ilm_bool visibility = ILM_FALSE;
+    t_ilm_float opacity = 0.0;
+    ilmLayerProperties properties;
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_layerAddNotification(layer,&LayerCallbackFunction));
+
+    ilm_layerSetVisibility(layer, ILM_TRUE);
+    ilm_layerSetOpacity(layer, 0.654);
+    ilm_commitChanges();
+    assertCallbackcalled(2);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetVisibilityCached(layer, &visibility, NULL));
+    EXPECT_EQ(ILM_TRUE, visibility);
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetOpacityCached(layer, &opacity, NULL));
+    EXPECT_NEAR(0.654, opacity, 0.01);
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayerCached(layer, &properties, NULL));
+    EXPECT_NEAR(0.654, properties.opacity, 0.01);
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_layerRemoveNotification(layer));
+
+    // without a notification the value is fetched from the compositor
+    ilm_layerSetOpacity(layer, 0.123);
+    ilm_commitChanges();
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerGetOpacityCached(layer, &opacity, NULL));
+    EXPECT_NEAR(0.123, opacity, 0.01);
+
+    ASSERT_EQ(ILM_FAILED, ilm_layerGetOpacityCached(0xdeadbeef, &opacity, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getPropertiesOfLayerCached(layer, NULL, NULL));
+}
+
+TEST_F(NotificationTest, NotifyOnLayerAllValuesCoalesced)
+{
+    ASSERT_EQ(ILM_SUCCESS,ilm_setNotificationCoalescing(ILM_TRUE));
+    ASSERT_EQ(ILM_SUCCESS,ilm_layerAddNotification(layer,&LayerCallbackFunction));
+    // change something
+    t_ilm_float opacity = 0.789;
+    ilm_layerSetOpacity(layer,opacity);
+    ilm_layerSetVisibility(layer,true);
+    ilm_layerSetDestinationRectangle(layer,133,1567,155,199);
+    ilm_layerSetSourceRectangle(layer,33,567,55,99);
+    ilm_commitChanges();
+
+    // expect a single callback with all changes, and nothing after it
+    assertCallbackcalled(1);
+    assertNoCallbackIsCalled();
+
+    EXPECT_EQ(layer,callbackLayerId);
+    EXPECT_EQ(33u,LayerProperties.sourceX);
+    EXPECT_EQ(99u,LayerProperties.sourceHeight);
+    EXPECT_TRUE(LayerProperties.visibility);
+    EXPECT_NEAR(opacity, LayerProperties.opacity, 0.1);
+    EXPECT_EQ(133u,LayerProperties.destX);
+    EXPECT_EQ(199u,LayerProperties.destHeight);
+    EXPECT_EQ(ILM_NOTIFICATION_DEST_RECT|ILM_NOTIFICATION_VISIBILITY|ILM_NOTIFICATION_OPACITY|ILM_NOTIFICATION_SOURCE_RECT,lastMask);
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_layerRemoveNotification(layer));
+    ASSERT_EQ(ILM_SUCCESS,ilm_setNotificationCoalescing(ILM_FALSE));
+}
+
+TEST_F(NotificationTest, NotifyOnSurfaceAllValuesCoalesced)
+{
+    ASSERT_EQ(ILM_SUCCESS,ilm_setNotificationCoalescing(ILM_TRUE));
+    ASSERT_EQ(ILM_SUCCESS,ilm_surfaceAddNotification(surface,&SurfaceCallbackFunction));
+
+    // content available on registration
+    assertCallbackcalled(1);
+    EXPECT_EQ(ILM_NOTIFICATION_CONTENT_AVAILABLE,lastMask);
+
+    // change something
+    t_ilm_float opacity = 0.789;
+    ilm_surfaceSetOpacity(surface,opacity);
+    ilm_surfaceSetVisibility(surface,true);
+    ilm_surfaceSetDestinationRectangle(surface,133,1567,155,199);
+    ilm_surfaceSetSourceRectangle(surface,33,567,55,99);
+    ilm_commitChanges();
+
+    // then a single callback with all changes, and nothing after it
+    assertCallbackcalled(1);
+    assertNoCallbackIsCalled();
+
+    EXPECT_EQ(surface,callbackSurfaceId);
+    EXPECT_EQ(33u,SurfaceProperties.sourceX);
+    EXPECT_EQ(99u,SurfaceProperties.sourceHeight);
+    EXPECT_TRUE(SurfaceProperties.visibility);
+    EXPECT_NEAR(opacity, SurfaceProperties.opacity, 0.1);
+    EXPECT_EQ(133u,SurfaceProperties.destX);
+    EXPECT_EQ(199u,SurfaceProperties.destHeight);
+    EXPECT_EQ(ILM_NOTIFICATION_DEST_RECT|ILM_NOTIFICATION_VISIBILITY|ILM_NOTIFICATION_OPACITY|
+              ILM_NOTIFICATION_SOURCE_RECT,lastMask);
+
+    ASSERT_EQ(ILM_SUCCESS,ilm_surfaceRemoveNotification(surface));
+    ASSERT_EQ(ILM_SUCCESS,ilm_setNotificationCoalescing(ILM_FALSE));
+}
+
+TEST_F(NotificationTest, NotificationQueue)
+{
+    t_ilm_int fd = -1;
+    t_ilm_uint count = 0;
+    t_ilm_uint delivered = 0;
+    t_ilm_uint dropped = 0;
+
+    ASSERT_EQ(ILM_FAILED, ilm_useNotificationQueue(16, ILM_FALSE));
+    ASSERT_EQ(ILM_FAILED, ilm_getNotificationFd(&fd));
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_useNotificationQueue(0x20000, ILM_FALSE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_useNotificationQueue(16, ILM_FALSE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getNotificationFd(&fd));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerAddNotification(layer,&LayerCallbackFunction));
+    ilm_layerSetOpacity(layer, 0.321);
+    ilm_commitChanges();
+
+    // nothing is invoked until the application asks for it
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    ASSERT_EQ(1, poll(&pfd, 1, 500));
+    ASSERT_EQ(0, timesCalled);
+    ASSERT_EQ(ILM_SUCCESS, ilm_dispatchNotifications(&count));
+    EXPECT_EQ(1u, count);
+    assertCallbackcalled(1);
+    EXPECT_EQ(layer, callbackLayerId);
+    EXPECT_NEAR(0.321, LayerProperties.opacity, 0.01);
+    EXPECT_EQ(ILM_NOTIFICATION_OPACITY, mask);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getNotificationQueueStats(&delivered, &dropped));
+    EXPECT_EQ(1u, delivered);
+    EXPECT_EQ(0u, dropped);
+
+    // notifications queued for a removed callback are discarded
+    ilm_layerSetOpacity(layer, 0.5);
+    ilm_commitChanges();
+    ASSERT_EQ(1, poll(&pfd, 1, 500));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerRemoveNotification(layer));
+    ASSERT_EQ(ILM_SUCCESS, ilm_dispatchNotifications(&count));
+    EXPECT_EQ(0u, count);
+    EXPECT_EQ(0, timesCalled);
+
+    // the initial notification of a surface is queued as well
+    mask = 0;
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(surface,&SurfaceCallbackFunction));
+    EXPECT_EQ(0, timesCalled);
+    ASSERT_EQ(ILM_SUCCESS, ilm_dispatchNotifications(&count));
+    EXPECT_EQ(1u, count);
+    EXPECT_EQ(1, timesCalled);
+    EXPECT_EQ(surface, callbackSurfaceId);
+    EXPECT_EQ(ILM_NOTIFICATION_CONTENT_AVAILABLE, mask);
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceRemoveNotification(surface));
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+    ASSERT_EQ(ILM_SUCCESS, ilm_useNotificationQueue(0, ILM_FALSE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+}
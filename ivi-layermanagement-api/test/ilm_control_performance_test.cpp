@@ -0,0 +1,1096 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TestBase.h"
+#include "TestImage.h"
+#include "swizzle.h"
+#include "ivi-flip.h"
+
+extern "C" {
+    #include "ilm_control.h"
+}
+
+/* Benchmarks of the ilmControl client side. They are run against a live
+ * compositor like the other tests, and print their timings to stdout.
+ * They are part of the sanitized test binary run by ctest, so timings are
+ * only printed, never compared; only functional results are checked.
+ */
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+class PerformanceTest : public TestBase, public ::testing::Test {
+public:
+    void SetUp()
+    {
+    }
+
+    void TearDown()
+    {
+        destroySurfaces();
+    }
+
+protected:
+    static const t_ilm_uint surfaceIdBase = 0x10000;
+
+    void createSurfaces(int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            struct iviSurface surf;
+            wl_surface *wlSurface = wl_compositor_create_surface(wlCompositor);
+
+            surf.surface_id = surfaceIdBase + i;
+            surf.surface = ivi_application_surface_create(iviApp,
+                                                          surf.surface_id,
+                                                          wlSurface);
+            perfWlSurfaces.push_back(wlSurface);
+            iviSurfaces.push_back(surf);
+        }
+
+        wl_display_roundtrip(wlDisplay);
+    }
+
+    void destroySurfaces()
+    {
+        for (std::vector<iviSurface>::reverse_iterator it = iviSurfaces.rbegin();
+             it != iviSurfaces.rend();
+             ++it)
+        {
+            ivi_surface_destroy((*it).surface);
+        }
+        iviSurfaces.clear();
+
+        for (std::vector<wl_surface *>::reverse_iterator it = perfWlSurfaces.rbegin();
+             it != perfWlSurfaces.rend();
+             ++it)
+        {
+            wl_surface_destroy(*it);
+        }
+        perfWlSurfaces.clear();
+
+        wl_display_roundtrip(wlDisplay);
+    }
+
+    std::vector<wl_surface *> perfWlSurfaces;
+};
+
+/* Connecting makes the compositor replay one surface_created event per
+ * surface, each of which is resolved by id on the client side. With the id
+ * index the cost per surface stays flat as the scene grows.
+ */
+TEST_F(PerformanceTest, SurfaceEventDispatchScaling) {
+    static const int counts[] = { 10, 100, 1000, 10000 };
+    static const int numCounts = sizeof(counts) / sizeof(counts[0]);
+    double nsPerSurface[numCounts];
+
+    for (int c = 0; c < numCounts; ++c)
+    {
+        t_ilm_int length = 0;
+        t_ilm_surface *ids = NULL;
+
+        createSurfaces(counts[c]);
+
+        uint64_t start = now_ns();
+        ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+        uint64_t elapsed = now_ns() - start;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceIDs(&length, &ids));
+        EXPECT_GE(length, counts[c]);
+        free(ids);
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+        destroySurfaces();
+
+        nsPerSurface[c] = (double)elapsed / counts[c];
+        printf("%6d surfaces: %10.1f ns per surface, %5.2fx the previous scene\n",
+               counts[c], nsPerSurface[c],
+               c > 0 ? nsPerSurface[c] / nsPerSurface[c - 1] : 1.0);
+    }
+}
+
+/* Every controller request resolves its surface in the compositor. With
+ * the registry of ivi-controller the cost per request must stay flat while
+ * the scene grows; a headless compositor, e.g. weston with
+ * --backend=headless-backend.so, keeps rendering out of the timings. The
+ * first surface created is the last one a list walk would reach.
+ */
+TEST_F(PerformanceTest, CompositorSurfaceLookupScaling) {
+    static const int counts[] = { 100, 1000, 4000 };
+    static const int numCounts = sizeof(counts) / sizeof(counts[0]);
+    static const int requests = 2000;
+    double nsPerRequest[numCounts];
+
+    for (int c = 0; c < numCounts; ++c)
+    {
+        ilmSurfaceProperties properties;
+
+        createSurfaces(counts[c]);
+        ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+        t_ilm_surface id = iviSurfaces[0].surface_id;
+
+        uint64_t start = now_ns();
+        for (int r = 0; r < requests; ++r)
+        {
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, (r & 1) ? 1.0 : 0.5));
+        }
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(id, &properties));
+        uint64_t elapsed = now_ns() - start;
+
+        // the requests reached the surface the registry resolved
+        EXPECT_NEAR(1.0, properties.opacity, 0.01);
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+        destroySurfaces();
+
+        /* a list walk would grow forty times from the first to the last scene */
+        nsPerRequest[c] = (double)elapsed / requests;
+        printf("%6d surfaces: %10.1f ns per request, %5.2fx the first scene\n",
+               counts[c], nsPerRequest[c], nsPerRequest[c] / nsPerRequest[0]);
+    }
+}
+
+/* Reading the properties of a scene one object at a time costs one
+ * roundtrip per object, the bulk query queues all requests behind a single
+ * roundtrip.
+ */
+TEST_F(PerformanceTest, BulkSurfacePropertyQuery) {
+    static const int count = 500;
+    std::vector<t_ilm_surface> ids(count);
+    std::vector<ilmSurfaceProperties> properties(count);
+
+    createSurfaces(count);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    for (int i = 0; i < count; ++i)
+    {
+        ids[i] = iviSurfaces[i].surface_id;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(ids[i], &properties[i]));
+    }
+    uint64_t singleNs = now_ns() - start;
+
+    std::vector<ilmSurfaceProperties> bulk(count);
+    start = now_ns();
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaces(count, &ids[0], &bulk[0]));
+    uint64_t bulkNs = now_ns() - start;
+
+    for (int i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(properties[i].destWidth, bulk[i].destWidth);
+        EXPECT_EQ(properties[i].creatorPid, bulk[i].creatorPid);
+    }
+
+    printf("%d surfaces: %10.1f us one by one, %10.1f us bulk\n",
+           count, singleNs / 1000.0, bulkNs / 1000.0);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* Capturing the whole scene with the per object getters costs several
+ * roundtrips per object, the scene snapshot is delivered in one exchange.
+ */
+TEST_F(PerformanceTest, SceneSnapshot) {
+    static const int count = 500;
+    ilmScene *scene = NULL;
+
+    createSurfaces(count);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    t_ilm_int surfaceCount = 0;
+    t_ilm_int layerCount = 0;
+    uint64_t start = now_ns();
+    {
+        t_ilm_surface *surfaceIds = NULL;
+        t_ilm_layer *layerIds = NULL;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceIDs(&surfaceCount, &surfaceIds));
+        for (t_ilm_int i = 0; i < surfaceCount; ++i)
+        {
+            ilmSurfaceProperties properties;
+            ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surfaceIds[i], &properties));
+        }
+        free(surfaceIds);
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_getLayerIDs(&layerCount, &layerIds));
+        for (t_ilm_int i = 0; i < layerCount; ++i)
+        {
+            ilmLayerProperties properties;
+            t_ilm_int length = 0;
+            t_ilm_surface *ids = NULL;
+
+            ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layerIds[i], &properties));
+            ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceIDsOnLayer(layerIds[i], &length, &ids));
+            free(ids);
+        }
+        free(layerIds);
+    }
+    uint64_t perCallNs = now_ns() - start;
+
+    start = now_ns();
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScene(&scene));
+    uint64_t snapshotNs = now_ns() - start;
+
+    EXPECT_GE(scene->surfaceCount, (t_ilm_uint)count);
+    EXPECT_EQ((t_ilm_uint)surfaceCount, scene->surfaceCount);
+    EXPECT_EQ((t_ilm_uint)layerCount, scene->layerCount);
+    free(scene);
+
+    printf("%d surfaces: %10.1f us per call, %10.1f us snapshot\n",
+           count, perCallNs / 1000.0, snapshotNs / 1000.0);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* The scene snapshot still costs an exchange with the compositor, reading
+ * the scene it publishes in shared memory costs none.
+ */
+TEST_F(PerformanceTest, SceneMirror) {
+    static const int count = 500;
+    static const int rounds = 20;
+    ilmScene *scene = NULL;
+
+    createSurfaces(count);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    // the first read maps the memory
+    ASSERT_EQ(ILM_SUCCESS, ilm_getSceneFromMirror(&scene));
+    EXPECT_GE(scene->surfaceCount, (t_ilm_uint)count);
+    free(scene);
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; ++r)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_getScene(&scene));
+        free(scene);
+    }
+    uint64_t snapshotNs = (now_ns() - start) / rounds;
+
+    start = now_ns();
+    for (int r = 0; r < rounds; ++r)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_getSceneFromMirror(&scene));
+        free(scene);
+    }
+    uint64_t mirrorNs = (now_ns() - start) / rounds;
+
+    ilmSurfaceProperties properties;
+    start = now_ns();
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaceFromMirror(
+                                   iviSurfaces[i].surface_id, &properties));
+    }
+    uint64_t lookupNs = (now_ns() - start) / count;
+
+    printf("%d surfaces: %10.1f us snapshot, %10.1f us mirror, %8.2f us per surface lookup\n",
+           count, snapshotNs / 1000.0, mirrorNs / 1000.0, lookupNs / 1000.0);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* A scene transition touching many properties costs one flush per setter,
+ * inside a transaction the sets are collapsed and sent with a single flush.
+ */
+TEST_F(PerformanceTest, TransactionBatching) {
+    static const int count = 50;
+    static const int rounds = 4;
+    t_ilm_uint recorded = 0, sent = 0;
+
+    createSurfaces(count);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            t_ilm_surface id = iviSurfaces[i].surface_id;
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, 0.25 * r));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(id, ILM_TRUE));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(id, r, r, 100, 100));
+        }
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    uint64_t directNs = now_ns() - start;
+
+    start = now_ns();
+    ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            t_ilm_surface id = iviSurfaces[i].surface_id;
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, 0.25 * r));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(id, ILM_TRUE));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(id, r, r, 100, 100));
+        }
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+    uint64_t transactionNs = now_ns() - start;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getTransactionStats(&recorded, &sent));
+    EXPECT_EQ((t_ilm_uint)(count * rounds * 3), recorded);
+    EXPECT_EQ((t_ilm_uint)(count * 3), sent);
+
+    printf("%d sets: %10.1f us direct, %10.1f us in a transaction, %u requests sent\n",
+           count * rounds * 3, directNs / 1000.0, transactionNs / 1000.0, sent);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+static void surfaceCallback(t_ilm_surface, struct ilmSurfaceProperties*,
+                            t_ilm_notification_mask)
+{
+}
+
+/* A subscribed surface is kept current by notifications, reading it from
+ * the local mirror avoids the roundtrip of the regular getters.
+ */
+TEST_F(PerformanceTest, CachedGetters) {
+    static const int reads = 1000;
+    t_ilm_float opacity;
+
+    createSurfaces(1);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    t_ilm_surface id = iviSurfaces[0].surface_id;
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(id, &surfaceCallback));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < reads; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(id, &opacity));
+    }
+    uint64_t roundtripNs = now_ns() - start;
+
+    t_ilm_float cachedOpacity = -1.0;
+    start = now_ns();
+    for (int i = 0; i < reads; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacityCached(id, &cachedOpacity, NULL));
+    }
+    uint64_t cachedNs = now_ns() - start;
+
+    EXPECT_FLOAT_EQ(opacity, cachedOpacity);
+
+    printf("%d reads: %10.1f ns per roundtrip read, %10.1f ns per cached read\n",
+           reads, (double)roundtripNs / reads, (double)cachedNs / reads);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceRemoveNotification(id));
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+struct ContentionReader {
+    pthread_t thread;
+    t_ilm_surface surface;
+    int reads;
+    int failures;
+    uint64_t elapsedNs;
+};
+
+static void* contentionReaderThread(void* data)
+{
+    ContentionReader* reader = static_cast<ContentionReader*>(data);
+    t_ilm_float opacity;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < reader->reads; ++i)
+    {
+        if (ilm_surfaceGetOpacityCached(reader->surface, &opacity, NULL) != ILM_SUCCESS)
+            reader->failures++;
+    }
+    reader->elapsedNs = now_ns() - start;
+
+    return NULL;
+}
+
+/* Several threads read a subscribed surface while another one keeps the
+ * context busy with commits. The readers only share the mirror lock, so a
+ * read stays far cheaper than a roundtrip; every read must succeed.
+ */
+TEST_F(PerformanceTest, CachedGetterContention) {
+    static const int numReaders = 5;
+    static const int reads = 20000;
+    static const int commits = 200;
+    static const int roundtripReads = 100;
+    ContentionReader readers[numReaders];
+    t_ilm_float opacity;
+
+    createSurfaces(1);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    t_ilm_surface id = iviSurfaces[0].surface_id;
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(id, &surfaceCallback));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < roundtripReads; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(id, &opacity));
+    }
+    double roundtripNs = (double)(now_ns() - start) / roundtripReads;
+
+    for (int t = 0; t < numReaders; ++t)
+    {
+        readers[t].surface = id;
+        readers[t].reads = reads;
+        readers[t].failures = 0;
+        readers[t].elapsedNs = 0;
+        ASSERT_EQ(0, pthread_create(&readers[t].thread, NULL,
+                                    contentionReaderThread, &readers[t]));
+    }
+
+    for (int i = 0; i < commits; ++i)
+    {
+        EXPECT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, (i & 1) ? 0.5 : 1.0));
+        EXPECT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    }
+
+    double cachedNs = 0.0;
+    for (int t = 0; t < numReaders; ++t)
+    {
+        pthread_join(readers[t].thread, NULL);
+        EXPECT_EQ(0, readers[t].failures);
+        cachedNs += (double)readers[t].elapsedNs / reads;
+    }
+    cachedNs /= numReaders;
+
+    printf("%d readers: %10.1f ns per cached read under contention, "
+           "%10.1f ns per roundtrip read\n",
+           numReaders, cachedNs, roundtripNs);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceRemoveNotification(id));
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* Layers created without an id get one from the client side allocator, and
+ * the ids of destroyed layers are handed out again. Each create includes a
+ * roundtrip to the compositor, which dominates the time printed here, so it
+ * is reported but not compared.
+ */
+TEST_F(PerformanceTest, LayerCreateWithGeneratedId) {
+    static const int count = 10000;
+    static const int window = 1000;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    std::vector<t_ilm_layer> layers(count);
+    uint64_t firstNs = 0;
+    uint64_t lastNs = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        layers[i] = INVALID_ID;
+        uint64_t start = now_ns();
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layers[i], 100, 100));
+        uint64_t elapsed = now_ns() - start;
+        if (i < window)
+            firstNs += elapsed;
+        else if (i >= count - window)
+            lastNs += elapsed;
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerRemove(layers[i]));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    uint64_t removeNs = now_ns() - start;
+
+    /* every id given back is used again before the counter moves on */
+    t_ilm_layer highest = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (layers[i] > highest)
+            highest = layers[i];
+    }
+
+    t_ilm_layer reused = INVALID_ID;
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&reused, 100, 100));
+    EXPECT_LE(reused, highest);
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerRemove(reused));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    printf("%d layers: %10.1f us per create and roundtrip (first %d), "
+           "%10.1f us per create and roundtrip (last %d), %10.1f us per remove\n",
+           count, firstNs / 1000.0 / window, window,
+           lastNs / 1000.0 / window, window, removeNs / 1000.0 / count);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+static unsigned int sceneSwitchCalls;
+
+static void countingSurfaceCallback(t_ilm_surface, struct ilmSurfaceProperties*,
+                                    t_ilm_notification_mask)
+{
+    __sync_fetch_and_add(&sceneSwitchCalls, 1);
+}
+
+static uint64_t cpu_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Every scene switch changes four properties of each surface. Callbacks are
+ * invoked once per property, or once per surface when coalescing.
+ */
+static void runSceneSwitches(const std::vector<TestBase::iviSurface>& surfaces,
+                             int rounds, unsigned int* calls, uint64_t* cpuNs)
+{
+    /* a getter syncs, so all notifications of the last commit are in */
+    t_ilm_float opacity;
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surfaces[0].surface_id, &opacity));
+
+    __sync_lock_test_and_set(&sceneSwitchCalls, 0);
+    uint64_t start = cpu_ns();
+    for (int r = 1; r <= rounds; ++r)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+        for (size_t i = 0; i < surfaces.size(); ++i)
+        {
+            t_ilm_surface id = surfaces[i].surface_id;
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, (r % 2) ? 0.5 : 1.0));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(id, (r % 2) ? ILM_TRUE : ILM_FALSE));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetSourceRectangle(id, 0, 0, 100 + r, 100));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(id, r, r, 100, 100));
+        }
+        ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+        ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surfaces[0].surface_id, &opacity));
+    }
+    *cpuNs = cpu_ns() - start;
+    *calls = __sync_fetch_and_add(&sceneSwitchCalls, 0);
+}
+
+TEST_F(PerformanceTest, CoalescedNotifications) {
+    static const int count = 50;
+    static const int rounds = 20;
+    unsigned int perEventCalls, coalescedCalls;
+    uint64_t perEventNs, coalescedNs;
+
+    createSurfaces(count);
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(iviSurfaces[i].surface_id,
+                                                          &countingSurfaceCallback));
+    }
+
+    runSceneSwitches(iviSurfaces, rounds, &perEventCalls, &perEventNs);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_setNotificationCoalescing(ILM_TRUE));
+    runSceneSwitches(iviSurfaces, rounds, &coalescedCalls, &coalescedNs);
+    ASSERT_EQ(ILM_SUCCESS, ilm_setNotificationCoalescing(ILM_FALSE));
+
+    printf("%d surfaces: %8.1f calls, %10.1f us cpu per scene switch; "
+           "coalesced %8.1f calls, %10.1f us cpu\n",
+           count, (double)perEventCalls / rounds, perEventNs / 1000.0 / rounds,
+           (double)coalescedCalls / rounds, coalescedNs / 1000.0 / rounds);
+    EXPECT_EQ((unsigned int)(count * rounds * 4), perEventCalls);
+    EXPECT_EQ((unsigned int)(count * rounds), coalescedCalls);
+
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceRemoveNotification(iviSurfaces[i].surface_id));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+static void slowSurfaceCallback(t_ilm_surface, struct ilmSurfaceProperties*,
+                                t_ilm_notification_mask)
+{
+    /* stands in for layout work of the application */
+    uint64_t end = now_ns() + 20000;
+    while (now_ns() < end)
+        ;
+    __sync_fetch_and_add(&sceneSwitchCalls, 1);
+}
+
+static uint64_t runOpacityCommits(const std::vector<TestBase::iviSurface>& surfaces,
+                                  int rounds)
+{
+    t_ilm_float opacity;
+    uint64_t start = now_ns();
+
+    for (int r = 1; r <= rounds; ++r)
+    {
+        for (size_t i = 0; i < surfaces.size(); ++i)
+        {
+            EXPECT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surfaces[i].surface_id,
+                                                         (r % 2) ? 0.5 : 1.0));
+        }
+        EXPECT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    }
+    /* a getter syncs, so all events of the last commit are dispatched */
+    EXPECT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surfaces[0].surface_id, &opacity));
+
+    return now_ns() - start;
+}
+
+/* With a slow callback, direct delivery holds up dispatching and with it
+ * every ilm call waiting for the compositor. Queued, dispatching only
+ * copies records, and the callbacks run later in ilm_dispatchNotifications.
+ */
+TEST_F(PerformanceTest, NotificationQueueThroughput) {
+    static const int count = 20;
+    static const int rounds = 100;
+    static const unsigned int expected = count * rounds;
+    t_ilm_uint delivered = 0;
+    t_ilm_uint dropped = 0;
+    t_ilm_uint dispatched = 0;
+
+    createSurfaces(count);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(iviSurfaces[i].surface_id,
+                                                          &slowSurfaceCallback));
+    }
+    __sync_lock_test_and_set(&sceneSwitchCalls, 0);
+    uint64_t directNs = runOpacityCommits(iviSurfaces, rounds);
+    EXPECT_EQ(expected, __sync_fetch_and_add(&sceneSwitchCalls, 0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+
+    // without a worker, so the test thread drains the queue itself
+    ASSERT_EQ(ILM_SUCCESS, ilm_useNotificationQueue(4096, ILM_FALSE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceAddNotification(iviSurfaces[i].surface_id,
+                                                          &slowSurfaceCallback));
+    }
+    // the content available notifications of the registration
+    ASSERT_EQ(ILM_SUCCESS, ilm_dispatchNotifications(NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getNotificationQueueStats(&delivered, &dropped));
+    t_ilm_uint deliveredBefore = delivered;
+    t_ilm_uint droppedBefore = dropped;
+
+    __sync_lock_test_and_set(&sceneSwitchCalls, 0);
+    uint64_t queuedNs = runOpacityCommits(iviSurfaces, rounds);
+    EXPECT_EQ(0u, __sync_fetch_and_add(&sceneSwitchCalls, 0));
+
+    // all events are dispatched, so the queue holds every notification
+    uint64_t start = now_ns();
+    ASSERT_EQ(ILM_SUCCESS, ilm_dispatchNotifications(&dispatched));
+    uint64_t drainNs = now_ns() - start;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getNotificationQueueStats(&delivered, &dropped));
+    delivered -= deliveredBefore;
+    dropped -= droppedBefore;
+
+    printf("%u notifications: %10.1f us dispatching directly, %10.1f us "
+           "dispatching queued, %10.1f notifications/s delivered, %u dropped\n",
+           expected, directNs / 1000.0, queuedNs / 1000.0,
+           delivered * 1e9 / drainNs, dropped);
+    EXPECT_EQ(expected, delivered + dropped);
+    EXPECT_EQ(delivered, dispatched);
+    EXPECT_EQ(delivered, __sync_fetch_and_add(&sceneSwitchCalls, 0));
+
+    for (int i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceRemoveNotification(iviSurfaces[i].surface_id));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+    ASSERT_EQ(ILM_SUCCESS, ilm_useNotificationQueue(0, ILM_FALSE));
+}
+
+/* A screenshot kept in memory skips the encoding to a file. */
+TEST_F(PerformanceTest, ScreenshotToMemory) {
+    static const int shots = 10;
+    const char* outputFile = "/tmp/perf_screenshot.bmp";
+    struct ilmScreenshot image;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < shots; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshot(0, outputFile));
+    }
+    uint64_t fileNs = now_ns() - start;
+    remove(outputFile);
+
+    start = now_ns();
+    for (int i = 0; i < shots; ++i)
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotToMemory(0, &image));
+        EXPECT_TRUE(image.buffer != NULL);
+        EXPECT_GE(image.stride, image.width * 4);
+        EXPECT_GE(image.size, image.stride * image.height);
+        ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+    }
+    uint64_t memoryNs = now_ns() - start;
+
+    printf("%d screenshots: %10.1f us per bmp file, %10.1f us in memory\n",
+           shots, fileNs / 1000.0 / shots, memoryNs / 1000.0 / shots);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* The compositor recycles a released screenshot buffer for the next
+ * capture instead of creating and faulting in a new file each time.
+ */
+TEST_F(PerformanceTest, ScreenshotBufferReuse) {
+    static const int shots = 100;
+    struct ilmScreenshot image;
+    struct stat previous = {};
+    int reused = 0;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < shots; ++i)
+    {
+        struct stat st;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotToMemory(0, &image));
+        ASSERT_EQ(0, fstat(image.fd, &st));
+        if (i > 0 && st.st_ino == previous.st_ino && st.st_dev == previous.st_dev)
+            ++reused;
+        previous = st;
+        ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+    }
+    uint64_t ns = now_ns() - start;
+
+    printf("%d screenshots: %10.1f captures per second, %d buffers reused\n",
+           shots, shots * 1e9 / ns, reused);
+    EXPECT_EQ(shots - 1, reused);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
+
+/* Encoding a screenshot as png used to run libpng row by row on the
+ * calling thread. The parallel encoder compresses stripes of rows on all
+ * cpus. The image is synthetic, so no compositor round trip is measured.
+ */
+static uint64_t encodePng(const struct ilmScreenshot* image, const char* file,
+                          t_ilm_uint threads, int runs)
+{
+    EXPECT_EQ(ILM_SUCCESS, ilm_setScreenshotPngOptions(-1, ILM_PNG_FILTER_ADAPTIVE, threads));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < runs; ++i)
+    {
+        EXPECT_EQ(ILM_SUCCESS, ilm_saveScreenshot(image, file));
+    }
+    return (now_ns() - start) / runs;
+}
+
+TEST_F(PerformanceTest, PngEncoding) {
+    static const t_ilm_uint sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    static const int runs = 3;
+    const char* outputFile = "/tmp/perf_screenshot.png";
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; ++s)
+    {
+        t_ilm_uint width = sizes[s][0];
+        t_ilm_uint height = sizes[s][1];
+        std::vector<uint32_t> pixels(width * height);
+
+        // gradients with some noise, closer to a screen than random data
+        for (t_ilm_uint y = 0; y < height; ++y)
+        {
+            for (t_ilm_uint x = 0; x < width; ++x)
+            {
+                pixels[y * width + x] = 0xff000000u | ((x * 255 / width) << 16) |
+                                        ((y * 255 / height) << 8) | ((x ^ y) & 0x0f);
+            }
+        }
+
+        struct ilmScreenshot image = wrapImage(pixels, width, height);
+
+        uint64_t serialNs = encodePng(&image, outputFile, 1, runs);
+        uint64_t parallelNs = encodePng(&image, outputFile, 0, runs);
+
+        double megabytes = image.size / 1e6;
+        printf("png %ux%u: %8.1f MB/s libpng, %8.1f MB/s on %ld cpus\n",
+               width, height, megabytes / (serialNs / 1e9),
+               megabytes / (parallelNs / 1e9), cpus);
+    }
+
+    remove(outputFile);
+    ASSERT_EQ(ILM_SUCCESS, ilm_setScreenshotPngOptions(-1, ILM_PNG_FILTER_ADAPTIVE, 0));
+}
+
+/* Pixel conversion of a 4K frame to png and bmp byte order, for every
+ * kernel the cpu supports.
+ */
+TEST_F(PerformanceTest, SwizzleThroughput) {
+    static const char* kernelNames[SWIZZLE_KERNEL_COUNT] = { "scalar", "ssse3", "avx2", "neon" };
+    static const uint32_t formats[] = { WL_SHM_FORMAT_ARGB8888, WL_SHM_FORMAT_XRGB8888 };
+    static const int width = 3840;
+    static const int height = 2160;
+    static const int runs = 5;
+
+    std::vector<uint32_t> pixels(width * height, 0x80402010u);
+    std::vector<unsigned char> out(width * height * 4);
+
+    for (size_t f = 0; f < sizeof formats / sizeof formats[0]; ++f)
+    {
+        for (int order = SWIZZLE_ORDER_RGB; order <= SWIZZLE_ORDER_BGR; ++order)
+        {
+            uint64_t scalarNs = 0;
+
+            for (int kernel = SWIZZLE_KERNEL_SCALAR; kernel < SWIZZLE_KERNEL_COUNT; ++kernel)
+            {
+                swizzle_func swizzle = get_swizzle_func(formats[f], (swizzle_order)order, (swizzle_kernel)kernel);
+                if (swizzle == NULL)
+                {
+                    continue;
+                }
+
+                int bpp = swizzle_bytes_per_pixel(formats[f]);
+                uint64_t start = now_ns();
+                for (int r = 0; r < runs; ++r)
+                {
+                    for (int y = 0; y < height; ++y)
+                    {
+                        swizzle(&pixels[y * width], &out[y * width * bpp], width);
+                    }
+                }
+                uint64_t ns = (now_ns() - start) / runs;
+                if (kernel == SWIZZLE_KERNEL_SCALAR)
+                {
+                    scalarNs = ns;
+                }
+
+                printf("swizzle 0x%08x to %s with %-6s: %8.1f MB/s, %5.2fx scalar\n",
+                       formats[f], order == SWIZZLE_ORDER_RGB ? "rgb" : "bgr",
+                       kernelNames[kernel], width * height * 4 / 1e6 / (ns / 1e9),
+                       (double)scalarNs / ns);
+            }
+        }
+    }
+}
+
+/* The compositor turns frames read back bottom up in place. The old loop
+ * swapped one pixel at a time, memcpy through a scratch chunk is checked
+ * against it on 1080p and 4K frames.
+ */
+static void flip_rows_per_pixel(uint32_t* data, int width, int height)
+{
+    for (int y = 0; y < height / 2; ++y)
+    {
+        uint32_t* top = &data[y * width];
+        uint32_t* bottom = &data[(height - y - 1) * width];
+        for (int x = 0; x < width; ++x)
+        {
+            uint32_t tmp = top[x];
+            top[x] = bottom[x];
+            bottom[x] = tmp;
+        }
+    }
+}
+
+TEST_F(PerformanceTest, FlipRows) {
+    static const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    static const int runs = 10;
+
+    for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; ++s)
+    {
+        const int width = sizes[s][0];
+        const int height = sizes[s][1];
+        std::vector<uint32_t> expected(width * height);
+        std::vector<uint32_t> pixels(width * height);
+
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            expected[i] = pixels[i] = (uint32_t)(i * 2654435761u);
+        }
+
+        // the timed loops flip an even number of times, so check one flip
+        std::vector<uint32_t> flipped(width * height);
+        for (int y = 0; y < height; ++y)
+        {
+            std::copy(pixels.begin() + (height - 1 - y) * width,
+                      pixels.begin() + (height - y) * width,
+                      flipped.begin() + y * width);
+        }
+
+        ivi_flip_rows(pixels.data(), width * 4, height);
+        ASSERT_TRUE(flipped == pixels);
+        flip_rows_per_pixel(expected.data(), width, height);
+        ASSERT_TRUE(flipped == expected);
+
+        uint64_t start = now_ns();
+        for (int r = 0; r < runs; ++r)
+        {
+            flip_rows_per_pixel(expected.data(), width, height);
+        }
+        uint64_t pixelNs = (now_ns() - start) / runs;
+
+        start = now_ns();
+        for (int r = 0; r < runs; ++r)
+        {
+            ivi_flip_rows(pixels.data(), width * 4, height);
+        }
+        uint64_t rowNs = (now_ns() - start) / runs;
+
+        ASSERT_TRUE(expected == pixels);
+        printf("flip %dx%d: %8.1f us per pixel swap, %8.1f us per row memcpy, %5.2fx\n",
+               width, height, pixelNs / 1000.0, rowNs / 1000.0,
+               (double)pixelNs / rowNs);
+    }
+}
+
+/* Encode time and file size of every screenshot format on a frame that
+ * looks like an HMI: flat panels, soft gradients, and small high-contrast
+ * details like text and icons.
+ */
+TEST_F(PerformanceTest, ScreenshotFormats) {
+    static const char* files[] = {
+        "/tmp/perf_format.bmp", "/tmp/perf_format.png", "/tmp/perf_format.qoi",
+        "/tmp/perf_format.lz4", "/tmp/perf_format.raw",
+    };
+    static const t_ilm_uint width = 1920;
+    static const t_ilm_uint height = 1080;
+    static const int runs = 3;
+
+    std::vector<uint32_t> pixels(width * height);
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < width; ++x)
+        {
+            uint32_t value;
+            if (y < 80)
+            {
+                value = 0xff1c1f24u;                        // status bar
+            }
+            else if (x < 320)
+            {
+                value = 0xff262a31u + ((y / 120 % 2) << 3); // side menu
+            }
+            else
+            {
+                uint32_t shade = (y - 80) * 96 / (height - 80);
+                value = 0xff000000u | (shade << 16) | (shade << 8) | (shade + 48);
+            }
+
+            // glyph-sized details in rows, as menu entries and labels
+            if ((y % 120) > 40 && (y % 120) < 64 && (x % 400) < 220 &&
+                ((x * 7 + y * 3) % 5) < 2)
+            {
+                value = 0xffe8e8e8u;
+            }
+            pixels[y * width + x] = value;
+        }
+    }
+
+    struct ilmScreenshot image = wrapImage(pixels, width, height);
+
+    for (size_t i = 0; i < sizeof files / sizeof files[0]; ++i)
+    {
+        uint64_t start = now_ns();
+        for (int r = 0; r < runs; ++r)
+        {
+            ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, files[i]));
+        }
+        uint64_t ns = (now_ns() - start) / runs;
+
+        struct stat st;
+        ASSERT_EQ(0, stat(files[i], &st));
+        printf("%-22s %9.2f ms %10lld bytes (%5.1f%% of raw)\n", files[i], ns / 1e6,
+               (long long)st.st_size, st.st_size * 100.0 / image.size);
+        remove(files[i]);
+    }
+}
+
+/* Monitoring a mostly static HMI with one screenshot per second: only a
+ * clock and a progress bar change between the frames, so the deltas are
+ * a small part of the full frame. The frames are synthetic, only the
+ * ilm context is needed.
+ */
+TEST_F(PerformanceTest, ScreenshotDelta) {
+    static const t_ilm_uint width = 1920;
+    static const t_ilm_uint height = 1080;
+    static const t_ilm_uint tileSize = 64;
+    static const int frames = 10;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+
+    std::vector<uint32_t> pixels(width * height);
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < width; ++x)
+        {
+            pixels[y * width + x] = 0xff000000u | ((x * 255 / width) << 16) |
+                                    ((y * 255 / height) << 8) | 0x30;
+        }
+    }
+
+    struct ilmScreenshot image = wrapImage(pixels, width, height);
+
+    struct ilmScreenshotDelta delta;
+    ASSERT_EQ(ILM_SUCCESS, ilm_computeScreenshotDelta(&image, 0, tileSize, &delta));
+    EXPECT_EQ(image.size, delta.tilesSize);
+    t_ilm_uint baseId = delta.id;
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshotDelta(&delta));
+
+    uint64_t deltaBytes = 0;
+    uint64_t start = now_ns();
+    for (int frame = 1; frame <= frames; ++frame)
+    {
+        // the clock in the status bar
+        for (t_ilm_uint y = 20; y < 60; ++y)
+        {
+            for (t_ilm_uint x = 1800; x < 1900; ++x)
+            {
+                pixels[y * width + x] = 0xff000000u | (frame * 0x1f1f1f);
+            }
+        }
+        // a progress bar growing by a few pixels
+        for (t_ilm_uint y = 900; y < 910; ++y)
+        {
+            pixels[y * width + 400 + frame * 5] = 0xffffffffu;
+        }
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_computeScreenshotDelta(&image, baseId, tileSize, &delta));
+        deltaBytes += delta.tilesSize + delta.tilesX * delta.tilesY;
+        baseId = delta.id;
+        ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshotDelta(&delta));
+    }
+    uint64_t ns = (now_ns() - start) / frames;
+
+    printf("delta of %ux%u in %u px tiles: %8.1f us, %8.1f KB instead of %8.1f KB\n",
+           width, height, tileSize, ns / 1e3, deltaBytes / 1e3 / frames, image.size / 1e3);
+    EXPECT_LT(deltaBytes / frames * 10, (uint64_t)image.size);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_destroy());
+}
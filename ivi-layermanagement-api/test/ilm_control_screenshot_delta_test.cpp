@@ -0,0 +1,211 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "TestImage.h"
+#include "tiledelta.h"
+
+TEST(ScreenshotDeltaTest, GridClipsEdgeTiles)
+{
+    struct tile_grid grid;
+    int32_t x, y, width, height;
+
+    tile_grid_init(&grid, 100, 50, 32);
+    EXPECT_EQ(4, grid.tiles_x);
+    EXPECT_EQ(2, grid.tiles_y);
+    EXPECT_EQ(8u, tile_grid_count(&grid));
+
+    tile_grid_rect(&grid, 0, &x, &y, &width, &height);
+    EXPECT_EQ(0, x);
+    EXPECT_EQ(0, y);
+    EXPECT_EQ(32, width);
+    EXPECT_EQ(32, height);
+
+    tile_grid_rect(&grid, 7, &x, &y, &width, &height);
+    EXPECT_EQ(96, x);
+    EXPECT_EQ(32, y);
+    EXPECT_EQ(4, width);
+    EXPECT_EQ(18, height);
+
+    // a tile larger than the image covers all of it
+    tile_grid_init(&grid, 100, 50, INT32_MAX);
+    EXPECT_EQ(1, grid.tiles_x);
+    EXPECT_EQ(1, grid.tiles_y);
+    tile_grid_rect(&grid, 0, &x, &y, &width, &height);
+    EXPECT_EQ(100, width);
+    EXPECT_EQ(50, height);
+}
+
+TEST(ScreenshotDeltaTest, HashesFindChangedTiles)
+{
+    const int width = 100;
+    const int height = 50;
+    struct tile_grid grid;
+    tile_grid_init(&grid, width, height, 16);
+
+    std::vector<uint32_t> before = randomImage(width, height);
+    std::vector<uint32_t> after = before;
+    std::vector<uint64_t> hashesBefore(tile_grid_count(&grid));
+    std::vector<uint64_t> hashesAfter(tile_grid_count(&grid));
+
+    // one pixel in the middle, one in the clipped corner tile
+    after[20 * width + 40] ^= 1;
+    after[(height - 1) * width + width - 1] ^= 0x01000000;
+
+    tile_hashes_compute(&grid, &before[0], width * 4, &hashesBefore[0]);
+    tile_hashes_compute(&grid, &after[0], width * 4, &hashesAfter[0]);
+
+    for (uint32_t i = 0; i < tile_grid_count(&grid); ++i)
+    {
+        bool changed = (i == 1 * 7 + 2) || (i == tile_grid_count(&grid) - 1);
+        EXPECT_EQ(changed, hashesBefore[i] != hashesAfter[i]) << "tile " << i;
+    }
+
+    // the same content in a padded buffer hashes the same
+    std::vector<uint32_t> padded((width + 3) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(&padded[y * (width + 3)], &before[y * width], width * 4);
+    }
+    tile_hashes_compute(&grid, &padded[0], (width + 3) * 4, &hashesAfter[0]);
+    EXPECT_EQ(hashesBefore, hashesAfter);
+}
+
+TEST(ScreenshotDeltaTest, PackAndApplyChangedTiles)
+{
+    const int width = 70;
+    const int height = 45;
+    struct tile_grid grid;
+    tile_grid_init(&grid, width, height, 32);
+
+    std::vector<uint32_t> image = randomImage(width, height);
+    std::vector<unsigned char> changeMap(tile_grid_count(&grid), 0);
+    changeMap[1] = 1;  // 32x32 at 32,0
+    changeMap[5] = 1;  // 6x13 at 64,32
+
+    size_t size = tile_delta_pack(&grid, &image[0], width * 4, &changeMap[0], NULL);
+    ASSERT_EQ((32u * 32 + 6 * 13) * 4, size);
+
+    std::vector<unsigned char> tiles(size);
+    ASSERT_EQ(size, tile_delta_pack(&grid, &image[0], width * 4, &changeMap[0], &tiles[0]));
+
+    std::vector<uint32_t> restored(width * height, 0);
+    tile_delta_apply(&grid, &changeMap[0], &tiles[0], &restored[0], width * 4);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            bool inTile = (x >= 32 && x < 64 && y < 32) || (x >= 64 && y >= 32);
+            ASSERT_EQ(inTile ? image[y * width + x] : 0u, restored[y * width + x])
+                << x << "," << y;
+        }
+    }
+}
+
+TEST(ScreenshotDeltaTest, ReconstructScreenshot)
+{
+    const int width = 70;
+    const int height = 45;
+    struct tile_grid grid;
+    tile_grid_init(&grid, width, height, 16);
+
+    std::vector<uint32_t> base = randomImage(width, height);
+    std::vector<uint32_t> next = base;
+    next[40 * width + 69] = 0xff00ff00u;
+
+    // a delta against base with the one changed tile
+    std::vector<unsigned char> changeMap(tile_grid_count(&grid), 0);
+    changeMap[2 * 5 + 4] = 1;
+    std::vector<unsigned char> tiles(tile_delta_pack(&grid, &next[0], width * 4, &changeMap[0], NULL));
+    tile_delta_pack(&grid, &next[0], width * 4, &changeMap[0], &tiles[0]);
+
+    struct ilmScreenshotDelta delta;
+    memset(&delta, 0, sizeof delta);
+    delta.id = 2;
+    delta.baseId = 1;
+    delta.width = width;
+    delta.height = height;
+    delta.format = WL_SHM_FORMAT_XRGB8888;
+    delta.tileSize = 16;
+    delta.tilesX = grid.tiles_x;
+    delta.tilesY = grid.tiles_y;
+    delta.changedTiles = 1;
+    delta.changeMap = &changeMap[0];
+    delta.tiles = &tiles[0];
+    delta.tilesSize = tiles.size();
+
+    struct ilmScreenshot baseImage = wrapImage(base, width, height);
+    struct ilmScreenshot restored;
+    ASSERT_EQ(ILM_SUCCESS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+    EXPECT_EQ((t_ilm_uint)width, restored.width);
+    EXPECT_EQ((t_ilm_uint)height, restored.height);
+    EXPECT_EQ((t_ilm_uint)width * 4, restored.stride);
+    EXPECT_EQ(-1, restored.fd);
+    EXPECT_EQ(0, memcmp(restored.buffer, &next[0], next.size() * 4));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&restored));
+
+    // without a base only a full delta can be rebuilt
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(NULL, &delta, &restored));
+}
+
+TEST(ScreenshotDeltaTest, ReconstructRejectsMismatches)
+{
+    std::vector<uint32_t> base = randomImage(32, 32);
+    std::vector<unsigned char> changeMap(4, 0);
+    struct ilmScreenshot baseImage = wrapImage(base, 32, 32);
+    struct ilmScreenshot restored;
+
+    struct ilmScreenshotDelta delta;
+    memset(&delta, 0, sizeof delta);
+    delta.baseId = 1;
+    delta.width = 32;
+    delta.height = 32;
+    delta.format = WL_SHM_FORMAT_XRGB8888;
+    delta.tileSize = 16;
+    delta.tilesX = 2;
+    delta.tilesY = 2;
+    delta.changeMap = &changeMap[0];
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+    EXPECT_EQ(0, memcmp(restored.buffer, &base[0], base.size() * 4));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&restored));
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, NULL, &restored));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, &delta, NULL));
+
+    // the tiles have to match the change map
+    changeMap[3] = 1;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+    changeMap[3] = 0;
+
+    baseImage.width = 31;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+    baseImage.width = 32;
+
+    baseImage.stride = 31 * 4;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+    baseImage.stride = 32 * 4;
+
+    delta.tilesX = 3;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_reconstructScreenshot(&baseImage, &delta, &restored));
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_releaseScreenshotDelta(NULL));
+}
@@ -0,0 +1,162 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "TestImage.h"
+
+/* Round trips through the screenshot file formats ilm_loadScreenshot
+ * reads back.
+ */
+
+TEST(ScreenshotFormatTest, RawAndLz4AreLossless)
+{
+    const char* files[] = { "/tmp/test_format.raw", "/tmp/test_format.lz4" };
+
+    for (size_t f = 0; f < sizeof screenshotFormats / sizeof screenshotFormats[0]; ++f)
+    {
+        for (size_t i = 0; i < sizeof files / sizeof files[0]; ++i)
+        {
+            std::vector<uint32_t> pixels = testImage(97, 31);
+            struct ilmScreenshot image = wrapImage(pixels, 97, 31, screenshotFormats[f]);
+            struct ilmScreenshot loaded;
+
+            ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, files[i]));
+            ASSERT_EQ(ILM_SUCCESS, ilm_loadScreenshot(files[i], &loaded));
+            EXPECT_EQ(97u, loaded.width);
+            EXPECT_EQ(31u, loaded.height);
+            EXPECT_EQ(screenshotFormats[f], loaded.format);
+            EXPECT_EQ(-1, loaded.fd);
+            EXPECT_EQ(0, memcmp(loaded.buffer, &pixels[0], pixels.size() * 4)) << files[i];
+            ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&loaded));
+            remove(files[i]);
+        }
+    }
+}
+
+TEST(ScreenshotFormatTest, SaveSkipsRowPadding)
+{
+    const char* files[] = { "/tmp/test_format.raw", "/tmp/test_format.lz4" };
+    const t_ilm_uint width = 97;
+    const t_ilm_uint height = 31;
+    const t_ilm_uint pitch = width + 3;
+
+    std::vector<uint32_t> pixels = testImage(width, height);
+    std::vector<uint32_t> padded(pitch * height, 0xdeadbeefu);
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        memcpy(&padded[y * pitch], &pixels[y * width], width * 4);
+    }
+
+    struct ilmScreenshot image = wrapImage(padded, width, height, WL_SHM_FORMAT_ARGB8888);
+    image.stride = pitch * 4;
+    image.size = image.stride * height;
+
+    for (size_t i = 0; i < sizeof files / sizeof files[0]; ++i)
+    {
+        struct ilmScreenshot loaded;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, files[i]));
+        ASSERT_EQ(ILM_SUCCESS, ilm_loadScreenshot(files[i], &loaded));
+        EXPECT_EQ(width * 4, loaded.stride);
+        EXPECT_EQ(0, memcmp(loaded.buffer, &pixels[0], pixels.size() * 4)) << files[i];
+        ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&loaded));
+        remove(files[i]);
+    }
+
+    image.stride = width * 4 - 4;
+    EXPECT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_saveScreenshot(&image, files[0]));
+}
+
+TEST(ScreenshotFormatTest, QoiIsLossless)
+{
+    const char* file = "/tmp/test_format.qoi";
+
+    for (size_t f = 0; f < sizeof screenshotFormats / sizeof screenshotFormats[0]; ++f)
+    {
+        bool alpha = screenshotFormats[f] == WL_SHM_FORMAT_ARGB8888 || screenshotFormats[f] == WL_SHM_FORMAT_ABGR8888;
+        bool bgr = screenshotFormats[f] == WL_SHM_FORMAT_ABGR8888 || screenshotFormats[f] == WL_SHM_FORMAT_XBGR8888;
+        std::vector<uint32_t> pixels = testImage(97, 31);
+        struct ilmScreenshot image = wrapImage(pixels, 97, 31, screenshotFormats[f]);
+        struct ilmScreenshot loaded;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, file));
+        ASSERT_EQ(ILM_SUCCESS, ilm_loadScreenshot(file, &loaded));
+        EXPECT_EQ(alpha ? (t_ilm_uint)WL_SHM_FORMAT_ABGR8888 : (t_ilm_uint)WL_SHM_FORMAT_XBGR8888,
+                  loaded.format);
+
+        // qoi is read back as R, G, B, A bytes
+        const unsigned char* out = (const unsigned char*)loaded.buffer;
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            uint32_t p = pixels[i];
+            unsigned char r = bgr ? p : p >> 16;
+            unsigned char b = bgr ? p >> 16 : p;
+            ASSERT_EQ(r, out[i * 4]) << "pixel " << i;
+            ASSERT_EQ((unsigned char)(p >> 8), out[i * 4 + 1]) << "pixel " << i;
+            ASSERT_EQ(b, out[i * 4 + 2]) << "pixel " << i;
+            ASSERT_EQ(alpha ? (unsigned char)(p >> 24) : 0xff, out[i * 4 + 3]) << "pixel " << i;
+        }
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&loaded));
+        remove(file);
+    }
+}
+
+TEST(ScreenshotFormatTest, LoadRejectsInvalidFiles)
+{
+    const char* file = "/tmp/test_format.lz4";
+    struct ilmScreenshot loaded;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_loadScreenshot(NULL, &loaded));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_loadScreenshot(file, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_loadScreenshot("/tmp/test_format.png", &loaded));
+    ASSERT_EQ(ILM_FAILED, ilm_loadScreenshot("/tmp/does_not_exist.qoi", &loaded));
+
+    FILE* f = fopen(file, "w");
+    ASSERT_TRUE(f != NULL);
+    fputs("not a screenshot at all, but long enough for a header", f);
+    fclose(f);
+    ASSERT_EQ(ILM_FAILED, ilm_loadScreenshot(file, &loaded));
+    remove(file);
+}
+
+TEST(ScreenshotFormatTest, SaveRejectsImagesTheLoaderRejects)
+{
+    const char* files[] = { "/tmp/test_format.raw", "/tmp/test_format.lz4", "/tmp/test_format.qoi" };
+    const t_ilm_uint width = 0x8001;
+
+    std::vector<uint32_t> pixels(width, 0);
+    struct ilmScreenshot image = wrapImage(pixels, width, 1, WL_SHM_FORMAT_ARGB8888);
+
+    for (size_t i = 0; i < sizeof files / sizeof files[0]; ++i)
+    {
+        remove(files[i]);
+        EXPECT_EQ(ILM_FAILED, ilm_saveScreenshot(&image, files[i])) << files[i];
+
+        FILE* f = fopen(files[i], "r");
+        EXPECT_TRUE(f == NULL) << files[i];
+        if (f != NULL)
+        {
+            fclose(f);
+            remove(files[i]);
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "TestImage.h"
+#include "swizzle.h"
+
+/* Every vector kernel the cpu supports has to produce the same bytes as
+ * the scalar one, and must not write past the row.
+ */
+
+static const unsigned char guard = 0xa5;
+
+TEST(SwizzleTest, ScalarChannelOrder)
+{
+    const uint32_t pixel = 0x11223344; // A=11 R=22 G=33 B=44 for ARGB8888
+    unsigned char out[4];
+
+    swizzle_func f = get_swizzle_func(WL_SHM_FORMAT_ARGB8888, SWIZZLE_ORDER_RGB, SWIZZLE_KERNEL_SCALAR);
+    ASSERT_TRUE(f != NULL);
+    f(&pixel, out, 1);
+    EXPECT_EQ(0x22, out[0]);
+    EXPECT_EQ(0x33, out[1]);
+    EXPECT_EQ(0x44, out[2]);
+    EXPECT_EQ(0x11, out[3]);
+
+    f = get_swizzle_func(WL_SHM_FORMAT_XRGB8888, SWIZZLE_ORDER_BGR, SWIZZLE_KERNEL_SCALAR);
+    ASSERT_TRUE(f != NULL);
+    memset(out, guard, sizeof out);
+    f(&pixel, out, 1);
+    EXPECT_EQ(0x44, out[0]);
+    EXPECT_EQ(0x33, out[1]);
+    EXPECT_EQ(0x22, out[2]);
+    EXPECT_EQ(guard, out[3]);
+
+    // A=11 B=22 G=33 R=44 for ABGR8888
+    f = get_swizzle_func(WL_SHM_FORMAT_ABGR8888, SWIZZLE_ORDER_RGB, SWIZZLE_KERNEL_SCALAR);
+    ASSERT_TRUE(f != NULL);
+    f(&pixel, out, 1);
+    EXPECT_EQ(0x44, out[0]);
+    EXPECT_EQ(0x33, out[1]);
+    EXPECT_EQ(0x22, out[2]);
+    EXPECT_EQ(0x11, out[3]);
+
+    f = get_swizzle_func(WL_SHM_FORMAT_XBGR8888, SWIZZLE_ORDER_BGR, SWIZZLE_KERNEL_SCALAR);
+    ASSERT_TRUE(f != NULL);
+    f(&pixel, out, 1);
+    EXPECT_EQ(0x22, out[0]);
+    EXPECT_EQ(0x33, out[1]);
+    EXPECT_EQ(0x44, out[2]);
+}
+
+TEST(SwizzleTest, KernelsMatchScalar)
+{
+    srand(1);
+
+    for (int kernel = SWIZZLE_KERNEL_SCALAR + 1; kernel < SWIZZLE_KERNEL_COUNT; ++kernel)
+    {
+        for (size_t f = 0; f < sizeof screenshotFormats / sizeof screenshotFormats[0]; ++f)
+        {
+            for (int order = SWIZZLE_ORDER_RGB; order <= SWIZZLE_ORDER_BGR; ++order)
+            {
+                swizzle_func scalar = get_swizzle_func(screenshotFormats[f], (swizzle_order)order, SWIZZLE_KERNEL_SCALAR);
+                swizzle_func vector = get_swizzle_func(screenshotFormats[f], (swizzle_order)order, (swizzle_kernel)kernel);
+                if (vector == NULL)
+                {
+                    continue;
+                }
+
+                // all tail lengths of the 4, 8 and 16 pixel loops
+                for (int width = 0; width <= 67; ++width)
+                {
+                    // one spare pixel, so the row is never empty
+                    std::vector<uint32_t> row = randomImage(width + 1, 1);
+                    size_t size = width * swizzle_bytes_per_pixel(screenshotFormats[f]);
+                    std::vector<unsigned char> expected(size + 32, guard);
+                    std::vector<unsigned char> actual(size + 32, guard);
+
+                    scalar(&row[0], &expected[0], width);
+                    vector(&row[0], &actual[0], width);
+
+                    ASSERT_EQ(expected, actual) << "kernel " << kernel << ", format 0x"
+                                                << std::hex << screenshotFormats[f] << std::dec
+                                                << ", order " << order << ", width " << width;
+                    for (size_t i = size; i < actual.size(); ++i)
+                    {
+                        ASSERT_EQ(guard, actual[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(SwizzleTest, BestKernelIsSupported)
+{
+    swizzle_kernel best = swizzle_best_kernel();
+    for (size_t f = 0; f < sizeof screenshotFormats / sizeof screenshotFormats[0]; ++f)
+    {
+        EXPECT_TRUE(get_swizzle_func(screenshotFormats[f], SWIZZLE_ORDER_RGB, best) != NULL);
+        EXPECT_TRUE(get_swizzle_func(screenshotFormats[f], SWIZZLE_ORDER_BGR, best) != NULL);
+    }
+}
+
+TEST(SwizzleTest, UnsupportedFormat)
+{
+    EXPECT_TRUE(get_swizzle_func(WL_SHM_FORMAT_RGB565, SWIZZLE_ORDER_RGB, SWIZZLE_KERNEL_SCALAR) == NULL);
+    EXPECT_TRUE(get_swizzle_func(WL_SHM_FORMAT_ARGB8888, SWIZZLE_ORDER_RGB, SWIZZLE_KERNEL_COUNT) == NULL);
+    EXPECT_EQ(0, swizzle_bytes_per_pixel(WL_SHM_FORMAT_RGB565));
+}
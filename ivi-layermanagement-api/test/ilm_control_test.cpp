@@ -20,12 +20,18 @@
  ****************************************************************************/
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <stdio.h>
+#include <string.h>
 
+#include <png.h>
 #include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/types.h>
 
 #include "TestBase.h"
+#include "TestImage.h"
 
 extern "C" {
     #include "ilm_control.h"
@@ -456,6 +462,32 @@ TEST_F(IlmCommandTest, ilm_getSurfaceIDsOnLayer_InvalidResources) {
     ASSERT_NE(ILM_SUCCESS, ilm_getSurfaceIDsOnLayer(layer, &length, NULL));
 }
 
+TEST_F(IlmCommandTest, ilm_getSurfaceFrameStats) {
+    static const int commits = 6;
+    uint surface = iviSurfaces[0].surface_id;
+
+    for (int i = 0; i < commits; ++i)
+    {
+        wl_surface_attach(wlSurfaces[0], wlBuffers[0], 0, 0);
+        wl_surface_damage(wlSurfaces[0], 0, 0, 1, 1);
+        wl_surface_commit(wlSurfaces[0]);
+        wl_display_flush(wlDisplay);
+        usleep(20000);
+    }
+    wl_display_roundtrip(wlDisplay);
+
+    ilmSurfaceFrameStats stats;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getSurfaceFrameStats(surface, NULL));
+    ASSERT_EQ(ILM_FAILED, ilm_getSurfaceFrameStats(0xdead, &stats));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceFrameStats(surface, &stats));
+    EXPECT_GE(stats.frames, (t_ilm_uint)commits - 1);
+    EXPECT_GT(stats.frameRate, 0.0);
+    EXPECT_LE(stats.intervalP50, stats.intervalP95);
+    EXPECT_LE(stats.intervalP95, stats.intervalP99);
+    EXPECT_LE(stats.intervalP99, stats.intervalMax);
+    EXPECT_GE(stats.intervalMax, 20000u);
+}
+
 TEST_F(IlmCommandTest, ilm_getPropertiesOfSurface_ilm_surfaceSetSourceRectangle_ilm_surfaceSetDestinationRectangle) {
     uint surface = iviSurfaces[0].surface_id;
 
@@ -548,6 +580,423 @@ TEST_F(IlmCommandTest, ilm_getPropertiesOfSurface_InvalidInput) {
     ASSERT_NE(ILM_SUCCESS, ilm_getPropertiesOfSurface(0xdeadbeef, &surfaceProperties));
 }
 
+TEST_F(IlmCommandTest, ilm_getPropertiesOfSurfaces) {
+    t_ilm_surface surfaces[3];
+    ilmSurfaceProperties properties[3];
+
+    for (int i = 0; i < 3; ++i)
+    {
+        surfaces[i] = iviSurfaces[i].surface_id;
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(surfaces[i], i, 2 * i, 10 + i, 20 + i));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaces(3, surfaces, properties));
+    for (int i = 0; i < 3; ++i)
+    {
+        ilmSurfaceProperties single;
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surfaces[i], &single));
+        EXPECT_EQ(single.destX, properties[i].destX);
+        EXPECT_EQ(single.destY, properties[i].destY);
+        EXPECT_EQ(10u + i, properties[i].destWidth);
+        EXPECT_EQ(20u + i, properties[i].destHeight);
+        EXPECT_EQ(single.creatorPid, properties[i].creatorPid);
+    }
+}
+
+static void expectSameProperties(const ilmSurfaceProperties& expected,
+                                 const ilmSurfaceProperties& actual)
+{
+    EXPECT_FLOAT_EQ(expected.opacity, actual.opacity);
+    EXPECT_EQ(expected.sourceX, actual.sourceX);
+    EXPECT_EQ(expected.sourceY, actual.sourceY);
+    EXPECT_EQ(expected.sourceWidth, actual.sourceWidth);
+    EXPECT_EQ(expected.sourceHeight, actual.sourceHeight);
+    EXPECT_EQ(expected.origSourceWidth, actual.origSourceWidth);
+    EXPECT_EQ(expected.origSourceHeight, actual.origSourceHeight);
+    EXPECT_EQ(expected.destX, actual.destX);
+    EXPECT_EQ(expected.destY, actual.destY);
+    EXPECT_EQ(expected.destWidth, actual.destWidth);
+    EXPECT_EQ(expected.destHeight, actual.destHeight);
+    EXPECT_EQ(expected.visibility, actual.visibility);
+    EXPECT_EQ(expected.creatorPid, actual.creatorPid);
+    EXPECT_EQ(expected.focus, actual.focus);
+}
+
+static void expectSameProperties(const ilmLayerProperties& expected,
+                                 const ilmLayerProperties& actual)
+{
+    EXPECT_FLOAT_EQ(expected.opacity, actual.opacity);
+    EXPECT_EQ(expected.sourceX, actual.sourceX);
+    EXPECT_EQ(expected.sourceY, actual.sourceY);
+    EXPECT_EQ(expected.sourceWidth, actual.sourceWidth);
+    EXPECT_EQ(expected.sourceHeight, actual.sourceHeight);
+    EXPECT_EQ(expected.destX, actual.destX);
+    EXPECT_EQ(expected.destY, actual.destY);
+    EXPECT_EQ(expected.destWidth, actual.destWidth);
+    EXPECT_EQ(expected.destHeight, actual.destHeight);
+    EXPECT_EQ(expected.visibility, actual.visibility);
+}
+
+TEST_F(IlmCommandTest, ilm_getPropertiesOfSurfaces_MatchSingleGetters) {
+    const t_ilm_uint count = iviSurfaces.size();
+    std::vector<t_ilm_surface> surfaces(count);
+    std::vector<ilmSurfaceProperties> properties(count);
+
+    for (t_ilm_uint i = 0; i < count; ++i)
+    {
+        surfaces[i] = iviSurfaces[i].surface_id;
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surfaces[i], 0.1 * i));
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(surfaces[i], i % 2 ? ILM_TRUE : ILM_FALSE));
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetSourceRectangle(surfaces[i], i, i + 1, 30 + i, 40 + i));
+        ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(surfaces[i], 3 * i, 5 * i, 50 + i, 60 + i));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    // the bulk query in reverse order, to see each entry matches its id
+    std::reverse(surfaces.begin(), surfaces.end());
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaces(count, &surfaces[0], &properties[0]));
+    for (t_ilm_uint i = 0; i < count; ++i)
+    {
+        ilmSurfaceProperties single;
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surfaces[i], &single));
+        expectSameProperties(single, properties[i]);
+        EXPECT_EQ(50u + count - 1 - i, properties[i].destWidth);
+    }
+}
+
+TEST_F(IlmCommandTest, ilm_getPropertiesOfLayers_MatchSingleGetters) {
+    static const t_ilm_uint count = 3;
+    t_ilm_layer layers[count];
+    ilmLayerProperties properties[count];
+
+    for (t_ilm_uint i = 0; i < count; ++i)
+    {
+        layers[i] = 360 + i;
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layers[i], 800, 480));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layers[i], 0.2 * (i + 1)));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetVisibility(layers[i], i % 2 ? ILM_TRUE : ILM_FALSE));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetSourceRectangle(layers[i], i, i + 1, 300 + i, 200 + i));
+        ASSERT_EQ(ILM_SUCCESS, ilm_layerSetDestinationRectangle(layers[i], 2 * i, 4 * i, 400 + i, 240 + i));
+    }
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayers(count, layers, properties));
+    for (t_ilm_uint i = 0; i < count; ++i)
+    {
+        ilmLayerProperties single;
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layers[i], &single));
+        expectSameProperties(single, properties[i]);
+        EXPECT_EQ(400u + i, properties[i].destWidth);
+    }
+}
+
+TEST_F(IlmCommandTest, ilm_getPropertiesOfSurfaces_InvalidInput) {
+    t_ilm_surface surfaces[2] = { iviSurfaces[0].surface_id, 0xdeadbeef };
+    ilmSurfaceProperties properties[2];
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getPropertiesOfSurfaces(2, surfaces, NULL));
+    ASSERT_NE(ILM_SUCCESS, ilm_getPropertiesOfSurfaces(2, surfaces, properties));
+    EXPECT_EQ(0u, properties[1].destWidth);
+    EXPECT_EQ(0u, properties[1].creatorPid);
+}
+
+TEST_F(IlmCommandTest, ilm_getPropertiesOfLayers) {
+    t_ilm_layer layers[2] = { 345, 346 };
+    ilmLayerProperties properties[2];
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layers[0], 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layers[1], 400, 240));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetDestinationRectangle(layers[0], 0, 0, 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetDestinationRectangle(layers[1], 10, 20, 400, 240));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layers[1], 0.25));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayers(2, layers, properties));
+    EXPECT_EQ(800u, properties[0].destWidth);
+    EXPECT_EQ(480u, properties[0].destHeight);
+    EXPECT_EQ(10u, properties[1].destX);
+    EXPECT_EQ(20u, properties[1].destY);
+    EXPECT_EQ(400u, properties[1].destWidth);
+    EXPECT_EQ(240u, properties[1].destHeight);
+    EXPECT_NEAR(0.25, properties[1].opacity, 0.01);
+
+    t_ilm_layer invalid[1] = { 0xdeadbeef };
+    ASSERT_NE(ILM_SUCCESS, ilm_getPropertiesOfLayers(1, invalid, properties));
+}
+
+TEST_F(IlmCommandTest, ilm_getScene) {
+    t_ilm_layer layer = 347;
+    t_ilm_surface surfaces[2] = { iviSurfaces[0].surface_id, iviSurfaces[1].surface_id };
+    t_ilm_display screen = 0;
+    ilmScene* scene = NULL;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layer, 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layer, 0.5));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetRenderOrder(layer, surfaces, 2));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(surfaces[1], 5, 6, 70, 80));
+    ASSERT_EQ(ILM_SUCCESS, ilm_displaySetRenderOrder(screen, &layer, 1));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getScene(NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScene(&scene));
+    ASSERT_TRUE(scene != NULL);
+
+    // the snapshot must agree with the per object getters
+    t_ilm_uint screenCount = 0;
+    t_ilm_display* screenIds = NULL;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScreenIDs(&screenCount, &screenIds));
+    EXPECT_EQ(screenCount, scene->screenCount);
+    free(screenIds);
+
+    t_ilm_int surfaceCount = 0;
+    t_ilm_surface* surfaceIds = NULL;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceIDs(&surfaceCount, &surfaceIds));
+    EXPECT_EQ((t_ilm_uint)surfaceCount, scene->surfaceCount);
+    free(surfaceIds);
+
+    const ilmSceneScreen* sceneScreen = NULL;
+    for (t_ilm_uint i = 0; i < scene->screenCount; ++i)
+    {
+        if (scene->screens[i].screenId == screen)
+            sceneScreen = &scene->screens[i];
+    }
+    ASSERT_TRUE(sceneScreen != NULL);
+    ASSERT_EQ(1u, sceneScreen->prop.layerCount);
+    EXPECT_EQ(layer, sceneScreen->prop.layerIds[0]);
+
+    const ilmSceneLayer* sceneLayer = NULL;
+    for (t_ilm_uint i = 0; i < scene->layerCount; ++i)
+    {
+        if (scene->layers[i].layerId == layer)
+            sceneLayer = &scene->layers[i];
+    }
+    ASSERT_TRUE(sceneLayer != NULL);
+    EXPECT_NEAR(0.5, sceneLayer->prop.opacity, 0.01);
+    ASSERT_EQ(2u, sceneLayer->surfaceCount);
+    EXPECT_EQ(surfaces[0], sceneLayer->surfaceIds[0]);
+    EXPECT_EQ(surfaces[1], sceneLayer->surfaceIds[1]);
+
+    bool found = false;
+    for (t_ilm_uint i = 0; i < scene->surfaceCount; ++i)
+    {
+        if (scene->surfaces[i].surfaceId != surfaces[1])
+            continue;
+
+        ilmSurfaceProperties single;
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surfaces[1], &single));
+        EXPECT_EQ(5u, scene->surfaces[i].prop.destX);
+        EXPECT_EQ(6u, scene->surfaces[i].prop.destY);
+        EXPECT_EQ(70u, scene->surfaces[i].prop.destWidth);
+        EXPECT_EQ(80u, scene->surfaces[i].prop.destHeight);
+        EXPECT_EQ(single.creatorPid, scene->surfaces[i].prop.creatorPid);
+        found = true;
+    }
+    EXPECT_TRUE(found);
+
+    free(scene);
+}
+
+TEST_F(IlmCommandTest, ilm_getSceneFromMirror) {
+    t_ilm_layer layer = 349;
+    t_ilm_surface surfaces[2] = { iviSurfaces[0].surface_id, iviSurfaces[1].surface_id };
+    t_ilm_display screen = 0;
+    ilmScene* scene = NULL;
+    ilmScene* mirrored = NULL;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layer, 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetOpacity(layer, 0.75));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetRenderOrder(layer, surfaces, 2));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(surfaces[0], 1, 2, 30, 40));
+    ASSERT_EQ(ILM_SUCCESS, ilm_displaySetRenderOrder(screen, &layer, 1));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getSceneFromMirror(NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getSceneFromMirror(&mirrored));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getScene(&scene));
+
+    // the mirror must agree with the snapshot sent over the protocol
+    ASSERT_EQ(scene->screenCount, mirrored->screenCount);
+    ASSERT_EQ(scene->layerCount, mirrored->layerCount);
+    ASSERT_EQ(scene->surfaceCount, mirrored->surfaceCount);
+
+    for (t_ilm_uint i = 0; i < scene->screenCount; ++i)
+    {
+        EXPECT_EQ(scene->screens[i].screenId, mirrored->screens[i].screenId);
+        EXPECT_STREQ(scene->screens[i].prop.connectorName,
+                     mirrored->screens[i].prop.connectorName);
+        ASSERT_EQ(scene->screens[i].prop.layerCount,
+                  mirrored->screens[i].prop.layerCount);
+        for (t_ilm_uint j = 0; j < scene->screens[i].prop.layerCount; ++j)
+            EXPECT_EQ(scene->screens[i].prop.layerIds[j],
+                      mirrored->screens[i].prop.layerIds[j]);
+    }
+
+    for (t_ilm_uint i = 0; i < scene->layerCount; ++i)
+    {
+        EXPECT_EQ(scene->layers[i].layerId, mirrored->layers[i].layerId);
+        EXPECT_EQ(0, memcmp(&scene->layers[i].prop, &mirrored->layers[i].prop,
+                            sizeof(ilmLayerProperties)));
+        ASSERT_EQ(scene->layers[i].surfaceCount, mirrored->layers[i].surfaceCount);
+        for (t_ilm_uint j = 0; j < scene->layers[i].surfaceCount; ++j)
+            EXPECT_EQ(scene->layers[i].surfaceIds[j], mirrored->layers[i].surfaceIds[j]);
+    }
+
+    for (t_ilm_uint i = 0; i < scene->surfaceCount; ++i)
+    {
+        EXPECT_EQ(scene->surfaces[i].surfaceId, mirrored->surfaces[i].surfaceId);
+        EXPECT_EQ(scene->surfaces[i].prop.destX, mirrored->surfaces[i].prop.destX);
+        EXPECT_EQ(scene->surfaces[i].prop.destWidth, mirrored->surfaces[i].prop.destWidth);
+        EXPECT_EQ(scene->surfaces[i].prop.creatorPid, mirrored->surfaces[i].prop.creatorPid);
+        EXPECT_LE(scene->surfaces[i].prop.frameCounter,
+                  mirrored->surfaces[i].prop.frameCounter);
+    }
+
+    free(scene);
+    free(mirrored);
+
+    ilmLayerProperties layerProperties;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayerFromMirror(layer, &layerProperties));
+    EXPECT_NEAR(0.75, layerProperties.opacity, 0.01);
+    EXPECT_EQ(800u, layerProperties.destWidth);
+
+    ilmSurfaceProperties surfaceProperties;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaceFromMirror(surfaces[0], &surfaceProperties));
+    EXPECT_EQ(1u, surfaceProperties.destX);
+    EXPECT_EQ(2u, surfaceProperties.destY);
+    EXPECT_EQ(30u, surfaceProperties.destWidth);
+    EXPECT_EQ(40u, surfaceProperties.destHeight);
+
+    // changes are published when the commit returns
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(surfaces[0], ILM_FALSE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurfaceFromMirror(surfaces[0], &surfaceProperties));
+    EXPECT_EQ(ILM_FALSE, surfaceProperties.visibility);
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getPropertiesOfLayerFromMirror(layer, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getPropertiesOfSurfaceFromMirror(surfaces[0], NULL));
+    ASSERT_EQ(ILM_FAILED, ilm_getPropertiesOfLayerFromMirror(0xdeadbeef, &layerProperties));
+    ASSERT_EQ(ILM_FAILED, ilm_getPropertiesOfSurfaceFromMirror(0xdeadbeef, &surfaceProperties));
+}
+
+TEST_F(IlmCommandTest, ilm_beginTransaction_ilm_endTransaction) {
+    t_ilm_surface surface = iviSurfaces[0].surface_id;
+    t_ilm_layer layer = 348;
+    ilmSurfaceProperties surfaceProperties;
+    ilmLayerProperties layerProperties;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerCreateWithDimension(&layer, 800, 480));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 1.0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 0.2));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(surface, 1, 2, 30, 40));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetVisibility(layer, ILM_TRUE));
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 0.6));
+    ASSERT_EQ(ILM_SUCCESS, ilm_layerSetRenderOrder(layer, &surface, 1));
+
+    // nothing is applied before the transaction ends
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surface, &surfaceProperties));
+    EXPECT_NEAR(1.0, surfaceProperties.opacity, 0.01);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+
+    // only the last value of each property is kept
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(surface, &surfaceProperties));
+    EXPECT_NEAR(0.6, surfaceProperties.opacity, 0.01);
+    EXPECT_EQ(1u, surfaceProperties.destX);
+    EXPECT_EQ(2u, surfaceProperties.destY);
+    EXPECT_EQ(30u, surfaceProperties.destWidth);
+    EXPECT_EQ(40u, surfaceProperties.destHeight);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfLayer(layer, &layerProperties));
+    EXPECT_EQ(ILM_TRUE, layerProperties.visibility);
+
+    t_ilm_int length = 0;
+    t_ilm_surface* ids = NULL;
+    ASSERT_EQ(ILM_SUCCESS, ilm_getSurfaceIDsOnLayer(layer, &length, &ids));
+    ASSERT_EQ(1, length);
+    EXPECT_EQ(surface, ids[0]);
+    free(ids);
+}
+
+TEST_F(IlmCommandTest, ilm_beginTransaction_nested) {
+    t_ilm_surface surface = iviSurfaces[0].surface_id;
+    t_ilm_float opacity = 0.0;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 1.0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+    ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(surface, 0.4));
+    ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+
+    // the inner end does not write anything out
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surface, &opacity));
+    EXPECT_NEAR(1.0, opacity, 0.01);
+
+    // commit inside the transaction sends the pending state
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceGetOpacity(surface, &opacity));
+    EXPECT_NEAR(0.4, opacity, 0.01);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+    ASSERT_EQ(ILM_FAILED, ilm_endTransaction());
+}
+
+TEST_F(IlmCommandTest, ilm_getTransactionStats) {
+    static const t_ilm_uint surfaces = 3;
+    static const t_ilm_uint rounds = 4;
+    t_ilm_uint recorded = 0, sent = 0;
+    t_ilm_uint recordedBefore = 0, sentBefore = 0;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getTransactionStats(NULL, &sent));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getTransactionStats(&recorded, NULL));
+    ASSERT_EQ(ILM_SUCCESS, ilm_getTransactionStats(&recordedBefore, &sentBefore));
+
+    // sets outside of a transaction are sent directly
+    ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(iviSurfaces[0].surface_id, 1.0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_getTransactionStats(&recorded, &sent));
+    EXPECT_EQ(recordedBefore, recorded);
+    EXPECT_EQ(sentBefore, sent);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_beginTransaction());
+    for (t_ilm_uint r = 0; r < rounds; ++r)
+    {
+        for (t_ilm_uint i = 0; i < surfaces; ++i)
+        {
+            t_ilm_surface id = iviSurfaces[i].surface_id;
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetOpacity(id, 0.25 * r));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetVisibility(id, ILM_TRUE));
+            ASSERT_EQ(ILM_SUCCESS, ilm_surfaceSetDestinationRectangle(id, r, r, 100 + r, 100));
+        }
+    }
+
+    // everything is recorded, nothing is sent yet
+    ASSERT_EQ(ILM_SUCCESS, ilm_getTransactionStats(&recorded, &sent));
+    EXPECT_EQ(rounds * surfaces * 3, recorded - recordedBefore);
+    EXPECT_EQ(0u, sent - sentBefore);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_endTransaction());
+
+    // one request per property and surface
+    ASSERT_EQ(ILM_SUCCESS, ilm_getTransactionStats(&recorded, &sent));
+    EXPECT_EQ(surfaces * 3, sent - sentBefore);
+
+    for (t_ilm_uint i = 0; i < surfaces; ++i)
+    {
+        ilmSurfaceProperties properties;
+        ASSERT_EQ(ILM_SUCCESS, ilm_getPropertiesOfSurface(iviSurfaces[i].surface_id, &properties));
+        EXPECT_NEAR(0.75, properties.opacity, 0.01);
+        EXPECT_EQ(ILM_TRUE, properties.visibility);
+        EXPECT_EQ(rounds - 1, properties.destX);
+        EXPECT_EQ(100 + rounds - 1, properties.destWidth);
+    }
+}
+
 TEST_F(IlmCommandTest, ilm_takeScreenshot) {
     const char* outputFile = "/tmp/test.bmp";
     // make sure the file is not there before
@@ -618,6 +1067,292 @@ TEST_F(IlmCommandTest, ilm_takeSurfaceScreenshot_InvalidInputs) {
     ASSERT_NE(0, remove(outputFile));
 }
 
+TEST_F(IlmCommandTest, ilm_takeScreenshotToMemory) {
+    const char* outputFile = "/tmp/test.png";
+    struct ilmScreenshot image;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotToMemory(0, &image));
+    ASSERT_TRUE(image.buffer != NULL);
+    EXPECT_GE(image.fd, 0);
+    EXPECT_GT(image.width, 0u);
+    EXPECT_GT(image.height, 0u);
+    EXPECT_GE(image.stride, image.width * 4);
+    EXPECT_EQ(image.stride * image.height, image.size);
+
+    // the image in memory can still be encoded to a file
+    remove(outputFile);
+    ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, outputFile));
+    FILE* f = fopen(outputFile, "r");
+    ASSERT_TRUE(f!=NULL);
+    fclose(f);
+    remove(outputFile);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+    EXPECT_TRUE(image.buffer == NULL);
+    EXPECT_EQ(-1, image.fd);
+}
+
+TEST_F(IlmCommandTest, ilm_takeSurfaceScreenshotToMemory) {
+    struct ilmScreenshot image;
+
+    uint surface = iviSurfaces[0].surface_id;
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeSurfaceScreenshotToMemory(surface, &image));
+    ASSERT_TRUE(image.buffer != NULL);
+    EXPECT_GT(image.width, 0u);
+    EXPECT_GT(image.height, 0u);
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+}
+
+static uint32_t pixelAt(const struct ilmScreenshot& image, t_ilm_uint x, t_ilm_uint y)
+{
+    return ((const uint32_t*)((const char*)image.buffer + (size_t)y * image.stride))[x];
+}
+
+// the box filter of the compositor, with the same rounding
+static uint32_t boxAverage(const struct ilmScreenshot& image, t_ilm_uint targetWidth,
+                           t_ilm_uint targetHeight, t_ilm_uint dx, t_ilm_uint dy)
+{
+    t_ilm_uint x0 = (uint64_t)dx * image.width / targetWidth;
+    t_ilm_uint x1 = (uint64_t)(dx + 1) * image.width / targetWidth;
+    t_ilm_uint y0 = (uint64_t)dy * image.height / targetHeight;
+    t_ilm_uint y1 = (uint64_t)(dy + 1) * image.height / targetHeight;
+    uint64_t count = (uint64_t)(x1 - x0) * (y1 - y0);
+    uint64_t sums[4] = { 0, 0, 0, 0 };
+    uint32_t pixel = 0;
+
+    for (t_ilm_uint y = y0; y < y1; ++y)
+    {
+        for (t_ilm_uint x = x0; x < x1; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                sums[c] += (pixelAt(image, x, y) >> (c * 8)) & 0xff;
+            }
+        }
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+        pixel |= (uint32_t)((sums[c] + count / 2) / count) << (c * 8);
+    }
+    return pixel;
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshotRegionToMemory) {
+    struct ilmScreenshot full;
+    struct ilmScreenshot image;
+    t_ilm_uint mismatches;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotToMemory(0, &full));
+    ASSERT_GE(full.width, 64u);
+    ASSERT_GE(full.height, 64u);
+
+    // the unused byte of formats without alpha is not compared
+    uint32_t mask = (full.format == WL_SHM_FORMAT_XRGB8888 ||
+                     full.format == WL_SHM_FORMAT_XBGR8888) ? 0x00ffffffu : 0xffffffffu;
+
+    // a crop has the size of the rectangle and the pixels of the screen there
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotRegionToMemory(0, 16, 8, 48, 40, 0, 0, &image));
+    ASSERT_EQ(48u, image.width);
+    ASSERT_EQ(40u, image.height);
+    EXPECT_EQ(full.format, image.format);
+    EXPECT_EQ(image.stride * image.height, image.size);
+    mismatches = 0;
+    for (t_ilm_uint y = 0; y < image.height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < image.width; ++x)
+        {
+            if ((pixelAt(image, x, y) & mask) != (pixelAt(full, 16 + x, 8 + y) & mask))
+            {
+                ++mismatches;
+            }
+        }
+    }
+    EXPECT_EQ(0u, mismatches);
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+
+    // a thumbnail of the whole screen averages the pixels each one covers
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotRegionToMemory(0, 0, 0, full.width, full.height,
+                                                            full.width / 8, full.height / 8,
+                                                            &image));
+    ASSERT_EQ(full.width / 8, image.width);
+    ASSERT_EQ(full.height / 8, image.height);
+    mismatches = 0;
+    for (t_ilm_uint y = 0; y < image.height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < image.width; ++x)
+        {
+            uint32_t expected = boxAverage(full, image.width, image.height, x, y);
+            if ((pixelAt(image, x, y) & mask) != (expected & mask))
+            {
+                ++mismatches;
+            }
+        }
+    }
+    EXPECT_EQ(0u, mismatches);
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+
+    // the rectangle has to be inside of the screen
+    ASSERT_EQ(ILM_FAILED, ilm_takeScreenshotRegionToMemory(0, full.width - 8, 0, 16, 16, 0, 0, &image));
+    ASSERT_EQ(ILM_FAILED, ilm_takeScreenshotRegionToMemory(0, -1, 0, 16, 16, 0, 0, &image));
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&full));
+}
+
+TEST_F(IlmCommandTest, ilm_takeSurfaceScreenshotRegionToMemory) {
+    struct ilmScreenshot full;
+    struct ilmScreenshot image;
+
+    uint surface = iviSurfaces[0].surface_id;
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChanges());
+    // the test surfaces have buffers of 1x1 pixels
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeSurfaceScreenshotToMemory(surface, &full));
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeSurfaceScreenshotRegionToMemory(surface, 0, 0, 1, 1, 0, 0, &image));
+    ASSERT_EQ(1u, image.width);
+    ASSERT_EQ(1u, image.height);
+    EXPECT_EQ(4u, image.stride);
+    EXPECT_EQ(pixelAt(full, 0, 0), pixelAt(image, 0, 0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&full));
+
+    ASSERT_EQ(ILM_FAILED, ilm_takeSurfaceScreenshotRegionToMemory(surface, 0, 0, 2, 1, 0, 0, &image));
+    ASSERT_EQ(ILM_FAILED, ilm_takeSurfaceScreenshotRegionToMemory(0xdeadbeef, 0, 0, 8, 6, 0, 0, &image));
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshotRegionToMemory_InvalidInputs) {
+    struct ilmScreenshot image;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotRegionToMemory(0, 0, 0, 8, 8, 0, 0, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotRegionToMemory(0, 0, 0, 0, 8, 0, 0, &image));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotRegionToMemory(0, 0, 0, 8, -1, 0, 0, &image));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotRegionToMemory(0, 0, 0, 8, 8, 16, 8, &image));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotRegionToMemory(0, 0, 0, 8, 8, 8, -2, &image));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeSurfaceScreenshotRegionToMemory(0, 0, 0, 8, 8, 0, 0, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeSurfaceScreenshotRegionToMemory(0, 0, 0, 8, 8, 0, 9, &image));
+    ASSERT_NE(ILM_SUCCESS, ilm_takeScreenshotRegionToMemory(0xdeadbeef, 0, 0, 8, 8, 0, 0, &image));
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshotDelta) {
+    struct ilmScreenshotDelta keyframe;
+    struct ilmScreenshotDelta delta;
+    struct ilmScreenshot full;
+    struct ilmScreenshot restored;
+    struct ilmScreenshot image;
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotDelta(0, 0, 64, &keyframe));
+    EXPECT_NE(0u, keyframe.id);
+    EXPECT_EQ(0u, keyframe.baseId);
+    EXPECT_EQ(keyframe.tilesX * keyframe.tilesY, keyframe.changedTiles);
+    EXPECT_EQ(keyframe.width * keyframe.height * 4, keyframe.tilesSize);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_reconstructScreenshot(NULL, &keyframe, &full));
+
+    // the scene does not change, but the screen may still be animated
+    ASSERT_EQ(ILM_SUCCESS, ilm_takeScreenshotToMemory(0, &image));
+    ASSERT_EQ(ILM_SUCCESS, ilm_computeScreenshotDelta(&image, keyframe.id, 64, &delta));
+    EXPECT_EQ(keyframe.id, delta.baseId);
+    EXPECT_NE(keyframe.id, delta.id);
+    EXPECT_LE(delta.changedTiles, keyframe.changedTiles);
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_reconstructScreenshot(&full, &delta, &restored));
+    for (t_ilm_uint y = 0; y < image.height; ++y)
+    {
+        ASSERT_EQ(0, memcmp((const char*)restored.buffer + y * restored.stride,
+                            (const char*)image.buffer + y * image.stride,
+                            image.width * 4)) << "row " << y;
+    }
+
+    // a base with other tiles does not fit
+    struct ilmScreenshotDelta other;
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_computeScreenshotDelta(&image, delta.id, 32, &other));
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&restored));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&image));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshot(&full));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshotDelta(&delta));
+    ASSERT_EQ(ILM_SUCCESS, ilm_releaseScreenshotDelta(&keyframe));
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshotDelta_InvalidInputs) {
+    struct ilmScreenshotDelta delta;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotDelta(0, 0, 64, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotDelta(0, 0, 0, &delta));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_computeScreenshotDelta(NULL, 0, 64, &delta));
+    ASSERT_EQ(ILM_ERROR_RESOURCE_NOT_FOUND, ilm_takeScreenshotDelta(0, 0xdeadbeef, 64, &delta));
+    ASSERT_NE(ILM_SUCCESS, ilm_takeScreenshotDelta(0xdeadbeef, 0, 64, &delta));
+}
+
+TEST_F(IlmCommandTest, ilm_takeScreenshotToMemory_InvalidInputs) {
+    struct ilmScreenshot image;
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeScreenshotToMemory(0, NULL));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_takeSurfaceScreenshotToMemory(0, NULL));
+    ASSERT_NE(ILM_SUCCESS, ilm_takeScreenshotToMemory(0xdeadbeef, &image));
+    ASSERT_EQ(ILM_FAILED, ilm_takeSurfaceScreenshotToMemory(0xdeadbeef, &image));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_saveScreenshot(NULL, "/tmp/test.bmp"));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_releaseScreenshot(NULL));
+}
+
+TEST_F(IlmCommandTest, ilm_setScreenshotPngOptions) {
+    const char* outputFile = "/tmp/test.png";
+    static const t_ilm_uint width = 257;
+    static const t_ilm_uint height = 131;
+    std::vector<uint32_t> pixels(width * height);
+    std::vector<uint32_t> decoded(width * height);
+
+    // gradients and noise, so every filter has something to predict; the
+    // unused byte of XRGB is set to check that it is not written
+    for (t_ilm_uint y = 0; y < height; ++y)
+    {
+        for (t_ilm_uint x = 0; x < width; ++x)
+        {
+            pixels[y * width + x] = 0x5a000000u | ((x * 255 / width) << 16) |
+                                    ((y * 255 / height) << 8) |
+                                    ((x * 7 ^ y * 13) & 0xff);
+        }
+    }
+
+    struct ilmScreenshot image = wrapImage(pixels, width, height);
+
+    // every filter, on libpng and on the parallel encoder, decodes to the source
+    for (int filter = ILM_PNG_FILTER_NONE; filter <= ILM_PNG_FILTER_ADAPTIVE; ++filter)
+    {
+        for (t_ilm_uint threads = 1; threads <= 4; threads += 3)
+        {
+            remove(outputFile);
+            ASSERT_EQ(ILM_SUCCESS, ilm_setScreenshotPngOptions(1, (ilmPngFilter)filter, threads));
+            ASSERT_EQ(ILM_SUCCESS, ilm_saveScreenshot(&image, outputFile));
+
+            png_image png;
+            memset(&png, 0, sizeof png);
+            png.version = PNG_IMAGE_VERSION;
+            ASSERT_NE(0, png_image_begin_read_from_file(&png, outputFile)) << png.message;
+            EXPECT_EQ(width, png.width);
+            EXPECT_EQ(height, png.height);
+            png.format = PNG_FORMAT_BGRA;
+            ASSERT_NE(0, png_image_finish_read(&png, NULL, &decoded[0], 0, NULL)) << png.message;
+
+            t_ilm_uint mismatches = 0;
+            for (size_t i = 0; i < pixels.size(); ++i)
+            {
+                if (decoded[i] != (pixels[i] | 0xff000000u))
+                {
+                    ++mismatches;
+                }
+            }
+            EXPECT_EQ(0u, mismatches) << "filter " << filter << ", " << threads << " threads";
+        }
+    }
+    remove(outputFile);
+
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_setScreenshotPngOptions(10, ILM_PNG_FILTER_NONE, 0));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_setScreenshotPngOptions(-2, ILM_PNG_FILTER_NONE, 0));
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_setScreenshotPngOptions(-1, (ilmPngFilter)6, 0));
+    ASSERT_EQ(ILM_SUCCESS, ilm_setScreenshotPngOptions(-1, ILM_PNG_FILTER_ADAPTIVE, 0));
+}
+
 TEST_F(IlmCommandTest, ilm_getPropertiesOfScreen) {
     t_ilm_uint numberOfScreens;
     t_ilm_uint* screenIDs;
@@ -896,3 +1631,77 @@ TEST_F(IlmCommandTest, LayerSetRenderOrder_empty) {
 
     ASSERT_EQ(0, layerSurfaceCount);
 }
+
+TEST_F(IlmCommandTest, ilm_getFd_InternalThread) {
+    t_ilm_int fd = -1;
+
+    // the entry points for an external event loop are not available
+    ASSERT_EQ(ILM_FAILED, ilm_getFd(&fd));
+    ASSERT_EQ(ILM_FAILED, ilm_dispatchPending());
+    ASSERT_EQ(ILM_FAILED, ilm_useExternalEventLoop(ILM_TRUE));
+}
+
+class IlmExternalEventLoopTest : public TestBase, public ::testing::Test {
+public:
+    void SetUp()
+    {
+        ASSERT_EQ(ILM_SUCCESS, ilm_useExternalEventLoop(ILM_TRUE));
+        ASSERT_EQ(ILM_SUCCESS, ilm_initWithNativedisplay((t_ilm_nativedisplay)wlDisplay));
+        commitCalled = false;
+    }
+
+    void TearDown()
+    {
+        EXPECT_EQ(ILM_SUCCESS, ilm_destroy());
+        EXPECT_EQ(ILM_SUCCESS, ilm_useExternalEventLoop(ILM_FALSE));
+    }
+
+    static void commitCallback(ilmErrorTypes result, t_ilm_uint frameTime, void* user_data)
+    {
+        EXPECT_EQ(ILM_SUCCESS, result);
+        EXPECT_TRUE(pthread_equal(pthread_self(), *(pthread_t*)user_data));
+        commitCalled = true;
+    }
+
+    // one iteration of an application event loop
+    static void runEventLoop(int timeoutMs)
+    {
+        t_ilm_int fd = -1;
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_getFd(&fd));
+        ASSERT_EQ(ILM_SUCCESS, ilm_prepareRead());
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) > 0 && (pfd.revents & POLLIN))
+            ASSERT_EQ(ILM_SUCCESS, ilm_readEvents());
+        else
+            ASSERT_EQ(ILM_SUCCESS, ilm_cancelRead());
+
+        ASSERT_EQ(ILM_SUCCESS, ilm_dispatchPending());
+    }
+
+    static bool commitCalled;
+};
+
+bool IlmExternalEventLoopTest::commitCalled;
+
+TEST_F(IlmExternalEventLoopTest, ilm_dispatchPending) {
+    pthread_t self = pthread_self();
+
+    ASSERT_EQ(ILM_SUCCESS, ilm_commitChangesAsync(&commitCallback, &self));
+
+    // nothing is dispatched behind the back of the application
+    usleep(100000);
+    EXPECT_FALSE(commitCalled);
+
+    for (int i = 0; i < 50 && !commitCalled; ++i)
+    {
+        runEventLoop(100);
+    }
+    EXPECT_TRUE(commitCalled);
+}
+
+TEST_F(IlmExternalEventLoopTest, ilm_getFd_InvalidInput) {
+    ASSERT_EQ(ILM_ERROR_INVALID_ARGUMENTS, ilm_getFd(NULL));
+    ASSERT_EQ(ILM_FAILED, ilm_useExternalEventLoop(ILM_FALSE));
+}
@@ -205,6 +205,11 @@ void printLayerProperties(unsigned int layerid, const char* prefix = "");
  */
 void printSurfaceProperties(unsigned int surfaceid, const char* prefix = "");
 
+/*
+ * Prints the frame timing of the specified surface
+ */
+void printSurfaceStats(unsigned int surfaceid);
+
 /*
  * Prints information about rendered scene
  * (All screens, all rendered layers, all rendered surfaces)
@@ -218,6 +223,7 @@ void printScene();
 void testNotificationLayer(t_ilm_layer layerid);
 void watchLayer(unsigned int* layerids, unsigned int layeridCount);
 void watchSurface(unsigned int* surfaceids, unsigned int surfaceidCount);
+void recordScreen(t_ilm_uint screenid, t_ilm_uint frames, string directory);
 
 
 //=============================================================================
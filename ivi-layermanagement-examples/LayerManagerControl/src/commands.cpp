@@ -145,6 +145,13 @@ COMMAND("get screen|layer|surface <id>")
     }
 }
 
+//=============================================================================
+COMMAND("get surface <id> stats")
+//=============================================================================
+{
+    printSurfaceStats(input->getUint("id"));
+}
+
 //=============================================================================
 COMMAND("dump screen|surface <id> to <file>")
 //=============================================================================
@@ -173,6 +180,13 @@ COMMAND("dump screen|surface <id> to <file>")
     }
 }
 
+//=============================================================================
+COMMAND("record screen <id> <frames> to <dir>")
+//=============================================================================
+{
+    recordScreen(input->getUint("id"), input->getUint("frames"), input->getString("dir"));
+}
+
 //=============================================================================
 COMMAND("set layer|surface <id> source region <x> <y> <w> <h>")
 //=============================================================================
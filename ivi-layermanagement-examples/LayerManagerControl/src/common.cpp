@@ -40,6 +40,7 @@ using std::vector;
 
 #include <pthread.h>
 #include <signal.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -127,10 +128,90 @@ vector<t_ilm_surface> getSceneRenderOrder(t_scene_data* pScene)
     return renderOrder;
 }
 
+static bool captureSceneSnapshot(t_scene_data* pScene)
+{
+    t_scene_data& scene = *pScene;
+    ilmScene* snapshot = NULL;
+    bool screenFound = false;
+
+    ilmErrorTypes callResult = ilm_getScene(&snapshot);
+    if (ILM_SUCCESS != callResult)
+    {
+        return false;
+    }
+
+    //extra layer for debugging
+    scene.extraLayer = 0xFFFFFFFF;
+
+    for (t_ilm_uint i = 0; i < snapshot->screenCount; ++i)
+    {
+        const ilmSceneScreen& screen = snapshot->screens[i];
+        t_ilm_display screenId = screen.screenId;
+
+        if (screenId == 0)
+        {
+            scene.screenWidth = screen.prop.screenWidth;
+            scene.screenHeight = screen.prop.screenHeight;
+            screenFound = true;
+        }
+
+        scene.screens.push_back(screenId);
+        scene.screenLayers[screenId] = vector<t_ilm_layer>(screen.prop.layerIds,
+                screen.prop.layerIds + screen.prop.layerCount);
+
+        //preserve rendering order for layers on each screen
+        for (t_ilm_uint j = 0; j < screen.prop.layerCount; ++j)
+        {
+            scene.layerScreen[screen.prop.layerIds[j]] = screenId;
+        }
+    }
+
+    for (t_ilm_uint i = 0; i < snapshot->layerCount; ++i)
+    {
+        const ilmSceneLayer& layer = snapshot->layers[i];
+
+        scene.layers.push_back(layer.layerId);
+        scene.layerProperties[layer.layerId] = layer.prop;
+
+        //rendering order on layer
+        scene.layerSurfaces[layer.layerId] = vector<t_ilm_surface>(layer.surfaceIds,
+                layer.surfaceIds + layer.surfaceCount);
+
+        //make each surface aware of its layer
+        for (t_ilm_uint k = 0; k < layer.surfaceCount; ++k)
+        {
+            scene.surfaceLayer[layer.surfaceIds[k]] = layer.layerId;
+        }
+    }
+
+    for (t_ilm_uint i = 0; i < snapshot->surfaceCount; ++i)
+    {
+        const ilmSceneSurface& surface = snapshot->surfaces[i];
+
+        scene.surfaces.push_back(surface.surfaceId);
+        scene.surfaceProperties[surface.surfaceId] = surface.prop;
+    }
+
+    free(snapshot);
+
+    if (!screenFound)
+    {
+        cout << "Failed to get screen resolution for screen with ID " << 0 << "\n";
+    }
+
+    return true;
+}
+
 void captureSceneData(t_scene_data* pScene)
 {
     t_scene_data& scene = *pScene;
 
+    //whole scene in a single exchange, if the compositor supports it
+    if (captureSceneSnapshot(pScene))
+    {
+        return;
+    }
+
     //get screen information
     t_ilm_uint screenWidth = 0;
     t_ilm_uint screenHeight = 0;
@@ -20,7 +20,9 @@
 #include "ilm_control.h"
 #include "LMControl.h"
 
+#include <cstdio>
 #include <cstring>
+#include <deque>
 
 #include <iostream>
 using std::cout;
@@ -220,3 +222,92 @@ void watchSurface(unsigned int* surfaceids, unsigned int surfaceidCount)
         delete[] surfaceids;
     }
 }
+
+struct RecordState
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    std::deque<ilmCaptureFrame> frames;
+    bool failed;
+};
+
+static void recordCallback(ilmErrorTypes result, t_ilm_uint captureId,
+                           const struct ilmCaptureFrame* frame, void* user_data)
+{
+    RecordState* state = static_cast<RecordState*>(user_data);
+    (void)captureId;
+
+    pthread_mutex_lock(&state->mutex);
+    if (ILM_SUCCESS == result)
+    {
+        state->frames.push_back(*frame);
+    }
+    else
+    {
+        state->failed = true;
+    }
+    pthread_cond_signal(&state->cond);
+    pthread_mutex_unlock(&state->mutex);
+}
+
+void recordScreen(t_ilm_uint screenid, t_ilm_uint frames, string directory)
+{
+    RecordState state;
+    pthread_mutex_init(&state.mutex, NULL);
+    pthread_cond_init(&state.cond, NULL);
+    state.failed = false;
+
+    // frames are written by this thread, while the next ones are captured
+    t_ilm_uint captureId = 0;
+    ilmErrorTypes callResult = ilm_captureStart(screenid, 3, recordCallback, &state, &captureId);
+    if (ILM_SUCCESS != callResult)
+    {
+        cout << "LayerManagerService returned: " << ILM_ERROR_STRING(callResult) << "\n";
+        cout << "Failed to start capture of screen with ID " << screenid << "\n";
+        pthread_cond_destroy(&state.cond);
+        pthread_mutex_destroy(&state.mutex);
+        return;
+    }
+
+    for (t_ilm_uint i = 0; i < frames; ++i)
+    {
+        pthread_mutex_lock(&state.mutex);
+        while (state.frames.empty() && !state.failed)
+        {
+            pthread_cond_wait(&state.cond, &state.mutex);
+        }
+
+        if (state.frames.empty())
+        {
+            pthread_mutex_unlock(&state.mutex);
+            cout << "Capture of screen with ID " << screenid << " failed\n";
+            break;
+        }
+
+        ilmCaptureFrame frame = state.frames.front();
+        state.frames.pop_front();
+        pthread_mutex_unlock(&state.mutex);
+
+        char name[32];
+        snprintf(name, sizeof name, "/frame_%05u.bmp", i);
+        string filename = directory + name;
+
+        callResult = ilm_saveScreenshot(&frame.image, filename.c_str());
+        ilm_captureReleaseFrame(captureId, frame.index);
+        if (ILM_SUCCESS != callResult)
+        {
+            cout << "Failed to write " << filename << "\n";
+            break;
+        }
+
+        cout << filename << ": " << frame.tvSec << "." << std::setfill('0') << std::setw(9)
+             << frame.tvNsec << std::setfill(' ') << " s, dropped " << frame.dropped << "\n";
+    }
+
+    t_ilm_uint dropped = 0;
+    ilm_captureStop(captureId, &dropped);
+    cout << "Frames dropped: " << dropped << "\n";
+
+    pthread_cond_destroy(&state.cond);
+    pthread_mutex_destroy(&state.mutex);
+}
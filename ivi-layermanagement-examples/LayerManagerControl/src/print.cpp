@@ -276,6 +276,49 @@ void printSurfaceProperties(unsigned int surfaceid, const char* prefix)
     free(layerArray);
 }
 
+void printSurfaceStats(unsigned int surfaceid)
+{
+    cout << "surface " << surfaceid << " (0x" << hex << surfaceid << dec
+            << ") frame timing\n";
+    cout << "---------------------------------------\n";
+
+    ilmSurfaceProperties p;
+
+    ilmErrorTypes callResult = ilm_getPropertiesOfSurface(surfaceid, &p);
+    if (ILM_SUCCESS != callResult)
+    {
+        cout << "LayerManagerService returned: " << ILM_ERROR_STRING(callResult) << "\n";
+        cout << "No surface with ID " << surfaceid << " found\n";
+        return;
+    }
+
+    cout << "- frame counter:      " << p.frameCounter << "\n";
+
+    ilmSurfaceFrameStats s;
+
+    callResult = ilm_getSurfaceFrameStats(surfaceid, &s);
+    if (ILM_SUCCESS != callResult)
+    {
+        cout << "LayerManagerService returned: " << ILM_ERROR_STRING(callResult) << "\n";
+        cout << "Failed to get frame timing of surface " << surfaceid << "\n";
+        return;
+    }
+
+    if (s.frames == 0)
+    {
+        cout << "- no frame timing, the surface committed less than twice\n";
+        return;
+    }
+
+    cout << "- sampled intervals:  " << s.frames << "\n";
+    cout << "- frame rate:         " << s.frameRate << " fps\n";
+    cout << "- interval p50:       " << s.intervalP50 / 1000.0 << " ms\n";
+    cout << "- interval p95:       " << s.intervalP95 / 1000.0 << " ms\n";
+    cout << "- interval p99:       " << s.intervalP99 / 1000.0 << " ms\n";
+    cout << "- max gap:            " << s.intervalMax / 1000.0 << " ms\n";
+    cout << "- jitter:             " << s.jitter / 1000.0 << " ms\n";
+}
+
 void printScene()
 {
     unsigned int screenCount = 0;
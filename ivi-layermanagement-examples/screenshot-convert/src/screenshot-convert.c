@@ -0,0 +1,65 @@
+/***************************************************************************
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+/*
+ * Converts screenshots stored in the fast .qoi, .lz4 or .raw formats, e.g.
+ * collected on target, into any format ilm_saveScreenshot writes. No
+ * compositor is needed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ilm_control.h"
+
+static void usage(int status)
+{
+    fprintf(stderr,
+            "Usage: screenshot-convert <input> <output>\n"
+            "    input:  screenshot file ending in .qoi, .lz4 or .raw\n"
+            "    output: file ending in .png, .bmp, .qoi, .lz4 or .raw\n");
+    exit(status);
+}
+
+int main(int argc, char *argv[])
+{
+    struct ilmScreenshot image;
+    ilmErrorTypes result;
+
+    if (argc != 3) {
+        usage(-1);
+    }
+
+    result = ilm_loadScreenshot(argv[1], &image);
+    if (result != ILM_SUCCESS) {
+        fprintf(stderr, "screenshot-convert: failed to load %s: %s\n",
+                argv[1], ILM_ERROR_STRING(result));
+        return -1;
+    }
+
+    result = ilm_saveScreenshot(&image, argv[2]);
+    ilm_releaseScreenshot(&image);
+
+    if (result != ILM_SUCCESS) {
+        fprintf(stderr, "screenshot-convert: failed to write %s: %s\n",
+                argv[2], ILM_ERROR_STRING(result));
+        return -1;
+    }
+
+    printf("screenshot-convert: %ux%u written to %s\n",
+           image.width, image.height, argv[2]);
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 Advanced Driver Information Technology Joint Venture GmbH
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef IVI_FLIP_H
+#define IVI_FLIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* bytes swapped per memcpy, small enough to stay on the stack and in L1 */
+#define IVI_FLIP_CHUNK 4096
+
+/* Turn an image upside down in place, for renderers which read pixels back
+ * bottom row first. Rows are swapped with memcpy through a small scratch
+ * buffer, so the C library's vector copy does the work instead of a loop
+ * over single pixels.
+ */
+static inline void
+ivi_flip_rows(void *data, size_t stride, int32_t height)
+{
+    uint8_t scratch[IVI_FLIP_CHUNK];
+    uint8_t *top = (uint8_t *)data;
+    uint8_t *bottom;
+    size_t offset, n;
+
+    if (height < 2)
+        return;
+
+    bottom = top + (size_t)(height - 1) * stride;
+    for (; top < bottom; top += stride, bottom -= stride) {
+        for (offset = 0; offset < stride; offset += n) {
+            n = stride - offset;
+            if (n > sizeof scratch)
+                n = sizeof scratch;
+
+            memcpy(scratch, top + offset, n);
+            memcpy(top + offset, bottom + offset, n);
+            memcpy(bottom + offset, scratch, n);
+        }
+    }
+}
+
+#endif /* IVI_FLIP_H */
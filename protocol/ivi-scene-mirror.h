@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 Advanced Driver Information Technology Joint Venture GmbH
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef IVI_SCENE_MIRROR_H
+#define IVI_SCENE_MIRROR_H
+
+#include <stdint.h>
+
+/*
+ * Layout of the shared memory the compositor publishes the scene in, see
+ * ivi_wm.get_scene_mirror. The compositor is the only writer; clients map
+ * the file read-only.
+ *
+ * Every update is framed by the sequence counter: it is odd while the
+ * compositor writes. A reader copies what it needs between
+ * ivi_scene_mirror_read_begin and ivi_scene_mirror_read_retry, and starts
+ * over if the sequence was odd or has changed in between.
+ */
+
+#define IVI_SCENE_MIRROR_MAGIC          0x52494d53  /* "SMIR" */
+#define IVI_SCENE_MIRROR_VERSION        1
+
+#define IVI_SCENE_MIRROR_MAX_SCREENS    16
+#define IVI_SCENE_MIRROR_MAX_LAYERS     256
+#define IVI_SCENE_MIRROR_MAX_SURFACES   1024
+#define IVI_SCENE_MIRROR_MAX_IDS        4096
+
+/* set if the scene did not fit, the lists are cut off */
+#define IVI_SCENE_MIRROR_TRUNCATED      (1 << 0)
+
+struct ivi_scene_mirror_screen {
+    uint32_t id;
+    int32_t width;
+    int32_t height;
+    uint32_t layer_count;
+    uint32_t layer_index;       /* first layer id of the render order in ids */
+    char name[64];              /* connector name, nul terminated */
+};
+
+struct ivi_scene_mirror_layer {
+    uint32_t id;
+    int32_t opacity;            /* wl_fixed_t */
+    int32_t visibility;
+    int32_t source_x;
+    int32_t source_y;
+    int32_t source_width;
+    int32_t source_height;
+    int32_t dest_x;
+    int32_t dest_y;
+    int32_t dest_width;
+    int32_t dest_height;
+    uint32_t surface_count;
+    uint32_t surface_index;     /* first surface id of the render order in ids */
+};
+
+struct ivi_scene_mirror_surface {
+    uint32_t id;
+    int32_t opacity;            /* wl_fixed_t */
+    int32_t visibility;
+    int32_t source_x;
+    int32_t source_y;
+    int32_t source_width;
+    int32_t source_height;
+    int32_t dest_x;
+    int32_t dest_y;
+    int32_t dest_width;
+    int32_t dest_height;
+    int32_t width;              /* size of the attached buffer */
+    int32_t height;
+    uint32_t frame_count;       /* committed frames, updated once per dispatch */
+    uint32_t pid;
+};
+
+struct ivi_scene_mirror {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              /* of the whole mapping */
+    uint32_t sequence;
+    uint32_t commit_count;      /* number of times the scene was published */
+    uint32_t flags;
+    uint32_t screen_count;
+    uint32_t layer_count;
+    uint32_t surface_count;
+    uint32_t id_count;
+    struct ivi_scene_mirror_screen screens[IVI_SCENE_MIRROR_MAX_SCREENS];
+    struct ivi_scene_mirror_layer layers[IVI_SCENE_MIRROR_MAX_LAYERS];
+    struct ivi_scene_mirror_surface surfaces[IVI_SCENE_MIRROR_MAX_SURFACES];
+    uint32_t ids[IVI_SCENE_MIRROR_MAX_IDS];
+};
+
+static inline void
+ivi_scene_mirror_write_begin(struct ivi_scene_mirror *mirror)
+{
+    __atomic_store_n(&mirror->sequence, mirror->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+ivi_scene_mirror_write_end(struct ivi_scene_mirror *mirror)
+{
+    __atomic_store_n(&mirror->sequence, mirror->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/* an odd result means an update is in progress */
+static inline uint32_t
+ivi_scene_mirror_read_begin(const struct ivi_scene_mirror *mirror)
+{
+    return __atomic_load_n(&mirror->sequence, __ATOMIC_ACQUIRE);
+}
+
+static inline int
+ivi_scene_mirror_read_retry(const struct ivi_scene_mirror *mirror,
+                            uint32_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (sequence & 1) ||
+           __atomic_load_n(&mirror->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+#endif /* IVI_SCENE_MIRROR_H */
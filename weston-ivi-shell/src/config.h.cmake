@@ -1 +1,2 @@
 #cmakedefine HAVE_POSIX_FALLOCATE 1
+#cmakedefine HAVE_MEMFD_CREATE 1
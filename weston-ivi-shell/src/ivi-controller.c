@@ -26,18 +26,28 @@
  * ivi-layout.c in weston.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "config.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 
 #include <weston.h>
 #include "ivi-wm-server-protocol.h"
 #include "ivi-controller.h"
+#include "ivi-flip.h"
+#include "ivi-scene-mirror.h"
 
 #include "wayland-util.h"
 
@@ -56,6 +66,9 @@ struct notification {
 
 struct ivilayer {
     struct wl_list link;
+    /* in ivishell.layer_by_layout and layer_by_id */
+    struct ivi_registry_entry layout_entry;
+    struct ivi_registry_entry id_entry;
     struct ivishell *shell;
     struct ivi_layout_layer *layout_layer;
     const struct ivi_layout_layer_properties *prop;
@@ -82,10 +95,68 @@ struct ivicontroller {
     struct wl_list surface_notifications;
 };
 
+/* Part of an output or surface to read back, and the size it is scaled
+ * down to. A width of 0 stands for the whole image.
+ */
+struct screenshot_region {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    int32_t target_width;
+    int32_t target_height;
+};
+
 struct screenshot_frame_listener {
+    struct ivishell *shell;
     struct wl_listener frame_listener;
     struct wl_listener output_destroyed;
     struct wl_resource *screenshot;
+    struct screenshot_region region;
+    /* post-processing on the worker thread, if any */
+    struct screenshot_job *job;
+};
+
+struct ivicapture_buffer {
+    int fd;
+    uint32_t *data;
+    bool busy;
+    /* on the worker, not yet sent to the client */
+    bool queued;
+};
+
+struct ivicapture {
+    /* NULL once the client destroyed it while frames were on the worker */
+    struct wl_resource *resource;
+    struct ivishell *shell;
+    struct weston_output *output;
+    struct wl_listener frame_listener;
+    struct wl_listener output_destroyed;
+    pixman_format_code_t format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    size_t size;
+    uint32_t buffer_count;
+    struct ivicapture_buffer *buffers;
+    /* frames missed since the last frame event */
+    uint32_t dropped;
+    /* frames queued on the screenshot worker */
+    uint32_t jobs;
+};
+
+struct commit_feedback {
+    struct wl_resource *callback;
+    struct weston_compositor *compositor;
+    struct wl_list output_list;
+};
+
+struct commit_feedback_output {
+    struct wl_list link;
+    struct commit_feedback *feedback;
+    struct weston_output *output;
+    struct wl_listener frame_listener;
+    struct wl_listener output_destroyed;
 };
 
 struct screen_id_info {
@@ -93,6 +164,25 @@ struct screen_id_info {
     uint32_t screen_id;
 };
 
+struct scene_mirror {
+    struct ivishell *shell;
+    struct ivi_scene_mirror *data;
+    int fd;
+    /* pending update, the scene is published once per dispatch */
+    struct wl_event_source *idle;
+    /* the pending update only carries frame counts and buffer sizes */
+    bool frames_only;
+};
+
+static void
+scene_mirror_schedule(struct ivishell *shell);
+
+static void
+scene_mirror_flush(struct ivishell *shell);
+
+static void
+ivicapture_job_finish(struct screenshot_job *job);
+
 static void
 clear_notification_list(struct wl_list* notification_list)
 {
@@ -125,32 +215,136 @@ unbind_resource_controller(struct wl_resource *resource)
     controller = NULL;
 }
 
-static struct ivisurface*
-get_surface(struct wl_list *list_surf, struct ivi_layout_surface *layout_surface)
+#define IVI_REGISTRY_INITIAL_SHIFT 6
+
+static int
+ivi_registry_alloc(struct ivi_registry *registry, uint32_t shift)
 {
-    struct ivisurface *ivisurf = NULL;
+    struct ivi_registry resized;
+    struct ivi_registry_entry *entry, *next;
+    uint32_t i, size = 1u << shift;
 
-    wl_list_for_each(ivisurf, list_surf, link) {
-        if (layout_surface == ivisurf->layout_surface) {
-            return ivisurf;
+    resized.buckets = malloc(size * sizeof *resized.buckets);
+    if (resized.buckets == NULL)
+        return -1;
+
+    resized.shift = shift;
+    for (i = 0; i < size; i++)
+        wl_list_init(&resized.buckets[i]);
+
+    if (registry->buckets != NULL) {
+        uint32_t old_size = 1u << registry->shift;
+
+        for (i = 0; i < old_size; i++) {
+            wl_list_for_each_safe(entry, next, &registry->buckets[i], link) {
+                wl_list_remove(&entry->link);
+                wl_list_insert(ivi_registry_bucket(&resized, entry->key),
+                               &entry->link);
+            }
         }
+        free(registry->buckets);
     }
 
-    return NULL;
+    registry->buckets = resized.buckets;
+    registry->shift = shift;
+    return 0;
 }
 
-static struct ivilayer*
-get_layer(struct wl_list *list_layer, struct ivi_layout_layer *layout_layer)
+static int
+ivi_registry_init(struct ivi_registry *registry)
 {
-    struct ivilayer *ivilayer = NULL;
+    registry->buckets = NULL;
+    registry->count = 0;
+    return ivi_registry_alloc(registry, IVI_REGISTRY_INITIAL_SHIFT);
+}
 
-    wl_list_for_each(ivilayer, list_layer, link) {
-        if (layout_layer == ivilayer->layout_layer) {
-            return ivilayer;
-        }
+static void
+ivi_registry_release(struct ivi_registry *registry)
+{
+    free(registry->buckets);
+    registry->buckets = NULL;
+    registry->count = 0;
+}
+
+static void
+ivi_registry_insert(struct ivi_registry *registry,
+                    struct ivi_registry_entry *entry, uintptr_t key)
+{
+    entry->key = key;
+
+    if (registry->buckets == NULL) {
+        wl_list_init(&entry->link);
+        return;
     }
 
-    return NULL;
+    /* keep the load factor below two, a failed resize only costs speed */
+    if ((registry->count >> 1) >= (1u << registry->shift) &&
+        registry->shift < 24)
+        ivi_registry_alloc(registry, registry->shift + 1);
+
+    wl_list_insert(ivi_registry_bucket(registry, key), &entry->link);
+    registry->count++;
+}
+
+static void
+ivi_registry_remove(struct ivi_registry *registry,
+                    struct ivi_registry_entry *entry)
+{
+    if (wl_list_empty(&entry->link))
+        return;
+
+    wl_list_remove(&entry->link);
+    wl_list_init(&entry->link);
+    registry->count--;
+}
+
+static struct ivilayer *
+get_layer(struct ivishell *shell, struct ivi_layout_layer *layout_layer)
+{
+    struct ivi_registry_entry *entry;
+    struct ivilayer *ivilayer;
+
+    entry = ivi_registry_lookup(&shell->layer_by_layout,
+                                (uintptr_t)layout_layer);
+    if (entry == NULL)
+        return NULL;
+
+    return wl_container_of(entry, ivilayer, layout_entry);
+}
+
+/* ivi-layout resolves ids with a walk over all its objects, the
+ * registry is asked first.
+ */
+static struct ivi_layout_surface *
+get_layout_surface(struct ivishell *shell, uint32_t surface_id)
+{
+    const struct ivi_layout_interface *lyt = shell->interface;
+    struct ivi_registry_entry *entry;
+    struct ivisurface *ivisurf;
+
+    entry = ivi_registry_lookup(&shell->surface_by_id, surface_id);
+    if (entry != NULL) {
+        ivisurf = wl_container_of(entry, ivisurf, id_entry);
+        if (lyt->get_id_of_surface(ivisurf->layout_surface) == surface_id)
+            return ivisurf->layout_surface;
+    }
+
+    return lyt->get_surface_from_id(surface_id);
+}
+
+static struct ivi_layout_layer *
+get_layout_layer(struct ivishell *shell, uint32_t layer_id)
+{
+    struct ivi_registry_entry *entry;
+    struct ivilayer *ivilayer;
+
+    entry = ivi_registry_lookup(&shell->layer_by_id, layer_id);
+    if (entry != NULL) {
+        ivilayer = wl_container_of(entry, ivilayer, id_entry);
+        return ivilayer->layout_layer;
+    }
+
+    return shell->interface->get_layer_from_id(layer_id);
 }
 
 static void
@@ -223,6 +417,8 @@ send_surface_prop(struct wl_listener *listener, void *data)
         ctrl = wl_resource_get_user_data(not->resource);
         send_surface_event(ctrl, ivisurf->layout_surface, surface_id, ivisurf->prop, mask);
     }
+
+    scene_mirror_schedule(ivisurf->shell);
 }
 
 static void
@@ -270,6 +466,8 @@ send_layer_prop(struct wl_listener *listener, void *data)
         ctrl = wl_resource_get_user_data(not->resource);
         send_layer_event(ctrl, ivilayer->layout_layer, layer_id, ivilayer->prop, mask);
     }
+
+    scene_mirror_schedule(ivilayer->shell);
 }
 
 static void
@@ -283,7 +481,7 @@ controller_set_surface_opacity(struct wl_client *client,
     (void)client;
     struct ivi_layout_surface *layout_surface;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -309,7 +507,7 @@ controller_set_surface_source_rectangle(struct wl_client *client,
     struct ivi_layout_surface *layout_surface;
     const struct ivi_layout_surface_properties *prop;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -347,7 +545,7 @@ controller_set_surface_destination_rectangle(struct wl_client *client,
     struct ivi_layout_surface *layout_surface;
     const struct ivi_layout_surface_properties *prop;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -387,7 +585,7 @@ controller_set_surface_visibility(struct wl_client *client,
     (void)client;
     struct ivi_layout_surface *layout_surface;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -435,11 +633,388 @@ create_screenshot_file(off_t size) {
     return fd;
 }
 
+/* Anonymous memory shared with clients. Without memfd_create it falls back
+ * to an unlinked file in XDG_RUNTIME_DIR.
+ */
+static int
+create_shm_file(const char *name, off_t size)
+{
+#ifdef HAVE_MEMFD_CREATE
+    int fd;
+
+    fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        if (ftruncate(fd, size) < 0) {
+            close(fd);
+            return -1;
+        }
+
+        /* clients must not be able to resize the memory under us */
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+        return fd;
+    }
+#else
+    (void)name;
+#endif
+
+    return create_screenshot_file(size);
+}
+
+/* number of idle screenshot buffers kept for reuse, per client */
+#define SCREENSHOT_POOL_SIZE 4
+
+/* A client can keep the file of a released screenshot open, so its buffers
+ * are only ever reused for screenshots of the same client.
+ */
+struct screenshot_pool {
+    /* in ivishell.screenshot_pools while the client exists */
+    struct wl_list link;
+    /* NULL once the client is destroyed */
+    struct wl_client *client;
+    struct wl_listener client_destroy;
+    /* idle buffers, most recently released first */
+    struct wl_list free;
+    /* buffers sent to the client and not yet released */
+    struct wl_list held;
+    /* buffers handed out, held or still being written */
+    uint32_t outstanding;
+};
+
+struct screenshot_buffer {
+    /* in screenshot_pool.free or held */
+    struct wl_list link;
+    struct screenshot_pool *pool;
+    int fd;
+    void *data;
+    size_t size;
+    struct wl_listener screenshot_destroy;
+};
+
+static void
+screenshot_buffer_destroy(struct screenshot_buffer *buffer)
+{
+    wl_list_remove(&buffer->link);
+    munmap(buffer->data, buffer->size);
+    close(buffer->fd);
+    free(buffer);
+}
+
 static void
-controller_surface_screenshot(struct wl_client *client,
-                              struct wl_resource *resource,
-                              uint32_t screenshot_id,
-                              uint32_t surface_id)
+screenshot_pool_destroy(struct screenshot_pool *pool)
+{
+    struct screenshot_buffer *buffer, *next;
+
+    wl_list_for_each_safe(buffer, next, &pool->held, link) {
+        wl_list_remove(&buffer->screenshot_destroy.link);
+        screenshot_buffer_destroy(buffer);
+    }
+
+    wl_list_for_each_safe(buffer, next, &pool->free, link)
+        screenshot_buffer_destroy(buffer);
+
+    if (pool->client != NULL)
+        wl_list_remove(&pool->client_destroy.link);
+
+    wl_list_remove(&pool->link);
+    free(pool);
+}
+
+/* Buffers still being written outlive the client, the pool goes with
+ * the last of them.
+ */
+static void
+screenshot_pool_client_destroyed(struct wl_listener *listener, void *data)
+{
+    struct screenshot_pool *pool =
+        wl_container_of(listener, pool, client_destroy);
+    struct screenshot_buffer *buffer, *next;
+    (void)data;
+
+    pool->client = NULL;
+    wl_list_remove(&pool->link);
+    wl_list_init(&pool->link);
+
+    wl_list_for_each_safe(buffer, next, &pool->free, link)
+        screenshot_buffer_destroy(buffer);
+
+    if (pool->outstanding == 0)
+        screenshot_pool_destroy(pool);
+}
+
+static struct screenshot_pool *
+screenshot_pool_get(struct ivishell *shell, struct wl_client *client)
+{
+    struct screenshot_pool *pool;
+
+    wl_list_for_each(pool, &shell->screenshot_pools, link) {
+        if (pool->client == client)
+            return pool;
+    }
+
+    pool = calloc(1, sizeof *pool);
+    if (pool == NULL)
+        return NULL;
+
+    pool->client = client;
+    wl_list_init(&pool->free);
+    wl_list_init(&pool->held);
+    pool->client_destroy.notify = screenshot_pool_client_destroyed;
+    wl_client_add_destroy_listener(client, &pool->client_destroy);
+    wl_list_insert(&shell->screenshot_pools, &pool->link);
+    return pool;
+}
+
+/* Take the smallest idle buffer of the client which holds size bytes and is
+ * at most twice as large, so the pages the last screenshot of an output
+ * touched are written again. The part beyond size is cleared, it would
+ * still show the end of an earlier, larger screenshot.
+ */
+static struct screenshot_buffer *
+screenshot_buffer_get(struct ivishell *shell, struct wl_client *client,
+                      size_t size)
+{
+    struct screenshot_pool *pool;
+    struct screenshot_buffer *buffer, *best = NULL;
+
+    pool = screenshot_pool_get(shell, client);
+    if (pool == NULL)
+        return NULL;
+
+    wl_list_for_each(buffer, &pool->free, link) {
+        if (buffer->size >= size && buffer->size / 2 <= size &&
+            (best == NULL || buffer->size < best->size))
+            best = buffer;
+    }
+
+    if (best != NULL) {
+        wl_list_remove(&best->link);
+        wl_list_init(&best->link);
+        memset((char *)best->data + size, 0, best->size - size);
+        pool->outstanding++;
+        return best;
+    }
+
+    buffer = calloc(1, sizeof *buffer);
+    if (buffer == NULL)
+        return NULL;
+
+    buffer->fd = create_shm_file("ivi-screenshot", size);
+    if (buffer->fd < 0) {
+        weston_log("screenshot: failed to create file of %zu bytes: %m\n",
+                   size);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        buffer->fd, 0);
+    if (buffer->data == MAP_FAILED) {
+        weston_log("screenshot: failed to mmap %zu bytes: %m\n", size);
+        close(buffer->fd);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->pool = pool;
+    buffer->size = size;
+    wl_list_init(&buffer->link);
+    pool->outstanding++;
+    return buffer;
+}
+
+/* Drop a handed out buffer instead of reusing it */
+static void
+screenshot_buffer_discard(struct screenshot_buffer *buffer)
+{
+    struct screenshot_pool *pool = buffer->pool;
+
+    screenshot_buffer_destroy(buffer);
+    if (--pool->outstanding == 0 && pool->client == NULL)
+        screenshot_pool_destroy(pool);
+}
+
+static void
+screenshot_buffer_put(struct screenshot_buffer *buffer)
+{
+    struct screenshot_pool *pool = buffer->pool;
+    struct screenshot_buffer *oldest;
+
+    if (pool->client == NULL) {
+        screenshot_buffer_discard(buffer);
+        return;
+    }
+
+    pool->outstanding--;
+    wl_list_remove(&buffer->link);
+    wl_list_insert(&pool->free, &buffer->link);
+
+    if (wl_list_length(&pool->free) > SCREENSHOT_POOL_SIZE) {
+        oldest = wl_container_of(pool->free.prev, oldest, link);
+        screenshot_buffer_destroy(oldest);
+    }
+}
+
+static void
+screenshot_buffer_released(struct wl_listener *listener, void *data)
+{
+    struct screenshot_buffer *buffer =
+        wl_container_of(listener, buffer, screenshot_destroy);
+    (void)data;
+
+    screenshot_buffer_put(buffer);
+}
+
+/* Send the buffer with the done event. Objects before version 6 are never
+ * released, their clients keep the file, so it cannot be used again.
+ */
+static void
+screenshot_buffer_send(struct screenshot_buffer *buffer,
+                       struct wl_resource *screenshot,
+                       int32_t width, int32_t height, int32_t stride,
+                       uint32_t format, uint32_t timestamp)
+{
+    ivi_screenshot_send_done(screenshot, buffer->fd, width, height, stride,
+                             format, timestamp);
+
+    if (wl_resource_get_version(screenshot) <
+        IVI_SCREENSHOT_DESTROY_SINCE_VERSION) {
+        screenshot_buffer_discard(buffer);
+        return;
+    }
+
+    wl_list_insert(&buffer->pool->held, &buffer->link);
+    buffer->screenshot_destroy.notify = screenshot_buffer_released;
+    wl_resource_add_destroy_listener(screenshot, &buffer->screenshot_destroy);
+}
+
+static void
+screenshot_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+    (void)client;
+
+    wl_resource_destroy(resource);
+}
+
+static const struct ivi_screenshot_interface screenshot_implementation = {
+    screenshot_destroy
+};
+
+/* From version 6 on the client destroys the screenshot object */
+static void
+screenshot_finish(struct wl_resource *screenshot)
+{
+    if (wl_resource_get_version(screenshot) <
+        IVI_SCREENSHOT_DESTROY_SINCE_VERSION)
+        wl_resource_destroy(screenshot);
+}
+
+/* Resolve a requested region against an image of width x height. Returns
+ * -1 if it does not fit, or the target is larger than the region.
+ */
+static int
+screenshot_region_fit(struct screenshot_region *region,
+                      int32_t width, int32_t height)
+{
+    if (region->width == 0) {
+        region->x = 0;
+        region->y = 0;
+        region->width = width;
+        region->height = height;
+    }
+
+    if (region->target_width == 0)
+        region->target_width = region->width;
+    if (region->target_height == 0)
+        region->target_height = region->height;
+
+    if (region->x < 0 || region->y < 0 ||
+        region->width <= 0 || region->height <= 0 ||
+        region->width > width - region->x ||
+        region->height > height - region->y ||
+        region->target_width <= 0 || region->target_height <= 0 ||
+        region->target_width > region->width ||
+        region->target_height > region->height)
+        return -1;
+
+    return 0;
+}
+
+static bool
+screenshot_region_scaled(const struct screenshot_region *region)
+{
+    return region->target_width != region->width ||
+           region->target_height != region->height;
+}
+
+/* Scale a 32 bit image down with a box filter: every destination pixel is
+ * the average of the source pixels it covers, per byte, so the pixel format
+ * does not matter. src_pitch is the distance between source rows in pixels;
+ * a negative pitch from the last row reads the image upside down.
+ */
+static int
+downsample_box(const uint32_t *src, ptrdiff_t src_pitch,
+               int32_t src_width, int32_t src_height,
+               uint32_t *dst, int32_t dst_width, int32_t dst_height)
+{
+    uint64_t *sums;
+    int32_t *columns;
+    int32_t dx, dy, sx, sy, c;
+
+    sums = malloc(dst_width * 4 * sizeof *sums);
+    columns = malloc((dst_width + 1) * sizeof *columns);
+    if (sums == NULL || columns == NULL) {
+        free(sums);
+        free(columns);
+        return -1;
+    }
+
+    for (dx = 0; dx <= dst_width; ++dx)
+        columns[dx] = (int64_t)dx * src_width / dst_width;
+
+    for (dy = 0; dy < dst_height; ++dy) {
+        int32_t y0 = (int64_t)dy * src_height / dst_height;
+        int32_t y1 = (int64_t)(dy + 1) * src_height / dst_height;
+
+        memset(sums, 0, dst_width * 4 * sizeof *sums);
+        for (sy = y0; sy < y1; ++sy) {
+            const uint32_t *row = src + sy * src_pitch;
+
+            for (dx = 0; dx < dst_width; ++dx) {
+                uint64_t *sum = sums + dx * 4;
+
+                for (sx = columns[dx]; sx < columns[dx + 1]; ++sx) {
+                    uint32_t pixel = row[sx];
+                    sum[0] += pixel & 0xff;
+                    sum[1] += (pixel >> 8) & 0xff;
+                    sum[2] += (pixel >> 16) & 0xff;
+                    sum[3] += pixel >> 24;
+                }
+            }
+        }
+
+        for (dx = 0; dx < dst_width; ++dx) {
+            uint64_t count = (uint64_t)(columns[dx + 1] - columns[dx]) *
+                             (y1 - y0);
+            uint32_t pixel = 0;
+
+            for (c = 0; c < 4; ++c)
+                pixel |= (uint32_t)((sums[dx * 4 + c] + count / 2) / count)
+                         << (c * 8);
+            dst[(size_t)dy * dst_width + dx] = pixel;
+        }
+    }
+
+    free(columns);
+    free(sums);
+    return 0;
+}
+
+static void
+surface_screenshot(struct wl_client *client,
+                   struct wl_resource *resource,
+                   uint32_t screenshot_id,
+                   uint32_t surface_id,
+                   struct screenshot_region region)
 {
     int32_t result = IVI_FAILED;
     struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
@@ -450,24 +1025,28 @@ controller_surface_screenshot(struct wl_client *client,
     int32_t size = 0;
     const struct ivi_layout_interface *lyt = ctrl->shell->interface;
     struct ivi_layout_surface *layout_surface;
-    char *buffer = NULL;
+    struct screenshot_buffer *buffer;
+    uint32_t *region_pixels = NULL;
     struct weston_compositor *compositor = ctrl->shell->compositor;
     // assuming ABGR32 is always written by surface_dump
     uint32_t format = WL_SHM_FORMAT_ABGR8888;
     struct wl_resource *screenshot;
     struct timespec stamp;
     uint32_t stamp_ms;
-    int fd;
 
     screenshot =
-        wl_resource_create(client, &ivi_screenshot_interface, 1, screenshot_id);
+        wl_resource_create(client, &ivi_screenshot_interface,
+                           wl_resource_get_version(resource), screenshot_id);
 
     if (screenshot == NULL) {
         wl_client_post_no_memory(client);
         return;
     }
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    wl_resource_set_implementation(screenshot, &screenshot_implementation,
+                                   NULL, NULL);
+
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_screenshot_send_error(
             screenshot, IVI_SCREENSHOT_ERROR_NO_SURFACE,
@@ -484,54 +1063,198 @@ controller_surface_screenshot(struct wl_client *client,
         goto err;
     }
 
-    size = stride * height;
-
-    fd = create_screenshot_file(size);
-    if (fd < 0) {
-        weston_log(
-            "surface_screenshot: failed to create file of %d bytes: %m\n",
-            size);
+    if (screenshot_region_fit(&region, width, height) < 0) {
         ivi_screenshot_send_error(
-            screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
-            "failed to create screenshot file");
+            screenshot, IVI_SCREENSHOT_ERROR_INVALID_REGION,
+            "surface_screenshot: region does not fit the surface");
         goto err;
     }
 
-    buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (buffer == MAP_FAILED) {
-        weston_log("surface_screenshot: failed to mmap %d bytes: %m\n", size);
-        ivi_screenshot_send_error(screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
-                                  "failed to create screenshot");
-        goto err_mmap;
+    // surface_dump writes rows of 4 bytes per pixel without padding
+    stride = region.target_width * 4;
+    size = stride * region.target_height;
+
+    buffer = screenshot_buffer_get(ctrl->shell, client, size);
+    if (buffer == NULL) {
+        ivi_screenshot_send_error(
+            screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
+            "failed to create screenshot file");
+        goto err;
     }
 
     weston_surface = lyt->surface_get_weston_surface(layout_surface);
 
-    result = lyt->surface_dump(weston_surface, buffer, size, 0, 0,
-                               width, height);
+    if (screenshot_region_scaled(&region)) {
+        region_pixels = malloc((size_t)region.width * region.height * 4);
+        if (region_pixels == NULL) {
+            ivi_screenshot_send_error(screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
+                                      "failed to allocate screenshot region");
+            goto err_readpix;
+        }
+
+        result = lyt->surface_dump(weston_surface, region_pixels,
+                                   region.width * region.height * 4,
+                                   region.x, region.y,
+                                   region.width, region.height);
+    } else {
+        result = lyt->surface_dump(weston_surface, buffer->data, size,
+                                   region.x, region.y,
+                                   region.width, region.height);
+    }
 
     if (result != IVI_SUCCEEDED) {
         ivi_screenshot_send_error(
-            resource, IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
+            screenshot, IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
             "surface_screenshot: surface dumping is not supported by renderer");
         goto err_readpix;
     }
 
+    if (region_pixels != NULL &&
+        downsample_box(region_pixels, region.width,
+                       region.width, region.height,
+                       buffer->data, region.target_width,
+                       region.target_height) < 0) {
+        ivi_screenshot_send_error(screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
+                                  "failed to scale screenshot");
+        goto err_readpix;
+    }
+
     // get current timestamp
     weston_compositor_read_presentation_clock(compositor, &stamp);
     stamp_ms = stamp.tv_sec * 1000 + stamp.tv_nsec / 1000000;
 
-    ivi_screenshot_send_done(screenshot, fd, width, height, stride, format,
-                             stamp_ms);
+    screenshot_buffer_send(buffer, screenshot, region.target_width,
+                           region.target_height, stride, format, stamp_ms);
+    buffer = NULL;
 
 err_readpix:
-    munmap(buffer, size);
-err_mmap:
-    close(fd);
+    free(region_pixels);
+    if (buffer != NULL)
+        screenshot_buffer_put(buffer);
 err:
-    wl_resource_destroy(screenshot);
+    screenshot_finish(screenshot);
+}
+
+static void
+controller_surface_screenshot(struct wl_client *client,
+                              struct wl_resource *resource,
+                              uint32_t screenshot_id,
+                              uint32_t surface_id)
+{
+    struct screenshot_region region = { 0 };
+
+    surface_screenshot(client, resource, screenshot_id, surface_id, region);
+}
+
+static void
+controller_surface_screenshot_region(struct wl_client *client,
+                                     struct wl_resource *resource,
+                                     uint32_t screenshot_id,
+                                     uint32_t surface_id,
+                                     int32_t x, int32_t y,
+                                     int32_t width, int32_t height,
+                                     int32_t target_width,
+                                     int32_t target_height)
+{
+    struct screenshot_region region = {
+        x, y, width, height, target_width, target_height
+    };
+
+    // an empty region must not select the whole surface
+    if (width <= 0 || height <= 0)
+        region.width = -1;
+
+    surface_screenshot(client, resource, screenshot_id, surface_id, region);
+}
+
+struct frame_stats {
+    uint32_t frames;
+    double fps;
+    uint32_t interval_p50;
+    uint32_t interval_p95;
+    uint32_t interval_p99;
+    uint32_t interval_max;
+    uint32_t jitter;
+};
+
+static void
+frame_times_record(struct ivi_frame_times *times, uint64_t commit_us)
+{
+    times->commit_us[times->next] = commit_us;
+    times->next = (times->next + 1) % IVI_FRAME_TIMES;
+    if (times->count < IVI_FRAME_TIMES)
+        times->count++;
+}
+
+static int
+compare_interval(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of sorted intervals */
+static uint32_t
+interval_percentile(const uint32_t *sorted, uint32_t count, uint32_t percent)
+{
+    uint32_t rank = (count * percent + 99) / 100;
+
+    return sorted[rank > 0 ? rank - 1 : 0];
 }
 
+/* Derive the frame timing from the commit times. Only called when a client
+ * asks for it, commits just store their time. The time since the last commit
+ * counts as an interval for interval_max, so a surface which stopped
+ * committing shows up.
+ */
+static void
+frame_times_get_stats(const struct ivi_frame_times *times, uint64_t now_us,
+                      struct frame_stats *stats)
+{
+    uint32_t intervals[IVI_FRAME_TIMES - 1];
+    uint32_t sorted[IVI_FRAME_TIMES - 1];
+    uint32_t first = (times->next + IVI_FRAME_TIMES - times->count) %
+                     IVI_FRAME_TIMES;
+    uint64_t previous, current, jitter_sum = 0;
+    uint32_t i;
+
+    memset(stats, 0, sizeof *stats);
+    if (times->count < 2)
+        return;
+
+    stats->frames = times->count - 1;
+    previous = times->commit_us[first];
+    for (i = 0; i < stats->frames; ++i) {
+        current = times->commit_us[(first + i + 1) % IVI_FRAME_TIMES];
+        intervals[i] = current - previous > UINT32_MAX ?
+                       UINT32_MAX : (uint32_t)(current - previous);
+        previous = current;
+
+        if (i > 0)
+            jitter_sum += intervals[i] > intervals[i - 1] ?
+                          intervals[i] - intervals[i - 1] :
+                          intervals[i - 1] - intervals[i];
+    }
+
+    if (previous > times->commit_us[first])
+        stats->fps = stats->frames * 1000000.0 /
+                     (previous - times->commit_us[first]);
+
+    memcpy(sorted, intervals, stats->frames * sizeof *sorted);
+    qsort(sorted, stats->frames, sizeof *sorted, compare_interval);
+
+    stats->interval_p50 = interval_percentile(sorted, stats->frames, 50);
+    stats->interval_p95 = interval_percentile(sorted, stats->frames, 95);
+    stats->interval_p99 = interval_percentile(sorted, stats->frames, 99);
+    stats->interval_max = sorted[stats->frames - 1];
+    if (now_us > previous && now_us - previous > stats->interval_max)
+        stats->interval_max = now_us - previous > UINT32_MAX ?
+                              UINT32_MAX : (uint32_t)(now_us - previous);
+    if (stats->frames > 1)
+        stats->jitter = jitter_sum / (stats->frames - 1);
+}
 
 static void
 send_surface_stats(struct ivicontroller *ctrl,
@@ -546,7 +1269,7 @@ send_surface_stats(struct ivicontroller *ctrl,
     uid_t uid;
     gid_t gid;
 
-    ivisurf = get_surface(&ctrl->shell->list_surface, layout_surface);
+    ivisurf = ivi_shell_get_surface(ctrl->shell, layout_surface);
 
     /* Get pid that creates surface */
     surface = lyt->surface_get_weston_surface(layout_surface);
@@ -556,6 +1279,25 @@ send_surface_stats(struct ivicontroller *ctrl,
     wl_client_get_credentials(target_client, &pid, &uid, &gid);
 
     ivi_wm_send_surface_stats(ctrl->resource, surface_id, ivisurf->frame_count, pid);
+
+    if (wl_resource_get_version(ctrl->resource) >=
+        IVI_WM_SURFACE_FRAME_STATS_SINCE_VERSION) {
+        struct frame_stats stats;
+        struct timespec now;
+
+        weston_compositor_read_presentation_clock(ctrl->shell->compositor,
+                                                  &now);
+        frame_times_get_stats(&ivisurf->frame_times,
+                              (uint64_t)now.tv_sec * 1000000 +
+                              now.tv_nsec / 1000, &stats);
+        ivi_wm_send_surface_frame_stats(ctrl->resource, surface_id,
+                                        stats.frames,
+                                        wl_fixed_from_double(stats.fps),
+                                        stats.interval_p50,
+                                        stats.interval_p95,
+                                        stats.interval_p99,
+                                        stats.interval_max, stats.jitter);
+    }
 }
 
 static void
@@ -565,13 +1307,12 @@ controller_surface_sync(struct wl_client *client,
                               int32_t sync_state)
 {
     struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
-    const struct ivi_layout_interface *lyt = ctrl->shell->interface;
     struct ivi_layout_surface *layout_surface;
     struct ivisurface *ivisurf;
     (void)client;
     struct notification *not;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -579,7 +1320,7 @@ controller_surface_sync(struct wl_client *client,
         return;
     }
 
-    ivisurf = get_surface(&ctrl->shell->list_surface, layout_surface);
+    ivisurf = ivi_shell_get_surface(ctrl->shell, layout_surface);
 
     switch (sync_state) {
     case IVI_WM_SYNC_ADD:
@@ -617,12 +1358,11 @@ controller_set_surface_type(struct wl_client *client, struct wl_resource *resour
                             uint32_t surface_id, int32_t type)
 {
     struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
-    const struct ivi_layout_interface *lyt = ctrl->shell->interface;
     (void)client;
     struct ivi_layout_surface *layout_surface;
     struct ivisurface *ivisurf;
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -630,7 +1370,7 @@ controller_set_surface_type(struct wl_client *client, struct wl_resource *resour
         return;
     }
 
-    ivisurf = get_surface(&ctrl->shell->list_surface, layout_surface);
+    ivisurf = ivi_shell_get_surface(ctrl->shell, layout_surface);
     ivisurf->type = type;
 }
 
@@ -667,7 +1407,7 @@ controller_surface_get(struct wl_client *client, struct wl_resource *resource,
 
     mask = convert_protocol_enum(param);
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_surface_error(resource, surface_id,
                                   IVI_WM_SURFACE_ERROR_NO_SURFACE,
@@ -696,7 +1436,7 @@ controller_set_layer_source_rectangle(struct wl_client *client,
     struct ivi_layout_layer *layout_layer;
     const struct ivi_layout_layer_properties *prop;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -734,7 +1474,7 @@ controller_set_layer_destination_rectangle(struct wl_client *client,
     struct ivi_layout_layer *layout_layer;
     const struct ivi_layout_layer_properties *prop;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -768,7 +1508,7 @@ controller_set_layer_visibility(struct wl_client *client,
     (void)client;
     struct ivi_layout_layer *layout_layer;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -790,7 +1530,7 @@ controller_set_layer_opacity(struct wl_client *client,
     (void)client;
     struct ivi_layout_layer *layout_layer;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -811,7 +1551,7 @@ controller_layer_clear(struct wl_client *client,
     (void)client;
     struct ivi_layout_layer *layout_layer;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -924,7 +1664,7 @@ controller_layer_add_surface(struct wl_client *client,
     struct ivi_layout_layer *layout_layer;
     struct ivi_layout_surface *layout_surface;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -932,7 +1672,7 @@ controller_layer_add_surface(struct wl_client *client,
         return;
     }
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_layer_error(resource, surface_id,
                                 IVI_WM_LAYER_ERROR_NO_SURFACE,
@@ -955,7 +1695,7 @@ controller_layer_remove_surface(struct wl_client *client,
     struct ivi_layout_layer *layout_layer;
     struct ivi_layout_surface *layout_surface;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -963,7 +1703,7 @@ controller_layer_remove_surface(struct wl_client *client,
         return;
     }
 
-    layout_surface = lyt->get_surface_from_id(surface_id);
+    layout_surface = get_layout_surface(ctrl->shell, surface_id);
     if (!layout_surface) {
         ivi_wm_send_layer_error(resource, surface_id,
                                 IVI_WM_LAYER_ERROR_NO_SURFACE,
@@ -981,13 +1721,12 @@ controller_layer_sync(struct wl_client *client,
                       int32_t sync_state)
 {
     struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
-    const struct ivi_layout_interface *lyt = ctrl->shell->interface;
     struct ivi_layout_layer *layout_layer;
     struct ivilayer *ivilayer;
     (void)client;
     struct notification *not;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -995,7 +1734,7 @@ controller_layer_sync(struct wl_client *client,
         return;
     }
 
-    ivilayer = get_layer(&ctrl->shell->list_layer, layout_layer);
+    ivilayer = get_layer(ctrl->shell, layout_layer);
 
     switch (sync_state) {
     case IVI_WM_SYNC_ADD:
@@ -1011,7 +1750,7 @@ controller_layer_sync(struct wl_client *client,
         not->resource = resource;
         break;
     case IVI_WM_SYNC_REMOVE:
-        ivilayer = get_layer(&ctrl->shell->list_layer, layout_layer);
+        ivilayer = get_layer(ctrl->shell, layout_layer);
 
         wl_list_for_each(not, &ivilayer->notification_list, layout_link)
         {
@@ -1054,7 +1793,7 @@ controller_destroy_layout_layer(struct wl_client *client,
     (void)client;
     struct ivi_layout_layer *layout_layer;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -1079,7 +1818,7 @@ controller_layer_get(struct wl_client *client, struct wl_resource *resource,
     int32_t surface_count, i;
     uint32_t id;
 
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(ctrl->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_send_layer_error(resource, layer_id,
                                 IVI_WM_LAYER_ERROR_NO_LAYER,
@@ -1145,7 +1884,7 @@ controller_screen_add_layer(struct wl_client *client,
     }
 
     lyt = iviscrn->shell->interface;
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(iviscrn->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_screen_send_error(resource, IVI_WM_SCREEN_ERROR_NO_LAYER,
                                  "the layer with given id does not exist");
@@ -1173,7 +1912,7 @@ controller_screen_remove_layer(struct wl_client *client,
     }
 
     lyt = iviscrn->shell->interface;
-    layout_layer = lyt->get_layer_from_id(layer_id);
+    layout_layer = get_layout_layer(iviscrn->shell, layer_id);
     if (!layout_layer) {
         ivi_wm_screen_send_error(resource, IVI_WM_SCREEN_ERROR_NO_LAYER,
                                  "the layer with given id does not exist");
@@ -1181,260 +1920,1505 @@ controller_screen_remove_layer(struct wl_client *client,
         return;
     }
 
-    lyt->screen_remove_layer(iviscrn->output, layout_layer);
+    lyt->screen_remove_layer(iviscrn->output, layout_layer);
+}
+
+static int
+shm_format_from_pixman(pixman_format_code_t format, uint32_t *shm_format)
+{
+    switch (format) {
+    case PIXMAN_a8r8g8b8:
+        *shm_format = WL_SHM_FORMAT_ARGB8888;
+        return 0;
+    case PIXMAN_x8r8g8b8:
+        *shm_format = WL_SHM_FORMAT_XRGB8888;
+        return 0;
+    case PIXMAN_a8b8g8r8:
+        *shm_format = WL_SHM_FORMAT_ABGR8888;
+        return 0;
+    case PIXMAN_x8b8g8r8:
+        *shm_format = WL_SHM_FORMAT_XBGR8888;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/* Pixels read back in a frame signal, processed on the worker thread */
+struct screenshot_job {
+    struct wl_list link;
+    /* NULL once the client destroyed the screenshot object */
+    struct wl_resource *screenshot;
+    struct screenshot_buffer *buffer;
+    struct screenshot_region region;
+    uint32_t *region_pixels;
+    bool flip;
+    int32_t stride;
+    uint32_t shm_format;
+    uint32_t timestamp;
+    uint32_t error;
+    const char *message;
+    /* set instead of screenshot and buffer for a frame of an ivi_capture */
+    struct ivicapture *capture;
+    uint32_t capture_index;
+    struct timespec frame_time;
+    uint32_t dropped;
+};
+
+/* The repaint path only reads the pixels back. Flipping and scaling them
+ * into the client's buffer, and flipping ivi_capture frames, run on one
+ * thread, which wakes the main loop through an eventfd to send the result.
+ */
+struct screenshot_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct wl_list pending;
+    struct wl_list done;
+    bool quit;
+    int fd;
+    struct wl_event_source *source;
+};
+
+static void
+screenshot_job_process(struct screenshot_job *job)
+{
+    struct screenshot_region *region = &job->region;
+    const uint32_t *src = job->region_pixels;
+    ptrdiff_t pitch = region->width;
+
+    if (job->capture != NULL) {
+        ivi_flip_rows(job->capture->buffers[job->capture_index].data,
+                      job->capture->stride, job->capture->height);
+        return;
+    }
+
+    if (src == NULL) {
+        if (job->flip)
+            ivi_flip_rows(job->buffer->data, (size_t)region->width * 4,
+                          region->height);
+        return;
+    }
+
+    // scaling reads the rows bottom up, there is no separate flip pass
+    if (job->flip) {
+        src += (size_t)(region->height - 1) * region->width;
+        pitch = -pitch;
+    }
+
+    if (downsample_box(src, pitch, region->width, region->height,
+                       job->buffer->data, region->target_width,
+                       region->target_height) < 0) {
+        job->error = IVI_SCREENSHOT_ERROR_IO_ERROR;
+        job->message = "failed to scale screenshot";
+    }
+}
+
+static void
+screenshot_job_finish(struct screenshot_job *job)
+{
+    struct screenshot_frame_listener *l;
+
+    if (job->capture != NULL) {
+        ivicapture_job_finish(job);
+        return;
+    }
+
+    free(job->region_pixels);
+
+    if (job->screenshot == NULL) {
+        screenshot_buffer_put(job->buffer);
+        free(job);
+        return;
+    }
+
+    l = wl_resource_get_user_data(job->screenshot);
+    l->job = NULL;
+
+    if (job->message != NULL) {
+        ivi_screenshot_send_error(job->screenshot, job->error, job->message);
+        screenshot_buffer_put(job->buffer);
+    } else {
+        screenshot_buffer_send(job->buffer, job->screenshot,
+                               job->region.target_width,
+                               job->region.target_height, job->stride,
+                               job->shm_format, job->timestamp);
+    }
+
+    screenshot_finish(job->screenshot);
+    free(job);
+}
+
+static void *
+screenshot_worker_run(void *data)
+{
+    struct screenshot_worker *worker = data;
+    struct screenshot_job *job;
+    uint64_t one = 1;
+
+    pthread_mutex_lock(&worker->lock);
+    while (!worker->quit) {
+        if (wl_list_empty(&worker->pending)) {
+            pthread_cond_wait(&worker->cond, &worker->lock);
+            continue;
+        }
+
+        job = wl_container_of(worker->pending.next, job, link);
+        wl_list_remove(&job->link);
+        pthread_mutex_unlock(&worker->lock);
+
+        screenshot_job_process(job);
+
+        pthread_mutex_lock(&worker->lock);
+        wl_list_insert(worker->done.prev, &job->link);
+        if (write(worker->fd, &one, sizeof one) < 0)
+            weston_log("screenshot: failed to wake the main loop: %m\n");
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return NULL;
+}
+
+static int
+screenshot_worker_dispatch(int fd, uint32_t mask, void *data)
+{
+    struct screenshot_worker *worker = data;
+    struct screenshot_job *job, *next;
+    struct wl_list done;
+    uint64_t count;
+    (void)mask;
+
+    if (read(fd, &count, sizeof count) < 0 && errno != EAGAIN)
+        weston_log("screenshot: failed to read the worker eventfd: %m\n");
+
+    wl_list_init(&done);
+    pthread_mutex_lock(&worker->lock);
+    wl_list_insert_list(&done, &worker->done);
+    wl_list_init(&worker->done);
+    pthread_mutex_unlock(&worker->lock);
+
+    wl_list_for_each_safe(job, next, &done, link)
+        screenshot_job_finish(job);
+
+    return 0;
+}
+
+static struct screenshot_worker *
+screenshot_worker_create(struct ivishell *shell)
+{
+    struct screenshot_worker *worker;
+    struct wl_event_loop *loop =
+        wl_display_get_event_loop(shell->compositor->wl_display);
+
+    worker = calloc(1, sizeof *worker);
+    if (worker == NULL)
+        return NULL;
+
+    wl_list_init(&worker->pending);
+    wl_list_init(&worker->done);
+
+    worker->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (worker->fd < 0)
+        goto err_free;
+
+    worker->source = wl_event_loop_add_fd(loop, worker->fd, WL_EVENT_READABLE,
+                                          screenshot_worker_dispatch, worker);
+    if (worker->source == NULL)
+        goto err_fd;
+
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+
+    if (pthread_create(&worker->thread, NULL, screenshot_worker_run,
+                       worker) != 0) {
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+        wl_event_source_remove(worker->source);
+        goto err_fd;
+    }
+
+    return worker;
+
+err_fd:
+    close(worker->fd);
+err_free:
+    free(worker);
+    weston_log("screenshot: failed to start the worker thread, "
+               "processing screenshots in the frame signal\n");
+    return NULL;
+}
+
+static void
+screenshot_worker_destroy(struct screenshot_worker *worker)
+{
+    struct screenshot_job *job, *next;
+    struct screenshot_frame_listener *l;
+
+    pthread_mutex_lock(&worker->lock);
+    worker->quit = true;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    // capture frames are sent in order, the ones left are flipped here
+    wl_list_for_each(job, &worker->pending, link) {
+        if (job->capture != NULL)
+            screenshot_job_process(job);
+    }
+
+    wl_list_insert_list(&worker->done, &worker->pending);
+    wl_list_for_each_safe(job, next, &worker->done, link) {
+        if (job->capture != NULL) {
+            ivicapture_job_finish(job);
+            continue;
+        }
+
+        if (job->screenshot != NULL) {
+            l = wl_resource_get_user_data(job->screenshot);
+            l->job = NULL;
+        }
+        free(job->region_pixels);
+        screenshot_buffer_put(job->buffer);
+        free(job);
+    }
+
+    wl_event_source_remove(worker->source);
+    close(worker->fd);
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+}
+
+/* Hands the job to the worker, or processes it right away if there is none */
+static void
+screenshot_job_queue(struct ivishell *shell, struct screenshot_job *job)
+{
+    struct screenshot_worker *worker;
+
+    if (shell->screenshot_worker == NULL)
+        shell->screenshot_worker = screenshot_worker_create(shell);
+
+    worker = shell->screenshot_worker;
+    if (worker == NULL) {
+        screenshot_job_process(job);
+        screenshot_job_finish(job);
+        return;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    wl_list_insert(worker->pending.prev, &job->link);
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+}
+
+static void
+controller_screenshot_notify(struct wl_listener *listener, void *data)
+{
+    struct screenshot_frame_listener *l =
+        wl_container_of(listener, l, frame_listener);
+
+    struct weston_output *output = data;
+    struct screenshot_region region = l->region;
+    struct screenshot_job *job;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    int32_t read_y;
+    struct screenshot_buffer *buffer;
+    uint32_t *region_pixels = NULL;
+    uint32_t *target;
+    uint32_t shm_format;
+    size_t size;
+    pixman_format_code_t format = output->compositor->read_format;
+
+    --output->disable_planes;
+
+    // one frame per request, the object may outlive it since version 6
+    wl_list_remove(&l->frame_listener.link);
+    wl_list_init(&l->frame_listener.link);
+    wl_list_remove(&l->output_destroyed.link);
+    wl_list_init(&l->output_destroyed.link);
+
+    // map to shm buffer format
+    if (shm_format_from_pixman(format, &shm_format) < 0) {
+        ivi_screenshot_send_error(l->screenshot,
+                                  IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
+                                  "unsupported pixel format");
+        goto err_fd;
+    }
+
+    width = output->current_mode->width;
+    height = output->current_mode->height;
+
+    // the mode may have changed since the region was requested
+    if (screenshot_region_fit(&region, width, height) < 0) {
+        ivi_screenshot_send_error(l->screenshot,
+                                  IVI_SCREENSHOT_ERROR_INVALID_REGION,
+                                  "region does not fit the output");
+        goto err_fd;
+    }
+
+    stride = region.target_width * (PIXMAN_FORMAT_BPP(format) / 8);
+    size = stride * region.target_height;
+
+    job = calloc(1, sizeof *job);
+    if (job == NULL) {
+        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
+                                  "failed to allocate screenshot");
+        goto err_fd;
+    }
+
+    buffer = screenshot_buffer_get(l->shell,
+                                   wl_resource_get_client(l->screenshot),
+                                   size);
+    if (buffer == NULL) {
+        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
+                                  "failed to create screenshot file");
+        goto err_job;
+    }
+
+    // only the region is read back, into the file unless it is scaled
+    target = buffer->data;
+    if (screenshot_region_scaled(&region)) {
+        region_pixels = malloc((size_t)region.width * region.height * 4);
+        if (region_pixels == NULL) {
+            ivi_screenshot_send_error(l->screenshot,
+                                      IVI_SCREENSHOT_ERROR_IO_ERROR,
+                                      "failed to allocate screenshot region");
+            goto err_readpix;
+        }
+        target = region_pixels;
+    }
+
+    // renderers with y-flip count rows from the bottom of the output
+    read_y = region.y;
+    if (output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
+        read_y = height - region.y - region.height;
+
+    if (output->compositor->renderer->read_pixels(output, format, target,
+                                                  region.x, read_y,
+                                                  region.width,
+                                                  region.height) < 0) {
+        ivi_screenshot_send_error(
+            l->screenshot, IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
+            "screenshot of given output is not supported by renderer");
+        goto err_readpix;
+    }
+
+    job->screenshot = l->screenshot;
+    job->buffer = buffer;
+    job->region = region;
+    job->region_pixels = region_pixels;
+    job->flip = output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP;
+    job->stride = stride;
+    job->shm_format = shm_format;
+    job->timestamp = timespec_to_msec(&output->frame_time);
+    l->job = job;
+
+    screenshot_job_queue(l->shell, job);
+    return;
+
+err_readpix:
+    free(region_pixels);
+    screenshot_buffer_put(buffer);
+err_job:
+    free(job);
+err_fd:
+    screenshot_finish(l->screenshot);
+}
+
+static void
+screenshot_output_destroyed(struct wl_listener *listener, void *data)
+{
+    struct screenshot_frame_listener *l =
+        wl_container_of(listener, l, output_destroyed);
+
+    wl_list_remove(&l->frame_listener.link);
+    wl_list_init(&l->frame_listener.link);
+    wl_list_remove(&l->output_destroyed.link);
+    wl_list_init(&l->output_destroyed.link);
+
+    ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_NO_OUTPUT,
+                              "the output has been destroyed");
+    screenshot_finish(l->screenshot);
+}
+
+static void
+screenshot_frame_listener_destroy(struct wl_resource *resource)
+{
+    struct screenshot_frame_listener *l = wl_resource_get_user_data(resource);
+
+    // the worker finishes the job, its buffer then goes back to the pool
+    if (l->job != NULL)
+        l->job->screenshot = NULL;
+
+    wl_list_remove(&l->frame_listener.link);
+    wl_list_remove(&l->output_destroyed.link);
+    free(l);
+}
+
+static void
+screen_screenshot(struct wl_client *client,
+                  struct wl_resource *resource,
+                  uint32_t id,
+                  struct screenshot_region region)
+{
+    struct iviscreen *iviscrn = wl_resource_get_user_data(resource);
+    struct screenshot_frame_listener *l;
+    (void)client;
+
+    l = malloc(sizeof *l);
+    if(l == NULL) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+
+    l->screenshot =
+        wl_resource_create(client, &ivi_screenshot_interface,
+                           wl_resource_get_version(resource), id);
+
+    if (l->screenshot == NULL) {
+        wl_resource_post_no_memory(resource);
+        free(l);
+        return;
+    }
+
+    if (!iviscrn) {
+        wl_resource_set_implementation(l->screenshot,
+                                       &screenshot_implementation, NULL, NULL);
+        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_NO_OUTPUT,
+                                  "the output is already destroyed");
+        screenshot_finish(l->screenshot);
+        free(l);
+        return;
+    }
+
+    l->shell = iviscrn->shell;
+    l->region = region;
+    l->job = NULL;
+    wl_resource_set_implementation(l->screenshot, &screenshot_implementation,
+                                   l, screenshot_frame_listener_destroy);
+    l->output_destroyed.notify = screenshot_output_destroyed;
+    wl_signal_add(&iviscrn->output->destroy_signal, &l->output_destroyed);
+    l->frame_listener.notify = controller_screenshot_notify;
+    wl_signal_add(&iviscrn->output->frame_signal, &l->frame_listener);
+    iviscrn->output->disable_planes++;
+    weston_output_damage(iviscrn->output);
+}
+
+static void
+controller_screen_screenshot(struct wl_client *client,
+                             struct wl_resource *resource,
+                             uint32_t id)
+{
+    struct screenshot_region region = { 0 };
+
+    screen_screenshot(client, resource, id, region);
+}
+
+static void
+controller_screen_screenshot_region(struct wl_client *client,
+                                    struct wl_resource *resource,
+                                    uint32_t id,
+                                    int32_t x, int32_t y,
+                                    int32_t width, int32_t height,
+                                    int32_t target_width,
+                                    int32_t target_height)
+{
+    struct screenshot_region region = {
+        x, y, width, height, target_width, target_height
+    };
+
+    // an empty region must not select the whole output
+    if (width <= 0 || height <= 0)
+        region.width = -1;
+
+    screen_screenshot(client, resource, id, region);
+}
+
+static void
+controller_screen_get(struct wl_client *client,
+                       struct wl_resource *resource,
+                       int32_t param)
+{
+    struct iviscreen *iviscrn = wl_resource_get_user_data(resource);
+    const struct ivi_layout_interface *lyt;
+    (void)client;
+    struct ivi_layout_layer **layer_list = NULL;
+    int32_t layer_count, i;
+    uint32_t id;
+
+    lyt = iviscrn->shell->interface;
+
+    if (!iviscrn) {
+        ivi_wm_screen_send_error(resource, IVI_WM_SCREEN_ERROR_NO_SCREEN,
+                                 "the output is already destroyed");
+        return;
+    }
+
+    if (param & IVI_WM_PARAM_RENDER_ORDER) {
+        lyt->get_layers_on_screen(iviscrn->output, &layer_count, &layer_list);
+
+        for (i = 0; i < layer_count; i++) {
+            id = lyt->get_id_of_layer(layer_list[i]);
+            ivi_wm_screen_send_layer_added(resource, id);
+	}
+
+        free(layer_list);
+    }
+}
+
+static const
+struct ivi_wm_screen_interface controller_screen_implementation = {
+    controller_screen_destroy,
+    controller_screen_clear,
+    controller_screen_add_layer,
+    controller_screen_remove_layer,
+    controller_screen_screenshot,
+    controller_screen_get,
+    controller_screen_screenshot_region
+};
+
+static void
+controller_commit_changes(struct wl_client *client,
+                          struct wl_resource *resource)
+{
+    int32_t ans = 0;
+    (void)client;
+    struct ivicontroller *controller = wl_resource_get_user_data(resource);
+
+    ans = controller->shell->interface->commit_changes();
+    if (ans < 0) {
+        weston_log("Failed to commit changes at controller_commit_changes\n");
+    }
+
+    /* published before any reply, so the committing client reads its changes */
+    scene_mirror_flush(controller->shell);
+}
+
+static void
+commit_feedback_send_now(struct commit_feedback *feedback)
+{
+    struct timespec stamp;
+
+    weston_compositor_read_presentation_clock(feedback->compositor, &stamp);
+    wl_callback_send_done(feedback->callback, timespec_to_msec(&stamp));
+    wl_resource_destroy(feedback->callback);
+}
+
+static void
+commit_feedback_output_destroy(struct commit_feedback_output *fo)
+{
+    wl_list_remove(&fo->frame_listener.link);
+    wl_list_remove(&fo->output_destroyed.link);
+    wl_list_remove(&fo->link);
+    free(fo);
+}
+
+static void
+commit_feedback_frame_notify(struct wl_listener *listener, void *data)
+{
+    struct commit_feedback_output *fo =
+        wl_container_of(listener, fo, frame_listener);
+    struct commit_feedback *feedback = fo->feedback;
+    (void)data;
+
+    wl_callback_send_done(feedback->callback,
+                          timespec_to_msec(&fo->output->frame_time));
+    wl_resource_destroy(feedback->callback);
+}
+
+static void
+commit_feedback_output_destroyed(struct wl_listener *listener, void *data)
+{
+    struct commit_feedback_output *fo =
+        wl_container_of(listener, fo, output_destroyed);
+    struct commit_feedback *feedback = fo->feedback;
+    (void)data;
+
+    commit_feedback_output_destroy(fo);
+
+    if (wl_list_empty(&feedback->output_list))
+        commit_feedback_send_now(feedback);
+}
+
+static void
+commit_feedback_destroy(struct wl_resource *resource)
+{
+    struct commit_feedback *feedback = wl_resource_get_user_data(resource);
+    struct commit_feedback_output *fo, *next;
+
+    wl_list_for_each_safe(fo, next, &feedback->output_list, link)
+        commit_feedback_output_destroy(fo);
+
+    free(feedback);
+}
+
+static void
+controller_commit_changes_feedback(struct wl_client *client,
+                                   struct wl_resource *resource,
+                                   uint32_t callback)
+{
+    struct ivicontroller *controller = wl_resource_get_user_data(resource);
+    struct ivishell *shell = controller->shell;
+    struct commit_feedback *feedback;
+    struct commit_feedback_output *fo;
+    struct iviscreen *iviscrn;
+
+    controller_commit_changes(client, resource);
+
+    feedback = calloc(1, sizeof *feedback);
+    if (feedback == NULL) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+
+    feedback->callback =
+        wl_resource_create(client, &wl_callback_interface, 1, callback);
+    if (feedback->callback == NULL) {
+        wl_resource_post_no_memory(resource);
+        free(feedback);
+        return;
+    }
+
+    feedback->compositor = shell->compositor;
+    wl_list_init(&feedback->output_list);
+    wl_resource_set_implementation(feedback->callback, NULL, feedback,
+                                   commit_feedback_destroy);
+
+    /* whichever output repaints first reports the change as presented */
+    wl_list_for_each(iviscrn, &shell->list_screen, link) {
+        fo = calloc(1, sizeof *fo);
+        if (fo == NULL) {
+            wl_resource_post_no_memory(resource);
+            wl_resource_destroy(feedback->callback);
+            return;
+        }
+
+        fo->feedback = feedback;
+        fo->output = iviscrn->output;
+        fo->frame_listener.notify = commit_feedback_frame_notify;
+        wl_signal_add(&iviscrn->output->frame_signal, &fo->frame_listener);
+        fo->output_destroyed.notify = commit_feedback_output_destroyed;
+        wl_signal_add(&iviscrn->output->destroy_signal, &fo->output_destroyed);
+        wl_list_insert(&feedback->output_list, &fo->link);
+    }
+
+    if (wl_list_empty(&feedback->output_list)) {
+        commit_feedback_send_now(feedback);
+        return;
+    }
+
+    weston_compositor_schedule_repaint(shell->compositor);
+}
+
+static void
+controller_create_screen(struct wl_client *client,
+                        struct wl_resource *resource,
+                        struct wl_resource *output_resource,
+                        uint32_t id)
+{
+    struct weston_head *weston_head =
+        wl_resource_get_user_data(output_resource);
+    struct wl_resource *screen_resource;
+    struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
+    struct iviscreen* iviscrn = NULL;
+
+
+    wl_list_for_each(iviscrn, &ctrl->shell->list_screen, link) {
+        if (weston_head->output != iviscrn->output) {
+            continue;
+        }
+
+        screen_resource = wl_resource_create(client, &ivi_wm_screen_interface,
+                                             wl_resource_get_version(resource),
+                                             id);
+        if (screen_resource == NULL) {
+            wl_resource_post_no_memory(resource);
+            return;
+        }
+
+        wl_resource_set_implementation(screen_resource,
+                                       &controller_screen_implementation,
+                                       iviscrn, destroy_ivicontroller_screen);
+
+        wl_list_insert(&iviscrn->resource_list, wl_resource_get_link(screen_resource));
+
+        ivi_wm_screen_send_screen_id(screen_resource, iviscrn->id_screen);
+        ivi_wm_screen_send_connector_name(screen_resource, iviscrn->output->name);
+    }
+}
+
+static void
+send_scene_screen(struct wl_resource *scene, struct iviscreen *iviscrn)
+{
+    const struct ivi_layout_interface *lyt = iviscrn->shell->interface;
+    struct ivi_layout_layer **layer_list = NULL;
+    int32_t layer_count = 0, i;
+
+    ivi_scene_send_screen(scene, iviscrn->id_screen, iviscrn->output->name,
+                          iviscrn->output->width, iviscrn->output->height);
+
+    lyt->get_layers_on_screen(iviscrn->output, &layer_count, &layer_list);
+    for (i = 0; i < layer_count; i++) {
+        ivi_scene_send_screen_layer(scene, iviscrn->id_screen,
+                                    lyt->get_id_of_layer(layer_list[i]));
+    }
+
+    free(layer_list);
+}
+
+static void
+send_scene_layer(struct wl_resource *scene, struct ivilayer *ivilayer)
+{
+    const struct ivi_layout_interface *lyt = ivilayer->shell->interface;
+    const struct ivi_layout_layer_properties *prop = ivilayer->prop;
+    struct ivi_layout_surface **surf_list = NULL;
+    int32_t surface_count = 0, i;
+    uint32_t layer_id;
+
+    layer_id = lyt->get_id_of_layer(ivilayer->layout_layer);
+
+    ivi_scene_send_layer(scene, layer_id, prop->opacity, prop->visibility,
+                         prop->source_x, prop->source_y,
+                         prop->source_width, prop->source_height,
+                         prop->dest_x, prop->dest_y,
+                         prop->dest_width, prop->dest_height);
+
+    lyt->get_surfaces_on_layer(ivilayer->layout_layer, &surface_count, &surf_list);
+    for (i = 0; i < surface_count; i++) {
+        ivi_scene_send_layer_surface(scene, layer_id,
+                                     lyt->get_id_of_surface(surf_list[i]));
+    }
+
+    free(surf_list);
+}
+
+static void
+send_scene_surface(struct wl_resource *scene, struct ivisurface *ivisurf)
+{
+    const struct ivi_layout_interface *lyt = ivisurf->shell->interface;
+    const struct ivi_layout_surface_properties *prop = ivisurf->prop;
+    struct weston_surface *surface;
+    int32_t width = 0;
+    int32_t height = 0;
+    pid_t pid = 0;
+    uid_t uid;
+    gid_t gid;
+
+    surface = lyt->surface_get_weston_surface(ivisurf->layout_surface);
+    if (surface) {
+        width = surface->width;
+        height = surface->height;
+
+        if (surface->resource)
+            wl_client_get_credentials(wl_resource_get_client(surface->resource),
+                                      &pid, &uid, &gid);
+    }
+
+    ivi_scene_send_surface(scene,
+                           lyt->get_id_of_surface(ivisurf->layout_surface),
+                           prop->opacity, prop->visibility,
+                           prop->source_x, prop->source_y,
+                           prop->source_width, prop->source_height,
+                           prop->dest_x, prop->dest_y,
+                           prop->dest_width, prop->dest_height,
+                           width, height, ivisurf->frame_count, pid);
+}
+
+static void
+controller_get_scene(struct wl_client *client,
+                     struct wl_resource *resource,
+                     uint32_t scene_id)
+{
+    struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
+    struct ivishell *shell = ctrl->shell;
+    struct wl_resource *scene;
+    struct iviscreen *iviscrn;
+    struct ivilayer *ivilayer;
+    struct ivisurface *ivisurf;
+
+    scene = wl_resource_create(client, &ivi_scene_interface, 1, scene_id);
+    if (scene == NULL) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    /* the lists are prepended, walk them backwards to keep creation order */
+    wl_list_for_each_reverse(iviscrn, &shell->list_screen, link)
+        send_scene_screen(scene, iviscrn);
+
+    wl_list_for_each_reverse(ivilayer, &shell->list_layer, link)
+        send_scene_layer(scene, ivilayer);
+
+    wl_list_for_each_reverse(ivisurf, &shell->list_surface, link)
+        send_scene_surface(scene, ivisurf);
+
+    ivi_scene_send_done(scene);
+    wl_resource_destroy(scene);
+}
+
+static uint32_t
+scene_mirror_add_layers(struct ivi_scene_mirror *data,
+                        struct ivi_layout_layer **layer_list,
+                        int32_t layer_count,
+                        const struct ivi_layout_interface *lyt)
+{
+    int32_t i;
+    uint32_t count = 0;
+
+    for (i = 0; i < layer_count; i++) {
+        if (data->id_count == IVI_SCENE_MIRROR_MAX_IDS) {
+            data->flags |= IVI_SCENE_MIRROR_TRUNCATED;
+            break;
+        }
+        data->ids[data->id_count++] = lyt->get_id_of_layer(layer_list[i]);
+        count++;
+    }
+
+    return count;
+}
+
+static uint32_t
+scene_mirror_add_surfaces(struct ivi_scene_mirror *data,
+                          struct ivi_layout_surface **surf_list,
+                          int32_t surface_count,
+                          const struct ivi_layout_interface *lyt)
+{
+    int32_t i;
+    uint32_t count = 0;
+
+    for (i = 0; i < surface_count; i++) {
+        if (data->id_count == IVI_SCENE_MIRROR_MAX_IDS) {
+            data->flags |= IVI_SCENE_MIRROR_TRUNCATED;
+            break;
+        }
+        data->ids[data->id_count++] = lyt->get_id_of_surface(surf_list[i]);
+        count++;
+    }
+
+    return count;
+}
+
+static void
+scene_mirror_fill_surface(struct ivi_scene_mirror_surface *entry,
+                          struct ivisurface *ivisurf)
+{
+    const struct ivi_layout_interface *lyt = ivisurf->shell->interface;
+    const struct ivi_layout_surface_properties *prop = ivisurf->prop;
+    struct weston_surface *surface;
+    pid_t pid = 0;
+    uid_t uid;
+    gid_t gid;
+
+    entry->id = lyt->get_id_of_surface(ivisurf->layout_surface);
+    entry->opacity = prop->opacity;
+    entry->visibility = prop->visibility;
+    entry->source_x = prop->source_x;
+    entry->source_y = prop->source_y;
+    entry->source_width = prop->source_width;
+    entry->source_height = prop->source_height;
+    entry->dest_x = prop->dest_x;
+    entry->dest_y = prop->dest_y;
+    entry->dest_width = prop->dest_width;
+    entry->dest_height = prop->dest_height;
+    entry->width = 0;
+    entry->height = 0;
+    entry->frame_count = ivisurf->frame_count;
+
+    surface = lyt->surface_get_weston_surface(ivisurf->layout_surface);
+    if (surface) {
+        entry->width = surface->width;
+        entry->height = surface->height;
+
+        if (surface->resource)
+            wl_client_get_credentials(wl_resource_get_client(surface->resource),
+                                      &pid, &uid, &gid);
+    }
+    entry->pid = pid;
+}
+
+/* Write the whole scene, in the same order controller_get_scene sends it */
+static void
+scene_mirror_publish(struct scene_mirror *mirror)
+{
+    struct ivishell *shell = mirror->shell;
+    const struct ivi_layout_interface *lyt = shell->interface;
+    struct ivi_scene_mirror *data = mirror->data;
+    struct iviscreen *iviscrn;
+    struct ivilayer *ivilayer;
+    struct ivisurface *ivisurf;
+
+    ivi_scene_mirror_write_begin(data);
+
+    data->flags = 0;
+    data->screen_count = 0;
+    data->layer_count = 0;
+    data->surface_count = 0;
+    data->id_count = 0;
+
+    wl_list_for_each_reverse(iviscrn, &shell->list_screen, link) {
+        struct ivi_scene_mirror_screen *entry;
+        struct ivi_layout_layer **layer_list = NULL;
+        int32_t layer_count = 0;
+
+        if (data->screen_count == IVI_SCENE_MIRROR_MAX_SCREENS) {
+            data->flags |= IVI_SCENE_MIRROR_TRUNCATED;
+            break;
+        }
+
+        entry = &data->screens[data->screen_count++];
+        entry->id = iviscrn->id_screen;
+        entry->width = iviscrn->output->width;
+        entry->height = iviscrn->output->height;
+        snprintf(entry->name, sizeof entry->name, "%s",
+                 iviscrn->output->name ? iviscrn->output->name : "");
+
+        lyt->get_layers_on_screen(iviscrn->output, &layer_count, &layer_list);
+        entry->layer_index = data->id_count;
+        entry->layer_count =
+            scene_mirror_add_layers(data, layer_list, layer_count, lyt);
+        free(layer_list);
+    }
+
+    wl_list_for_each_reverse(ivilayer, &shell->list_layer, link) {
+        const struct ivi_layout_layer_properties *prop = ivilayer->prop;
+        struct ivi_scene_mirror_layer *entry;
+        struct ivi_layout_surface **surf_list = NULL;
+        int32_t surface_count = 0;
+
+        if (data->layer_count == IVI_SCENE_MIRROR_MAX_LAYERS) {
+            data->flags |= IVI_SCENE_MIRROR_TRUNCATED;
+            break;
+        }
+
+        entry = &data->layers[data->layer_count++];
+        entry->id = lyt->get_id_of_layer(ivilayer->layout_layer);
+        entry->opacity = prop->opacity;
+        entry->visibility = prop->visibility;
+        entry->source_x = prop->source_x;
+        entry->source_y = prop->source_y;
+        entry->source_width = prop->source_width;
+        entry->source_height = prop->source_height;
+        entry->dest_x = prop->dest_x;
+        entry->dest_y = prop->dest_y;
+        entry->dest_width = prop->dest_width;
+        entry->dest_height = prop->dest_height;
+
+        lyt->get_surfaces_on_layer(ivilayer->layout_layer,
+                                   &surface_count, &surf_list);
+        entry->surface_index = data->id_count;
+        entry->surface_count =
+            scene_mirror_add_surfaces(data, surf_list, surface_count, lyt);
+        free(surf_list);
+    }
+
+    wl_list_for_each_reverse(ivisurf, &shell->list_surface, link) {
+        if (data->surface_count == IVI_SCENE_MIRROR_MAX_SURFACES) {
+            data->flags |= IVI_SCENE_MIRROR_TRUNCATED;
+            ivisurf->mirror_index = -1;
+            continue;
+        }
+
+        ivisurf->mirror_index = data->surface_count;
+        scene_mirror_fill_surface(&data->surfaces[data->surface_count++],
+                                  ivisurf);
+    }
+
+    data->commit_count++;
+
+    ivi_scene_mirror_write_end(data);
+}
+
+/* Write the frame counts and buffer sizes of the surfaces already in the
+ * mirror, the rest of the scene is unchanged.
+ */
+static void
+scene_mirror_publish_frames(struct scene_mirror *mirror)
+{
+    struct ivishell *shell = mirror->shell;
+    const struct ivi_layout_interface *lyt = shell->interface;
+    struct ivi_scene_mirror *data = mirror->data;
+    struct ivisurface *ivisurf;
+
+    ivi_scene_mirror_write_begin(data);
+
+    wl_list_for_each(ivisurf, &shell->list_surface, link) {
+        struct ivi_scene_mirror_surface *entry;
+        struct weston_surface *surface;
+
+        if (ivisurf->mirror_index < 0)
+            continue;
+
+        entry = &data->surfaces[ivisurf->mirror_index];
+        entry->frame_count = ivisurf->frame_count;
+        surface = lyt->surface_get_weston_surface(ivisurf->layout_surface);
+        if (surface) {
+            entry->width = surface->width;
+            entry->height = surface->height;
+        }
+    }
+
+    ivi_scene_mirror_write_end(data);
+}
+
+static void
+scene_mirror_idle(void *data)
+{
+    struct scene_mirror *mirror = data;
+
+    mirror->idle = NULL;
+    if (mirror->frames_only)
+        scene_mirror_publish_frames(mirror);
+    else
+        scene_mirror_publish(mirror);
+}
+
+static void
+scene_mirror_add_idle(struct scene_mirror *mirror)
+{
+    struct wl_event_loop *loop;
+
+    loop = wl_display_get_event_loop(mirror->shell->compositor->wl_display);
+    mirror->idle = wl_event_loop_add_idle(loop, scene_mirror_idle, mirror);
+    if (mirror->idle == NULL)
+        scene_mirror_idle(mirror);
+}
+
+/* Publish the scene once the current batch of changes is through. Nothing
+ * is done until a client asked for the mirror.
+ */
+static void
+scene_mirror_schedule(struct ivishell *shell)
+{
+    struct scene_mirror *mirror = shell->scene_mirror;
+
+    if (mirror == NULL)
+        return;
+
+    mirror->frames_only = false;
+    if (mirror->idle == NULL)
+        scene_mirror_add_idle(mirror);
+}
+
+/* Commits only change frame counts and buffer sizes. They are published
+ * together with the next update, or on their own once per dispatch, so a
+ * client committing at a high rate does not keep readers retrying.
+ */
+static void
+scene_mirror_schedule_frames(struct ivishell *shell)
+{
+    struct scene_mirror *mirror = shell->scene_mirror;
+
+    if (mirror == NULL || mirror->idle)
+        return;
+
+    mirror->frames_only = true;
+    scene_mirror_add_idle(mirror);
+}
+
+static void
+scene_mirror_flush(struct ivishell *shell)
+{
+    struct scene_mirror *mirror = shell->scene_mirror;
+
+    if (mirror == NULL)
+        return;
+
+    if (mirror->idle) {
+        wl_event_source_remove(mirror->idle);
+        mirror->idle = NULL;
+    }
+
+    scene_mirror_publish(mirror);
+}
+
+static struct scene_mirror *
+scene_mirror_create(struct ivishell *shell)
+{
+    struct scene_mirror *mirror;
+    size_t size = sizeof(struct ivi_scene_mirror);
+
+    mirror = calloc(1, sizeof *mirror);
+    if (mirror == NULL)
+        return NULL;
+
+    mirror->fd = create_shm_file("ivi-scene-mirror", size);
+    if (mirror->fd < 0) {
+        weston_log("failed to create scene mirror file\n");
+        free(mirror);
+        return NULL;
+    }
+
+    mirror->data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, mirror->fd, 0);
+    if (mirror->data == MAP_FAILED) {
+        weston_log("failed to map scene mirror\n");
+        close(mirror->fd);
+        free(mirror);
+        return NULL;
+    }
+
+    mirror->shell = shell;
+    mirror->data->magic = IVI_SCENE_MIRROR_MAGIC;
+    mirror->data->version = IVI_SCENE_MIRROR_VERSION;
+    mirror->data->size = size;
+    scene_mirror_publish(mirror);
+
+    return mirror;
 }
 
 static void
-flip_y(int32_t stride, int32_t height, uint32_t *data) {
-    int i, y, p, q;
-    // assuming stride aligned to 4 bytes
-    int pitch = stride / sizeof(*data);
-    for (y = 0; y < height / 2; ++y) {
-        p = y * pitch;
-        q = (height - y - 1) * pitch;
-        for (i = 0; i < pitch; ++i) {
-            uint32_t tmp = data[p + i];
-            data[p + i] = data[q + i];
-            data[q + i] = tmp;
-        }
-    }
+scene_mirror_destroy(struct scene_mirror *mirror)
+{
+    if (mirror->idle)
+        wl_event_source_remove(mirror->idle);
+
+    munmap(mirror->data, sizeof(struct ivi_scene_mirror));
+    close(mirror->fd);
+    free(mirror);
 }
 
 static void
-controller_screenshot_notify(struct wl_listener *listener, void *data)
+controller_get_scene_mirror(struct wl_client *client,
+                            struct wl_resource *resource)
 {
-    struct screenshot_frame_listener *l =
-        wl_container_of(listener, l, frame_listener);
-
-    struct weston_output *output = data;
-    int32_t width = 0;
-    int32_t height = 0;
-    int32_t stride = 0;
-    uint32_t *readpixs = NULL;
-    uint32_t shm_format;
+    struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
+    struct ivishell *shell = ctrl->shell;
+    char path[64];
     int fd;
-    size_t size;
-    pixman_format_code_t format = output->compositor->read_format;
-
-    --output->disable_planes;
+    (void)client;
 
-    // map to shm buffer format
-    switch (format) {
-    case PIXMAN_a8r8g8b8:
-        shm_format = WL_SHM_FORMAT_ARGB8888;
-        break;
-    case PIXMAN_x8r8g8b8:
-        shm_format = WL_SHM_FORMAT_XRGB8888;
-        break;
-    case PIXMAN_a8b8g8r8:
-        shm_format = WL_SHM_FORMAT_ABGR8888;
-        break;
-    case PIXMAN_x8b8g8r8:
-        shm_format = WL_SHM_FORMAT_XBGR8888;
-        break;
-    default:
-        ivi_screenshot_send_error(l->screenshot,
-                                  IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
-                                  "unsupported pixel format");
-        goto err_fd;
+    if (shell->scene_mirror == NULL) {
+        shell->scene_mirror = scene_mirror_create(shell);
+        if (shell->scene_mirror == NULL)
+            return;
     }
 
-    width = output->current_mode->width;
-    height = output->current_mode->height;
-    stride = width * (PIXMAN_FORMAT_BPP(format) / 8);
-    size = stride * height;
-
-    fd = create_screenshot_file(size);
+    /* hand out a descriptor which cannot be mapped writable */
+    snprintf(path, sizeof path, "/proc/self/fd/%d", shell->scene_mirror->fd);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
     if (fd < 0) {
-        weston_log("screenshot: failed to create file of %zu bytes: %m\n",
-                   size);
-        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
-                                  "failed to create screenshot file");
-        goto err_fd;
+        weston_log("failed to open scene mirror read-only\n");
+        return;
     }
 
-    readpixs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (readpixs == MAP_FAILED) {
-        weston_log("screenshot: failed to mmap %zu bytes: %m\n", size);
-        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_IO_ERROR,
-                                  "failed to create screenshot");
-        goto err_mmap;
-    }
+    ivi_wm_send_scene_mirror(resource, fd, sizeof(struct ivi_scene_mirror));
+    close(fd);
+}
 
-    if (output->compositor->renderer->read_pixels(output, format, readpixs,
-                                                  0, 0, width, height) < 0) {
-        ivi_screenshot_send_error(
-            l->screenshot, IVI_SCREENSHOT_ERROR_NOT_SUPPORTED,
-            "screenshot of given output is not supported by renderer");
-        goto err_readpix;
-    }
+#define IVICAPTURE_MAX_BUFFERS 16
 
-    if (output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP)
-        flip_y(stride, height, readpixs);
+static void
+ivicapture_stop(struct ivicapture *capture)
+{
+    if (capture->output == NULL)
+        return;
+
+    wl_list_remove(&capture->frame_listener.link);
+    wl_list_remove(&capture->output_destroyed.link);
+    --capture->output->disable_planes;
+    capture->output = NULL;
+}
 
-    ivi_screenshot_send_done(l->screenshot, fd, width, height, stride,
-                             shm_format, timespec_to_msec(&output->frame_time));
+static void
+ivicapture_fail(struct ivicapture *capture, uint32_t error,
+                const char *message)
+{
+    ivi_capture_send_error(capture->resource, error, message);
+    ivicapture_stop(capture);
+}
 
-err_readpix:
-    munmap(readpixs, size);
-err_mmap:
-    close(fd);
-err_fd:
-    wl_resource_destroy(l->screenshot);
+static void
+ivicapture_send_frame(struct ivicapture *capture, uint32_t index,
+                      const struct timespec *frame_time, uint32_t dropped)
+{
+    uint64_t tv_sec = (uint64_t)frame_time->tv_sec;
+
+    ivi_capture_send_frame(capture->resource, index, tv_sec >> 32,
+                           tv_sec & 0xffffffff, frame_time->tv_nsec, dropped);
 }
 
 static void
-screenshot_output_destroyed(struct wl_listener *listener, void *data)
+ivicapture_free(struct ivicapture *capture)
 {
-    struct screenshot_frame_listener *l =
-        wl_container_of(listener, l, output_destroyed);
+    uint32_t i;
 
-    ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_NO_OUTPUT,
-                              "the output has been destroyed");
-    wl_resource_destroy(l->screenshot);
+    for (i = 0; i < capture->buffer_count; i++) {
+        if (capture->buffers[i].data != NULL)
+            munmap(capture->buffers[i].data, capture->size);
+        if (capture->buffers[i].fd >= 0)
+            close(capture->buffers[i].fd);
+    }
+
+    free(capture->buffers);
+    free(capture);
 }
 
+/* Sends a frame the worker has flipped, unless the capture has ended */
 static void
-screenshot_frame_listener_destroy(struct wl_resource *resource)
+ivicapture_job_finish(struct screenshot_job *job)
 {
-    struct screenshot_frame_listener *l = wl_resource_get_user_data(resource);
+    struct ivicapture *capture = job->capture;
+
+    capture->buffers[job->capture_index].queued = false;
+    --capture->jobs;
+    if (capture->resource == NULL) {
+        if (capture->jobs == 0)
+            ivicapture_free(capture);
+    } else if (capture->output != NULL) {
+        ivicapture_send_frame(capture, job->capture_index, &job->frame_time,
+                              job->dropped);
+    }
 
-    wl_list_remove(&l->frame_listener.link);
-    wl_list_remove(&l->output_destroyed.link);
-    free(l);
+    free(job);
 }
 
 static void
-controller_screen_screenshot(struct wl_client *client,
-                             struct wl_resource *resource,
-                             uint32_t id)
+ivicapture_frame_notify(struct wl_listener *listener, void *data)
 {
-    struct iviscreen *iviscrn = wl_resource_get_user_data(resource);
-    struct screenshot_frame_listener *l;
-    (void)client;
+    struct ivicapture *capture =
+        wl_container_of(listener, capture, frame_listener);
+    struct weston_output *output = data;
+    struct ivicapture_buffer *buffer = NULL;
+    struct screenshot_job *job;
+    uint32_t i;
 
-    l = malloc(sizeof *l);
-    if(l == NULL) {
-        wl_resource_post_no_memory(resource);
-        return;
+    for (i = 0; i < capture->buffer_count; i++) {
+        if (!capture->buffers[i].busy) {
+            buffer = &capture->buffers[i];
+            break;
+        }
     }
 
-    l->screenshot =
-        wl_resource_create(client, &ivi_screenshot_interface, 1, id);
+    /* the client keeps all buffers, it can not keep up */
+    if (buffer == NULL) {
+        capture->dropped++;
+        return;
+    }
 
-    if (l->screenshot == NULL) {
-        wl_resource_post_no_memory(resource);
-        free(l);
+    if (output->current_mode->width != capture->width ||
+        output->current_mode->height != capture->height) {
+        ivicapture_fail(capture, IVI_CAPTURE_ERROR_NOT_SUPPORTED,
+                        "the output mode has changed");
         return;
     }
 
-    if (!iviscrn) {
-        ivi_screenshot_send_error(l->screenshot, IVI_SCREENSHOT_ERROR_NO_OUTPUT,
-                                  "the output is already destroyed");
-        wl_resource_destroy(l->screenshot);
-        free(l);
+    if (output->compositor->renderer->read_pixels(output, capture->format,
+                                                  buffer->data, 0, 0,
+                                                  capture->width,
+                                                  capture->height) < 0) {
+        ivicapture_fail(capture, IVI_CAPTURE_ERROR_NOT_SUPPORTED,
+                        "capture of given output is not supported by renderer");
         return;
     }
 
-    wl_resource_set_implementation(l->screenshot, NULL, l,
-                                   screenshot_frame_listener_destroy);
-    l->output_destroyed.notify = screenshot_output_destroyed;
-    wl_signal_add(&iviscrn->output->destroy_signal, &l->output_destroyed);
-    l->frame_listener.notify = controller_screenshot_notify;
-    wl_signal_add(&iviscrn->output->frame_signal, &l->frame_listener);
-    iviscrn->output->disable_planes++;
-    weston_output_damage(iviscrn->output);
+    buffer->busy = true;
+
+    /* the worker turns the frame upside down, then it is sent */
+    if (output->compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP) {
+        job = calloc(1, sizeof *job);
+        if (job != NULL) {
+            buffer->queued = true;
+            job->capture = capture;
+            job->capture_index = i;
+            job->frame_time = output->frame_time;
+            job->dropped = capture->dropped;
+            capture->dropped = 0;
+            capture->jobs++;
+            screenshot_job_queue(capture->shell, job);
+            return;
+        }
+
+        ivi_flip_rows(buffer->data, capture->stride, capture->height);
+    }
+
+    ivicapture_send_frame(capture, i, &output->frame_time, capture->dropped);
+    capture->dropped = 0;
 }
 
 static void
-controller_screen_get(struct wl_client *client,
-                       struct wl_resource *resource,
-                       int32_t param)
+ivicapture_output_destroyed(struct wl_listener *listener, void *data)
 {
-    struct iviscreen *iviscrn = wl_resource_get_user_data(resource);
-    const struct ivi_layout_interface *lyt;
-    (void)client;
-    struct ivi_layout_layer **layer_list = NULL;
-    int32_t layer_count, i;
-    uint32_t id;
+    struct ivicapture *capture =
+        wl_container_of(listener, capture, output_destroyed);
+    (void)data;
 
-    lyt = iviscrn->shell->interface;
+    ivicapture_fail(capture, IVI_CAPTURE_ERROR_NO_OUTPUT,
+                    "the output has been destroyed");
+}
 
-    if (!iviscrn) {
-        ivi_wm_screen_send_error(resource, IVI_WM_SCREEN_ERROR_NO_SCREEN,
-                                 "the output is already destroyed");
+static void
+ivicapture_destroy(struct wl_resource *resource)
+{
+    struct ivicapture *capture = wl_resource_get_user_data(resource);
+
+    ivicapture_stop(capture);
+
+    /* the worker may still write to the buffers, the last job frees them */
+    if (capture->jobs != 0) {
+        capture->resource = NULL;
         return;
     }
 
-    if (param & IVI_WM_PARAM_RENDER_ORDER) {
-        lyt->get_layers_on_screen(iviscrn->output, &layer_count, &layer_list);
+    ivicapture_free(capture);
+}
 
-        for (i = 0; i < layer_count; i++) {
-            id = lyt->get_id_of_layer(layer_list[i]);
-            ivi_wm_screen_send_layer_added(resource, id);
-	}
+static void
+capture_destroy(struct wl_client *client, struct wl_resource *resource)
+{
+    (void)client;
+    wl_resource_destroy(resource);
+}
 
-        free(layer_list);
+static void
+capture_release(struct wl_client *client, struct wl_resource *resource,
+                uint32_t index)
+{
+    struct ivicapture *capture = wl_resource_get_user_data(resource);
+    (void)client;
+
+    if (index >= capture->buffer_count || !capture->buffers[index].busy ||
+        capture->buffers[index].queued) {
+        ivicapture_fail(capture, IVI_CAPTURE_ERROR_BAD_INDEX,
+                        "release: the buffer is not owned by the client");
+        return;
     }
+
+    capture->buffers[index].busy = false;
 }
 
-static const
-struct ivi_wm_screen_interface controller_screen_implementation = {
-    controller_screen_destroy,
-    controller_screen_clear,
-    controller_screen_add_layer,
-    controller_screen_remove_layer,
-    controller_screen_screenshot,
-    controller_screen_get
+static const struct ivi_capture_interface capture_implementation = {
+    capture_destroy,
+    capture_release
 };
 
-static void
-controller_commit_changes(struct wl_client *client,
-                          struct wl_resource *resource)
+static int
+ivicapture_create_buffers(struct ivicapture *capture)
 {
-    int32_t ans = 0;
-    (void)client;
-    struct ivicontroller *controller = wl_resource_get_user_data(resource);
+    struct ivicapture_buffer *buffer;
+    uint32_t i;
 
-    ans = controller->shell->interface->commit_changes();
-    if (ans < 0) {
-        weston_log("Failed to commit changes at controller_commit_changes\n");
+    for (i = 0; i < capture->buffer_count; i++) {
+        buffer = &capture->buffers[i];
+
+        buffer->fd = create_shm_file("ivi-capture", capture->size);
+        if (buffer->fd < 0) {
+            weston_log("capture: failed to create file of %zu bytes: %m\n",
+                       capture->size);
+            return -1;
+        }
+
+        buffer->data = mmap(NULL, capture->size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, buffer->fd, 0);
+        if (buffer->data == MAP_FAILED) {
+            weston_log("capture: failed to mmap %zu bytes: %m\n",
+                       capture->size);
+            buffer->data = NULL;
+            return -1;
+        }
     }
+
+    return 0;
 }
 
 static void
-controller_create_screen(struct wl_client *client,
-                        struct wl_resource *resource,
-                        struct wl_resource *output_resource,
-                        uint32_t id)
+controller_create_capture(struct wl_client *client,
+                          struct wl_resource *resource,
+                          uint32_t id,
+                          struct wl_resource *output_resource,
+                          uint32_t buffer_count)
 {
+    struct ivicontroller *controller = wl_resource_get_user_data(resource);
     struct weston_head *weston_head =
         wl_resource_get_user_data(output_resource);
-    struct wl_resource *screen_resource;
-    struct ivicontroller *ctrl = wl_resource_get_user_data(resource);
-    struct iviscreen* iviscrn = NULL;
+    struct iviscreen *iviscrn = NULL, *it;
+    struct weston_output *output;
+    struct ivicapture *capture;
+    uint32_t shm_format;
+    uint32_t i;
 
+    capture = calloc(1, sizeof *capture);
+    if (capture == NULL) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
 
-    wl_list_for_each(iviscrn, &ctrl->shell->list_screen, link) {
-        if (weston_head->output != iviscrn->output) {
-            continue;
-        }
+    capture->resource =
+        wl_resource_create(client, &ivi_capture_interface, 1, id);
+    if (capture->resource == NULL) {
+        wl_resource_post_no_memory(resource);
+        free(capture);
+        return;
+    }
 
-        screen_resource = wl_resource_create(client, &ivi_wm_screen_interface, 1, id);
-        if (screen_resource == NULL) {
-            wl_resource_post_no_memory(resource);
-            return;
+    wl_resource_set_implementation(capture->resource, &capture_implementation,
+                                   capture, ivicapture_destroy);
+    capture->shell = controller->shell;
+
+    if (weston_head != NULL) {
+        wl_list_for_each(it, &controller->shell->list_screen, link) {
+            if (it->output == weston_head->output) {
+                iviscrn = it;
+                break;
+            }
         }
+    }
 
-        wl_resource_set_implementation(screen_resource,
-                                       &controller_screen_implementation,
-                                       iviscrn, destroy_ivicontroller_screen);
+    if (iviscrn == NULL) {
+        ivi_capture_send_error(capture->resource, IVI_CAPTURE_ERROR_NO_OUTPUT,
+                               "the output is already destroyed");
+        return;
+    }
 
-        wl_list_insert(&iviscrn->resource_list, wl_resource_get_link(screen_resource));
+    output = iviscrn->output;
+    capture->format = output->compositor->read_format;
+    if (shm_format_from_pixman(capture->format, &shm_format) < 0) {
+        ivi_capture_send_error(capture->resource,
+                               IVI_CAPTURE_ERROR_NOT_SUPPORTED,
+                               "unsupported pixel format");
+        return;
+    }
 
-        ivi_wm_screen_send_screen_id(screen_resource, iviscrn->id_screen);
-        ivi_wm_screen_send_connector_name(screen_resource, iviscrn->output->name);
+    if (buffer_count == 0)
+        buffer_count = 1;
+    if (buffer_count > IVICAPTURE_MAX_BUFFERS)
+        buffer_count = IVICAPTURE_MAX_BUFFERS;
+
+    capture->width = output->current_mode->width;
+    capture->height = output->current_mode->height;
+    capture->stride = capture->width * (PIXMAN_FORMAT_BPP(capture->format) / 8);
+    capture->size = (size_t)capture->stride * capture->height;
+
+    capture->buffers = calloc(buffer_count, sizeof *capture->buffers);
+    if (capture->buffers == NULL) {
+        wl_resource_post_no_memory(resource);
+        return;
     }
+
+    capture->buffer_count = buffer_count;
+    for (i = 0; i < buffer_count; i++)
+        capture->buffers[i].fd = -1;
+
+    if (ivicapture_create_buffers(capture) < 0) {
+        ivi_capture_send_error(capture->resource, IVI_CAPTURE_ERROR_IO_ERROR,
+                               "failed to create capture buffers");
+        return;
+    }
+
+    for (i = 0; i < buffer_count; i++) {
+        ivi_capture_send_buffer(capture->resource, i, capture->buffers[i].fd,
+                                capture->width, capture->height,
+                                capture->stride, shm_format);
+    }
+
+    capture->output = output;
+    capture->output_destroyed.notify = ivicapture_output_destroyed;
+    wl_signal_add(&output->destroy_signal, &capture->output_destroyed);
+    capture->frame_listener.notify = ivicapture_frame_notify;
+    wl_signal_add(&output->frame_signal, &capture->frame_listener);
+    output->disable_planes++;
+    weston_output_damage(output);
 }
 
 static const struct ivi_wm_interface controller_implementation = {
@@ -1458,7 +3442,12 @@ static const struct ivi_wm_interface controller_implementation = {
     controller_layer_add_surface,
     controller_layer_remove_surface,
     controller_create_layout_layer,
-    controller_destroy_layout_layer
+    controller_destroy_layout_layer,
+    controller_get_scene,
+    controller_commit_changes_feedback,
+    controller_create_capture,
+    controller_surface_screenshot_region,
+    controller_get_scene_mirror
 };
 
 static void
@@ -1467,7 +3456,6 @@ bind_ivi_controller(struct wl_client *client, void *data,
 {
     struct ivishell *shell = data;
     struct ivicontroller *controller;
-    (void)version;
     uint32_t surface_id, layer_id;
     struct ivisurface *ivisurf;
     struct ivilayer *ivilayer;
@@ -1479,7 +3467,7 @@ bind_ivi_controller(struct wl_client *client, void *data,
     }
 
     controller->resource =
-        wl_resource_create(client, &ivi_wm_interface, 1, id);
+        wl_resource_create(client, &ivi_wm_interface, version, id);
     if (controller->resource == NULL) {
         wl_client_post_no_memory(client);
         free(controller);
@@ -1540,7 +3528,7 @@ create_screen(struct ivishell *shell, struct weston_output *output)
     wl_list_insert(&shell->list_screen, &iviscrn->link);
     wl_list_init(&iviscrn->resource_list);
 
-    return;
+    scene_mirror_schedule(shell);
 }
 
 static void
@@ -1554,6 +3542,7 @@ destroy_screen(struct iviscreen *iviscrn)
     }
 
     wl_list_remove(&iviscrn->link);
+    scene_mirror_schedule(iviscrn->shell);
     free(iviscrn);
 }
 
@@ -1579,7 +3568,9 @@ output_destroyed_event(struct wl_listener *listener, void *data)
 static void
 output_resized_event(struct wl_listener *listener, void *data)
 {
-    struct ivishell *shell = wl_container_of(listener, shell, output_destroyed);
+    struct ivishell *shell = wl_container_of(listener, shell, output_resized);
+
+    scene_mirror_schedule(shell);
 
     if (shell->bkgnd_view && shell->client)
         set_bkgnd_surface_prop(shell);
@@ -1616,6 +3607,9 @@ create_layer(struct ivishell *shell,
 
     ivilayer->shell = shell;
     wl_list_insert(&shell->list_layer, &ivilayer->link);
+    ivi_registry_insert(&shell->layer_by_layout, &ivilayer->layout_entry,
+                        (uintptr_t)layout_layer);
+    ivi_registry_insert(&shell->layer_by_id, &ivilayer->id_entry, id_layer);
     wl_list_init(&ivilayer->notification_list);
     ivilayer->layout_layer = layout_layer;
     ivilayer->prop = lyt->get_properties_of_layer(layout_layer);
@@ -1628,6 +3622,8 @@ create_layer(struct ivishell *shell,
             ivi_wm_send_layer_created(controller->resource, id_layer);
     }
 
+    scene_mirror_schedule(shell);
+
     return ivilayer;
 }
 
@@ -1635,9 +3631,19 @@ static void
 surface_committed(struct wl_listener *listener, void *data)
 {
     struct ivisurface *ivisurf = wl_container_of(listener, ivisurf, committed);
+    struct timespec stamp;
     (void)data;
 
     ivisurf->frame_count++;
+
+    weston_compositor_read_presentation_clock(ivisurf->shell->compositor,
+                                              &stamp);
+    frame_times_record(&ivisurf->frame_times,
+                       (uint64_t)stamp.tv_sec * 1000000 +
+                       stamp.tv_nsec / 1000);
+
+    if (ivisurf->mirror_index >= 0)
+        scene_mirror_schedule_frames(ivisurf->shell);
 }
 
 static struct ivisurface*
@@ -1659,6 +3665,9 @@ create_surface(struct ivishell *shell,
     ivisurf->shell = shell;
     ivisurf->layout_surface = layout_surface;
     ivisurf->prop = lyt->get_properties_of_surface(layout_surface);
+    ivisurf->mirror_index = -1;
+    wl_list_init(&ivisurf->layout_entry.link);
+    wl_list_init(&ivisurf->id_entry.link);
     wl_list_init(&ivisurf->notification_list);
 
     ivisurf->committed.notify = surface_committed;
@@ -1667,6 +3676,10 @@ create_surface(struct ivishell *shell,
 
     if (shell->bkgnd_surface_id != (int32_t)id_surface) {
         wl_list_insert(&shell->list_surface, &ivisurf->link);
+        ivi_registry_insert(&shell->surface_by_layout, &ivisurf->layout_entry,
+                            (uintptr_t)layout_surface);
+        ivi_registry_insert(&shell->surface_by_id, &ivisurf->id_entry,
+                            id_surface);
 
         wl_list_for_each(controller, &shell->list_controller, link) {
             if (controller->resource)
@@ -1675,6 +3688,8 @@ create_surface(struct ivishell *shell,
 
         ivisurf->property_changed.notify = send_surface_prop;
         lyt->surface_add_listener(layout_surface, &ivisurf->property_changed);
+
+        scene_mirror_schedule(shell);
     }
     else {
         shell->bkgnd_surface = ivisurf;
@@ -1713,7 +3728,7 @@ layer_event_remove(struct wl_listener *listener, void *data)
     uint32_t id_layer = 0;
     struct notification *not, *next;
 
-    ivilayer = get_layer(&shell->list_layer, layout_layer);
+    ivilayer = get_layer(shell, layout_layer);
     if (ivilayer == NULL) {
         weston_log("id_surface is not created yet\n");
         return;
@@ -1727,6 +3742,8 @@ layer_event_remove(struct wl_listener *listener, void *data)
     }
 
     wl_list_remove(&ivilayer->link);
+    ivi_registry_remove(&shell->layer_by_layout, &ivilayer->layout_entry);
+    ivi_registry_remove(&shell->layer_by_id, &ivilayer->id_entry);
     wl_list_remove(&ivilayer->property_changed.link);
     free(ivilayer);
 
@@ -1736,6 +3753,8 @@ layer_event_remove(struct wl_listener *listener, void *data)
         if (controller->resource)
             ivi_wm_send_layer_destroyed(controller->resource, id_layer);
     }
+
+    scene_mirror_schedule(shell);
 }
 
 
@@ -1772,7 +3791,7 @@ surface_event_remove(struct wl_listener *listener, void *data)
     uint32_t id_surface = 0;
     struct notification *not, *next;
 
-    ivisurf = get_surface(&shell->list_surface, layout_surface);
+    ivisurf = ivi_shell_get_surface(shell, layout_surface);
     if (ivisurf == NULL) {
         weston_log("id_surface is not created yet\n");
         return;
@@ -1787,6 +3806,8 @@ surface_event_remove(struct wl_listener *listener, void *data)
     }
 
     wl_list_remove(&ivisurf->link);
+    ivi_registry_remove(&shell->surface_by_layout, &ivisurf->layout_entry);
+    ivi_registry_remove(&shell->surface_by_id, &ivisurf->id_entry);
     wl_list_remove(&ivisurf->property_changed.link);
     wl_list_remove(&ivisurf->committed.link);
     free(ivisurf);
@@ -1803,6 +3824,8 @@ surface_event_remove(struct wl_listener *listener, void *data)
         if (controller->resource)
             ivi_wm_send_surface_destroyed(controller->resource, id_surface);
     }
+
+    scene_mirror_schedule(shell);
 }
 
 static void
@@ -1842,12 +3865,19 @@ surface_event_configure(struct wl_listener *listener, void *data)
         return;
     }
 
-    ivisurf = get_surface(&shell->list_surface, layout_surface);
+    ivisurf = ivi_shell_get_surface(shell, layout_surface);
     if (ivisurf == NULL) {
         weston_log("id_surface is not created yet\n");
         return;
     }
 
+    /* desktop surfaces can get their id after they were created */
+    if (ivisurf->id_entry.key != surface_id) {
+        ivi_registry_remove(&shell->surface_by_id, &ivisurf->id_entry);
+        ivi_registry_insert(&shell->surface_by_id, &ivisurf->id_entry,
+                            surface_id);
+    }
+
     if (ivisurf->type == IVI_WM_SURFACE_TYPE_DESKTOP) {
         w_surface = lyt->surface_get_weston_surface(layout_surface);
         lyt->surface_set_destination_rectangle(layout_surface,
@@ -1868,6 +3898,7 @@ surface_event_configure(struct wl_listener *listener, void *data)
         send_surface_event(ctrl, ivisurf->layout_surface, surface_id, ivisurf->prop,
                            IVI_NOTIFICATION_CONFIGURE);
     }
+    scene_mirror_schedule(shell);
 }
 
 static int32_t
@@ -2034,6 +4065,8 @@ ivi_shell_destroy(struct wl_listener *listener, void *data)
 	struct ivilayer *ivilayer_next;
 	struct iviscreen *iviscrn;
 	struct iviscreen *iviscrn_next;
+	struct screenshot_pool *pool;
+	struct screenshot_pool *pool_next;
 	struct ivishell *shell =
 		wl_container_of(listener, shell, destroy_listener);
 
@@ -2072,11 +4105,26 @@ ivi_shell_destroy(struct wl_listener *listener, void *data)
 		destroy_screen(iviscrn);
 	}
 
+	if (shell->scene_mirror)
+		scene_mirror_destroy(shell->scene_mirror);
+
+	if (shell->screenshot_worker)
+		screenshot_worker_destroy(shell->screenshot_worker);
+
+	wl_list_for_each_safe(pool, pool_next,
+			      &shell->screenshot_pools, link)
+		screenshot_pool_destroy(pool);
+
+	ivi_registry_release(&shell->surface_by_layout);
+	ivi_registry_release(&shell->surface_by_id);
+	ivi_registry_release(&shell->layer_by_layout);
+	ivi_registry_release(&shell->layer_by_id);
+
 	destroy_screen_ids(shell);
 	free(shell);
 }
 
-void
+int32_t
 init_ivi_shell(struct weston_compositor *ec, struct ivishell *shell)
 {
     const struct ivi_layout_interface *lyt = shell->interface;
@@ -2089,6 +4137,20 @@ init_ivi_shell(struct weston_compositor *ec, struct ivishell *shell)
     wl_list_init(&shell->list_layer);
     wl_list_init(&shell->list_screen);
     wl_list_init(&shell->list_controller);
+    wl_list_init(&shell->screenshot_pools);
+
+    if (ivi_registry_init(&shell->surface_by_layout) < 0 ||
+        ivi_registry_init(&shell->surface_by_id) < 0 ||
+        ivi_registry_init(&shell->layer_by_layout) < 0 ||
+        ivi_registry_init(&shell->layer_by_id) < 0) {
+        /* the lookups of surfaces and layers depend on it */
+        weston_log("failed to allocate the surface and layer registry\n");
+        ivi_registry_release(&shell->surface_by_layout);
+        ivi_registry_release(&shell->surface_by_id);
+        ivi_registry_release(&shell->layer_by_layout);
+        ivi_registry_release(&shell->layer_by_id);
+        return -1;
+    }
 
     wl_list_for_each(output, &ec->output_list, link)
         create_screen(shell, output);
@@ -2127,13 +4189,15 @@ init_ivi_shell(struct weston_compositor *ec, struct ivishell *shell)
 
     wl_signal_init(&shell->ivisurface_created_signal);
     wl_signal_init(&shell->ivisurface_removed_signal);
+
+    return 0;
 }
 
 int
 setup_ivi_controller_server(struct weston_compositor *compositor,
                             struct ivishell *shell)
 {
-    if (wl_global_create(compositor->wl_display, &ivi_wm_interface, 1,
+    if (wl_global_create(compositor->wl_display, &ivi_wm_interface, 7,
                          shell, bind_ivi_controller) == NULL) {
         return -1;
     }
@@ -2276,7 +4340,13 @@ wet_module_init(struct weston_compositor *compositor,
                                   WESTON_LAYER_POSITION_BACKGROUND);
     }
 
-    init_ivi_shell(compositor, shell);
+    if (init_ivi_shell(compositor, shell) < 0) {
+        if (shell->bkgnd_surface_id && shell->ivi_client_name)
+            weston_layer_unset_position(&shell->bkgnd_layer);
+        destroy_screen_ids(shell);
+        free(shell);
+        return -1;
+    }
 
     if (setup_ivi_controller_server(compositor, shell)) {
         destroy_screen_ids(shell);
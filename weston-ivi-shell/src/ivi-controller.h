@@ -23,6 +23,8 @@
 #ifndef WESTON_IVI_SHELL_SRC_IVI_CONTROLLER_H_
 #define WESTON_IVI_SHELL_SRC_IVI_CONTROLLER_H_
 
+#include <stdint.h>
+
 #include "ivi-wm-server-protocol.h"
 #include <weston/ivi-layout-export.h>
 
@@ -39,8 +41,61 @@ timespec_to_msec(const struct timespec *a)
 	return (int64_t)a->tv_sec * 1000 + a->tv_nsec / 1000000;
 }
 
+/* Intrusive hash table over surface and layer ids or ivi_layout objects.
+ * Entries stay on the shell lists as well, so iteration order does not
+ * change. Only ivi-controller inserts and removes, other modules look up
+ * through the helpers below.
+ */
+struct ivi_registry_entry {
+    struct wl_list link;
+    uintptr_t key;
+};
+
+struct ivi_registry {
+    struct wl_list *buckets;
+    uint32_t shift;
+    uint32_t count;
+};
+
+static inline struct wl_list *
+ivi_registry_bucket(const struct ivi_registry *registry, uintptr_t key)
+{
+    uint64_t hash = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+
+    return &registry->buckets[hash >> (64 - registry->shift)];
+}
+
+static inline struct ivi_registry_entry *
+ivi_registry_lookup(const struct ivi_registry *registry, uintptr_t key)
+{
+    struct ivi_registry_entry *entry;
+
+    if (registry->buckets == NULL)
+        return NULL;
+
+    wl_list_for_each(entry, ivi_registry_bucket(registry, key), link) {
+        if (entry->key == key)
+            return entry;
+    }
+
+    return NULL;
+}
+
+/* commits of a surface remembered for its frame timing */
+#define IVI_FRAME_TIMES 128
+
+/* ring of commit times in microseconds, next is the slot written next */
+struct ivi_frame_times {
+    uint64_t commit_us[IVI_FRAME_TIMES];
+    uint32_t next;
+    uint32_t count;
+};
+
 struct ivisurface {
     struct wl_list link;
+    /* in ivishell.surface_by_layout and surface_by_id */
+    struct ivi_registry_entry layout_entry;
+    struct ivi_registry_entry id_entry;
     struct ivishell *shell;
     uint32_t update_count;
     struct ivi_layout_surface *layout_surface;
@@ -51,9 +106,15 @@ struct ivisurface {
     struct wl_list notification_list;
     enum ivi_wm_surface_type type;
     uint32_t frame_count;
+    struct ivi_frame_times frame_times;
     struct wl_list accepted_seat_list;
+    /* slot in the scene mirror, -1 if not published yet */
+    int32_t mirror_index;
 };
 
+struct scene_mirror;
+struct screenshot_worker;
+
 struct ivishell {
     struct weston_compositor *compositor;
     const struct ivi_layout_interface *interface;
@@ -62,6 +123,11 @@ struct ivishell {
     struct wl_list list_layer;
     struct wl_list list_screen;
 
+    struct ivi_registry surface_by_layout;
+    struct ivi_registry surface_by_id;
+    struct ivi_registry layer_by_layout;
+    struct ivi_registry layer_by_id;
+
     struct wl_list list_controller;
 
     struct wl_signal ivisurface_created_signal;
@@ -96,6 +162,53 @@ struct ivishell {
     struct wl_client *client;
     char *ivi_client_name;
     char *debug_scopes;
+
+    struct scene_mirror *scene_mirror;
+
+    /* screenshot buffers of every client taking screenshots */
+    struct wl_list screenshot_pools;
+    struct screenshot_worker *screenshot_worker;
 };
 
+static inline struct ivisurface *
+ivi_shell_get_surface(struct ivishell *shell,
+                      struct ivi_layout_surface *layout_surface)
+{
+    struct ivi_registry_entry *entry;
+    struct ivisurface *ivisurf;
+
+    entry = ivi_registry_lookup(&shell->surface_by_layout,
+                                (uintptr_t)layout_surface);
+    if (entry == NULL)
+        return NULL;
+
+    return wl_container_of(entry, ivisurf, layout_entry);
+}
+
+/* Surfaces are indexed by the id they had when they were created or last
+ * configured. Other ids, like the one of the background surface, are
+ * resolved through ivi-layout.
+ */
+static inline struct ivisurface *
+ivi_shell_get_surface_from_id(struct ivishell *shell, uint32_t id)
+{
+    const struct ivi_layout_interface *lyt = shell->interface;
+    struct ivi_layout_surface *layout_surface;
+    struct ivi_registry_entry *entry;
+    struct ivisurface *ivisurf;
+
+    entry = ivi_registry_lookup(&shell->surface_by_id, id);
+    if (entry != NULL) {
+        ivisurf = wl_container_of(entry, ivisurf, id_entry);
+        if (lyt->get_id_of_surface(ivisurf->layout_surface) == id)
+            return ivisurf;
+    }
+
+    layout_surface = lyt->get_surface_from_id(id);
+    if (layout_surface == NULL)
+        return NULL;
+
+    return ivi_shell_get_surface(shell, layout_surface);
+}
+
 #endif /* WESTON_IVI_SHELL_SRC_IVI_CONTROLLER_H_ */